@@ -3,7 +3,7 @@ from iocbuilder.arginfo import makeArgInfo, Simple
 from iocbuilder.modules.asyn import Asyn
 from iocbuilder.modules.ethercat.devices import SdoControl, SdoEntryControlWithTemplate
 
-from core import AnalogInputModule, base_arginfo_args
+from core import AnalogInputModule, base_arginfo_args, publisher_arginfo_args
 
 #==============================================================================
 # Custom templates
@@ -17,6 +17,14 @@ class _ELM3704ChannelTemplate(AutoSubstitution):
     TemplateFile = "ethercat_gui_ELM3704_channel.template"
 
 
+class _ELM3704AcquisitionModuleTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_ELM3704_acquisition_module.template"
+
+
+class _ELM3704AcquisitionChannelTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_ELM3704_acquisition_channel.template"
+
+
 #==============================================================================
 # Module templates
 #==============================================================================
@@ -24,7 +32,7 @@ class _ELM3704ChannelTemplate(AutoSubstitution):
 
 class EL3104(AnalogInputModule):
 
-    def __init__(self, name, slave, P, R, SCAN="1 second"):
+    def __init__(self, name, slave, P, R, SCAN="1 second", publish_changes=False, heartbeat=10.0):
         self.__super.__init__(
             name,
             slave,
@@ -33,10 +41,12 @@ class EL3104(AnalogInputModule):
             value_entry="AIStandardChannel{ch}.Value",
             measurement_type="Analog input",
             measurement_subtype="+/-10V",
-            SCAN=SCAN
+            SCAN=SCAN,
+            publish_changes=publish_changes,
+            heartbeat=heartbeat
         )
 
-    ArgInfo = makeArgInfo(__init__, **base_arginfo_args)
+    ArgInfo = makeArgInfo(__init__, **dict(base_arginfo_args, **publisher_arginfo_args))
 
 
 class ELM3704(AnalogInputModule):
@@ -47,17 +57,31 @@ class ELM3704(AnalogInputModule):
     DbdFileList = ['ethercatUtil']
     LibFileList = ['ethercatUtil']
 
-    def __init__(self, name, slave, P, R, SCAN="1 second", simulation=False):
+    def __init__(
+            self,
+            name,
+            slave,
+            P,
+            R,
+            SCAN="1 second",
+            simulation=False,
+            oversampling=1,
+            acquisition=False):
         # Create name for the asynPortDriver port for handling configuration
         self.logic_port = slave.name + ":LOGIC"
 
+        # Create name for the asynPortDriver port for processing sample data
+        self.acquisition = acquisition
+        self.acquisition_port = slave.name + ":ACQ"
+        self.oversampling = oversampling
+
         # Call base class init
         self.__super.__init__(
             name,
             slave,
             P,
             R,
-            value_entry="PAISamples1Channel{ch}.Samples__ARRAY[0]",
+            value_entry="PAISamples%dChannel{ch}.Samples__ARRAY[0]" % oversampling,
             SCAN=SCAN
         )
 
@@ -68,6 +92,8 @@ class ELM3704(AnalogInputModule):
     ArgInfo = makeArgInfo(
         __init__,
         simulation=Simple("If simulated, disable SDO creation requests", bool),
+        oversampling=Simple("Number of samples per channel in each PDO (1, 2, 5, 10, ...)", int),
+        acquisition=Simple("Create the driver for filtering the oversampled data", bool),
         **base_arginfo_args
     )
 
@@ -82,6 +108,12 @@ class ELM3704(AnalogInputModule):
             PORT=self.port,
             SCAN=self.scan
         )
+        if self.acquisition:
+            _ELM3704AcquisitionModuleTemplate(
+                P=self.p,
+                R=self.r,
+                ACQPORT=self.acquisition_port
+            )
 
     def make_channel_template(self, channel, entry):
         _ELM3704ChannelTemplate(
@@ -93,6 +125,14 @@ class ELM3704(AnalogInputModule):
             ENTRY=entry,
             SCAN=self.scan
         )
+        if self.acquisition:
+            _ELM3704AcquisitionChannelTemplate(
+                P=self.p,
+                R=self.r,
+                CHANNEL=channel,
+                ACQPORT=self.acquisition_port,
+                NSAMPLES=self.oversampling
+            )
 
     def InitialiseOnce(self):
         print("# Creating ELM3704 driver for handling configuration logic")
@@ -103,6 +143,15 @@ class ELM3704(AnalogInputModule):
                 logic_port=self.logic_port, slave_port=self.port
             )
         )
+        if self.acquisition:
+            print(
+                "ELM3704AcquisitionConfigure(\"{acquisition_port}\", \"{slave_port}\", {oversampling}, \"{logic_port}\")".format(
+                    acquisition_port=self.acquisition_port,
+                    slave_port=self.port,
+                    oversampling=self.oversampling,
+                    logic_port=self.logic_port
+                )
+            )
 
     def create_sdo_interface(self, slave):
         """
@@ -1,12 +1,23 @@
 from iocbuilder.arginfo import ArgInfo, makeArgInfo
 
-from core import AnalogOutputModule, base_arginfo_args
+from core import AnalogOutputModule, base_arginfo_args, generator_arginfo_args
 
 
 class EL4134(AnalogOutputModule):
     ''' GUI for EL4134 analog output module '''
 
-    def __init__(self, name, slave, P, R, SCAN="1 second"):
+    def __init__(
+            self,
+            name,
+            slave,
+            P,
+            R,
+            SCAN="1 second",
+            generate_setpoints=False,
+            cycle_port="",
+            cycle_entry="",
+            cycle_period=0.001,
+            setpoint_points=1024):
         self.__super.__init__(
             name,
             slave,
@@ -15,7 +26,12 @@ class EL4134(AnalogOutputModule):
             value_entry="AOOutputChannel{ch}.Analogoutput",
             measurement_type="Analog output",
             measurement_subtype="+/-10V",
-            SCAN=SCAN
+            SCAN=SCAN,
+            generate_setpoints=generate_setpoints,
+            cycle_port=cycle_port,
+            cycle_entry=cycle_entry,
+            cycle_period=cycle_period,
+            setpoint_points=setpoint_points
         )
 
-    ArgInfo = makeArgInfo(__init__, **base_arginfo_args)
+    ArgInfo = makeArgInfo(__init__, **dict(base_arginfo_args, **generator_arginfo_args))
@@ -1,5 +1,6 @@
 from iocbuilder import AutoSubstitution, Device
 from iocbuilder.arginfo import Choice, Ident, makeArgInfo, Simple
+from iocbuilder.modules.asyn import Asyn
 from iocbuilder.modules.calc import Calc
 from iocbuilder.modules.ethercat import EthercatSlave
 
@@ -27,6 +28,31 @@ base_arginfo_args = {
 }
 
 
+publisher_arginfo_args = {
+    "publish_changes": Simple("Publish raw values on change (I/O Intr) instead of scanning them", bool),
+    "heartbeat": Simple("Seconds after which an unchanged value is published again (0 to disable)", float)
+}
+
+
+batch_arginfo_args = {
+    "batch_outputs": Simple("Write output changes together on the next cycle", bool),
+    "cycle_port": Simple("Asyn port with an entry which changes every cycle (optional)", str),
+    "cycle_entry": Simple("Entry which changes every cycle, e.g. an input cycle counter (optional)", str),
+    "cycle_period": Simple("Cycle period in seconds, used without a cycle entry", float),
+    "sequence_outputs": Simple("Add a cycle-timed pulse and sequence generator for the outputs (not with batch_outputs)", bool),
+    "sequence_steps": Simple("Maximum number of steps in the sequence table", int)
+}
+
+
+generator_arginfo_args = {
+    "generate_setpoints": Simple("Add a ramp and waveform setpoint generator written every cycle", bool),
+    "cycle_port": Simple("Asyn port with an entry which changes every cycle (optional)", str),
+    "cycle_entry": Simple("Entry which changes every cycle, e.g. an input cycle counter (optional)", str),
+    "cycle_period": Simple("Cycle period in seconds", float),
+    "setpoint_points": Simple("Maximum number of points in a setpoint table", int)
+}
+
+
 #==============================================================================
 # Module templates
 #==============================================================================
@@ -51,6 +77,10 @@ class _EthercatPowerSupplyModuleTemplate(AutoSubstitution):
     TemplateFile = "ethercat_gui_power_supply_module.template"
 
 
+class _PowerSupplyMonitorTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_power_supply_monitor.template"
+
+
 #==============================================================================
 # Channel templates
 #==============================================================================
@@ -67,6 +97,191 @@ class _EthercatGuiAnalogOutputChannelTemplate(AutoSubstitution):
     TemplateFile = "ethercat_gui_analog_output_channel.template"
 
 
+#==============================================================================
+# Driver templates
+#==============================================================================
+
+class _ChangePublisherModuleTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_change_publisher_module.template"
+
+
+class _ChangePublisherChannelTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_change_publisher_channel.template"
+
+
+class _DigitalInputFanoutModuleTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_digital_input_fanout_module.template"
+
+
+class _DigitalOutputBatchModuleTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_digital_output_batch_module.template"
+
+
+class _OutputSequencerModuleTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_output_sequencer_module.template"
+
+
+class _SetpointGeneratorModuleTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_setpoint_generator_module.template"
+
+
+class _SetpointGeneratorChannelTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_setpoint_generator_channel.template"
+
+
+#==============================================================================
+# Drivers
+#==============================================================================
+
+class _ChangePublisher(Device):
+    ''' Driver publishing the input values of a slave module when they change '''
+
+    Dependencies = (Asyn,)
+
+    DbdFileList = ['ethercatUtil']
+    LibFileList = ['ethercatUtil']
+
+    def __init__(self, port, slave_port, entry_format, channels, heartbeat):
+        self.__super.__init__()
+        self.port = port
+        self.slave_port = slave_port
+        self.entry_format = entry_format
+        self.channels = channels
+        self.heartbeat = heartbeat
+
+    def InitialiseOnce(self):
+        print("# Creating drivers for publishing input values on change")
+
+    def Initialise(self):
+        print(
+            "ChangePublisherConfigure(\"{port}\", \"{slave_port}\", \"{entry_format}\", {channels}, {heartbeat})".format(
+                port=self.port,
+                slave_port=self.slave_port,
+                entry_format=self.entry_format,
+                channels=self.channels,
+                heartbeat=self.heartbeat
+            )
+        )
+
+
+class _DigitalOutputBatcher(Device):
+    ''' Driver writing the outputs of a digital output module together each cycle '''
+
+    Dependencies = (Asyn,)
+
+    DbdFileList = ['ethercatUtil']
+    LibFileList = ['ethercatUtil']
+
+    def __init__(self, port, slave_port, entry_format, channels, cycle_port, cycle_entry, cycle_period):
+        self.__super.__init__()
+        self.port = port
+        self.slave_port = slave_port
+        self.entry_format = entry_format
+        self.channels = channels
+        self.cycle_port = cycle_port
+        self.cycle_entry = cycle_entry
+        self.cycle_period = cycle_period
+
+    def InitialiseOnce(self):
+        print("# Creating drivers for batching digital output writes")
+
+    def Initialise(self):
+        print(
+            "DigitalOutputBatcherConfigure(\"{port}\", \"{slave_port}\", \"{entry_format}\", {channels}, \"{cycle_port}\", \"{cycle_entry}\", {cycle_period})".format(
+                port=self.port,
+                slave_port=self.slave_port,
+                entry_format=self.entry_format,
+                channels=self.channels,
+                cycle_port=self.cycle_port,
+                cycle_entry=self.cycle_entry,
+                cycle_period=self.cycle_period
+            )
+        )
+
+
+class _OutputSequencer(Device):
+    ''' Driver playing cycle-timed pulses and sequences on digital outputs '''
+
+    Dependencies = (Asyn,)
+
+    DbdFileList = ['ethercatUtil']
+    LibFileList = ['ethercatUtil']
+
+    def __init__(self, port, slave_port, entry_format, channels, cycle_port, cycle_entry, cycle_period, max_steps):
+        self.__super.__init__()
+        self.port = port
+        self.slave_port = slave_port
+        self.entry_format = entry_format
+        self.channels = channels
+        self.cycle_port = cycle_port
+        self.cycle_entry = cycle_entry
+        self.cycle_period = cycle_period
+        self.max_steps = max_steps
+
+    def InitialiseOnce(self):
+        print("# Creating drivers for sequencing digital outputs")
+
+    def Initialise(self):
+        print(
+            "OutputSequencerConfigure(\"{port}\", \"{slave_port}\", \"{entry_format}\", {channels}, \"{cycle_port}\", \"{cycle_entry}\", {cycle_period}, {max_steps})".format(
+                port=self.port,
+                slave_port=self.slave_port,
+                entry_format=self.entry_format,
+                channels=self.channels,
+                cycle_port=self.cycle_port,
+                cycle_entry=self.cycle_entry,
+                cycle_period=self.cycle_period,
+                max_steps=self.max_steps
+            )
+        )
+
+
+class _SetpointGenerator(Device):
+    ''' Driver generating the setpoints of analog outputs every cycle '''
+
+    Dependencies = (Asyn,)
+
+    DbdFileList = ['ethercatUtil']
+    LibFileList = ['ethercatUtil']
+
+    def __init__(self, port, slave_port, entry_format, channels, cycle_port, cycle_entry, cycle_period,
+                 raw_low, raw_high, low, high, max_points):
+        self.__super.__init__()
+        self.port = port
+        self.slave_port = slave_port
+        self.entry_format = entry_format
+        self.channels = channels
+        self.cycle_port = cycle_port
+        self.cycle_entry = cycle_entry
+        self.cycle_period = cycle_period
+        self.raw_low = raw_low
+        self.raw_high = raw_high
+        self.low = low
+        self.high = high
+        self.max_points = max_points
+
+    def InitialiseOnce(self):
+        print("# Creating drivers for generating analog output setpoints")
+
+    def Initialise(self):
+        print(
+            "SetpointGeneratorConfigure(\"{port}\", \"{slave_port}\", \"{entry_format}\", {channels}, \"{cycle_port}\", \"{cycle_entry}\", {cycle_period}, {raw_low}, {raw_high}, {low}, {high}, {max_points})".format(
+                port=self.port,
+                slave_port=self.slave_port,
+                entry_format=self.entry_format,
+                channels=self.channels,
+                cycle_port=self.cycle_port,
+                cycle_entry=self.cycle_entry,
+                cycle_period=self.cycle_period,
+                raw_low=self.raw_low,
+                raw_high=self.raw_high,
+                low=self.low,
+                high=self.high,
+                max_points=self.max_points
+            )
+        )
+
+
 #==============================================================================
 # Base module class
 #==============================================================================
@@ -80,6 +295,9 @@ class EthercatSlaveModule(Device):
     # Module dependencies
     Dependencies = (Calc,)
 
+    # Record holding each channel's value, after CH<n>: (None without channel values)
+    channel_value_suffix = None
+
     def __init__(
             self,
             name,
@@ -90,7 +308,9 @@ class EthercatSlaveModule(Device):
             value_entry=None,
             measurement_type="Default",
             measurement_subtype="Default",
-            SCAN="1 second"):
+            SCAN="1 second",
+            publish_changes=False,
+            heartbeat=10.0):
         # Initialise base class
         self.__super.__init__()
 
@@ -109,6 +329,19 @@ class EthercatSlaveModule(Device):
         self.type = slave.chainelem.type
         self.port = slave.name
 
+        # Optional driver publishing the raw values on change
+        self.publish_changes = publish_changes and value_entry is not None
+        self.publisher_port = slave.name + ":PUB"
+        if self.publish_changes:
+            _ChangePublisher(
+                self.publisher_port,
+                self.port,
+                self.value_entry.format(ch="%d"),
+                self.channels,
+                heartbeat
+            )
+            _ChangePublisherModuleTemplate(P=self.p, R=self.r, PUBPORT=self.publisher_port)
+
         # Module-level template
         self.make_module_template()
 
@@ -116,6 +349,8 @@ class EthercatSlaveModule(Device):
         for channel in range(1, self.channels+1):
             entry = self._get_entry_name(channel)
             self.make_channel_template(channel, entry)
+            if self.publish_changes:
+                _ChangePublisherChannelTemplate(P=self.p, R=self.r, CHANNEL=channel, PUBPORT=self.publisher_port)
 
     def _get_entry_name(self, channel):
         if self.value_entry:
@@ -124,6 +359,14 @@ class EthercatSlaveModule(Device):
         else:
             return None
 
+    def raw_value_args(self):
+        ''' Port, scan and monitor deadband for records reading the raw value '''
+        if self.publish_changes:
+            # Every callback is a change outside the deadband or a heartbeat
+            return dict(PORT=self.publisher_port, SCAN="I/O Intr", MDEL=-1)
+        else:
+            return dict(PORT=self.port, SCAN=self.scan)
+
     def make_module_template(self):
         raise NotImplementedError(
             "{name}: no module template found. Please use one of the module type classes.".format(
@@ -142,7 +385,7 @@ class EthercatSlaveModule(Device):
         value_entry          = Simple("PDO entry name for raw value. Can use {ch} to sub in channel number", str),
         measurement_type     = Simple("Measurement type", str),
         measurement_subtype  = Simple("Measurement subtype", str),
-        **base_arginfo_args
+        **dict(base_arginfo_args, **publisher_arginfo_args)
     )
 
 
@@ -152,6 +395,30 @@ class EthercatSlaveModule(Device):
 
 class DigitalInputModule(EthercatSlaveModule):
 
+    # Record holding each channel's value, after CH<n>:
+    channel_value_suffix = "VAL"
+
+    def __init__(self, name, slave, P, R, fanout=None, **kwargs):
+        # Register with the fan-out driver before the templates are created
+        self.fanout = fanout
+        if fanout:
+            self.fanout_addr = fanout.add_module(
+                slave.name,
+                kwargs["value_entry"].format(ch="%d"),
+                kwargs.get("channels", 4)
+            )
+            kwargs["publish_changes"] = False
+
+        self.__super.__init__(name, slave, P, R, **kwargs)
+
+    def raw_value_args(self):
+        # Bits read through the fan-out driver are called back when they change,
+        # and read once at iocInit for the value published when the module was added
+        if self.fanout:
+            return dict(PORT=self.fanout.port, ADDR=self.fanout_addr, SCAN="I/O Intr", PINI="YES")
+        else:
+            return self.__super.raw_value_args()
+
     def make_module_template(self):
         _EthercatGuiDigitalInputModuleTemplate(
             name=self.name,
@@ -162,6 +429,13 @@ class DigitalInputModule(EthercatSlaveModule):
             PORT=self.port,
             SCAN=self.scan
         )
+        if self.fanout:
+            _DigitalInputFanoutModuleTemplate(
+                P=self.p,
+                R=self.r,
+                FANOUTPORT=self.fanout.port,
+                ADDR=self.fanout_addr
+            )
 
     def make_channel_template(self, channel, entry):
         _EthercatGuiInputChannelTemplate(
@@ -170,14 +444,62 @@ class DigitalInputModule(EthercatSlaveModule):
             CHANNEL=channel,
             TYPE=self.measurement_type,
             SUBTYPE=self.measurement_subtype,
-            PORT=self.port,
             ENTRY=entry,
-            SCAN=self.scan
+            **self.raw_value_args()
         )
 
 
 class DigitalOutputModule(EthercatSlaveModule):
 
+    # Record holding each channel's value, after CH<n>:
+    channel_value_suffix = "OUTPUT:RBV"
+
+    def __init__(
+            self,
+            name,
+            slave,
+            P,
+            R,
+            batch_outputs=False,
+            cycle_port="",
+            cycle_entry="",
+            cycle_period=0.001,
+            sequence_outputs=False,
+            sequence_steps=64,
+            **kwargs):
+        # Optional drivers writing the outputs together and sequencing them, created before the templates.
+        # Both keep their own copy of the output word, so only one of them may write it.
+        assert not (batch_outputs and sequence_outputs), \
+            "{name}: batch_outputs and sequence_outputs cannot both be enabled".format(name=name)
+        self.batch_outputs = batch_outputs
+        self.batch_port = slave.name + ":BATCH"
+        if batch_outputs:
+            _DigitalOutputBatcher(
+                self.batch_port,
+                slave.name,
+                kwargs["value_entry"].format(ch="%d"),
+                kwargs.get("channels", 4),
+                cycle_port,
+                cycle_entry,
+                cycle_period
+            )
+        self.sequence_outputs = sequence_outputs
+        self.sequence_port = slave.name + ":SEQ"
+        self.sequence_steps = sequence_steps
+        if sequence_outputs:
+            _OutputSequencer(
+                self.sequence_port,
+                slave.name,
+                kwargs["value_entry"].format(ch="%d"),
+                kwargs.get("channels", 4),
+                cycle_port,
+                cycle_entry,
+                cycle_period,
+                sequence_steps
+            )
+
+        self.__super.__init__(name, slave, P, R, **kwargs)
+
     def make_module_template(self):
         _EthercatGuiDigitalOutputModuleTemplate(
             name=self.name,
@@ -188,21 +510,44 @@ class DigitalOutputModule(EthercatSlaveModule):
             PORT=self.port,
             SCAN=self.scan
         )
+        if self.batch_outputs:
+            _DigitalOutputBatchModuleTemplate(
+                P=self.p,
+                R=self.r,
+                BATCHPORT=self.batch_port,
+                MASK=hex((1 << self.channels) - 1)
+            )
+        if self.sequence_outputs:
+            _OutputSequencerModuleTemplate(
+                P=self.p,
+                R=self.r,
+                SEQPORT=self.sequence_port,
+                NSTEPS=self.sequence_steps
+            )
 
     def make_channel_template(self, channel, entry):
+        if self.batch_outputs:
+            # Outputs go through the batching driver, which calls back on readback
+            # and has the initial outputs before iocInit
+            output_args = dict(PORT=self.batch_port, RBV_SCAN="I/O Intr", RBV_PINI="YES")
+        else:
+            output_args = dict(PORT=self.port)
         _EthercatGuiDigitalOutputChannelTemplate(
             P=self.p,
             R=self.r,
             CHANNEL=channel,
             TYPE=self.measurement_type,
             SUBTYPE=self.measurement_subtype,
-            PORT=self.port,
-            ENTRY=entry
+            ENTRY=entry,
+            **output_args
         )
 
 
 class AnalogInputModule(EthercatSlaveModule):
 
+    # Record holding each channel's value, after CH<n>:
+    channel_value_suffix = "VAL"
+
     def make_module_template(self):
         _EthercatGuiAnalogInputModuleTemplate(
             name=self.name,
@@ -221,14 +566,56 @@ class AnalogInputModule(EthercatSlaveModule):
             CHANNEL=channel,
             TYPE=self.measurement_type,
             SUBTYPE=self.measurement_subtype,
-            PORT=self.port,
             ENTRY=entry,
-            SCAN=self.scan
+            **self.raw_value_args()
         )
 
 
 class AnalogOutputModule(EthercatSlaveModule):
 
+    # Record holding each channel's value, after CH<n>:
+    channel_value_suffix = "OUTPUT:RBV"
+
+    # Output range in raw counts and volts
+    raw_low = -32768
+    raw_high = 32767
+    egu_low = -10.0
+    egu_high = 10.0
+
+    def __init__(
+            self,
+            name,
+            slave,
+            P,
+            R,
+            generate_setpoints=False,
+            cycle_port="",
+            cycle_entry="",
+            cycle_period=0.001,
+            setpoint_points=1024,
+            **kwargs):
+        # Optional driver generating the setpoints, created before the templates
+        self.generate_setpoints = generate_setpoints
+        self.generator_port = slave.name + ":GEN"
+        self.setpoint_points = setpoint_points
+        if generate_setpoints:
+            _SetpointGenerator(
+                self.generator_port,
+                slave.name,
+                kwargs["value_entry"].format(ch="%d"),
+                kwargs.get("channels", 4),
+                cycle_port,
+                cycle_entry,
+                cycle_period,
+                self.raw_low,
+                self.raw_high,
+                self.egu_low,
+                self.egu_high,
+                setpoint_points
+            )
+
+        self.__super.__init__(name, slave, P, R, **kwargs)
+
     def make_module_template(self):
         _EthercatGuiAnalogOutputModuleTemplate(
             name=self.name,
@@ -239,8 +626,12 @@ class AnalogOutputModule(EthercatSlaveModule):
             PORT=self.port,
             SCAN=self.scan
         )
+        if self.generate_setpoints:
+            _SetpointGeneratorModuleTemplate(P=self.p, R=self.r, GENPORT=self.generator_port)
 
     def make_channel_template(self, channel, entry):
+        # The slave port calls back on each generated setpoint
+        rbv_scan = "I/O Intr" if self.generate_setpoints else "1 second"
         _EthercatGuiAnalogOutputChannelTemplate(
             P=self.p,
             R=self.r,
@@ -250,16 +641,51 @@ class AnalogOutputModule(EthercatSlaveModule):
             PORT=self.port,
             ENTRY=entry,
             EGU="V",
-            EGUF=10.0,
-            EGUL=-10.0,
-            DRVH=10.0,
-            DRVL=-10.0
+            EGUF=self.egu_high,
+            EGUL=self.egu_low,
+            DRVH=self.egu_high,
+            DRVL=self.egu_low,
+            RBV_SCAN=rbv_scan
         )
+        if self.generate_setpoints:
+            _SetpointGeneratorChannelTemplate(
+                P=self.p,
+                R=self.r,
+                CHANNEL=channel,
+                GENPORT=self.generator_port,
+                EGU="V",
+                DRVH=self.egu_high,
+                DRVL=self.egu_low,
+                NPOINTS=self.setpoint_points
+            )
 
 
 class PowerSupplyModule(EthercatSlaveModule):
 
+    # Status PDO entries of the supply
+    power_ok_entry = "StatusUo.PowerOK"
+    overload_entry = "StatusUo.Overload"
+
+    def __init__(self, name, slave, P, R, monitor=None, **kwargs):
+        # Register with the monitor driver before the templates are created
+        self.monitor = monitor
+        if monitor:
+            self.monitor_addr = monitor.add_terminal(slave.name, self.power_ok_entry, self.overload_entry)
+
+        self.__super.__init__(name, slave, P, R, **kwargs)
+
     def make_module_template(self):
+        # Bits read through the monitor driver are called back when they change
+        if self.monitor:
+            status_args = dict(
+                PSPORT=self.monitor.port,
+                PSADDR=self.monitor_addr,
+                PSSCAN="I/O Intr",
+                POWER_OK="POWER_OK",
+                OVERLOAD="OVERLOAD"
+            )
+        else:
+            status_args = dict(POWER_OK=self.power_ok_entry, OVERLOAD=self.overload_entry)
         _EthercatPowerSupplyModuleTemplate(
             name=self.name,
             P=self.p,
@@ -269,6 +695,12 @@ class PowerSupplyModule(EthercatSlaveModule):
             SUBTYPE=self.measurement_subtype,
             PORT=self.port,
             SCAN=self.scan,
-            POWER_OK="StatusUo.PowerOK",
-            OVERLOAD="StatusUo.Overload"
+            **status_args
         )
+        if self.monitor:
+            _PowerSupplyMonitorTemplate(
+                P=self.p,
+                R=self.r,
+                PSUPORT=self.monitor.port,
+                ADDR=self.monitor_addr
+            )
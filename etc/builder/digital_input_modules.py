@@ -1,12 +1,63 @@
-from iocbuilder.arginfo import ArgInfo, makeArgInfo
+from iocbuilder import Device
+from iocbuilder.arginfo import ArgInfo, Ident, makeArgInfo, Simple
+from iocbuilder.modules.asyn import Asyn
 
-from core import DigitalInputModule, base_arginfo_args
+from core import DigitalInputModule, base_arginfo_args, publisher_arginfo_args
+
+
+class DigitalInputFanout(Device):
+    ''' Driver reading the inputs of digital input modules as packed words '''
+
+    Dependencies = (Asyn,)
+
+    DbdFileList = ['ethercatUtil']
+    LibFileList = ['ethercatUtil']
+
+    def __init__(self, name, max_modules=8):
+        self.__super.__init__()
+        self.name = name
+        self.port = name
+        self.max_modules = max_modules
+        self.modules = []
+
+    def add_module(self, slave_port, entry_format, channels):
+        ''' Add a module and return its asyn address on this port '''
+        addr = len(self.modules)
+        assert addr < self.max_modules, \
+            "{name}: more than {max} modules".format(name=self.name, max=self.max_modules)
+        self.modules.append((slave_port, entry_format, channels))
+        return addr
+
+    def InitialiseOnce(self):
+        print("# Creating drivers for reading packed digital inputs")
+
+    def Initialise(self):
+        print("DigitalInputFanoutConfigure(\"{port}\", {max_modules})".format(
+            port=self.port, max_modules=self.max_modules
+        ))
+        for addr, (slave_port, entry_format, channels) in enumerate(self.modules):
+            print("DigitalInputFanoutAddModule(\"{port}\", {addr}, \"{slave_port}\", \"{entry_format}\", {channels})".format(
+                port=self.port, addr=addr, slave_port=slave_port, entry_format=entry_format, channels=channels
+            ))
+
+    ArgInfo = makeArgInfo(
+        __init__,
+        name=Simple("Object and asyn port name", str),
+        max_modules=Simple("Maximum number of modules", int)
+    )
+
+
+digital_input_arginfo_args = dict(
+    base_arginfo_args,
+    fanout=Ident("Read the inputs through this fan-out driver (overrides publish_changes)", DigitalInputFanout),
+    **publisher_arginfo_args
+)
 
 
 class EL1014(DigitalInputModule):
     ''' GUI for EL1014 24V digital input module '''
 
-    def __init__(self, name, slave, P, R, SCAN="1 second"):
+    def __init__(self, name, slave, P, R, SCAN="1 second", publish_changes=False, heartbeat=10.0, fanout=None):
         self.__super.__init__(
             name,
             slave,
@@ -15,16 +66,19 @@ class EL1014(DigitalInputModule):
             value_entry="Channel{ch}.Input",
             measurement_type="Digital input",
             measurement_subtype="24V",
-            SCAN=SCAN
+            SCAN=SCAN,
+            publish_changes=publish_changes,
+            heartbeat=heartbeat,
+            fanout=fanout
         )
 
-    ArgInfo = makeArgInfo(__init__, **base_arginfo_args)
+    ArgInfo = makeArgInfo(__init__, **digital_input_arginfo_args)
 
 
 class EL1124(DigitalInputModule):
     ''' GUI for EL1124 5V digital input module '''
 
-    def __init__(self, name, slave, P, R, SCAN="1 second"):
+    def __init__(self, name, slave, P, R, SCAN="1 second", publish_changes=False, heartbeat=10.0, fanout=None):
         self.__super.__init__(
             name,
             slave,
@@ -33,7 +87,10 @@ class EL1124(DigitalInputModule):
             value_entry="Channel{ch}.Input",
             measurement_type="Digital input",
             measurement_subtype="5V",
-            SCAN=SCAN
+            SCAN=SCAN,
+            publish_changes=publish_changes,
+            heartbeat=heartbeat,
+            fanout=fanout
         )
 
-    ArgInfo = makeArgInfo(__init__, **base_arginfo_args)
+    ArgInfo = makeArgInfo(__init__, **digital_input_arginfo_args)
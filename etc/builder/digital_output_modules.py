@@ -1,12 +1,24 @@
 from iocbuilder.arginfo import ArgInfo, makeArgInfo
 
-from core import DigitalOutputModule, base_arginfo_args
+from core import DigitalOutputModule, base_arginfo_args, batch_arginfo_args
 
 
 class EL2124(DigitalOutputModule):
     ''' GUI for EL2124 5V digital output module '''
 
-    def __init__(self, name, slave, P, R, SCAN="1 second"):
+    def __init__(
+            self,
+            name,
+            slave,
+            P,
+            R,
+            SCAN="1 second",
+            batch_outputs=False,
+            cycle_port="",
+            cycle_entry="",
+            cycle_period=0.001,
+            sequence_outputs=False,
+            sequence_steps=64):
         self.__super.__init__(
             name,
             slave,
@@ -15,16 +27,34 @@ class EL2124(DigitalOutputModule):
             value_entry="Channel{ch}.Output",
             measurement_type="Digital output",
             measurement_subtype="5V",
-            SCAN=SCAN
+            SCAN=SCAN,
+            batch_outputs=batch_outputs,
+            cycle_port=cycle_port,
+            cycle_entry=cycle_entry,
+            cycle_period=cycle_period,
+            sequence_outputs=sequence_outputs,
+            sequence_steps=sequence_steps
         )
 
-    ArgInfo = makeArgInfo(__init__, **base_arginfo_args)
+    ArgInfo = makeArgInfo(__init__, **dict(base_arginfo_args, **batch_arginfo_args))
 
 
 class EL2624(DigitalOutputModule):
     ''' GUI for EL2624 125V AC / 30V DC relay output module '''
 
-    def __init__(self, name, slave, P, R, SCAN="1 second"):
+    def __init__(
+            self,
+            name,
+            slave,
+            P,
+            R,
+            SCAN="1 second",
+            batch_outputs=False,
+            cycle_port="",
+            cycle_entry="",
+            cycle_period=0.001,
+            sequence_outputs=False,
+            sequence_steps=64):
         self.__super.__init__(
             name,
             slave,
@@ -33,7 +63,13 @@ class EL2624(DigitalOutputModule):
             value_entry="Channel{ch}.Output",
             measurement_type="Relay output",
             measurement_subtype="125V AC / 30V DC",
-            SCAN=SCAN
+            SCAN=SCAN,
+            batch_outputs=batch_outputs,
+            cycle_port=cycle_port,
+            cycle_entry=cycle_entry,
+            cycle_period=cycle_period,
+            sequence_outputs=sequence_outputs,
+            sequence_steps=sequence_steps
         )
 
-    ArgInfo = makeArgInfo(__init__, **base_arginfo_args)
+    ArgInfo = makeArgInfo(__init__, **dict(base_arginfo_args, **batch_arginfo_args))
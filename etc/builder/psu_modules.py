@@ -1,12 +1,62 @@
-from iocbuilder.arginfo import ArgInfo, makeArgInfo
+from iocbuilder import Device
+from iocbuilder.arginfo import ArgInfo, Ident, makeArgInfo, Simple
+from iocbuilder.modules.asyn import Asyn
 
 from core import PowerSupplyModule, base_arginfo_args
 
 
+class PowerSupplyMonitor(Device):
+    ''' Driver following the status bits of power supply terminals every cycle '''
+
+    Dependencies = (Asyn,)
+
+    DbdFileList = ['ethercatUtil']
+    LibFileList = ['ethercatUtil']
+
+    def __init__(self, name, max_terminals=8):
+        self.__super.__init__()
+        self.name = name
+        self.port = name
+        self.max_terminals = max_terminals
+        self.terminals = []
+
+    def add_terminal(self, slave_port, power_ok_entry, overload_entry):
+        ''' Add a terminal and return its asyn address on this port '''
+        addr = len(self.terminals)
+        assert addr < self.max_terminals, \
+            "{name}: more than {max} terminals".format(name=self.name, max=self.max_terminals)
+        self.terminals.append((slave_port, power_ok_entry, overload_entry))
+        return addr
+
+    def InitialiseOnce(self):
+        print("# Creating drivers for monitoring power supply terminals")
+
+    def Initialise(self):
+        print("PowerSupplyMonitorConfigure(\"{port}\", {max_terminals})".format(
+            port=self.port, max_terminals=self.max_terminals
+        ))
+        for addr, (slave_port, power_ok_entry, overload_entry) in enumerate(self.terminals):
+            print("PowerSupplyMonitorAddTerminal(\"{port}\", {addr}, \"{slave_port}\", \"{power_ok}\", \"{overload}\")".format(
+                port=self.port, addr=addr, slave_port=slave_port, power_ok=power_ok_entry, overload=overload_entry
+            ))
+
+    ArgInfo = makeArgInfo(
+        __init__,
+        name=Simple("Object and asyn port name", str),
+        max_terminals=Simple("Maximum number of terminals", int)
+    )
+
+
+psu_arginfo_args = dict(
+    base_arginfo_args,
+    monitor=Ident("Follow the status bits every cycle with this monitor driver", PowerSupplyMonitor)
+)
+
+
 class EL9505(PowerSupplyModule):
     ''' GUI for EL9505 power supply module '''
 
-    def __init__(self, name, slave, P, R, SCAN="1 second"):
+    def __init__(self, name, slave, P, R, SCAN="1 second", monitor=None):
         self.__super.__init__(
             name,
             slave,
@@ -16,7 +66,8 @@ class EL9505(PowerSupplyModule):
             value_entry=None,
             measurement_type="Power supply",
             measurement_subtype="5V DC",
-            SCAN=SCAN
+            SCAN=SCAN,
+            monitor=monitor
         )
 
-    ArgInfo = makeArgInfo(__init__, **base_arginfo_args)
+    ArgInfo = makeArgInfo(__init__, **psu_arginfo_args)
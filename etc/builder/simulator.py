@@ -1,5 +1,5 @@
 from iocbuilder import Device
-from iocbuilder.arginfo import makeArgInfo, Simple
+from iocbuilder.arginfo import makeArgInfo, Simple, Ident
 
 
 # Core builder functionality requires these attributes to be set for slave modules
@@ -8,27 +8,78 @@ class _SimChainElem:
         self.position = position
         self.type = type
 
+class SimMailbox(Device):
+    """Shared mailbox of a simulated master, serialising the SDO writes of its slaves"""
+
+    def __init__(self, name, service_time=0.005):
+        self.__super.__init__()
+        self.name = name
+        self.service_time = service_time
+
+    def Initialise(self):
+        print("SimMailboxConfigure(\"{name}\", {service_time})".format(
+            name=self.name, service_time=self.service_time
+        ))
+
+    ArgInfo = makeArgInfo(
+        __init__,
+        name = Simple("Mailbox name", str),
+        service_time = Simple("Time each SDO transfer holds the mailbox in seconds", float),
+    )
+
 class SimELM3704SdoPortDriver(Device):
     """Simulate the SDO asynPortDriver for the ELM3704"""
 
-    def __init__(self, name, position=4, type="ELM3704-0000"):
+    def __init__(self, name, position=4, type="ELM3704-0000",
+                 write_latency="fixed 1.0", readback_latency="zero",
+                 pdo_stream=False, oversampling=1, period=0.001, mailbox=None,
+                 replay_trace=""):
         self.__super.__init__()
         # Store attributes
         self.name = name
         self.port_name = name + "_SDO"
         self.chainelem = _SimChainElem(position, type)
+        self.latencies = [("write", write_latency), ("readback", readback_latency)]
+        # The simulated PDO port takes the name of the slave port
+        self.pdo_stream = pdo_stream
+        self.oversampling = oversampling
+        self.period = period
+        self.mailbox = mailbox
+        self.replay_trace = replay_trace
 
     def InitialiseOnce(self):
         print("# Creating Simulated ELM3704 SDO asynPortDriver")
 
     def Initialise(self):
-        print("SimELM3704SdoPortDriverConfigure(\"{port_name}\")".format(
-            port_name=self.port_name
+        print("SimELM3704SdoPortDriverConfigure(\"{port_name}\", \"{mailbox}\")".format(
+            port_name=self.port_name, mailbox=self.mailbox.name if self.mailbox else ""
         ))
+        # Latency models are "<model> [a [b]]", e.g. "uniform 0.1 0.5"
+        for stage, latency in self.latencies:
+            words = latency.split()
+            args = (words[1:] + ["0", "0"])[:2]
+            print("SimELM3704SdoPortDriverSetLatency(\"{port_name}\", \"*\", \"{stage}\", \"{model}\", {a}, {b})".format(
+                port_name=self.port_name, stage=stage, model=words[0], a=args[0], b=args[1]
+            ))
+        if self.replay_trace:
+            print("SimELM3704SdoPortDriverReplay(\"{port_name}\", \"{replay_trace}\", \"\")".format(
+                port_name=self.port_name, replay_trace=self.replay_trace
+            ))
+        if self.pdo_stream:
+            print("SimELM3704PdoPortDriverConfigure(\"{name}\", {oversampling}, {period})".format(
+                name=self.name, oversampling=self.oversampling, period=self.period
+            ))
 
     ArgInfo = makeArgInfo(
         __init__,
         name = Simple("Name (use as slave module name)", str),
         position = Simple("Module position (e.g. 3)", int),
         type = Simple("Module type (e.g. ELM3704-0000)", str),
+        write_latency = Simple("Write latency: zero, fixed <s>, uniform <min> <max>, normal <mean> <sd> or longtail <median> <shape>", str),
+        readback_latency = Simple("Delay from a write completing to its readback changing, as write_latency", str),
+        pdo_stream = Simple("Also simulate the PDO entries (samples, status) on a port with the slave name", bool),
+        oversampling = Simple("Number of samples per channel in each simulated PDO", int),
+        period = Simple("Simulated cycle period in seconds", float),
+        mailbox = Ident("Share the mailbox of this simulated master with other slaves", SimMailbox),
+        replay_trace = Simple("SDO trace recorded with SdoTraceStart whose writes to this port are replayed", str),
     )
@@ -1,5 +1,6 @@
 from iocbuilder import AutoSubstitution, Device
 from iocbuilder.arginfo import ArgInfo, Choice, Ident, makeArgInfo, Simple
+from iocbuilder.modules.asyn import Asyn
 
 from core import EthercatSlaveModule
 
@@ -12,6 +13,18 @@ class _InputChannelScaleOffsetSyncChannelTemplate(AutoSubstitution):
     TemplateFile = "input_channel_scale_offset_sync_channel.template"
 
 
+class _RackAggregatorTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_rack_aggregator.template"
+
+
+class _DerivedChannelsTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_derived_channels.template"
+
+
+class _DerivedChannelTemplate(AutoSubstitution):
+    TemplateFile = "ethercat_gui_derived_channel.template"
+
+
 class InputChannelScalePluginSync(Device):
     """Synchronise an input channel scale and offset with up to 2 scale plugin instances"""
     def __init__(
@@ -115,3 +128,188 @@ class InputChannelScalePluginSync(Device):
         PLUGIN_2_R=Simple('Scale plugin 2 PV suffix', str),
         PLUGIN_2_CHANNEL=Simple('Scale plugin 2 channel', int),
     )
+
+
+class RackAggregator(Device):
+    """Collect channel values, severities and module states of many modules into arrays"""
+
+    Dependencies = (Asyn,)
+
+    DbdFileList = ['ethercatUtil']
+    LibFileList = ['ethercatUtil']
+
+    def __init__(self, name, P, R, max_channels=256, max_modules=64, period=1.0):
+        # Initialise base class
+        self.__super.__init__()
+
+        self.name = name
+        self.port = name
+        self.max_channels = max_channels
+        self.max_modules = max_modules
+        self.period = period
+        self.modules = []
+
+        _RackAggregatorTemplate(
+            P=P,
+            R=R,
+            AGGPORT=self.port,
+            NCHANNELS=max_channels,
+            NMODULES=max_modules
+        )
+
+    def add_module(self, module):
+        ''' Add the records of a slave module object '''
+        assert len(self.modules) < self.max_modules, \
+            "{name}: more than {max} modules".format(name=self.name, max=self.max_modules)
+        suffix = module.channel_value_suffix
+        channels = module.channels if suffix else 0
+        self.modules.append(("{P}:{R}".format(P=module.p, R=module.r), channels, suffix or "VAL"))
+
+    def InitialiseOnce(self):
+        print("# Creating drivers for aggregating module values")
+
+    def Initialise(self):
+        print("RackAggregatorConfigure(\"{port}\", {max_channels}, {max_modules}, {period})".format(
+            port=self.port, max_channels=self.max_channels, max_modules=self.max_modules, period=self.period
+        ))
+        for prefix, channels, suffix in self.modules:
+            print("RackAggregatorAddModule(\"{port}\", \"{prefix}\", {channels}, \"{suffix}\")".format(
+                port=self.port, prefix=prefix, channels=channels, suffix=suffix
+            ))
+
+    ArgInfo = makeArgInfo(
+        __init__,
+        name=Simple('Object and asyn port name', str),
+        P=Simple('PV prefix', str),
+        R=Simple('PV suffix', str),
+        max_channels=Simple('Maximum number of channels over all modules', int),
+        max_modules=Simple('Maximum number of modules', int),
+        period=Simple('Update period in seconds', float),
+    )
+
+
+class RackAggregatorModule(Device):
+    """Add a module's channel values and state to a rack aggregator"""
+    def __init__(self, AGGREGATOR, MODULE):
+        # Initialise base class
+        self.__super.__init__()
+
+        AGGREGATOR.add_module(MODULE)
+
+    ArgInfo = makeArgInfo(
+        __init__,
+        AGGREGATOR=Ident('Rack aggregator', RackAggregator),
+        MODULE=Ident('Slave module', EthercatSlaveModule),
+    )
+
+
+class DerivedChannels(Device):
+    """Channels computed every cycle from expressions of the PDO entries of other modules"""
+
+    Dependencies = (Asyn,)
+
+    DbdFileList = ['ethercatUtil']
+    LibFileList = ['ethercatUtil']
+
+    def __init__(self, name, P, R, max_channels=16, cycle_port="", cycle_entry="", cycle_period=0.001):
+        # Initialise base class
+        self.__super.__init__()
+
+        self.name = name
+        self.port = name
+        self.p = P
+        self.r = R
+        self.max_channels = max_channels
+        self.cycle_port = cycle_port
+        self.cycle_entry = cycle_entry
+        self.cycle_period = cycle_period
+        self.inputs = []
+        self.expressions = []
+
+        _DerivedChannelsTemplate(P=P, R=R, DERPORT=self.port)
+
+    def add_input(self, name, slave_port, entry, scale=1.0, offset=0.0):
+        ''' Add a named input, raw * scale + offset of a slave port entry '''
+        assert name not in [i[0] for i in self.inputs], \
+            "{name}: input {input} already exists".format(name=self.name, input=name)
+        self.inputs.append((name, slave_port, entry, scale, offset))
+
+    def add_channel(self, expression, DESC="Derived value", EGU="", PREC=3):
+        ''' Add a channel computed from the inputs, returning its number '''
+        assert len(self.expressions) < self.max_channels, \
+            "{name}: more than {max} channels".format(name=self.name, max=self.max_channels)
+        self.expressions.append(expression)
+        channel = len(self.expressions)
+        _DerivedChannelTemplate(P=self.p, R=self.r, CHANNEL=channel, DERPORT=self.port, DESC=DESC, EGU=EGU, PREC=PREC)
+        return channel
+
+    def InitialiseOnce(self):
+        print("# Creating drivers for derived channels")
+
+    def Initialise(self):
+        print("DerivedChannelsConfigure(\"{port}\", {max_channels}, \"{cycle_port}\", \"{cycle_entry}\", {cycle_period})".format(
+            port=self.port, max_channels=self.max_channels, cycle_port=self.cycle_port,
+            cycle_entry=self.cycle_entry, cycle_period=self.cycle_period
+        ))
+        for name, slave_port, entry, scale, offset in self.inputs:
+            print("DerivedChannelsAddInput(\"{port}\", \"{name}\", \"{slave_port}\", \"{entry}\", {scale}, {offset})".format(
+                port=self.port, name=name, slave_port=slave_port, entry=entry, scale=scale, offset=offset
+            ))
+        for expression in self.expressions:
+            print("DerivedChannelsAddChannel(\"{port}\", \"{expression}\")".format(
+                port=self.port, expression=expression
+            ))
+
+    ArgInfo = makeArgInfo(
+        __init__,
+        name=Simple('Object and asyn port name', str),
+        P=Simple('PV prefix', str),
+        R=Simple('PV suffix', str),
+        max_channels=Simple('Maximum number of derived channels', int),
+        cycle_port=Simple('Asyn port with an entry which changes every cycle (optional)', str),
+        cycle_entry=Simple('Entry which changes every cycle, e.g. an input cycle counter (optional)', str),
+        cycle_period=Simple('Cycle period in seconds, used without a cycle entry', float),
+    )
+
+
+class DerivedChannelInput(Device):
+    """Add a module channel as a named input of derived channels"""
+    def __init__(self, DERIVED, NAME, MODULE, CHANNEL, ENTRY="", SCALE=1.0, OFFSET=0.0):
+        # Initialise base class
+        self.__super.__init__()
+
+        # The module's value entry unless another entry is given
+        entry = ENTRY or MODULE._get_entry_name(CHANNEL)
+        assert entry, "{name}: no value entry for {module} channel {channel}".format(
+            name=NAME, module=MODULE.name, channel=CHANNEL
+        )
+        DERIVED.add_input(NAME, MODULE.port, entry, SCALE, OFFSET)
+
+    ArgInfo = makeArgInfo(
+        __init__,
+        DERIVED=Ident('Derived channels', DerivedChannels),
+        NAME=Simple('Input name used in expressions', str),
+        MODULE=Ident('Slave module', EthercatSlaveModule),
+        CHANNEL=Simple('Module channel', int),
+        ENTRY=Simple('PDO entry, instead of the channel value entry (optional)', str),
+        SCALE=Simple('Scale applied to the raw value', float),
+        OFFSET=Simple('Offset added after scaling', float),
+    )
+
+
+class DerivedChannel(Device):
+    """Add a channel computed from the inputs of derived channels"""
+    def __init__(self, DERIVED, EXPRESSION, DESC="Derived value", EGU="", PREC=3):
+        # Initialise base class
+        self.__super.__init__()
+
+        self.channel = DERIVED.add_channel(EXPRESSION, DESC, EGU, PREC)
+
+    ArgInfo = makeArgInfo(
+        __init__,
+        DERIVED=Ident('Derived channels', DerivedChannels),
+        EXPRESSION=Simple('Expression of the inputs, e.g. (a - b) / (a + b)', str),
+        DESC=Simple('Description', str),
+        EGU=Simple('Engineering units', str),
+        PREC=Simple('Display precision', int),
+    )
@@ -0,0 +1,103 @@
+#include "AlarmEvaluator.h"
+
+#include <math.h>
+
+
+// Constructor
+AlarmEvaluator::AlarmEvaluator() :
+    lastSample(0.0),
+    haveLast(false),
+    latchedSeverity(epicsSevNone),
+    latchedStatus(epicsAlarmNone),
+    alarmBlocks(0)
+{
+    limits.hihi = limits.high = limits.low = limits.lolo = limits.rateOfChange = 0.0;
+    limits.hihiSeverity = limits.highSeverity = limits.lowSeverity = limits.loloSeverity = limits.rateSeverity = epicsSevNone;
+}
+
+
+// Replace the limits
+void AlarmEvaluator::setLimits(const Limits &newLimits)
+{
+    limits = newLimits;
+}
+
+
+/* Reduce the block to its minimum, maximum and largest step in one pass, then
+ * compare those with the limits. The loop has no branches on the limits so the
+ * compiler can vectorise it.
+*/
+void AlarmEvaluator::process(const double *samples, size_t n, double samplePeriod)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    double minimum = samples[0];
+    double maximum = samples[0];
+    double largestStep = haveLast ? fabs(samples[0] - lastSample) : 0.0;
+    for (size_t i=1; i<n; i++)
+    {
+        minimum = samples[i] < minimum ? samples[i] : minimum;
+        maximum = samples[i] > maximum ? samples[i] : maximum;
+        double step = fabs(samples[i] - samples[i-1]);
+        largestStep = step > largestStep ? step : largestStep;
+    }
+    lastSample = samples[n-1];
+    haveLast = true;
+
+    bool inAlarm = false;
+    if (limits.hihiSeverity != epicsSevNone && maximum >= limits.hihi)
+    {
+        raise(limits.hihiSeverity, epicsAlarmHiHi);
+        inAlarm = true;
+    }
+    else if (limits.highSeverity != epicsSevNone && maximum >= limits.high)
+    {
+        raise(limits.highSeverity, epicsAlarmHigh);
+        inAlarm = true;
+    }
+    if (limits.loloSeverity != epicsSevNone && minimum <= limits.lolo)
+    {
+        raise(limits.loloSeverity, epicsAlarmLoLo);
+        inAlarm = true;
+    }
+    else if (limits.lowSeverity != epicsSevNone && minimum <= limits.low)
+    {
+        raise(limits.lowSeverity, epicsAlarmLow);
+        inAlarm = true;
+    }
+
+    // There is no rate-of-change alarm condition, change of state is the closest
+    if (limits.rateSeverity != epicsSevNone && samplePeriod > 0.0 && largestStep >= limits.rateOfChange * samplePeriod)
+    {
+        raise(limits.rateSeverity, epicsAlarmCos);
+        inAlarm = true;
+    }
+    if (inAlarm)
+    {
+        alarmBlocks++;
+    }
+}
+
+
+// Latch an alarm if it is worse than the one already latched
+void AlarmEvaluator::raise(epicsAlarmSeverity severity, epicsAlarmCondition status)
+{
+    if (severity > latchedSeverity)
+    {
+        latchedSeverity = severity;
+        latchedStatus = status;
+    }
+}
+
+
+// Worst alarm since the last call, then clear the latch
+void AlarmEvaluator::takeLatched(epicsAlarmSeverity &severity, epicsAlarmCondition &status)
+{
+    severity = latchedSeverity;
+    status = latchedStatus;
+    latchedSeverity = epicsSevNone;
+    latchedStatus = epicsAlarmNone;
+}
@@ -0,0 +1,69 @@
+/*
+ * AlarmEvaluator.h
+ *
+ * Class for checking every sample of a channel against HIHI/HIGH/LOW/LOLO and
+ * rate-of-change limits. The worst alarm seen is latched until it is taken when
+ * a value is published, so excursions between published values are not lost.
+ *
+*/
+
+#ifndef ALARMEVALUATOR_H
+#define ALARMEVALUATOR_H
+
+#include <stddef.h>
+
+#include <alarm.h>
+
+
+class AlarmEvaluator
+{
+public:
+    // Limits with the same meaning as the record fields. A severity of
+    // epicsSevNone disables the limit.
+    struct Limits
+    {
+        double hihi;
+        double high;
+        double low;
+        double lolo;
+        double rateOfChange;
+        epicsAlarmSeverity hihiSeverity;
+        epicsAlarmSeverity highSeverity;
+        epicsAlarmSeverity lowSeverity;
+        epicsAlarmSeverity loloSeverity;
+        epicsAlarmSeverity rateSeverity;
+    };
+
+    // Constructor, all limits disabled
+    AlarmEvaluator();
+
+    // Replace the limits, keeping any latched alarm
+    void setLimits(const Limits &newLimits);
+    const Limits &getLimits() const { return limits; }
+
+    // Check a block of consecutive samples. The rate of change is in units per second.
+    void process(const double *samples, size_t n, double samplePeriod);
+
+    // Latch an alarm found outside the limit checks, e.g. from device status bits
+    void raise(epicsAlarmSeverity severity, epicsAlarmCondition status);
+
+    // Worst alarm since the last call, then clear the latch
+    void takeLatched(epicsAlarmSeverity &severity, epicsAlarmCondition &status);
+
+    // Number of blocks which raised an alarm since construction
+    unsigned long getAlarmBlocks() const { return alarmBlocks; }
+
+    // Forget the previous sample, e.g. after a gap in the data
+    void reset() { haveLast = false; }
+
+private:
+    // Attributes
+    Limits limits;
+    double lastSample;
+    bool haveLast;
+    epicsAlarmSeverity latchedSeverity;
+    epicsAlarmCondition latchedStatus;
+    unsigned long alarmBlocks;
+};
+
+#endif /* ALARMEVALUATOR_H */
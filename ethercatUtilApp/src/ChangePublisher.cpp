@@ -0,0 +1,268 @@
+#include "ChangePublisher.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+#include <asynInt32.h>
+#include <ellLib.h>
+
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+// For logging
+static const char *driverName = "ChangePublisher";
+
+// How often the heartbeat thread checks for stale values
+static const std::chrono::milliseconds heartbeatCheckPeriod(100);
+
+
+// Constructor
+ChangePublisher::ChangePublisher(const char* portName, const char* slavePortName, const char* entryFormat, int channels, double heartbeat) : asynPortDriver(
+    portName,  /* asyn port name for this driver*/
+    1, /* maxAddr */
+    asynInt32Mask | asynFloat64Mask | asynDrvUserMask, /* Interface mask */
+    asynInt32Mask | asynFloat64Mask,  /* Interrupt mask */
+    0, /* asynFlags.  This driver does not block and it is not multi-device, so flag is 0 */
+    1, /* Autoconnect */
+    0, /* Default priority */
+    0), /* Default stack size*/
+    value(channels > 0 ? channels : 0),
+    deadband(value.size()),
+    deadbandMode(value.size()),
+    updates(value.size()),
+    channels(value.size()),
+    pdoPortClient(slavePortName) /* Create PdoPortClient instance */
+{
+    /* Asyn parameter creation */
+    createParam("HEARTBEAT", asynParamFloat64, &heartbeatPeriod);
+    setDoubleParam(heartbeatPeriod, heartbeat);
+
+    // For each channel
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (unsigned int channel=0; channel<this->channels.size(); channel++)
+    {
+        // The value uses the entry name so records only need a different port
+        epicsSnprintf(str, NBUFF, entryFormat, channel+1);
+        this->channels[channel].entry = str;
+        this->channels[channel].valid = false;
+        this->channels[channel].published = 0;
+        createParam(str, asynParamInt32, &value[channel]);
+        setIntegerParam(value[channel], 0);
+
+        // Deadband settings
+        epicsSnprintf(str, NBUFF, "CH%d:DEADBAND", channel+1);
+        createParam(str, asynParamFloat64, &deadband[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:DEADBAND_MODE", channel+1);
+        createParam(str, asynParamInt32, &deadbandMode[channel]);
+
+        // Number of values published
+        epicsSnprintf(str, NBUFF, "CH%d:UPDATES", channel+1);
+        createParam(str, asynParamInt32, &updates[channel]);
+
+        // Publish every change by default
+        setDoubleParam(deadband[channel], 0.0);
+        setIntegerParam(deadbandMode[channel], DeadbandMode::Absolute);
+        setIntegerParam(updates[channel], 0);
+    }
+    callParamCallbacks();
+
+    // Start following the slave port
+    connectEntries();
+    heartbeatThread = std::thread(&ChangePublisher::heartbeatLoop, this);
+}
+
+
+// Register for changes of each channel's entry and publish the current values
+void ChangePublisher::connectEntries()
+{
+    for (unsigned int channel=0; channel<channels.size(); channel++)
+    {
+        const char *entry = channels[channel].entry.c_str();
+        pdoPortClient.monitor(
+            entry,
+            [this, channel](epicsInt32 newValue, const epicsTimeStamp &timestamp) { onValue(channel, newValue, timestamp); }
+        );
+
+        epicsInt32 current;
+        if (pdoPortClient.read(entry, current) == asynSuccess)
+        {
+            epicsTimeStamp now;
+            epicsTimeGetCurrent(&now);
+            lock();
+            channels[channel].latest = current;
+            channels[channel].latestTime = now;
+            channels[channel].valid = true;
+            publish(channel, now);
+            unlock();
+        }
+    }
+}
+
+
+/* New value from the slave port. The slave port only calls back when an entry
+ * changes, so this sees every change at the cycle rate.
+*/
+void ChangePublisher::onValue(unsigned int channel, epicsInt32 newValue, const epicsTimeStamp &timestamp)
+{
+    lock();
+    Channel &state = channels[channel];
+    state.latest = newValue;
+    state.latestTime = timestamp;
+    if (!state.valid || outsideDeadband(channel, newValue))
+    {
+        state.valid = true;
+        publish(channel, timestamp);
+    }
+    unlock();
+}
+
+
+// Compare a value with the last published one using the channel's deadband
+bool ChangePublisher::outsideDeadband(unsigned int channel, epicsInt32 newValue)
+{
+    double band;
+    int mode;
+    getDoubleParam(deadband[channel], &band);
+    getIntegerParam(deadbandMode[channel], &mode);
+
+    double published = channels[channel].published;
+    double change = fabs((double) newValue - published);
+
+    // A relative deadband is a percentage of the last published value
+    double limit = (mode == DeadbandMode::Relative) ? fabs(published) * band / 100.0 : band;
+    return change > (limit > 0.0 ? limit : 0.0);
+}
+
+
+/* Publish the latest value of a channel. A value which has not changed (heartbeat)
+ * would not be passed on by callParamCallbacks, so its clients are called directly.
+*/
+void ChangePublisher::publish(unsigned int channel, const epicsTimeStamp &timestamp)
+{
+    Channel &state = channels[channel];
+    int count;
+    getIntegerParam(updates[channel], &count);
+    setIntegerParam(updates[channel], count + 1);
+
+    setTimeStamp(&timestamp);
+    bool changed = (state.latest != state.published);
+    setIntegerParam(value[channel], state.latest);
+    callParamCallbacks();
+    if (!changed)
+    {
+        forceInt32Callbacks(value[channel], state.latest, timestamp);
+    }
+
+    state.published = state.latest;
+    state.publishedTime = timestamp;
+}
+
+
+// Call the I/O Intr clients of an Int32 parameter directly
+void ChangePublisher::forceInt32Callbacks(int param, epicsInt32 newValue, const epicsTimeStamp &timestamp)
+{
+    ELLLIST *clients;
+    pasynManager->interruptStart(asynStdInterfaces.int32InterruptPvt, &clients);
+    interruptNode *node = (interruptNode *) ellFirst(clients);
+    while (node)
+    {
+        asynInt32Interrupt *interrupt = (asynInt32Interrupt *) node->drvPvt;
+        if (interrupt->pasynUser->reason == param)
+        {
+            interrupt->pasynUser->auxStatus = asynSuccess;
+            interrupt->pasynUser->timestamp = timestamp;
+            interrupt->callback(interrupt->userPvt, interrupt->pasynUser, newValue);
+        }
+        node = (interruptNode *) ellNext(&node->node);
+    }
+    pasynManager->interruptEnd(asynStdInterfaces.int32InterruptPvt);
+}
+
+
+// Republish channels which have not been published for a heartbeat period
+void ChangePublisher::heartbeatLoop()
+{
+    while (true)
+    {
+        std::this_thread::sleep_for(heartbeatCheckPeriod);
+
+        lock();
+        double period;
+        getDoubleParam(heartbeatPeriod, &period);
+        if (period > 0.0)
+        {
+            epicsTimeStamp now;
+            epicsTimeGetCurrent(&now);
+            for (unsigned int channel=0; channel<channels.size(); channel++)
+            {
+                Channel &state = channels[channel];
+                if (state.valid && epicsTimeDiffInSeconds(&now, &state.publishedTime) >= period)
+                {
+                    publish(channel, now);
+                }
+            }
+        }
+        unlock();
+    }
+}
+
+
+// AsynPortDriver::writeFloat64 override
+asynStatus ChangePublisher::writeFloat64(asynUser *pasynUser, epicsFloat64 newValue)
+{
+    // For logging
+    static const char *functionName = "writeFloat64";
+
+    if (newValue < 0.0)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: %g: deadband and heartbeat cannot be negative\n",
+                  driverName, functionName, newValue);
+        return asynError;
+    }
+    return asynPortDriver::writeFloat64(pasynUser, newValue);
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to call constructor for the ChangePublisher class.
+      * \param[in] portName The name of the asyn port created in this driver.
+      * \param[in] slavePortName The name of the asyn port of the slave module
+      * \param[in] entryFormat The PDO entry of each channel, with %d for the channel number
+      * \param[in] channels The number of channels
+      * \param[in] heartbeat Seconds after which an unchanged value is published again (0 to disable)
+      */
+    int ChangePublisherConfigure(const char *portName, const char *slavePortName, const char *entryFormat, int channels, double heartbeat)
+    {
+        new ChangePublisher(portName, slavePortName, entryFormat, channels, heartbeat);
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg initArg0 = { "portName", iocshArgString };
+    static const iocshArg initArg1 = { "slavePortName", iocshArgString };
+    static const iocshArg initArg2 = { "entryFormat", iocshArgString };
+    static const iocshArg initArg3 = { "channels", iocshArgInt };
+    static const iocshArg initArg4 = { "heartbeat", iocshArgDouble };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1, &initArg2, &initArg3, &initArg4 };
+    static const iocshFuncDef initFuncDef = { "ChangePublisherConfigure", 5, initArgs };
+
+    static void initCallFunc(const iocshArgBuf *args)
+    {
+        ChangePublisherConfigure(args[0].sval, args[1].sval, args[2].sval, args[3].ival, args[4].dval);
+    }
+
+    void ChangePublisherRegister(void)
+    {
+        iocshRegister(&initFuncDef, initCallFunc);
+    }
+
+    epicsExportRegistrar(ChangePublisherRegister);
+
+}
@@ -0,0 +1,87 @@
+/*
+ * ChangePublisher.h
+ *
+ * Class for publishing the input values of a slave module only when they change
+ * by more than a deadband. Values are monitored on the slave asyn port every
+ * cycle and passed on to I/O Intr records on this port, with a heartbeat to
+ * refresh values which stay inside the deadband.
+ *
+*/
+
+#ifndef CHANGEPUBLISHER_H
+#define CHANGEPUBLISHER_H
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asynPortDriver.h"
+#include "PdoPortClient.h"
+
+
+class ChangePublisher : public asynPortDriver
+{
+
+public:
+    // Constructor
+    ChangePublisher(const char* portName, const char* slavePortName, const char* entryFormat, int channels, double heartbeat);
+
+    // Overidden methods from asynPortDriver
+    virtual asynStatus writeFloat64(asynUser *pasynUser, epicsFloat64 value);
+
+protected:
+    // Module asyn parameter indices
+    int heartbeatPeriod;
+
+    // Channel asyn parameter indices
+    std::vector<int> value;
+    std::vector<int> deadband;
+    std::vector<int> deadbandMode;
+    std::vector<int> updates;
+
+    // Deadband mode enum
+    enum DeadbandMode {
+        Absolute,
+        Relative,
+    };
+
+private:
+    // Per-channel state
+    struct Channel
+    {
+        std::string entry;
+        bool valid;
+        epicsInt32 latest;
+        epicsTimeStamp latestTime;
+        epicsInt32 published;
+        epicsTimeStamp publishedTime;
+    };
+
+    // Methods for following the slave port values
+    void connectEntries();
+    void onValue(unsigned int channel, epicsInt32 newValue, const epicsTimeStamp &timestamp);
+
+    // Whether a value is far enough from the last published one
+    bool outsideDeadband(unsigned int channel, epicsInt32 newValue);
+
+    // Publish the latest value of a channel
+    void publish(unsigned int channel, const epicsTimeStamp &timestamp);
+
+    // Call I/O Intr clients even though the parameter value has not changed
+    void forceInt32Callbacks(int param, epicsInt32 newValue, const epicsTimeStamp &timestamp);
+
+    // Thread republishing values which have not changed for a heartbeat period
+    void heartbeatLoop();
+
+    // Attributes
+    std::vector<Channel> channels;
+
+    // Client for the PDO entries of the slave port
+    PdoPortClient pdoPortClient;
+
+    // Heartbeat thread
+    std::thread heartbeatThread;
+
+};
+
+#endif /* CHANGEPUBLISHER_H */
@@ -0,0 +1,315 @@
+#include "Clock.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+#include <epicsThread.h>
+
+#include <chrono>
+#include <stdio.h>
+
+// For logging
+static const char *driverName = "Clock";
+
+
+// The clock in use, NULL for the system clock
+static Clock *currentClock = NULL;
+
+
+// The clock in use
+Clock &Clock::get()
+{
+    static SystemClock systemClock;
+    return currentClock ? *currentClock : systemClock;
+}
+
+
+// Use a clock for everything created from now on
+void Clock::set(Clock *clock)
+{
+    currentClock = clock;
+}
+
+
+// Seconds of the monotonic clock
+double SystemClock::now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void SystemClock::sleep(double seconds)
+{
+    epicsThreadSleep(seconds);
+}
+
+
+bool SystemClock::wait(epicsEvent &event, double seconds)
+{
+    if (seconds < 0.0)
+    {
+        event.wait();
+        return true;
+    }
+    return event.wait(seconds);
+}
+
+
+void SystemClock::signal(epicsEvent &event)
+{
+    event.signal();
+}
+
+
+// Constructor
+VirtualClock::VirtualClock(bool autoAdvance) :
+    autoAdvance(autoAdvance),
+    time(0.0),
+    running(0)
+{
+}
+
+
+double VirtualClock::now()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return time;
+}
+
+
+// Block until the clock reaches the end of the sleep
+void VirtualClock::sleep(double seconds)
+{
+    if (seconds <= 0.0)
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> guard(mutex);
+    double end = time + seconds;
+    std::multiset<double>::iterator wake = wakeTimes.insert(end);
+    block(guard, [this, end]() { return time >= end; });
+    wakeTimes.erase(wake);
+    advanced.notify_all();
+}
+
+
+// Block until the event is signalled through the clock or the clock reaches the timeout
+bool VirtualClock::wait(epicsEvent &event, double seconds)
+{
+    std::unique_lock<std::mutex> guard(mutex);
+    bool forever = seconds < 0.0;
+    double end = time + (forever ? 0.0 : seconds);
+    std::multiset<double>::iterator wake = forever ? wakeTimes.end() : wakeTimes.insert(end);
+    bool taken = false;
+    waiting[&event]++;
+    block(guard, [this, &event, &taken, forever, end]()
+    {
+        taken = event.tryWait();
+        if (taken)
+        {
+            signalled.erase(&event);
+        }
+        return taken || (!forever && time >= end);
+    });
+    if (--waiting[&event] == 0)
+    {
+        waiting.erase(&event);
+    }
+    if (!forever)
+    {
+        wakeTimes.erase(wake);
+    }
+    advanced.notify_all();
+    return taken;
+}
+
+
+// Signal the event, holding the clock until a waiting thread takes it
+void VirtualClock::signal(epicsEvent &event)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    signalled.insert(&event);
+    event.signal();
+    advanced.notify_all();
+}
+
+
+// Count the calling thread as running until it blocks on the clock
+void VirtualClock::attach()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if (attached[std::this_thread::get_id()]++ == 0)
+    {
+        running++;
+    }
+}
+
+
+// Stop holding the clock back once the last attachment of the thread is gone
+void VirtualClock::detach()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    std::map<std::thread::id, int>::iterator it = attached.find(std::this_thread::get_id());
+    if (it != attached.end() && --it->second == 0)
+    {
+        attached.erase(it);
+        running--;
+        advanced.notify_all();
+    }
+}
+
+
+/* Wait on the condition variable until ready. An attached thread stops running
+ * while blocked, and with auto-advance the last one to block moves the clock.
+ * The threads woken by the clock or a signal hold it until they return from
+ * sleep() or wait(), which then wakes the others to check again.
+*/
+void VirtualClock::block(std::unique_lock<std::mutex> &guard, const std::function<bool()> &ready)
+{
+    bool isAttached = attached.count(std::this_thread::get_id()) != 0;
+    if (isAttached)
+    {
+        running--;
+    }
+    while (!ready())
+    {
+        if (!autoAdvance || !autoAdvanceIfIdle())
+        {
+            advanced.wait(guard);
+        }
+    }
+    if (isAttached)
+    {
+        running++;
+    }
+}
+
+
+/* Move the clock to the earliest wake time if every thread is blocked: no
+ * attached thread is running, no signalled event is waiting to be taken and no
+ * thread has been woken but not yet returned, which leaves a wake time at or
+ * before the clock.
+*/
+bool VirtualClock::autoAdvanceIfIdle()
+{
+    if (running > 0 || wakeTimes.empty() || *wakeTimes.begin() <= time)
+    {
+        return false;
+    }
+    for (std::set<epicsEvent *>::iterator it = signalled.begin(); it != signalled.end(); ++it)
+    {
+        if (waiting.count(*it))
+        {
+            return false;
+        }
+    }
+    time = *wakeTimes.begin();
+    advanced.notify_all();
+    return true;
+}
+
+
+// Move the clock forward, waking the threads whose time has come
+void VirtualClock::advance(double seconds)
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        time += seconds > 0.0 ? seconds : 0.0;
+    }
+    advanced.notify_all();
+}
+
+
+// Move the clock to the earliest wake time ahead of it
+bool VirtualClock::advanceToNextWake()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (wakeTimes.empty())
+        {
+            return false;
+        }
+        double next = *wakeTimes.begin();
+        time = next > time ? next : time;
+    }
+    advanced.notify_all();
+    return true;
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to use a virtual clock for the SDO configuration path.
+      * Call it before creating the SDO ports and ELM3704 drivers, which keep the clock they
+      * were created with.
+      * \param[in] autoAdvance If non-zero, the clock moves to the next wake time once every attached thread is blocked
+      */
+    int VirtualClockEnable(int autoAdvance)
+    {
+        static VirtualClock *clock = NULL;
+        if (clock)
+        {
+            printf("%s: virtual clock already enabled\n", driverName);
+            return(-1);
+        }
+        clock = new VirtualClock(autoAdvance != 0);
+        Clock::set(clock);
+        return(0);
+    }
+
+
+    /** EPICS iocsh callable function to advance the virtual clock.
+      * \param[in] seconds The time to advance by, or 0 to move to the next thread's wake time
+      */
+    int VirtualClockAdvance(double seconds)
+    {
+        VirtualClock *clock = dynamic_cast<VirtualClock *>(&Clock::get());
+        if (!clock)
+        {
+            printf("%s: virtual clock not enabled\n", driverName);
+            return(-1);
+        }
+        if (seconds > 0.0)
+        {
+            clock->advance(seconds);
+        }
+        else if (!clock->advanceToNextWake())
+        {
+            printf("%s: no thread is waiting on the clock\n", driverName);
+        }
+        printf("%s: virtual time %.6f s\n", driverName, clock->now());
+        return(0);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg enableArg0 = { "autoAdvance", iocshArgInt };
+    static const iocshArg * const enableArgs[] = { &enableArg0 };
+    static const iocshFuncDef enableFuncDef = { "VirtualClockEnable", 1, enableArgs };
+
+    static void enableCallFunc(const iocshArgBuf *args)
+    {
+        VirtualClockEnable(args[0].ival);
+    }
+
+    static const iocshArg advanceArg0 = { "seconds", iocshArgDouble };
+    static const iocshArg * const advanceArgs[] = { &advanceArg0 };
+    static const iocshFuncDef advanceFuncDef = { "VirtualClockAdvance", 1, advanceArgs };
+
+    static void advanceCallFunc(const iocshArgBuf *args)
+    {
+        VirtualClockAdvance(args[0].dval);
+    }
+
+    void ClockRegister(void)
+    {
+        iocshRegister(&enableFuncDef, enableCallFunc);
+        iocshRegister(&advanceFuncDef, advanceCallFunc);
+    }
+
+    epicsExportRegistrar(ClockRegister);
+
+}
@@ -0,0 +1,138 @@
+/*
+ * Clock.h
+ *
+ * Classes for the time and sleeps of the SDO configuration path: SdoPortClient,
+ * the ELM3704 driver and the simulated SDO port. They use the clock in use when
+ * they are created, the system clock unless a virtual clock was enabled first.
+ *
+ * Time on the virtual clock only passes when it is advanced, from iocsh or a
+ * test, or with auto-advance when every thread attached to it is blocked on
+ * it. Timeouts and retries which take seconds on the system clock then take no
+ * real time. An event waited on through a clock must be signalled through it.
+ *
+*/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <epicsEvent.h>
+
+
+class Clock
+{
+
+public:
+    virtual ~Clock() {}
+
+    // Seconds since an arbitrary start, never going backwards
+    virtual double now() = 0;
+
+    // Block for a time in seconds
+    virtual void sleep(double seconds) = 0;
+
+    // Wait for an event for up to a time in seconds, or forever if negative.
+    // Returns true if the event was signalled.
+    virtual bool wait(epicsEvent &event, double seconds) = 0;
+
+    // Signal an event which a thread may be waiting on with wait()
+    virtual void signal(epicsEvent &event) = 0;
+
+    // Hold an auto-advancing clock back while the calling thread runs, until
+    // it detaches. Calls nest. Other clocks ignore them.
+    virtual void attach() {}
+    virtual void detach() {}
+
+    // The clock in use, the system clock unless another was set
+    static Clock &get();
+
+    // Use a clock for everything created from now on. The clock is not deleted.
+    static void set(Clock *clock);
+
+};
+
+
+// Clock of the operating system
+class SystemClock : public Clock
+{
+
+public:
+    virtual double now();
+    virtual void sleep(double seconds);
+    virtual bool wait(epicsEvent &event, double seconds);
+    virtual void signal(epicsEvent &event);
+
+};
+
+
+// Attaches the calling thread to a clock for the lifetime of the object
+class ClockAttachment
+{
+
+public:
+    ClockAttachment(Clock &clock) : clock(clock) { clock.attach(); }
+    ~ClockAttachment() { clock.detach(); }
+
+private:
+    Clock &clock;
+
+};
+
+
+// Clock which moves only when advanced
+class VirtualClock : public Clock
+{
+
+public:
+    /* Constructor. With auto-advance the clock moves to the earliest wake time
+     * once every attached thread is blocked in sleep() or wait(). An attached
+     * thread which blocks on anything else must not be waiting for a thread
+     * blocked on the clock, or neither moves again.
+    */
+    VirtualClock(bool autoAdvance = false);
+
+    virtual double now();
+    virtual void sleep(double seconds);
+    virtual bool wait(epicsEvent &event, double seconds);
+    virtual void signal(epicsEvent &event);
+    virtual void attach();
+    virtual void detach();
+
+    // Move the clock forward, waking the threads whose time has come
+    void advance(double seconds);
+
+    // Move the clock to the earliest end of a sleep or wait, if there is one.
+    // Returns false if no thread is waiting on the clock.
+    bool advanceToNextWake();
+
+private:
+    // Methods, called with the mutex held
+    void block(std::unique_lock<std::mutex> &guard, const std::function<bool()> &ready);
+    bool autoAdvanceIfIdle();
+
+    // Attributes
+    bool autoAdvance;
+    std::mutex mutex;
+    std::condition_variable advanced;
+    double time;
+
+    // Times at which the threads blocked on the clock wake
+    std::multiset<double> wakeTimes;
+
+    // Attached threads with their number of attachments, and how many are not blocked
+    std::map<std::thread::id, int> attached;
+    int running;
+
+    // Events with threads waiting on them, and those signalled but not yet taken
+    std::map<epicsEvent *, int> waiting;
+    std::set<epicsEvent *> signalled;
+
+};
+
+#endif /* CLOCK_H */
@@ -0,0 +1,86 @@
+#include "CycleTicker.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// For logging
+static const char *className = "CycleTicker";
+
+
+// Constructor
+CycleTicker::CycleTicker(const char* portName, const char* entryName, double period) :
+    period(period > 0.0 ? period : 0.001),
+    signalledCycles(0),
+    takenCycles(0),
+    lateCycles(0)
+{
+    epicsTimeGetCurrent(&lastCycle);
+    if (!portName || !entryName || strlen(portName) == 0 || strlen(entryName) == 0)
+    {
+        return;
+    }
+
+    client.reset(new PdoPortClient(portName));
+    asynStatus status = client->monitor(
+        entryName,
+        [this](epicsInt32, const epicsTimeStamp &timestamp) { onCycle(timestamp); }
+    );
+    if (status != asynSuccess)
+    {
+        printf("%s: cannot monitor %s on %s, using a %g s period\n", className, entryName, portName, this->period);
+        client.reset();
+    }
+}
+
+
+// Signal the waiting thread. This runs in the slave port's callback thread, so does no more.
+void CycleTicker::onCycle(const epicsTimeStamp &timestamp)
+{
+    timestampMutex.lock();
+    lastCycle = timestamp;
+    signalledCycles++;
+    timestampMutex.unlock();
+    cycleEvent.signal();
+}
+
+
+// Forget cycles signalled while nobody was waiting
+void CycleTicker::clear()
+{
+    cycleEvent.tryWait();
+    timestampMutex.lock();
+    takenCycles = signalledCycles;
+    timestampMutex.unlock();
+}
+
+
+/* Count the cycles signalled since the last call rather than the wakes, as the
+ * event does not queue signals. With a cycle source a late cycle is allowed up to
+ * a second period before falling back to the timer, without one this is a sleep.
+ * A wake for a cycle already counted by the last call waits again.
+*/
+long CycleTicker::waitForCycles(epicsTimeStamp &timestamp)
+{
+    while (true)
+    {
+        bool signalled = cycleEvent.wait(client ? 2.0 * period : period);
+
+        timestampMutex.lock();
+        long cycles = signalledCycles - takenCycles;
+        takenCycles = signalledCycles;
+        timestamp = lastCycle;
+        timestampMutex.unlock();
+
+        if (cycles > 0)
+        {
+            lateCycles += cycles - 1;
+            return cycles;
+        }
+        if (!signalled)
+        {
+            if (client) lateCycles++;
+            epicsTimeGetCurrent(&timestamp);
+            return 1;
+        }
+    }
+}
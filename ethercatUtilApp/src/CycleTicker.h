@@ -0,0 +1,61 @@
+/*
+ * CycleTicker.h
+ *
+ * Class for waking a thread once per EtherCAT cycle. The cycle is taken from a
+ * PDO entry which changes every cycle (e.g. an input cycle counter). Without one,
+ * or if it stops updating, the ticker falls back to a fixed period.
+ *
+*/
+
+#ifndef CYCLETICKER_H
+#define CYCLETICKER_H
+
+#include <memory>
+
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsTime.h>
+
+#include "PdoPortClient.h"
+
+
+class CycleTicker
+{
+
+public:
+    // Constructor. portName and entryName may be empty to always use the period.
+    CycleTicker(const char* portName, const char* entryName, double period);
+
+    /* Block until the next cycle and return the number of cycles since the last
+     * call, at least 1. Cycles missed in between, and a period which elapsed
+     * without a cycle, are counted as late.
+    */
+    long waitForCycles(epicsTimeStamp &timestamp);
+
+    // Forget cycles signalled while nobody was waiting
+    void clear();
+
+    double getPeriod() const { return period; }
+    long getLateCycles() const { return lateCycles; }
+
+private:
+    // Called by the slave port each cycle
+    void onCycle(const epicsTimeStamp &timestamp);
+
+    // Attributes
+    double period;
+    std::unique_ptr<PdoPortClient> client;
+    epicsEvent cycleEvent;
+    epicsMutex timestampMutex;
+    epicsTimeStamp lastCycle;
+
+    // Cycles signalled and those taken by waitForCycles, guarded by timestampMutex
+    unsigned long signalledCycles;
+    unsigned long takenCycles;
+
+    // Only used by the waiting thread
+    long lateCycles;
+
+};
+
+#endif /* CYCLETICKER_H */
@@ -0,0 +1,267 @@
+#include "DecimationFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+/* CICDecimator */
+
+// Constructor
+CICDecimator::CICDecimator(unsigned int ratio, unsigned int order) :
+    decimationRatio(ratio),
+    order(order),
+    phase(0),
+    gain(1.0),
+    integrators(order, 0),
+    combs(order, 0)
+{
+    if (ratio < 1)
+    {
+        throw std::runtime_error("CIC decimation ratio must be at least 1");
+    }
+    if (order < 1 || order > maxOrder(ratio))
+    {
+        throw std::runtime_error(
+            "CIC order " + std::to_string(order) + " not valid for ratio " +
+            std::to_string(ratio) + " (max " + std::to_string(maxOrder(ratio)) + ")"
+        );
+    }
+    // DC gain of the filter is ratio^order
+    gain = std::pow((double) ratio, (double) order);
+}
+
+
+// Input samples are 32 bit so the register growth of order * log2(ratio) bits
+// has to fit in the remaining 32 bits of the 64 bit integrators.
+unsigned int CICDecimator::maxOrder(unsigned int ratio)
+{
+    static const unsigned int absoluteMaxOrder = 6;
+    if (ratio < 2) return absoluteMaxOrder;
+    unsigned int maxAllowed = (unsigned int) (32.0 / std::ceil(std::log2((double) ratio)));
+    return maxAllowed < absoluteMaxOrder ? maxAllowed : absoluteMaxOrder;
+}
+
+
+// Integrate every input sample and run the combs once per output sample
+void CICDecimator::process(const double *input, size_t nIn, std::vector<double> &output)
+{
+    for (size_t i=0; i<nIn; i++)
+    {
+        uint64_t value = (uint64_t) (int64_t) std::llround(input[i]);
+        for (unsigned int stage=0; stage<order; stage++)
+        {
+            integrators[stage] += value;
+            value = integrators[stage];
+        }
+
+        if (++phase < decimationRatio) continue;
+        phase = 0;
+
+        for (unsigned int stage=0; stage<order; stage++)
+        {
+            uint64_t delayed = combs[stage];
+            combs[stage] = value;
+            value -= delayed;
+        }
+        output.push_back((double) (int64_t) value / gain);
+    }
+}
+
+
+// Clear integrators and combs
+void CICDecimator::reset()
+{
+    phase = 0;
+    std::fill(integrators.begin(), integrators.end(), 0);
+    std::fill(combs.begin(), combs.end(), 0);
+}
+
+
+/* FIRDecimator */
+
+// Constructor
+FIRDecimator::FIRDecimator(unsigned int ratio, const std::vector<double> &coefficients) :
+    decimationRatio(ratio),
+    phase(0),
+    reversedCoefficients(coefficients.rbegin(), coefficients.rend()),
+    delayLine(2 * coefficients.size(), 0.0),
+    delayIndex(0)
+{
+    if (ratio < 1)
+    {
+        throw std::runtime_error("FIR decimation ratio must be at least 1");
+    }
+    if (coefficients.empty())
+    {
+        throw std::runtime_error("FIR decimator needs at least one coefficient");
+    }
+}
+
+
+// Windowed-sinc low pass design
+std::vector<double> FIRDecimator::designLowPass(unsigned int ratio, unsigned int numTaps)
+{
+    // Default to 8 taps per output sample, always odd for a symmetric filter
+    if (numTaps == 0) numTaps = 8 * ratio + 1;
+    if (numTaps % 2 == 0) numTaps++;
+
+    std::vector<double> coefficients(numTaps);
+    const double cutoff = 0.5 / ratio;
+    const double centre = (numTaps - 1) / 2.0;
+    double sum = 0.0;
+    for (unsigned int n=0; n<numTaps; n++)
+    {
+        double x = n - centre;
+        double sinc = (x == 0.0) ? 2.0 * cutoff : std::sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+        double window = (numTaps > 1) ? 0.54 - 0.46 * std::cos(2.0 * M_PI * n / (numTaps - 1)) : 1.0;
+        coefficients[n] = sinc * window;
+        sum += coefficients[n];
+    }
+    // Normalise to unity DC gain
+    for (unsigned int n=0; n<numTaps; n++)
+    {
+        coefficients[n] /= sum;
+    }
+    return coefficients;
+}
+
+
+// Dot product of two contiguous arrays
+double FIRDecimator::dotProduct(const double *a, const double *b, size_t n)
+{
+    size_t i = 0;
+    double sum = 0.0;
+#if defined(__AVX__)
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double partial[4];
+    _mm256_storeu_pd(partial, _mm256_add_pd(acc0, acc1));
+    sum = partial[0] + partial[1] + partial[2] + partial[3];
+#elif defined(__SSE2__)
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double partial[2];
+    _mm_storeu_pd(partial, _mm_add_pd(acc0, acc1));
+    sum = partial[0] + partial[1];
+#endif
+    // Remaining elements (or everything on targets without SIMD)
+    for (; i < n; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+
+// Push samples into the delay line, only computing the outputs we keep
+void FIRDecimator::process(const double *input, size_t nIn, std::vector<double> &output)
+{
+    const size_t numTaps = reversedCoefficients.size();
+    for (size_t i=0; i<nIn; i++)
+    {
+        // Write to both halves so the last numTaps samples are always contiguous
+        delayLine[delayIndex] = input[i];
+        delayLine[delayIndex + numTaps] = input[i];
+        delayIndex = (delayIndex + 1) % numTaps;
+
+        if (++phase < decimationRatio) continue;
+        phase = 0;
+
+        // Oldest sample is at delayIndex, newest at delayIndex + numTaps - 1
+        output.push_back(dotProduct(&delayLine[delayIndex], reversedCoefficients.data(), numTaps));
+    }
+}
+
+
+// Clear the delay line
+void FIRDecimator::reset()
+{
+    phase = 0;
+    delayIndex = 0;
+    std::fill(delayLine.begin(), delayLine.end(), 0.0);
+}
+
+
+/* DecimationPipeline */
+
+// Constructor
+DecimationPipeline::DecimationPipeline()
+{
+
+}
+
+
+// Remove all stages
+void DecimationPipeline::clear()
+{
+    stages.clear();
+}
+
+
+// Add a stage to the end of the pipeline (takes ownership)
+void DecimationPipeline::addStage(DecimationStage *stage)
+{
+    stages.push_back(std::unique_ptr<DecimationStage>(stage));
+}
+
+
+// Product of all stage ratios
+unsigned int DecimationPipeline::ratio() const
+{
+    unsigned int totalRatio = 1;
+    for (size_t i=0; i<stages.size(); i++)
+    {
+        totalRatio *= stages[i]->ratio();
+    }
+    return totalRatio;
+}
+
+
+// Run input through every stage in turn
+void DecimationPipeline::process(const double *input, size_t nIn, std::vector<double> &output)
+{
+    output.clear();
+    if (stages.empty())
+    {
+        output.assign(input, input + nIn);
+        return;
+    }
+
+    const double *stageInput = input;
+    size_t stageLength = nIn;
+    for (size_t i=0; i<stages.size(); i++)
+    {
+        // Last stage writes straight into the output
+        std::vector<double> &stageOutput = (i == stages.size() - 1) ? output : (i % 2 ? bufferB : bufferA);
+        stageOutput.clear();
+        stages[i]->process(stageInput, stageLength, stageOutput);
+        stageInput = stageOutput.data();
+        stageLength = stageOutput.size();
+    }
+}
+
+
+// Reset all stages
+void DecimationPipeline::reset()
+{
+    for (size_t i=0; i<stages.size(); i++)
+    {
+        stages[i]->reset();
+    }
+}
@@ -0,0 +1,126 @@
+/*
+ * DecimationFilter.h
+ *
+ * Classes for decimating oversampled channel data down to a lower output rate.
+ * Stages can be chained into a DecimationPipeline. All stages keep their state
+ * between calls to process() so a pipeline can be fed one EtherCAT cycle of
+ * samples at a time.
+ *
+*/
+
+#ifndef DECIMATIONFILTER_H
+#define DECIMATIONFILTER_H
+
+#include <memory>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Base class for a single decimation stage
+class DecimationStage
+{
+public:
+    virtual ~DecimationStage() {}
+
+    // Filter nIn input samples and append any decimated output samples to output
+    virtual void process(const double *input, size_t nIn, std::vector<double> &output) = 0;
+
+    // Clear the filter state
+    virtual void reset() = 0;
+
+    // Decimation ratio of this stage
+    virtual unsigned int ratio() const = 0;
+};
+
+
+// Cascaded integrator-comb decimator
+class CICDecimator : public DecimationStage
+{
+public:
+    // Constructor
+    CICDecimator(unsigned int ratio, unsigned int order);
+
+    virtual void process(const double *input, size_t nIn, std::vector<double> &output);
+    virtual void reset();
+    virtual unsigned int ratio() const { return decimationRatio; }
+
+    // Maximum order supported for a given ratio without overflowing the integrators
+    static unsigned int maxOrder(unsigned int ratio);
+
+private:
+    // Attributes
+    unsigned int decimationRatio;
+    unsigned int order;
+    unsigned int phase;
+    double gain;
+
+    // Integrator and comb state. Unsigned arithmetic gives the modulo wrap-around
+    // the CIC structure relies on.
+    std::vector<uint64_t> integrators;
+    std::vector<uint64_t> combs;
+};
+
+
+// FIR decimator which only evaluates the output phase that is kept
+class FIRDecimator : public DecimationStage
+{
+public:
+    // Constructor
+    FIRDecimator(unsigned int ratio, const std::vector<double> &coefficients);
+
+    virtual void process(const double *input, size_t nIn, std::vector<double> &output);
+    virtual void reset();
+    virtual unsigned int ratio() const { return decimationRatio; }
+
+    // Windowed-sinc (Hamming) low pass with the cut-off at the output Nyquist frequency
+    static std::vector<double> designLowPass(unsigned int ratio, unsigned int numTaps = 0);
+
+    // Dot product used for each output sample (SIMD where available)
+    static double dotProduct(const double *a, const double *b, size_t n);
+
+private:
+    // Attributes
+    unsigned int decimationRatio;
+    unsigned int phase;
+
+    // Coefficients stored in reverse order so each output is a forward dot product
+    std::vector<double> reversedCoefficients;
+
+    // Delay line of length 2 * numTaps. Each sample is written twice so the most
+    // recent numTaps samples are always contiguous.
+    std::vector<double> delayLine;
+    size_t delayIndex;
+};
+
+
+// Chain of decimation stages applied in order
+class DecimationPipeline
+{
+public:
+    // Constructor
+    DecimationPipeline();
+
+    // Methods for building the pipeline
+    void clear();
+    void addStage(DecimationStage *stage);
+    size_t numStages() const { return stages.size(); }
+
+    // Overall decimation ratio of the pipeline
+    unsigned int ratio() const;
+
+    // Run the input through all stages, replacing the contents of output
+    void process(const double *input, size_t nIn, std::vector<double> &output);
+
+    // Clear the state of all stages
+    void reset();
+
+private:
+    std::vector<std::unique_ptr<DecimationStage> > stages;
+
+    // Intermediate buffers re-used between calls
+    std::vector<double> bufferA;
+    std::vector<double> bufferB;
+};
+
+#endif /* DECIMATIONFILTER_H */
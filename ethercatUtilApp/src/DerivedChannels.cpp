@@ -0,0 +1,344 @@
+#include "DerivedChannels.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+#include <alarm.h>
+
+#include <cmath>
+#include <stdexcept>
+
+// For logging
+static const char *driverName = "DerivedChannels";
+
+
+// Constructor
+DerivedChannels::DerivedChannels(const char* portName, int maxChannels, const char* cyclePortName, const char* cycleEntry, double period) : asynPortDriver(
+    portName,  /* asyn port name for this driver*/
+    1, /* maxAddr */
+    asynInt32Mask | asynFloat64Mask | asynOctetMask | asynDrvUserMask, /* Interface mask */
+    asynInt32Mask | asynFloat64Mask | asynOctetMask,  /* Interrupt mask */
+    0, /* asynFlags.  This driver does not block and it is not multi-device, so flag is 0 */
+    1, /* Autoconnect */
+    0, /* Default priority */
+    0), /* Default stack size*/
+    value(maxChannels > 0 ? maxChannels : 0),
+    expressionText(value.size()),
+    invalidCycles(value.size()),
+    maxChannels(value.size()),
+    ticker(cyclePortName, cycleEntry, period)
+{
+    /* Asyn parameter creation */
+    createParam("CYCLE_PERIOD", asynParamFloat64, &cyclePeriod);
+    createParam("LATE_CYCLES", asynParamInt32, &lateCycles);
+    createParam("NUM_INPUTS", asynParamInt32, &numInputs);
+    createParam("NUM_CHANNELS", asynParamInt32, &numChannels);
+    setDoubleParam(cyclePeriod, ticker.getPeriod());
+    setIntegerParam(lateCycles, 0);
+    setIntegerParam(numInputs, 0);
+    setIntegerParam(numChannels, 0);
+
+    // Channels are created up front, they are defined as they are added
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (unsigned int channel=0; channel<this->maxChannels; channel++)
+    {
+        epicsSnprintf(str, NBUFF, "CH%d:VAL", channel+1);
+        createParam(str, asynParamFloat64, &value[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:EXPR", channel+1);
+        createParam(str, asynParamOctet, &expressionText[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:INVALID_CYCLES", channel+1);
+        createParam(str, asynParamInt32, &invalidCycles[channel]);
+
+        setDoubleParam(value[channel], 0.0);
+        setParamAlarmStatus(value[channel], epicsAlarmUDF);
+        setParamAlarmSeverity(value[channel], epicsSevInvalid);
+        setStringParam(expressionText[channel], "");
+        setIntegerParam(invalidCycles[channel], 0);
+    }
+    callParamCallbacks();
+
+    evaluateThread = std::thread(&DerivedChannels::evaluateLoop, this);
+}
+
+
+/* Add an input. The entry is monitored so the latest value is always to hand
+ * when the channels are evaluated, without reading the slave port each cycle.
+*/
+void DerivedChannels::addInput(const char* name, const char* slavePortName, const char* entry, double scale, double offset)
+{
+    lock();
+    size_t input = inputNames.size();
+    bool duplicate = false;
+    for (size_t i=0; i<inputNames.size(); i++)
+    {
+        duplicate = duplicate || inputNames[i] == name;
+    }
+    unlock();
+    if (duplicate)
+    {
+        throw std::runtime_error(std::string("input ") + name + " already exists");
+    }
+
+    // The clients are only used from iocsh, the map needs no lock
+    std::unique_ptr<PdoPortClient> &client = pdoPortClients[slavePortName];
+    if (!client)
+    {
+        client.reset(new PdoPortClient(slavePortName));
+    }
+    epicsInt32 raw = 0;
+    if (client->read(entry, raw) != asynSuccess)
+    {
+        throw std::runtime_error(std::string("cannot read ") + slavePortName + " " + entry);
+    }
+
+    // Add the input with its current value before monitoring it, so no update is dropped
+    lock();
+    inputNames.push_back(name);
+    inputScales.push_back(scale);
+    inputOffsets.push_back(offset);
+    inputValues.push_back(raw * scale + offset);
+    unlock();
+
+    if (client->monitor(entry, [this, input](epicsInt32 raw, const epicsTimeStamp &) { onInput(input, raw); }) != asynSuccess)
+    {
+        lock();
+        inputNames.pop_back();
+        inputScales.pop_back();
+        inputOffsets.pop_back();
+        inputValues.pop_back();
+        unlock();
+        throw std::runtime_error(std::string("cannot monitor ") + slavePortName + " " + entry);
+    }
+
+    // Catch a change between the read and the monitor
+    if (client->read(entry, raw) == asynSuccess)
+    {
+        onInput(input, raw);
+    }
+
+    lock();
+    setIntegerParam(numInputs, inputNames.size());
+    callParamCallbacks();
+    unlock();
+}
+
+
+// Compile an expression of the inputs added so far into the next free channel
+int DerivedChannels::addChannel(const char* expression)
+{
+    lock();
+    std::string error;
+    int channel = programs.size();
+    if (programs.size() >= maxChannels)
+    {
+        error = "more than " + std::to_string(maxChannels) + " channels";
+    }
+    else
+    {
+        try
+        {
+            programs.emplace_back(new ExpressionProgram(expression, inputNames));
+        } catch (const std::runtime_error &e)
+        {
+            error = e.what();
+        }
+    }
+    if (!error.empty())
+    {
+        unlock();
+        throw std::runtime_error(error);
+    }
+
+    setStringParam(expressionText[channel], expression);
+    setIntegerParam(numChannels, programs.size());
+    callParamCallbacks();
+    unlock();
+    return channel + 1;
+}
+
+
+// Keep the latest scaled value of an input
+void DerivedChannels::onInput(size_t input, epicsInt32 raw)
+{
+    lock();
+    // An input is only monitored once it has been added
+    if (input < inputValues.size())
+    {
+        inputValues[input] = raw * inputScales[input] + inputOffsets[input];
+    }
+    unlock();
+}
+
+
+/* Evaluate every channel on the same input values and publish them with the time
+ * of the cycle. A result which is not a number (e.g. a division by zero) is
+ * published with INVALID severity and counted.
+*/
+void DerivedChannels::evaluate(const epicsTimeStamp &timestamp)
+{
+    lock();
+    setTimeStamp(&timestamp);
+    setIntegerParam(lateCycles, ticker.getLateCycles());
+    for (size_t channel=0; channel<programs.size(); channel++)
+    {
+        double result = programs[channel]->evaluate(inputValues.data());
+        bool valid = std::isfinite(result);
+        setDoubleParam(value[channel], result);
+        setParamAlarmStatus(value[channel], valid ? epicsAlarmNone : epicsAlarmCalc);
+        setParamAlarmSeverity(value[channel], valid ? epicsSevNone : epicsSevInvalid);
+        if (!valid)
+        {
+            int count;
+            getIntegerParam(invalidCycles[channel], &count);
+            setIntegerParam(invalidCycles[channel], count + 1);
+        }
+    }
+    callParamCallbacks();
+    unlock();
+}
+
+
+// Evaluate the channels once per cycle, from the latest inputs after any missed cycles
+void DerivedChannels::evaluateLoop()
+{
+    epicsTimeStamp timestamp;
+    while (true)
+    {
+        ticker.waitForCycles(timestamp);
+        evaluate(timestamp);
+    }
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to call constructor for the DerivedChannels class.
+      * \param[in] portName The name of the asyn port created in this driver.
+      * \param[in] maxChannels The maximum number of derived channels
+      * \param[in] cyclePortName The asyn port with an entry which changes every cycle (optional)
+      * \param[in] cycleEntry The entry which changes every cycle (optional)
+      * \param[in] period The cycle period in seconds, used without a cycle entry
+      */
+    int DerivedChannelsConfigure(const char *portName, int maxChannels, const char *cyclePortName, const char *cycleEntry, double period)
+    {
+        new DerivedChannels(portName, maxChannels, cyclePortName, cycleEntry, period);
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to add an input to a DerivedChannels port.
+      * \param[in] portName The name of the DerivedChannels port
+      * \param[in] name The name of the input in expressions
+      * \param[in] slavePortName The asyn port of the slave module
+      * \param[in] entry The PDO entry of the input
+      * \param[in] scale The scale applied to the raw value
+      * \param[in] offset The offset added after scaling
+      */
+    int DerivedChannelsAddInput(const char *portName, const char *name, const char *slavePortName, const char *entry,
+                                double scale, double offset)
+    {
+        if (!portName || !name || !slavePortName || !entry)
+        {
+            printf("Usage: DerivedChannelsAddInput portName name slavePortName entry scale offset\n");
+            return(asynError);
+        }
+        DerivedChannels *derived = (DerivedChannels *) findAsynPortDriver(portName);
+        if (!derived)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        try
+        {
+            derived->addInput(name, slavePortName, entry, scale, offset);
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: %s: cannot add input %s: %s\n", driverName, portName, name, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to add a channel to a DerivedChannels port.
+      * Channels are numbered from 1 in the order they are added.
+      * \param[in] portName The name of the DerivedChannels port
+      * \param[in] expression The expression of the inputs, e.g. (a - b) / (a + b)
+      */
+    int DerivedChannelsAddChannel(const char *portName, const char *expression)
+    {
+        if (!portName || !expression)
+        {
+            printf("Usage: DerivedChannelsAddChannel portName expression\n");
+            return(asynError);
+        }
+        DerivedChannels *derived = (DerivedChannels *) findAsynPortDriver(portName);
+        if (!derived)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        try
+        {
+            derived->addChannel(expression);
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: %s: cannot add channel: %s\n", driverName, portName, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg initArg0 = { "portName", iocshArgString };
+    static const iocshArg initArg1 = { "maxChannels", iocshArgInt };
+    static const iocshArg initArg2 = { "cyclePortName", iocshArgString };
+    static const iocshArg initArg3 = { "cycleEntry", iocshArgString };
+    static const iocshArg initArg4 = { "period", iocshArgDouble };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1, &initArg2, &initArg3, &initArg4 };
+    static const iocshFuncDef initFuncDef = { "DerivedChannelsConfigure", 5, initArgs };
+
+    static void initCallFunc(const iocshArgBuf *args)
+    {
+        DerivedChannelsConfigure(args[0].sval, args[1].ival, args[2].sval, args[3].sval, args[4].dval);
+    }
+
+    static const iocshArg inputArg0 = { "portName", iocshArgString };
+    static const iocshArg inputArg1 = { "name", iocshArgString };
+    static const iocshArg inputArg2 = { "slavePortName", iocshArgString };
+    static const iocshArg inputArg3 = { "entry", iocshArgString };
+    static const iocshArg inputArg4 = { "scale", iocshArgDouble };
+    static const iocshArg inputArg5 = { "offset", iocshArgDouble };
+    static const iocshArg * const inputArgs[] = { &inputArg0, &inputArg1, &inputArg2, &inputArg3, &inputArg4, &inputArg5 };
+    static const iocshFuncDef inputFuncDef = { "DerivedChannelsAddInput", 6, inputArgs };
+
+    static void inputCallFunc(const iocshArgBuf *args)
+    {
+        DerivedChannelsAddInput(args[0].sval, args[1].sval, args[2].sval, args[3].sval, args[4].dval, args[5].dval);
+    }
+
+    static const iocshArg channelArg0 = { "portName", iocshArgString };
+    static const iocshArg channelArg1 = { "expression", iocshArgString };
+    static const iocshArg * const channelArgs[] = { &channelArg0, &channelArg1 };
+    static const iocshFuncDef channelFuncDef = { "DerivedChannelsAddChannel", 2, channelArgs };
+
+    static void channelCallFunc(const iocshArgBuf *args)
+    {
+        DerivedChannelsAddChannel(args[0].sval, args[1].sval);
+    }
+
+    void DerivedChannelsRegister(void)
+    {
+        iocshRegister(&initFuncDef, initCallFunc);
+        iocshRegister(&inputFuncDef, inputCallFunc);
+        iocshRegister(&channelFuncDef, channelCallFunc);
+    }
+
+    epicsExportRegistrar(DerivedChannelsRegister);
+
+}
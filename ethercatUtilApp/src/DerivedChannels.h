@@ -0,0 +1,78 @@
+/*
+ * DerivedChannels.h
+ *
+ * Class for computing channels from the PDO entries of any slave modules, e.g.
+ * a bridge ratio, the difference of two channels or a cold junction correction.
+ * Each channel is an expression of named inputs, compiled once when it is added
+ * and evaluated every EtherCAT cycle on the input values of that cycle.
+ *
+*/
+
+#ifndef DERIVEDCHANNELS_H
+#define DERIVEDCHANNELS_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asynPortDriver.h"
+#include "PdoPortClient.h"
+#include "CycleTicker.h"
+#include "ExpressionProgram.h"
+
+
+class DerivedChannels : public asynPortDriver
+{
+
+public:
+    // Constructor
+    DerivedChannels(const char* portName, int maxChannels, const char* cyclePortName, const char* cycleEntry, double period);
+
+    // Add an input, the scaled value of a slave port entry: raw * scale + offset
+    void addInput(const char* name, const char* slavePortName, const char* entry, double scale, double offset);
+
+    // Add a channel computed from the inputs, returning its number
+    int addChannel(const char* expression);
+
+protected:
+    // Module asyn parameter indices
+    int cyclePeriod;
+    int lateCycles;
+    int numInputs;
+    int numChannels;
+
+    // Channel asyn parameter indices
+    std::vector<int> value;
+    std::vector<int> expressionText;
+    std::vector<int> invalidCycles;
+
+private:
+    // Monitor an input entry, keeping its latest scaled value
+    void onInput(size_t input, epicsInt32 raw);
+
+    // Thread evaluating the channels each cycle
+    void evaluateLoop();
+    void evaluate(const epicsTimeStamp &timestamp);
+
+    // Attributes
+    size_t maxChannels;
+    std::vector<std::string> inputNames;
+    std::vector<double> inputScales;
+    std::vector<double> inputOffsets;
+    std::vector<std::unique_ptr<ExpressionProgram> > programs;
+
+    // Latest scaled value of each input
+    std::vector<double> inputValues;
+
+    // One client per slave port providing inputs
+    std::map<std::string, std::unique_ptr<PdoPortClient> > pdoPortClients;
+
+    // Cycle timing and the evaluation thread
+    CycleTicker ticker;
+    std::thread evaluateThread;
+
+};
+
+#endif /* DERIVEDCHANNELS_H */
@@ -0,0 +1,254 @@
+#include "DigitalInputFanout.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include <stdexcept>
+#include <string>
+
+// For logging
+static const char *driverName = "DigitalInputFanout";
+
+// A module's inputs are packed into one 32 bit word
+static const int maxChannels = 32;
+
+
+// Constructor
+DigitalInputFanout::DigitalInputFanout(const char* portName, int maxModules) : asynPortDriver(
+    portName,  /* asyn port name for this driver*/
+    maxModules > 0 ? maxModules : 1, /* maxAddr */
+    asynInt32Mask | asynDrvUserMask, /* Interface mask */
+    asynInt32Mask,  /* Interrupt mask */
+    ASYN_MULTIDEVICE, /* asynFlags.  This driver does not block and has one address per module */
+    1, /* Autoconnect */
+    0, /* Default priority */
+    0), /* Default stack size*/
+    modules(maxModules > 0 ? maxModules : 1)
+{
+    /* Asyn parameter creation */
+    createParam("INPUTS", asynParamInt32, &packedInputs);
+    createParam("CHANGES", asynParamInt32, &changeCount);
+    for (unsigned int addr=0; addr<modules.size(); addr++)
+    {
+        modules[addr].word = 0;
+        modules[addr].valid = false;
+        setIntegerParam(addr, packedInputs, 0);
+        setIntegerParam(addr, changeCount, 0);
+        callParamCallbacks(addr);
+    }
+}
+
+
+/* Follow the input entries of a slave module. Each bit gets a parameter named after
+ * its entry, so records only need this port and the module's address.
+*/
+void DigitalInputFanout::addModule(int addr, const char* slavePortName, const char* entryFormat, int channels)
+{
+    if (addr < 0 || addr >= (int) modules.size())
+    {
+        throw std::runtime_error("address " + std::to_string(addr) + " out of range");
+    }
+    if (channels < 1 || channels > maxChannels)
+    {
+        throw std::runtime_error("number of channels must be 1-" + std::to_string(maxChannels));
+    }
+    Module &module = modules[addr];
+    if (module.client)
+    {
+        throw std::runtime_error("address " + std::to_string(addr) + " already in use");
+    }
+    module.client.reset(new PdoPortClient(slavePortName));
+    module.bitParams.resize(channels);
+
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    epicsUInt32 initialWord = 0;
+    for (int bit=0; bit<channels; bit++)
+    {
+        // Modules of the same type share the parameter names
+        epicsSnprintf(str, NBUFF, entryFormat, bit+1);
+        if (findParam(str, &module.bitParams[bit]) != asynSuccess)
+        {
+            createParam(str, asynParamInt32, &module.bitParams[bit]);
+        }
+
+        epicsInt32 value;
+        if (module.client->read(str, value) != asynSuccess)
+        {
+            // Leave the address free for another attempt
+            module.client.reset();
+            module.bitParams.clear();
+            throw std::runtime_error(std::string("cannot read ") + str);
+        }
+        if (value)
+        {
+            initialWord |= 1u << bit;
+        }
+    }
+
+    // Publish every bit of the initial word
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    lock();
+    setTimeStamp(&now);
+    for (int bit=0; bit<channels; bit++)
+    {
+        setIntegerParam(addr, module.bitParams[bit], (initialWord >> bit) & 1);
+    }
+    setIntegerParam(addr, packedInputs, initialWord);
+    module.word = initialWord;
+    module.valid = true;
+    callParamCallbacks(addr);
+    unlock();
+
+    // Monitor the bits only once the word is valid, so no change is discarded
+    for (int bit=0; bit<channels; bit++)
+    {
+        epicsSnprintf(str, NBUFF, entryFormat, bit+1);
+        module.client->monitor(
+            str,
+            [this, addr, bit](epicsInt32 value, const epicsTimeStamp &timestamp) { onBit(addr, bit, value, timestamp); }
+        );
+    }
+
+    // Catch any change between the initial read and the monitors
+    epicsUInt32 readMask = 0, readWord = 0;
+    for (int bit=0; bit<channels; bit++)
+    {
+        epicsSnprintf(str, NBUFF, entryFormat, bit+1);
+        epicsInt32 value;
+        if (module.client->read(str, value) == asynSuccess)
+        {
+            readMask |= 1u << bit;
+            if (value) readWord |= 1u << bit;
+        }
+    }
+    epicsTimeGetCurrent(&now);
+    lock();
+    commitWord(addr, (module.word & ~readMask) | readWord, now);
+    unlock();
+}
+
+
+// Apply a bit change from the slave port to the module's word
+void DigitalInputFanout::onBit(int addr, unsigned int bit, epicsInt32 value, const epicsTimeStamp &timestamp)
+{
+    lock();
+    Module &module = modules[addr];
+    epicsUInt32 newWord = value ? (module.word | (1u << bit)) : (module.word & ~(1u << bit));
+    commitWord(addr, newWord, timestamp);
+    unlock();
+}
+
+
+// Set only the parameters of changed bits so callParamCallbacks calls back just those
+void DigitalInputFanout::commitWord(int addr, epicsUInt32 newWord, const epicsTimeStamp &timestamp)
+{
+    Module &module = modules[addr];
+    epicsUInt32 changed = module.word ^ newWord;
+    if (!module.valid || !changed)
+    {
+        return;
+    }
+
+    setTimeStamp(&timestamp);
+    for (unsigned int bit=0; bit<module.bitParams.size(); bit++)
+    {
+        if (changed & (1u << bit))
+        {
+            setIntegerParam(addr, module.bitParams[bit], (newWord >> bit) & 1);
+        }
+    }
+    setIntegerParam(addr, packedInputs, newWord);
+
+    int count;
+    getIntegerParam(addr, changeCount, &count);
+    setIntegerParam(addr, changeCount, count + 1);
+    callParamCallbacks(addr);
+
+    module.word = newWord;
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to call constructor for the DigitalInputFanout class.
+      * \param[in] portName The name of the asyn port created in this driver.
+      * \param[in] maxModules The number of modules (asyn addresses)
+      */
+    int DigitalInputFanoutConfigure(const char *portName, int maxModules)
+    {
+        new DigitalInputFanout(portName, maxModules);
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to add a slave module to a DigitalInputFanout port.
+      * \param[in] portName The name of the DigitalInputFanout port
+      * \param[in] addr The asyn address for the module's records
+      * \param[in] slavePortName The name of the asyn port of the slave module
+      * \param[in] entryFormat The PDO entry of each input, with %d for the channel number
+      * \param[in] channels The number of inputs
+      */
+    int DigitalInputFanoutAddModule(const char *portName, int addr, const char *slavePortName, const char *entryFormat, int channels)
+    {
+        if (!portName || !slavePortName || !entryFormat)
+        {
+            printf("Usage: DigitalInputFanoutAddModule portName addr slavePortName entryFormat channels\n");
+            return(asynError);
+        }
+        DigitalInputFanout *fanout = (DigitalInputFanout *) findAsynPortDriver(portName);
+        if (!fanout)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        try
+        {
+            fanout->addModule(addr, slavePortName, entryFormat, channels);
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: %s: cannot add %s: %s\n", driverName, portName, slavePortName, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg initArg0 = { "portName", iocshArgString };
+    static const iocshArg initArg1 = { "maxModules", iocshArgInt };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1 };
+    static const iocshFuncDef initFuncDef = { "DigitalInputFanoutConfigure", 2, initArgs };
+
+    static void initCallFunc(const iocshArgBuf *args)
+    {
+        DigitalInputFanoutConfigure(args[0].sval, args[1].ival);
+    }
+
+    static const iocshArg addArg0 = { "portName", iocshArgString };
+    static const iocshArg addArg1 = { "addr", iocshArgInt };
+    static const iocshArg addArg2 = { "slavePortName", iocshArgString };
+    static const iocshArg addArg3 = { "entryFormat", iocshArgString };
+    static const iocshArg addArg4 = { "channels", iocshArgInt };
+    static const iocshArg * const addArgs[] = { &addArg0, &addArg1, &addArg2, &addArg3, &addArg4 };
+    static const iocshFuncDef addFuncDef = { "DigitalInputFanoutAddModule", 5, addArgs };
+
+    static void addCallFunc(const iocshArgBuf *args)
+    {
+        DigitalInputFanoutAddModule(args[0].sval, args[1].ival, args[2].sval, args[3].sval, args[4].ival);
+    }
+
+    void DigitalInputFanoutRegister(void)
+    {
+        iocshRegister(&initFuncDef, initCallFunc);
+        iocshRegister(&addFuncDef, addCallFunc);
+    }
+
+    epicsExportRegistrar(DigitalInputFanoutRegister);
+
+}
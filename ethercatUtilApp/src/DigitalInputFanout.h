@@ -0,0 +1,57 @@
+/*
+ * DigitalInputFanout.h
+ *
+ * Class for collecting the input bits of one or more digital input modules into
+ * a packed word per module. Changed bits are found by XOR with the previous word
+ * and only the records of those bits are called back (I/O Intr).
+ *
+*/
+
+#ifndef DIGITALINPUTFANOUT_H
+#define DIGITALINPUTFANOUT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asynPortDriver.h"
+#include "PdoPortClient.h"
+
+
+class DigitalInputFanout : public asynPortDriver
+{
+
+public:
+    // Constructor
+    DigitalInputFanout(const char* portName, int maxModules);
+
+    // Add the inputs of a slave module at an address of this port
+    void addModule(int addr, const char* slavePortName, const char* entryFormat, int channels);
+
+protected:
+    // Asyn parameter indices (one list per module)
+    int packedInputs;
+    int changeCount;
+
+private:
+    // Inputs of one slave module
+    struct Module
+    {
+        std::unique_ptr<PdoPortClient> client;
+        std::vector<int> bitParams;
+        epicsUInt32 word;
+        bool valid;
+    };
+
+    // Update one bit of a module's word
+    void onBit(int addr, unsigned int bit, epicsInt32 value, const epicsTimeStamp &timestamp);
+
+    // Publish a new word, calling back only the bits which changed
+    void commitWord(int addr, epicsUInt32 newWord, const epicsTimeStamp &timestamp);
+
+    // Attributes
+    std::vector<Module> modules;
+
+};
+
+#endif /* DIGITALINPUTFANOUT_H */
@@ -0,0 +1,264 @@
+#include "DigitalOutputBatcher.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+
+// For logging
+static const char *driverName = "DigitalOutputBatcher";
+
+// A module's outputs are packed into one 32 bit word
+static const int maxChannels = 32;
+
+
+// Constructor
+DigitalOutputBatcher::DigitalOutputBatcher(const char* portName, const char* slavePortName, const char* entryFormat, int channels,
+                                           const char* cyclePortName, const char* cycleEntry, double period) : asynPortDriver(
+    portName,  /* asyn port name for this driver*/
+    1, /* maxAddr */
+    asynInt32Mask | asynUInt32DigitalMask | asynDrvUserMask, /* Interface mask */
+    asynInt32Mask | asynUInt32DigitalMask,  /* Interrupt mask */
+    0, /* asynFlags.  This driver does not block and it is not multi-device, so flag is 0 */
+    1, /* Autoconnect */
+    0, /* Default priority */
+    0), /* Default stack size*/
+    allBits(0),
+    shadowWord(0),
+    committedWord(0),
+    readbackWord(0),
+    updatedBits(0),
+    pdoPortClient(slavePortName), /* Create PdoPortClient instance */
+    ticker(cyclePortName, cycleEntry, period)
+{
+    if (channels < 1 || channels > maxChannels)
+    {
+        printf("%s: %s: number of channels must be 1-%d\n", driverName, portName, maxChannels);
+        channels = channels < 1 ? 1 : maxChannels;
+    }
+
+    /* Asyn parameter creation */
+    createParam("OUTPUTS", asynParamUInt32Digital, &outputs);
+    createParam("PENDING", asynParamInt32, &pendingOutputs);
+    createParam("COMMITS", asynParamInt32, &commitCount);
+    createParam("WRITE_ERRORS", asynParamInt32, &writeErrors);
+    setIntegerParam(pendingOutputs, 0);
+    setIntegerParam(commitCount, 0);
+    setIntegerParam(writeErrors, 0);
+
+    /* The output of each channel uses the entry name so records only need a different
+     * port. Outputs packed into one entry are named after it and the channel number.
+    */
+    entries = PdoPortClient::bitEntries(entryFormat, channels);
+    allBits = entries.allBits;
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    output.resize(channels);
+    for (int channel=0; channel<channels; channel++)
+    {
+        if (entries.word.empty()) epicsSnprintf(str, NBUFF, "%s", entries.bits[channel].c_str());
+        else epicsSnprintf(str, NBUFF, "%s:%d", entries.word.c_str(), channel+1);
+        createParam(str, asynParamInt32, &output[channel]);
+    }
+
+    // Start from the outputs as they are so nothing changes until written
+    connectReadbacks();
+
+    commitThread = std::thread(&DigitalOutputBatcher::commitLoop, this);
+}
+
+
+/* Register for updates of the outputs in the PDO, then read them. Bits which
+ * update before the read is published keep the value of the update.
+*/
+void DigitalOutputBatcher::connectReadbacks()
+{
+    pdoPortClient.monitorBits(
+        entries,
+        [this](epicsUInt32 word, epicsUInt32 mask, const epicsTimeStamp &timestamp) { onReadback(word, mask, timestamp); }
+    );
+
+    epicsUInt32 initialWord = 0;
+    pdoPortClient.readBits(entries, initialWord);
+
+    lock();
+    initialWord = (initialWord & ~updatedBits) | (readbackWord & updatedBits);
+    shadowWord = committedWord = readbackWord = initialWord;
+    for (unsigned int bit=0; bit<output.size(); bit++)
+    {
+        setIntegerParam(output[bit], (initialWord >> bit) & 1);
+    }
+    setUIntDigitalParam(outputs, initialWord, allBits);
+    callParamCallbacks();
+    unlock();
+}
+
+
+// The PDO shows new values of the outputs in the mask
+void DigitalOutputBatcher::onReadback(epicsUInt32 word, epicsUInt32 mask, const epicsTimeStamp &timestamp)
+{
+    lock();
+    readbackWord = (readbackWord & ~mask) | (word & mask);
+    updatedBits |= mask;
+
+    setTimeStamp(&timestamp);
+    for (unsigned int bit=0; bit<output.size(); bit++)
+    {
+        if (mask & (1u << bit)) setIntegerParam(output[bit], (word >> bit) & 1);
+    }
+    setUIntDigitalParam(outputs, readbackWord, allBits);
+    setIntegerParam(pendingOutputs, (shadowWord ^ readbackWord) & allBits);
+    callParamCallbacks();
+    unlock();
+}
+
+
+// Commit the shadow word once per cycle
+void DigitalOutputBatcher::commitLoop()
+{
+    epicsTimeStamp timestamp;
+    while (true)
+    {
+        ticker.waitForCycles(timestamp);
+        commitOutputs();
+    }
+}
+
+
+/* Write the outputs which changed since the last commit, without our lock. Only
+ * the bits written successfully count as committed, so the others are written
+ * again at the next commit.
+*/
+void DigitalOutputBatcher::commitOutputs()
+{
+    lock();
+    epicsUInt32 word = shadowWord;
+    epicsUInt32 changed = (word ^ committedWord) & allBits;
+    unlock();
+
+    if (!changed)
+    {
+        return;
+    }
+
+    epicsUInt32 written = pdoPortClient.writeBits(entries, word, changed);
+    int errors = 0;
+    for (epicsUInt32 failed = changed & ~written; failed; failed &= failed - 1)
+    {
+        errors++;
+    }
+
+    lock();
+    committedWord = (committedWord & ~written) | (word & written);
+    int count;
+    getIntegerParam(commitCount, &count);
+    setIntegerParam(commitCount, count + 1);
+    if (errors)
+    {
+        getIntegerParam(writeErrors, &count);
+        setIntegerParam(writeErrors, count + errors);
+    }
+    callParamCallbacks();
+    unlock();
+}
+
+
+// Find the channel an asyn parameter belongs to (or -1)
+int DigitalOutputBatcher::findChannel(int param)
+{
+    for (unsigned int channel=0; channel<output.size(); channel++)
+    {
+        if (output[channel] == param) return channel;
+    }
+    return -1;
+}
+
+
+// Stage a single output for the next commit. The parameter keeps showing the readback.
+asynStatus DigitalOutputBatcher::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    // For logging
+    static const char *functionName = "writeInt32";
+
+    int channel = findChannel(pasynUser->reason);
+    if (channel < 0)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: parameter %d is read only\n",
+                  driverName, functionName, pasynUser->reason);
+        return asynError;
+    }
+
+    if (value) shadowWord |= 1u << channel;
+    else shadowWord &= ~(1u << channel);
+    setIntegerParam(pendingOutputs, (shadowWord ^ readbackWord) & allBits);
+    callParamCallbacks();
+    return asynSuccess;
+}
+
+
+// Stage several outputs at once, they are written in the same cycle
+asynStatus DigitalOutputBatcher::writeUInt32Digital(asynUser *pasynUser, epicsUInt32 value, epicsUInt32 mask)
+{
+    // For logging
+    static const char *functionName = "writeUInt32Digital";
+
+    if (pasynUser->reason != outputs)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: parameter %d is read only\n",
+                  driverName, functionName, pasynUser->reason);
+        return asynError;
+    }
+
+    mask &= allBits;
+    shadowWord = (shadowWord & ~mask) | (value & mask);
+    setIntegerParam(pendingOutputs, (shadowWord ^ readbackWord) & allBits);
+    callParamCallbacks();
+    return asynSuccess;
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to call constructor for the DigitalOutputBatcher class.
+      * \param[in] portName The name of the asyn port created in this driver.
+      * \param[in] slavePortName The name of the asyn port of the slave module
+      * \param[in] entryFormat The PDO entry of each output, with %d for the channel number, or one entry holding them all
+      * \param[in] channels The number of outputs
+      * \param[in] cyclePortName The asyn port with an entry changing every cycle (optional)
+      * \param[in] cycleEntry The entry changing every cycle (optional)
+      * \param[in] period The cycle period in seconds, used when there is no cycle entry
+      */
+    int DigitalOutputBatcherConfigure(const char *portName, const char *slavePortName, const char *entryFormat, int channels,
+                                      const char *cyclePortName, const char *cycleEntry, double period)
+    {
+        new DigitalOutputBatcher(portName, slavePortName, entryFormat, channels, cyclePortName, cycleEntry, period);
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg initArg0 = { "portName", iocshArgString };
+    static const iocshArg initArg1 = { "slavePortName", iocshArgString };
+    static const iocshArg initArg2 = { "entryFormat", iocshArgString };
+    static const iocshArg initArg3 = { "channels", iocshArgInt };
+    static const iocshArg initArg4 = { "cyclePortName", iocshArgString };
+    static const iocshArg initArg5 = { "cycleEntry", iocshArgString };
+    static const iocshArg initArg6 = { "period", iocshArgDouble };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1, &initArg2, &initArg3, &initArg4, &initArg5, &initArg6 };
+    static const iocshFuncDef initFuncDef = { "DigitalOutputBatcherConfigure", 7, initArgs };
+
+    static void initCallFunc(const iocshArgBuf *args)
+    {
+        DigitalOutputBatcherConfigure(args[0].sval, args[1].sval, args[2].sval, args[3].ival, args[4].sval, args[5].sval, args[6].dval);
+    }
+
+    void DigitalOutputBatcherRegister(void)
+    {
+        iocshRegister(&initFuncDef, initCallFunc);
+    }
+
+    epicsExportRegistrar(DigitalOutputBatcherRegister);
+
+}
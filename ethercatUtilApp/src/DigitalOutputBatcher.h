@@ -0,0 +1,78 @@
+/*
+ * DigitalOutputBatcher.h
+ *
+ * Class for writing the outputs of a digital output module together. Output
+ * changes are gathered into a shadow word and written to the slave port as one
+ * burst at the next cycle boundary. Readbacks are published (I/O Intr) when the
+ * PDO reflects the change.
+ *
+*/
+
+#ifndef DIGITALOUTPUTBATCHER_H
+#define DIGITALOUTPUTBATCHER_H
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asynPortDriver.h"
+#include "PdoPortClient.h"
+#include "CycleTicker.h"
+
+
+class DigitalOutputBatcher : public asynPortDriver
+{
+
+public:
+    // Constructor
+    DigitalOutputBatcher(const char* portName, const char* slavePortName, const char* entryFormat, int channels,
+                         const char* cyclePortName, const char* cycleEntry, double period);
+
+    // Overidden methods from asynPortDriver
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+    virtual asynStatus writeUInt32Digital(asynUser *pasynUser, epicsUInt32 value, epicsUInt32 mask);
+
+protected:
+    // Module asyn parameter indices
+    int outputs;
+    int pendingOutputs;
+    int commitCount;
+    int writeErrors;
+
+    // Channel asyn parameter indices (named after the output entries)
+    std::vector<int> output;
+
+private:
+    // Methods for following the output entries on the slave port
+    void connectReadbacks();
+    void onReadback(epicsUInt32 word, epicsUInt32 mask, const epicsTimeStamp &timestamp);
+
+    // Thread writing the shadow word each cycle
+    void commitLoop();
+    void commitOutputs();
+
+    // Find the channel an asyn parameter belongs to
+    int findChannel(int param);
+
+    // Attributes
+    PdoPortClient::BitEntries entries;
+    epicsUInt32 allBits;
+
+    // Requested outputs, outputs written to the slave port and the PDO readback
+    epicsUInt32 shadowWord;
+    epicsUInt32 committedWord;
+    epicsUInt32 readbackWord;
+
+    // Bits the PDO has updated since the readbacks were connected
+    epicsUInt32 updatedBits;
+
+    // Client for the PDO entries of the slave port
+    PdoPortClient pdoPortClient;
+
+    // Cycle timing and the thread committing outputs
+    CycleTicker ticker;
+    std::thread commitThread;
+
+};
+
+#endif /* DIGITALOUTPUTBATCHER_H */
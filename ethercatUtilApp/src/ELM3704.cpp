@@ -3,19 +3,45 @@
 #include <iocsh.h>
 #include <epicsExport.h>
 
+#include <epicsEvent.h>
+#include <epicsThread.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <thread>
 #include <iostream>
+#include <vector>
 
 #include "ELM3704Properties.h"
+#include "SdoPortClient.h"
 
 // For logging
 static const char *driverName = "ELM3704";
 
+// All drivers, for the startup report
+static std::mutex driversMutex;
+static std::vector<ELM3704 *> drivers;
+
+
+// Constructor talking to the module through its SDO port
+ELM3704::ELM3704(const char* portName, const char* sdoPortName) :
+    ELM3704(portName, sdoPortName, NULL, true)
+{
+}
+
+
+// Constructor talking to the module through a transport
+ELM3704::ELM3704(const char* portName, SdoTransport *transport, bool initialiseInThread) :
+    ELM3704(portName, NULL, transport, initialiseInThread)
+{
+}
 
-// Constructor
-ELM3704::ELM3704(const char* portName, const char* sdoPortName) : asynPortDriver(
+
+// Constructor talking to the module through a transport, or its SDO port if there is none
+ELM3704::ELM3704(const char* portName, const char* sdoPortName, SdoTransport *transport, bool initialiseInThread) : asynPortDriver(
     portName,  /* asyn port name for this driver*/
     1, /* maxAddr */
     asynInt32Mask | asynEnumMask | asynOctetMask | asynDrvUserMask, /* Interface mask */
@@ -24,8 +50,16 @@ ELM3704::ELM3704(const char* portName, const char* sdoPortName) : asynPortDriver
     1, /* Autoconnect */
     0, /* Default priority */
     0), /* Default stack size*/
-    sdoPortClient(sdoPortName) /* Create SdoPortClient instance */
+    clock(Clock::get()),
+    startup(clock.now()),
+    initialised(false),
+    sdoTransport(transport)
 {
+    if (!sdoTransport)
+    {
+        sdoTransport.reset(new SdoPortClient(sdoPortName, clock));
+    }
+
     /* Asyn parameter creation */
 
     // For each channel
@@ -70,8 +104,45 @@ ELM3704::ELM3704(const char* portName, const char* sdoPortName) : asynPortDriver
         createParam(str, asynParamOctet, &channelStatusMessage[channel]);
     }
 
-    // Initialise asyn parameters using a thread
-    initialiseThread = std::thread(&ELM3704::initialiseValues, this);
+    startup.constructed = clock.now();
+
+    /* Initialise asyn parameters using a thread. It is attached to the clock
+     * before the constructor returns, so an auto-advancing clock waits for it
+     * whatever the host is busy with.
+    */
+    if (initialiseInThread)
+    {
+        epicsEvent attached;
+        initialiseThread = std::thread([this, &attached]()
+        {
+            ClockAttachment attachment(clock);
+            attached.signal();
+            initialiseValues();
+        });
+        attached.wait();
+    }
+    else
+    {
+        initialiseValues();
+    }
+
+    // Registered last, so a constructor which throws leaves no driver behind
+    std::lock_guard<std::mutex> guard(driversMutex);
+    drivers.push_back(this);
+}
+
+
+// Destructor
+ELM3704::~ELM3704()
+{
+    {
+        std::lock_guard<std::mutex> guard(driversMutex);
+        drivers.erase(std::remove(drivers.begin(), drivers.end(), this), drivers.end());
+    }
+    if (initialiseThread.joinable())
+    {
+        initialiseThread.join();
+    }
 }
 
 
@@ -87,15 +158,16 @@ void ELM3704::initialiseValues()
         if (readChannelSubSetting(0, "Interface", parameterValue) == asynSuccess)
         {
             printf("%s: SDO connection is up\n", portName);
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            clock.sleep(0.5);
             break;
         }
         else
         {
             tries++;
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            clock.sleep(0.1);
         }
     }
+    startup.portUp = clock.now();
 
     // Now fetch actual values
     int interface, scaler, sensorSupply, RTDElement, TCElement;
@@ -130,12 +202,87 @@ void ELM3704::initialiseValues()
             setStringParam(channelStatusMessage[channel], "OK");
         }
     }
+    startup.valuesRead = clock.now();
     // Reflect changes in asynParameter values
     callParamCallbacks();
+    startup.calledBack = clock.now();
+    initialised = true;
     std::cout << portName << ": initialising values complete" << std::endl;
 }
 
 
+// Wait until every driver has initialised its values
+bool ELM3704::waitForStartup(double timeout)
+{
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> guard(driversMutex);
+            if (std::all_of(drivers.begin(), drivers.end(), [](ELM3704 *driver) { return driver->initialised.load(); }))
+            {
+                return true;
+            }
+        }
+        if (std::chrono::steady_clock::now() >= end)
+        {
+            return false;
+        }
+        epicsThreadSleep(0.1);
+    }
+}
+
+
+/* Print the mean and maximum time of each phase over the drivers which have
+ * initialised, and the time from the first driver being created to the last
+ * one finishing.
+*/
+void ELM3704::reportStartup(FILE *fp)
+{
+    static const char *phases[] = { "construction", "port_wait", "reads", "callbacks", "total" };
+    static const int numPhases = sizeof(phases) / sizeof(phases[0]);
+    double sums[numPhases] = { 0.0 };
+    double maxima[numPhases] = { 0.0 };
+    double first = 0.0, last = 0.0;
+    int done = 0;
+
+    std::lock_guard<std::mutex> guard(driversMutex);
+    for (size_t i=0; i<drivers.size(); i++)
+    {
+        if (!drivers[i]->initialised)
+        {
+            continue;
+        }
+        const StartupTimes &times = drivers[i]->startup;
+        double durations[numPhases] = {
+            times.constructed - times.start,
+            times.portUp - times.constructed,
+            times.valuesRead - times.portUp,
+            times.calledBack - times.valuesRead,
+            times.calledBack - times.start
+        };
+        for (int phase=0; phase<numPhases; phase++)
+        {
+            sums[phase] += durations[phase];
+            maxima[phase] = std::max(maxima[phase], durations[phase]);
+        }
+        first = done ? std::min(first, times.start) : times.start;
+        last = done ? std::max(last, times.calledBack) : times.calledBack;
+        done++;
+    }
+
+    fprintf(fp, "{\"drivers\": %d, \"initialised\": %d, \"time_to_initialised_s\": %.6f",
+            (int) drivers.size(), done, last - first);
+    for (int phase=0; phase<numPhases; phase++)
+    {
+        fprintf(fp, ", \"%s_mean_s\": %.6f, \"%s_max_s\": %.6f",
+                phases[phase], done ? sums[phase] / done : 0.0, phases[phase], maxima[phase]);
+    }
+    fprintf(fp, "}");
+}
+
+
 // Empty the subtype options list
 void ELM3704::writeNAOption(int param)
 {
@@ -632,7 +779,7 @@ asynStatus ELM3704::setChannelParameter(unsigned int channel, const std::string
     std::string parameterString = "CH" + std::to_string(channel+1) + ":" + paramName;
     try
     {
-        status = sdoPortClient.writeRead(parameterString, (epicsInt32) value);
+        status = sdoTransport->writeRead(parameterString, (epicsInt32) value);
     } catch (const std::runtime_error &e)
     {
         // Update to bad channel status message and rethrow exception
@@ -696,7 +843,7 @@ asynStatus ELM3704::setChannelScaler(unsigned int channel, unsigned int value)
 asynStatus ELM3704::readChannelSubSetting(unsigned int channel, const std::string &paramName, epicsInt32 &paramValue)
 {
     std::string paramString = "CH" + std::to_string(channel+1) + ":" + paramName;
-    return sdoPortClient.read(paramString, paramValue);
+    return sdoTransport->read(paramString, paramValue);
 }
 
 
@@ -1146,6 +1293,22 @@ extern "C"
     }
 
 
+    /** EPICS iocsh callable function to print how long the ELM3704 drivers took to start,
+      * as JSON with the mean and maximum of each phase.
+      * \param[in] timeout Seconds to wait for the drivers still initialising (0 not to wait)
+      */
+    int ELM3704StartupReport(double timeout)
+    {
+        if (timeout > 0.0 && !ELM3704::waitForStartup(timeout))
+        {
+            printf("%s: not all drivers initialised after %g s\n", driverName, timeout);
+        }
+        ELM3704::reportStartup(stdout);
+        printf("\n");
+        return(asynSuccess);
+    }
+
+
     /* EPICS iocsh shell commands */
 
     static const iocshArg initArg0 = { "portName", iocshArgString };
@@ -1158,9 +1321,19 @@ extern "C"
         ELM3704DriverConfigure(args[0].sval, args[1].sval);
     }
 
+    static const iocshArg startupArg0 = { "timeout", iocshArgDouble };
+    static const iocshArg * const startupArgs[] = { &startupArg0 };
+    static const iocshFuncDef startupFuncDef = { "ELM3704StartupReport", 1, startupArgs };
+
+    static void startupCallFunc(const iocshArgBuf *args)
+    {
+        ELM3704StartupReport(args[0].dval);
+    }
+
     void ELM3704DriverRegister(void)
     {
         iocshRegister(&initFuncDef, initCallFunc);
+        iocshRegister(&startupFuncDef, startupCallFunc);
     }
 
     epicsExportRegistrar(ELM3704DriverRegister);
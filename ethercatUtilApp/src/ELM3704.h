@@ -11,10 +11,14 @@
 #ifndef ELM3704_H
 #define ELM3704_H
 
+#include <atomic>
+#include <memory>
+#include <stdio.h>
 #include <thread>
 
 #include "asynPortDriver.h"
-#include "SdoPortClient.h"
+#include "SdoTransport.h"
+#include "Clock.h"
 #include <alarm.h>
 
 
@@ -22,24 +26,26 @@ class ELM3704 : public asynPortDriver
 {
 
 public:
-    // Constructor
+    // Constructor talking to the module through its SDO port
     ELM3704(const char* portName, const char* sdoPortName);
 
+    // Constructor talking to the module through a transport, which the driver
+    // takes ownership of. Without initialiseInThread the parameters are read
+    // from the module before returning.
+    ELM3704(const char* portName, SdoTransport *transport, bool initialiseInThread = true);
+
+    // Destructor, waits for the initialisation and leaves the startup report
+    virtual ~ELM3704();
+
     // Overidden methods from asynPortDriver
     virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
 
-protected:
-    // Channel asyn parameter indices
-    int measurementType[4];
-    int measurementSubType[4];
-    int measurementTypeLoaded[4];
-    int measurementSensorSupply[4];
-    int measurementRTDElementPage[4];
-    int measurementRTDElement[4];
-    int measurementTCElementPage[4];
-    int measurementTCElement[4];
-    int measurementScaler[4];
-    int channelStatusMessage[4];
+    // Wait until every driver has initialised its values, for up to a time in
+    // seconds. Returns false if some have not.
+    static bool waitForStartup(double timeout);
+
+    // Print the startup phases of all drivers as a JSON object
+    static void reportStartup(FILE *fp);
 
     // Measurement type enum
     enum Type {
@@ -56,7 +62,35 @@ protected:
         RTD,
     };
 
+protected:
+    // Channel asyn parameter indices
+    int measurementType[4];
+    int measurementSubType[4];
+    int measurementTypeLoaded[4];
+    int measurementSensorSupply[4];
+    int measurementRTDElementPage[4];
+    int measurementRTDElement[4];
+    int measurementTCElementPage[4];
+    int measurementTCElement[4];
+    int measurementScaler[4];
+    int channelStatusMessage[4];
+
 private:
+    // Constructor for both of the above. The SDO port client is created once the
+    // start time is taken, so that it counts towards the constructor.
+    ELM3704(const char* portName, const char* sdoPortName, SdoTransport *transport, bool initialiseInThread);
+
+    // Times on the clock when each phase of startup ended
+    struct StartupTimes
+    {
+        StartupTimes(double start) : start(start), constructed(0.0), portUp(0.0), valuesRead(0.0), calledBack(0.0) {}
+        double start;           // Start of the constructor
+        double constructed;     // End of the constructor
+        double portUp;          // SDO port answered and settled
+        double valuesRead;      // Settings of all channels read
+        double calledBack;      // Parameter callbacks done
+    };
+
     // Method to initialise values
     void initialiseValues();
 
@@ -125,8 +159,15 @@ private:
     // Method for updating channel status string
     void updateChannelStatusString(unsigned int channel, const std::string &string, const epicsAlarmSeverity &severity);
 
-    // asynPortClient to talk to the SDO port when setting channel parameters
-    SdoPortClient sdoPortClient;
+    // Clock for waits on the SDO port, shared with the client
+    Clock &clock;
+
+    // Startup phases, complete once initialised is set
+    StartupTimes startup;
+    std::atomic<bool> initialised;
+
+    // Transport to talk to the module when setting channel parameters
+    std::unique_ptr<SdoTransport> sdoTransport;
 
     // Initialise values thread
     std::thread initialiseThread;
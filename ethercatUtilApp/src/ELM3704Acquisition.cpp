@@ -0,0 +1,1231 @@
+#include "ELM3704Acquisition.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <string.h>
+
+#include "ELM3704.h"
+#include "ELM3704Properties.h"
+
+// For logging
+static const char *driverName = "ELM3704Acquisition";
+
+// Scale of the median absolute deviation to the standard deviation of normal noise
+static const double madToSigma = 1.4826;
+
+
+// Constructor
+ELM3704Acquisition::ELM3704Acquisition(const char* portName, const char* slavePortName, int oversampling, const char* logicPortName) : asynPortDriver(
+    portName,  /* asyn port name for this driver*/
+    1, /* maxAddr */
+    asynInt32Mask | asynFloat64Mask | asynInt32ArrayMask | asynFloat64ArrayMask | asynOctetMask | asynDrvUserMask, /* Interface mask */
+    asynInt32Mask | asynFloat64Mask | asynInt32ArrayMask | asynFloat64ArrayMask | asynOctetMask,  /* Interrupt mask */
+    0, /* asynFlags.  This driver does not block and it is not multi-device, so flag is 0 */
+    1, /* Autoconnect */
+    0, /* Default priority */
+    0), /* Default stack size*/
+    oversampling(oversampling > 0 ? oversampling : 1),
+    distributedClockLow(0),
+    distributedClockHigh(0),
+    distributedClockValid(false),
+    distributedClockFound(false),
+    recorder(portName, this->oversampling),
+    recordingChannels(0),
+    pdoPortClient(slavePortName) /* Create PdoPortClient instance */
+{
+    /* Asyn parameter creation */
+    createParam("OVERSAMPLING", asynParamInt32, &oversamplingFactor);
+    setIntegerParam(oversamplingFactor, this->oversampling);
+    createParam("SAMPLE_RATE", asynParamFloat64, &sampleRate);
+    // Assume a 1kHz EtherCAT cycle until told otherwise
+    setDoubleParam(sampleRate, 1000.0 * this->oversampling);
+    createParam("TIMESTAMP_SOURCE", asynParamInt32, &timestampSource);
+    setIntegerParam(timestampSource, TimestampSource::Cycle);
+
+    // Recording to file
+    createParam("RECORD", asynParamInt32, &recordEnable);
+    setIntegerParam(recordEnable, 0);
+    createParam("RECORD_CHANNELS", asynParamInt32, &recordChannels);
+    setIntegerParam(recordChannels, 0xF);
+    createParam("RECORD_PATH", asynParamOctet, &recordPath);
+    setStringParam(recordPath, "/tmp");
+    createParam("RECORD_FILE_SIZE", asynParamInt32, &recordFileSize);
+    setIntegerParam(recordFileSize, 256);
+    createParam("RECORD_FILE_TIME", asynParamFloat64, &recordFileTime);
+    setDoubleParam(recordFileTime, 600.0);
+    createParam("RECORD_FILE", asynParamOctet, &recordFile);
+    setStringParam(recordFile, "");
+    createParam("RECORD_BLOCKS", asynParamInt32, &recordBlocks);
+    setIntegerParam(recordBlocks, 0);
+    createParam("RECORD_DROPPED", asynParamInt32, &recordDropped);
+    setIntegerParam(recordDropped, 0);
+    createParam("RECORD_STATUS", asynParamOctet, &recordStatus);
+    setStringParam(recordStatus, "Stopped");
+
+    // Tare (auto-zero)
+    createParam("TARE", asynParamInt32, &tareAll);
+    setIntegerParam(tareAll, 0);
+    createParam("TARE_SAMPLES", asynParamInt32, &tareSamples);
+    setIntegerParam(tareSamples, 1000);
+    createParam("TARE_REJECT", asynParamFloat64, &tareReject);
+    setDoubleParam(tareReject, 3.0);
+
+    // Period over which the PAI status conditions are counted
+    createParam("STATUS_INTERVAL", asynParamFloat64, &statusInterval);
+    setDoubleParam(statusInterval, 1.0);
+
+    // For each channel
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (unsigned int channel=0; channel<4; channel++)
+    {
+        // Raw samples of the last cycle
+        epicsSnprintf(str, NBUFF, "CH%d:SAMPLES", channel+1);
+        createParam(str, asynParamInt32Array, &rawSamples[channel]);
+
+        // Filter mode
+        epicsSnprintf(str, NBUFF, "CH%d:FILTER", channel+1);
+        createParam(str, asynParamInt32, &filterMode[channel]);
+
+        // CIC settings
+        epicsSnprintf(str, NBUFF, "CH%d:CIC_DECIMATION", channel+1);
+        createParam(str, asynParamInt32, &cicDecimation[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:CIC_ORDER", channel+1);
+        createParam(str, asynParamInt32, &cicOrder[channel]);
+
+        // FIR settings
+        epicsSnprintf(str, NBUFF, "CH%d:FIR_DECIMATION", channel+1);
+        createParam(str, asynParamInt32, &firDecimation[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:FIR_COEFFS", channel+1);
+        createParam(str, asynParamFloat64Array, &firCoefficients[channel]);
+
+        // Filtered output
+        epicsSnprintf(str, NBUFF, "CH%d:FILTERED", channel+1);
+        createParam(str, asynParamFloat64, &filteredValue[channel]);
+
+        // Status message
+        epicsSnprintf(str, NBUFF, "CH%d:FILTER_STATUS", channel+1);
+        createParam(str, asynParamOctet, &filterStatusMessage[channel]);
+
+        // Spectrum of IEPE channels
+        epicsSnprintf(str, NBUFF, "CH%d:SPECTRUM_ENABLED", channel+1);
+        createParam(str, asynParamInt32, &spectrumEnabled[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:SPECTRUM_SIZE", channel+1);
+        createParam(str, asynParamInt32, &spectrumSize[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:SPECTRUM_AVERAGES", channel+1);
+        createParam(str, asynParamInt32, &spectrumAverages[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:SPECTRUM", channel+1);
+        createParam(str, asynParamFloat64Array, &spectrumAmplitude[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:SPECTRUM_FREQ", channel+1);
+        createParam(str, asynParamFloat64Array, &spectrumFrequency[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:BAND_LOW", channel+1);
+        createParam(str, asynParamFloat64, &bandLow[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:BAND_HIGH", channel+1);
+        createParam(str, asynParamFloat64, &bandHigh[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:BAND_POWER", channel+1);
+        createParam(str, asynParamFloat64, &bandPower[channel]);
+
+        // Alarm limits checked on every sample
+        epicsSnprintf(str, NBUFF, "CH%d:HIHI", channel+1);
+        createParam(str, asynParamFloat64, &alarmHiHi[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:HIGH", channel+1);
+        createParam(str, asynParamFloat64, &alarmHigh[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:LOW", channel+1);
+        createParam(str, asynParamFloat64, &alarmLow[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:LOLO", channel+1);
+        createParam(str, asynParamFloat64, &alarmLoLo[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:ROC", channel+1);
+        createParam(str, asynParamFloat64, &alarmRate[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:HHSV", channel+1);
+        createParam(str, asynParamInt32, &alarmHiHiSeverity[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:HSV", channel+1);
+        createParam(str, asynParamInt32, &alarmHighSeverity[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:LSV", channel+1);
+        createParam(str, asynParamInt32, &alarmLowSeverity[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:LLSV", channel+1);
+        createParam(str, asynParamInt32, &alarmLoLoSeverity[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:ROC_SV", channel+1);
+        createParam(str, asynParamInt32, &alarmRateSeverity[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:ALARM_BLOCKS", channel+1);
+        createParam(str, asynParamInt32, &alarmBlocks[channel]);
+
+        // Tare
+        epicsSnprintf(str, NBUFF, "CH%d:TARE", channel+1);
+        createParam(str, asynParamInt32, &tareStart[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:TARE_BUSY", channel+1);
+        createParam(str, asynParamInt32, &tareBusy[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:TARE_ZERO", channel+1);
+        createParam(str, asynParamFloat64, &tareZero[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:TARE_STATUS", channel+1);
+        createParam(str, asynParamOctet, &tareStatusMessage[channel]);
+
+        // PAI status bits and the cycles they were set in the last interval
+        epicsSnprintf(str, NBUFF, "CH%d:UNDERRANGE", channel+1);
+        createParam(str, asynParamInt32, &underrange[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:OVERRANGE", channel+1);
+        createParam(str, asynParamInt32, &overrange[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:ERROR", channel+1);
+        createParam(str, asynParamInt32, &channelError[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:UNDERRANGE_CYCLES", channel+1);
+        createParam(str, asynParamInt32, &underrangeCycles[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:OVERRANGE_CYCLES", channel+1);
+        createParam(str, asynParamInt32, &overrangeCycles[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:ERROR_CYCLES", channel+1);
+        createParam(str, asynParamInt32, &errorCycles[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:STALE_CYCLES", channel+1);
+        createParam(str, asynParamInt32, &staleCycles[channel]);
+
+        // Default to a single cycle's worth of samples per output
+        setIntegerParam(filterMode[channel], FilterMode::None);
+        setIntegerParam(cicDecimation[channel], this->oversampling);
+        setIntegerParam(cicOrder[channel], 3);
+        setIntegerParam(firDecimation[channel], 1);
+        setDoubleParam(filteredValue[channel], 0.0);
+        setIntegerParam(spectrumEnabled[channel], 0);
+        setIntegerParam(spectrumSize[channel], 1024);
+        setIntegerParam(spectrumAverages[channel], 4);
+        setDoubleParam(bandLow[channel], 0.0);
+        setDoubleParam(bandHigh[channel], 0.0);
+        setDoubleParam(bandPower[channel], 0.0);
+        setDoubleParam(alarmHiHi[channel], 0.0);
+        setDoubleParam(alarmHigh[channel], 0.0);
+        setDoubleParam(alarmLow[channel], 0.0);
+        setDoubleParam(alarmLoLo[channel], 0.0);
+        setDoubleParam(alarmRate[channel], 0.0);
+        setIntegerParam(alarmHiHiSeverity[channel], epicsSevNone);
+        setIntegerParam(alarmHighSeverity[channel], epicsSevNone);
+        setIntegerParam(alarmLowSeverity[channel], epicsSevNone);
+        setIntegerParam(alarmLoLoSeverity[channel], epicsSevNone);
+        setIntegerParam(alarmRateSeverity[channel], epicsSevNone);
+        setIntegerParam(alarmBlocks[channel], 0);
+        setIntegerParam(tareStart[channel], 0);
+        setIntegerParam(tareBusy[channel], 0);
+        setDoubleParam(tareZero[channel], 0.0);
+        setStringParam(tareStatusMessage[channel], "Not tared");
+        taring[channel] = false;
+        tareTarget[channel] = 0;
+        setIntegerParam(underrange[channel], 0);
+        setIntegerParam(overrange[channel], 0);
+        setIntegerParam(channelError[channel], 0);
+        setIntegerParam(underrangeCycles[channel], 0);
+        setIntegerParam(overrangeCycles[channel], 0);
+        setIntegerParam(errorCycles[channel], 0);
+        setIntegerParam(staleCycles[channel], 0);
+        statusWord[channel] = 0;
+        previousStatusWord[channel] = 0;
+        statusBitsAvailable[channel] = 0;
+        memset(statusCounts[channel], 0, sizeof(statusCounts[channel]));
+
+        blocks[channel].samples.assign(this->oversampling, 0);
+        blocks[channel].samplePeriod = 1.0 / (1000.0 * this->oversampling);
+        epicsTimeGetCurrent(&blocks[channel].timestamp);
+        cycleTimestamps[channel] = blocks[channel].timestamp;
+        statusIntervalStart[channel] = blocks[channel].timestamp;
+        rebuildPipeline(channel);
+
+        // Unknown until read from the logic port
+        memset(&channelSettings[channel], 0, sizeof(RecorderChannelHeader));
+        channelSettings[channel].channel = channel + 1;
+        channelSettings[channel].type = -1;
+        strncpy(channelSettings[channel].typeName, "Unknown", sizeof(channelSettings[channel].typeName) - 1);
+    }
+    lastRecorderStatus = blocks[0].timestamp;
+    callParamCallbacks();
+
+    // Enable the spectrum of IEPE channels if we know the measurement types
+    if (logicPortName && strlen(logicPortName) > 0)
+    {
+        logicPortClient.reset(new PdoPortClient(logicPortName));
+        connectMeasurementTypes();
+        connectChannelSettings();
+    }
+
+    // Start receiving sample blocks and their status
+    connectStatusEntries();
+    connectSampleEntries();
+}
+
+
+// Register for changes of the measurement type of each channel
+void ELM3704Acquisition::connectMeasurementTypes()
+{
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (unsigned int channel=0; channel<4; channel++)
+    {
+        epicsSnprintf(str, NBUFF, "CH%d:TYPE", channel+1);
+        logicPortClient->monitor(
+            str,
+            [this, channel](epicsInt32 value, const epicsTimeStamp &) { onMeasurementType(channel, value); }
+        );
+
+        // Pick up the current type as there may not be another callback
+        epicsInt32 type;
+        if (logicPortClient->read(str, type) == asynSuccess)
+        {
+            onMeasurementType(channel, type);
+        }
+    }
+}
+
+
+// The spectrum stage only exists while the channel measures vibration
+void ELM3704Acquisition::onMeasurementType(unsigned int channel, epicsInt32 type)
+{
+    lock();
+    channelSettings[channel].type = type;
+    memset(channelSettings[channel].typeName, 0, sizeof(channelSettings[channel].typeName));
+    if (type >= 0 && type < ELM3704Properties::numTypeOptions)
+    {
+        strncpy(channelSettings[channel].typeName, ELM3704Properties::typeStrings[type], sizeof(channelSettings[channel].typeName) - 1);
+    }
+
+    int enabled = (type == ELM3704::Type::IEPiezoElectric);
+    setIntegerParam(spectrumEnabled[channel], enabled);
+    try
+    {
+        rebuildSpectrum(channel);
+    } catch (const std::runtime_error &e)
+    {
+        printf("%s: channel %d: cannot create spectrum: %s\n", driverName, channel+1, e.what());
+    }
+    callParamCallbacks();
+    unlock();
+}
+
+
+// Logic port parameters written to the recorder file header for each channel
+static const struct
+{
+    const char *format;
+    int32_t RecorderChannelHeader::*field;
+} recordedSettings[] = {
+    { "CH%d:SUBTYPE", &RecorderChannelHeader::subtype },
+    { "CH%d:SENSOR_SUPPLY", &RecorderChannelHeader::sensorSupply },
+    { "CH%d:RTD_ELEMENT", &RecorderChannelHeader::rtdElement },
+    { "CH%d:TC_ELEMENT", &RecorderChannelHeader::tcElement },
+    { "CH%d:SCALER", &RecorderChannelHeader::scaler },
+};
+
+
+// Register for changes of the settings which describe a channel's recorded data
+void ELM3704Acquisition::connectChannelSettings()
+{
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (unsigned int channel=0; channel<4; channel++)
+    {
+        for (unsigned int i=0; i<sizeof(recordedSettings)/sizeof(recordedSettings[0]); i++)
+        {
+            int32_t RecorderChannelHeader::*field = recordedSettings[i].field;
+            epicsSnprintf(str, NBUFF, recordedSettings[i].format, channel+1);
+            logicPortClient->monitor(
+                str,
+                [this, channel, field](epicsInt32 value, const epicsTimeStamp &) { onChannelSetting(channel, field, value); }
+            );
+
+            epicsInt32 value;
+            if (logicPortClient->read(str, value) == asynSuccess)
+            {
+                onChannelSetting(channel, field, value);
+            }
+        }
+    }
+}
+
+
+// Keep a channel setting for the header of the next recorder file
+void ELM3704Acquisition::onChannelSetting(unsigned int channel, int32_t RecorderChannelHeader::*field, epicsInt32 value)
+{
+    lock();
+    channelSettings[channel].*field = value;
+    unlock();
+}
+
+
+// Register for updates of the sample and cycle counter entries of each channel
+void ELM3704Acquisition::connectSampleEntries()
+{
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (unsigned int channel=0; channel<4; channel++)
+    {
+        for (unsigned int index=0; index<oversampling; index++)
+        {
+            epicsSnprintf(str, NBUFF, ELM3704Properties::sampleEntryFormat, oversampling, channel+1, index);
+            pdoPortClient.monitor(
+                str,
+                [this, channel, index](epicsInt32 value, const epicsTimeStamp &) { onSample(channel, index, value); }
+            );
+        }
+        epicsSnprintf(str, NBUFF, ELM3704Properties::cycleCounterEntryFormat, channel+1);
+        pdoPortClient.monitor(
+            str,
+            [this, channel](epicsInt32, const epicsTimeStamp &timestamp) { onCycleCounter(channel, timestamp); }
+        );
+    }
+
+    // The distributed clock time is optional, without it the cycle time is used
+    bool haveLow = pdoPortClient.monitor(
+        ELM3704Properties::timestampLowEntry,
+        [this](epicsInt32 value, const epicsTimeStamp &) { onDistributedClock(false, value); }
+    ) == asynSuccess;
+    bool haveHigh = pdoPortClient.monitor(
+        ELM3704Properties::timestampHighEntry,
+        [this](epicsInt32 value, const epicsTimeStamp &) { onDistributedClock(true, value); }
+    ) == asynSuccess;
+    if (haveLow && haveHigh)
+    {
+        lock();
+        distributedClockFound = true;
+        setIntegerParam(timestampSource, TimestampSource::DistributedClock);
+        callParamCallbacks();
+        unlock();
+    }
+}
+
+
+// Store half of the 64 bit distributed clock time of the last cycle
+void ELM3704Acquisition::onDistributedClock(bool highWord, epicsInt32 value)
+{
+    lock();
+    if (highWord) distributedClockHigh = (epicsUInt32) value;
+    else distributedClockLow = (epicsUInt32) value;
+    distributedClockValid = true;
+    unlock();
+}
+
+
+// PAI status entries of a channel, in the order of the bits of StatusBit
+static const char **statusEntryFormats[] = {
+    &ELM3704Properties::underrangeEntryFormat,
+    &ELM3704Properties::overrangeEntryFormat,
+    &ELM3704Properties::errorEntryFormat,
+    &ELM3704Properties::txPdoToggleEntryFormat,
+};
+
+
+// Register for the status bits of each channel. Slave ports which do not map the
+// status entries leave their bits clear.
+void ELM3704Acquisition::connectStatusEntries()
+{
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (unsigned int channel=0; channel<4; channel++)
+    {
+        for (unsigned int i=0; i<sizeof(statusEntryFormats)/sizeof(statusEntryFormats[0]); i++)
+        {
+            epicsUInt32 bit = 1 << i;
+            epicsSnprintf(str, NBUFF, *statusEntryFormats[i], channel+1);
+            if (pdoPortClient.monitor(
+                    str,
+                    [this, channel, bit](epicsInt32 value, const epicsTimeStamp &) { onStatusBit(channel, bit, value); }
+                ) == asynSuccess)
+            {
+                lock();
+                statusBitsAvailable[channel] |= bit;
+                unlock();
+            }
+        }
+    }
+}
+
+
+// Store a status bit. Like the samples, bits only call back when they change.
+void ELM3704Acquisition::onStatusBit(unsigned int channel, epicsUInt32 bit, epicsInt32 value)
+{
+    lock();
+    statusWord[channel] = value ? (statusWord[channel] | bit) : (statusWord[channel] & ~bit);
+    unlock();
+}
+
+
+// Store a new sample value. Samples which did not change since the last cycle do
+// not generate a callback, so the stored value is still current.
+void ELM3704Acquisition::onSample(unsigned int channel, unsigned int index, epicsInt32 value)
+{
+    lock();
+    blocks[channel].samples[index] = value;
+    unlock();
+}
+
+
+/* The cycle counter changes every cycle. Its callback for cycle N+1 arrives before
+ * the sample callbacks of that cycle, so the stored samples form the complete block
+ * of cycle N at this point. The block is stamped with the time of cycle N: either
+ * the distributed clock time from the PDO or the update time of the slave port.
+*/
+void ELM3704Acquisition::onCycleCounter(unsigned int channel, const epicsTimeStamp &timestamp)
+{
+    lock();
+    int source;
+    double rate;
+    getIntegerParam(timestampSource, &source);
+    getDoubleParam(sampleRate, &rate);
+
+    SampleBlock &block = blocks[channel];
+    if (source == TimestampSource::DistributedClock && distributedClockValid)
+    {
+        epicsUInt64 nanoseconds = ((epicsUInt64) distributedClockHigh << 32) | distributedClockLow;
+        block.timestamp = SampleBlock::fromDistributedClock(nanoseconds);
+    }
+    else
+    {
+        block.timestamp = cycleTimestamps[channel];
+    }
+    block.samplePeriod = rate > 0.0 ? 1.0 / rate : 0.0;
+
+    decodeStatus(channel);
+    processSampleBlock(channel);
+    cycleTimestamps[channel] = timestamp;
+    unlock();
+}
+
+
+/* Run a block of samples through the channel pipeline and publish the newest output.
+ * The raw samples are stamped with the time of the first sample, the sample period
+ * gives the time of the others. Filter outputs and spectra are stamped with the time
+ * of the newest sample that went into them.
+*/
+void ELM3704Acquisition::processSampleBlock(unsigned int channel)
+{
+    SampleBlock &block = blocks[channel];
+
+    // Recording only copies the block into the recorder's queue
+    if (recordingChannels & (1 << channel))
+    {
+        recorder.push(channel, block);
+    }
+    if (channel == 0 && epicsTimeDiffInSeconds(&block.timestamp, &lastRecorderStatus) >= 1.0)
+    {
+        publishRecorderStatus();
+        lastRecorderStatus = block.timestamp;
+    }
+
+    epicsTimeStamp firstSampleTime = block.sampleTime(0);
+    setTimeStamp(&firstSampleTime);
+    doCallbacksInt32Array(block.samples.data(), block.samples.size(), rawSamples[channel], 0);
+
+    filterInput[channel].assign(block.samples.begin(), block.samples.end());
+    alarms[channel].process(filterInput[channel].data(), filterInput[channel].size(), block.samplePeriod);
+    pipeline[channel].process(filterInput[channel].data(), filterInput[channel].size(), filterOutput[channel]);
+    if (taring[channel])
+    {
+        collectTareSamples(channel);
+    }
+
+    // A high decimation ratio only produces an output every few cycles. The output
+    // carries the worst alarm of all the samples since the last one.
+    setTimeStamp(&block.timestamp);
+    if (!filterOutput[channel].empty())
+    {
+        epicsAlarmSeverity severity;
+        epicsAlarmCondition status;
+        alarms[channel].takeLatched(severity, status);
+        setDoubleParam(filteredValue[channel], filterOutput[channel].back());
+        setParamAlarmStatus(filteredValue[channel], status);
+        setParamAlarmSeverity(filteredValue[channel], severity);
+        unsigned long blocksInAlarm = alarms[channel].getAlarmBlocks();
+        setIntegerParam(alarmBlocks[channel], blocksInAlarm > 0x7FFFFFFF ? 0x7FFFFFFF : (int) blocksInAlarm);
+        callParamCallbacks();
+    }
+
+    // The spectrum uses the full rate data
+    if (spectrum[channel] && spectrum[channel]->addSamples(filterInput[channel].data(), filterInput[channel].size()))
+    {
+        publishSpectrum(channel);
+    }
+}
+
+
+/* Decode the status word once per cycle. The states of the underrange, overrange
+ * and error bits are published when they change, with a severity, and raise the
+ * alarm of the filtered value so a saturated channel cannot read as valid. The
+ * TxPDO toggle should change every cycle; a cycle without a change repeated old
+ * samples and is counted as stale.
+*/
+void ELM3704Acquisition::decodeStatus(unsigned int channel)
+{
+    const epicsUInt32 conditions = Underrange | Overrange | Error;
+    epicsUInt32 word = statusWord[channel];
+    epicsUInt32 changed = word ^ previousStatusWord[channel];
+    previousStatusWord[channel] = word;
+
+    unsigned int *counts = statusCounts[channel];
+    counts[0] += word & Underrange;
+    counts[1] += (word & Overrange) >> 1;
+    counts[2] += (word & Error) >> 2;
+    counts[3] += (statusBitsAvailable[channel] & ~changed & TxPdoToggle) >> 3;
+
+    if (word & Error)
+    {
+        alarms[channel].raise(epicsSevInvalid, epicsAlarmRead);
+    }
+    else if (word & (Underrange | Overrange))
+    {
+        alarms[channel].raise(epicsSevMajor, epicsAlarmHwLimit);
+    }
+
+    if (changed & conditions)
+    {
+        setIntegerParam(underrange[channel], (word & Underrange) != 0);
+        setParamAlarmStatus(underrange[channel], (word & Underrange) ? epicsAlarmHwLimit : epicsAlarmNone);
+        setParamAlarmSeverity(underrange[channel], (word & Underrange) ? epicsSevMajor : epicsSevNone);
+        setIntegerParam(overrange[channel], (word & Overrange) != 0);
+        setParamAlarmStatus(overrange[channel], (word & Overrange) ? epicsAlarmHwLimit : epicsAlarmNone);
+        setParamAlarmSeverity(overrange[channel], (word & Overrange) ? epicsSevMajor : epicsSevNone);
+        setIntegerParam(channelError[channel], (word & Error) != 0);
+        setParamAlarmStatus(channelError[channel], (word & Error) ? epicsAlarmRead : epicsAlarmNone);
+        setParamAlarmSeverity(channelError[channel], (word & Error) ? epicsSevInvalid : epicsSevNone);
+        setTimeStamp(&blocks[channel].timestamp);
+        callParamCallbacks();
+    }
+
+    double interval;
+    getDoubleParam(statusInterval, &interval);
+    if (epicsTimeDiffInSeconds(&blocks[channel].timestamp, &statusIntervalStart[channel]) >= interval)
+    {
+        publishStatusCounts(channel);
+        statusIntervalStart[channel] = blocks[channel].timestamp;
+    }
+}
+
+
+// Publish the cycles each status condition was seen in the last interval and restart the counts
+void ELM3704Acquisition::publishStatusCounts(unsigned int channel)
+{
+    const int params[4] = { underrangeCycles[channel], overrangeCycles[channel], errorCycles[channel], staleCycles[channel] };
+    for (unsigned int i=0; i<4; i++)
+    {
+        int count = statusCounts[channel][i] > 0x7FFFFFFF ? 0x7FFFFFFF : (int) statusCounts[channel][i];
+        setIntegerParam(params[i], count);
+        setParamAlarmSeverity(params[i], count > 0 ? epicsSevMinor : epicsSevNone);
+        statusCounts[channel][i] = 0;
+    }
+    setTimeStamp(&blocks[channel].timestamp);
+    callParamCallbacks();
+}
+
+
+// Start recording the selected channels with the current settings
+void ELM3704Acquisition::startRecording()
+{
+    int mask, fileSize;
+    double fileTime, rate;
+    std::string path;
+    getIntegerParam(recordChannels, &mask);
+    getIntegerParam(recordFileSize, &fileSize);
+    getDoubleParam(recordFileTime, &fileTime);
+    getDoubleParam(sampleRate, &rate);
+    getStringParam(recordPath, path);
+
+    if (fileSize < 1)
+    {
+        throw std::runtime_error("maximum file size must be at least 1 MB");
+    }
+    std::vector<RecorderChannelHeader> channels;
+    for (unsigned int channel=0; channel<4; channel++)
+    {
+        if (mask & (1 << channel)) channels.push_back(channelSettings[channel]);
+    }
+
+    recorder.start(path, channels, rate, (size_t) fileSize * 1024 * 1024, fileTime);
+    recordingChannels = mask & 0xF;
+}
+
+
+/* Publish the recorder statistics. Called from the acquisition thread about once a
+ * second; the recorder's counters are atomics so this does not wait for the writer.
+*/
+void ELM3704Acquisition::publishRecorderStatus()
+{
+    int enabled;
+    getIntegerParam(recordEnable, &enabled);
+    unsigned long long written = recorder.getBlocksWritten();
+    unsigned long long dropped = recorder.getBlocksDropped();
+    setIntegerParam(recordBlocks, written > 0x7FFFFFFF ? 0x7FFFFFFF : (int) written);
+    setIntegerParam(recordDropped, dropped > 0x7FFFFFFF ? 0x7FFFFFFF : (int) dropped);
+    setStringParam(recordFile, recorder.getCurrentFile());
+
+    // The writer thread stops recording if it cannot write a file
+    if (enabled && !recorder.isRecording())
+    {
+        recordingChannels = 0;
+        setIntegerParam(recordEnable, 0);
+        setStringParam(recordStatus, "Stopped: " + recorder.getLastError());
+        setParamAlarmSeverity(recordStatus, epicsSevMajor);
+    }
+    else if (enabled && dropped > 0)
+    {
+        setStringParam(recordStatus, "Recording, blocks dropped");
+        setParamAlarmSeverity(recordStatus, epicsSevMinor);
+    }
+    callParamCallbacks();
+}
+
+
+// Pass the alarm limit parameters of a channel to its evaluator
+void ELM3704Acquisition::updateAlarmLimits(unsigned int channel)
+{
+    AlarmEvaluator::Limits limits;
+    int hihiSeverity, highSeverity, lowSeverity, loloSeverity, rateSeverity;
+    getDoubleParam(alarmHiHi[channel], &limits.hihi);
+    getDoubleParam(alarmHigh[channel], &limits.high);
+    getDoubleParam(alarmLow[channel], &limits.low);
+    getDoubleParam(alarmLoLo[channel], &limits.lolo);
+    getDoubleParam(alarmRate[channel], &limits.rateOfChange);
+    getIntegerParam(alarmHiHiSeverity[channel], &hihiSeverity);
+    getIntegerParam(alarmHighSeverity[channel], &highSeverity);
+    getIntegerParam(alarmLowSeverity[channel], &lowSeverity);
+    getIntegerParam(alarmLoLoSeverity[channel], &loloSeverity);
+    getIntegerParam(alarmRateSeverity[channel], &rateSeverity);
+    limits.hihiSeverity = (epicsAlarmSeverity) hihiSeverity;
+    limits.highSeverity = (epicsAlarmSeverity) highSeverity;
+    limits.lowSeverity = (epicsAlarmSeverity) lowSeverity;
+    limits.loloSeverity = (epicsAlarmSeverity) loloSeverity;
+    limits.rateSeverity = (epicsAlarmSeverity) rateSeverity;
+    alarms[channel].setLimits(limits);
+}
+
+
+// Only bridge channels have a zero point which is worth taring
+static bool isStrainGauge(int type)
+{
+    return type == ELM3704::Type::StrainGaugeFullBridge
+        || type == ELM3704::Type::StrainGaugeHalfBridge
+        || type == ELM3704::Type::StrainGaugeQuarterBridge2Wire
+        || type == ELM3704::Type::StrainGaugeQuarterBridge3Wire;
+}
+
+
+// Start collecting samples to find the zero point of a channel
+void ELM3704Acquisition::startTare(unsigned int channel)
+{
+    int samples;
+    getIntegerParam(tareSamples, &samples);
+    if (samples < 1)
+    {
+        throw std::runtime_error("number of tare samples must be at least 1");
+    }
+
+    // The type is unknown without a logic port, the user knows what is connected
+    int type = channelSettings[channel].type;
+    if (type >= 0 && !isStrainGauge(type))
+    {
+        throw std::runtime_error(std::string("cannot tare a ") + channelSettings[channel].typeName + " channel");
+    }
+
+    tareBuffer[channel].clear();
+    tareBuffer[channel].reserve(samples);
+    tareTarget[channel] = samples;
+    taring[channel] = true;
+    setIntegerParam(tareBusy[channel], 1);
+    setStringParam(tareStatusMessage[channel], "Taring");
+    setParamAlarmSeverity(tareStatusMessage[channel], epicsSevNone);
+}
+
+
+// Add the samples of the current block until enough have been collected
+void ELM3704Acquisition::collectTareSamples(unsigned int channel)
+{
+    const std::vector<double> &samples = filterInput[channel];
+    size_t n = std::min(samples.size(), tareTarget[channel] - tareBuffer[channel].size());
+    tareBuffer[channel].insert(tareBuffer[channel].end(), samples.begin(), samples.begin() + n);
+    if (tareBuffer[channel].size() >= tareTarget[channel])
+    {
+        finishTare(channel);
+    }
+}
+
+
+/* Estimate the zero point as the mean of the samples within TARE_REJECT standard
+ * deviations of the median. The spread comes from the median absolute deviation
+ * so a few spikes, e.g. someone knocking the load cell, cannot widen the window
+ * that is meant to reject them. The zero point is published in raw counts, the
+ * database turns it into the OFFSET of the channel.
+*/
+void ELM3704Acquisition::finishTare(unsigned int channel)
+{
+    std::vector<double> &values = tareBuffer[channel];
+    size_t n = values.size();
+    double reject;
+    getDoubleParam(tareReject, &reject);
+
+    std::nth_element(values.begin(), values.begin() + n/2, values.end());
+    double median = values[n/2];
+    std::vector<double> deviations(n);
+    for (size_t i=0; i<n; i++)
+    {
+        deviations[i] = std::fabs(values[i] - median);
+    }
+    std::nth_element(deviations.begin(), deviations.begin() + n/2, deviations.end());
+    double window = reject * madToSigma * deviations[n/2];
+
+    // Noise free data (e.g. a simulator) has no spread, keep the samples at the median
+    double sum = 0.0;
+    size_t used = 0;
+    for (size_t i=0; i<n; i++)
+    {
+        if (reject <= 0.0 || std::fabs(values[i] - median) <= window)
+        {
+            sum += values[i];
+            used++;
+        }
+    }
+    double zero = sum / used;
+
+    taring[channel] = false;
+    values.clear();
+    values.shrink_to_fit();
+    setIntegerParam(tareBusy[channel], 0);
+    setDoubleParam(tareZero[channel], zero);
+    setStringParam(
+        tareStatusMessage[channel],
+        "Tared at " + std::to_string(zero) + " from " + std::to_string(used) + " of " + std::to_string(n) + " samples"
+    );
+    setParamAlarmSeverity(tareStatusMessage[channel], used < n/2 ? epicsSevMinor : epicsSevNone);
+    callParamCallbacks();
+}
+
+
+// Create or remove the spectrum engine of a channel based on the current settings
+void ELM3704Acquisition::rebuildSpectrum(unsigned int channel)
+{
+    int enabled, size, averages;
+    getIntegerParam(spectrumEnabled[channel], &enabled);
+    getIntegerParam(spectrumSize[channel], &size);
+    getIntegerParam(spectrumAverages[channel], &averages);
+
+    if (!enabled)
+    {
+        spectrum[channel].reset();
+        return;
+    }
+    if (size < 4 || averages < 1)
+    {
+        throw std::runtime_error("spectrum size must be at least 4 and averages at least 1");
+    }
+
+    // Throws if the size is not a power of two, leaving the old engine in place
+    spectrum[channel].reset(new SpectrumEngine(size, averages));
+    publishFrequencies(channel);
+}
+
+
+// Publish the averaged spectrum and band power of a channel
+void ELM3704Acquisition::publishSpectrum(unsigned int channel)
+{
+    double rate, low, high;
+    getDoubleParam(sampleRate, &rate);
+    getDoubleParam(bandLow[channel], &low);
+    getDoubleParam(bandHigh[channel], &high);
+
+    // An empty band means the whole spectrum
+    if (high <= low) high = rate / 2.0;
+    setDoubleParam(bandPower[channel], spectrum[channel]->bandPower(low, high, rate));
+
+    spectrumValues[channel] = spectrum[channel]->amplitudeSpectrum();
+    doCallbacksFloat64Array(spectrumValues[channel].data(), spectrumValues[channel].size(), spectrumAmplitude[channel], 0);
+    callParamCallbacks();
+}
+
+
+// Publish the frequency axis of a channel's spectrum
+void ELM3704Acquisition::publishFrequencies(unsigned int channel)
+{
+    if (!spectrum[channel]) return;
+    double rate;
+    getDoubleParam(sampleRate, &rate);
+    spectrumFrequencies[channel] = spectrum[channel]->binFrequencies(rate);
+    doCallbacksFloat64Array(spectrumFrequencies[channel].data(), spectrumFrequencies[channel].size(), spectrumFrequency[channel], 0);
+}
+
+
+// Replace the pipeline of a channel based on the current filter settings
+void ELM3704Acquisition::rebuildPipeline(unsigned int channel)
+{
+    int mode, cicRatio, order, firRatio;
+    getIntegerParam(filterMode[channel], &mode);
+    getIntegerParam(cicDecimation[channel], &cicRatio);
+    getIntegerParam(cicOrder[channel], &order);
+    getIntegerParam(firDecimation[channel], &firRatio);
+
+    if (cicRatio < 1 || firRatio < 1 || order < 1)
+    {
+        throw std::runtime_error("decimation ratios and CIC order must be positive");
+    }
+
+    // Build the new pipeline before replacing the old one so errors leave it intact
+    DecimationPipeline newPipeline;
+    std::string description;
+    switch (mode)
+    {
+        case FilterMode::None:
+            // Pass through, the latest sample is published
+            description = "No filter";
+            break;
+
+        case FilterMode::CIC:
+            newPipeline.addStage(new CICDecimator(cicRatio, order));
+            description = "CIC";
+            break;
+
+        case FilterMode::FIR:
+        case FilterMode::CICAndFIR:
+            if (mode == FilterMode::CICAndFIR)
+            {
+                newPipeline.addStage(new CICDecimator(cicRatio, order));
+                description = "CIC + ";
+            }
+            if (coefficients[channel].empty())
+            {
+                newPipeline.addStage(new FIRDecimator(firRatio, FIRDecimator::designLowPass(firRatio)));
+                description += "FIR (default low pass)";
+            }
+            else
+            {
+                newPipeline.addStage(new FIRDecimator(firRatio, coefficients[channel]));
+                description += "FIR (" + std::to_string(coefficients[channel].size()) + " taps)";
+            }
+            break;
+
+        default:
+            throw std::runtime_error("invalid filter mode " + std::to_string(mode));
+    }
+
+    pipeline[channel] = std::move(newPipeline);
+    setStringParam(
+        filterStatusMessage[channel],
+        description + ", decimation " + std::to_string(pipeline[channel].ratio())
+    );
+    setParamAlarmSeverity(filterStatusMessage[channel], epicsSevNone);
+}
+
+
+// Find the channel an asyn parameter belongs to (or -1)
+int ELM3704Acquisition::findChannel(const int *params, int param)
+{
+    for (unsigned int channel=0; channel<4; channel++)
+    {
+        if (params[channel] == param) return channel;
+    }
+    return -1;
+}
+
+
+// AsynPortDriver::writeInt32 override
+asynStatus ELM3704Acquisition::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    // For logging
+    static const char *functionName = "writeInt32";
+
+    // Updated parameter
+    const int param = pasynUser->reason;
+
+    // Module level settings
+    if (param == recordEnable)
+    {
+        asynStatus status = asynSuccess;
+        try
+        {
+            if (value)
+            {
+                startRecording();
+                setStringParam(recordStatus, "Recording");
+            }
+            else
+            {
+                recorder.stop();
+                recordingChannels = 0;
+                setStringParam(recordStatus, "Stopped");
+            }
+            setIntegerParam(recordEnable, value ? 1 : 0);
+            setParamAlarmSeverity(recordStatus, epicsSevNone);
+        } catch (const std::runtime_error &e)
+        {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: cannot record: %s\n",
+                      driverName, functionName, e.what());
+            setIntegerParam(recordEnable, 0);
+            setStringParam(recordStatus, std::string("Cannot record: ") + e.what());
+            setParamAlarmSeverity(recordStatus, epicsSevMajor);
+            status = asynError;
+        }
+        publishRecorderStatus();
+        return status;
+    }
+    if (param == tareAll || findChannel(tareStart, param) >= 0)
+    {
+        // Taring every channel skips those known not to be bridges
+        int channel = findChannel(tareStart, param);
+        asynStatus status = asynSuccess;
+        for (unsigned int i=0; i<4; i++)
+        {
+            if (!value || (channel >= 0 && (int) i != channel)) continue;
+            if (channel < 0 && channelSettings[i].type >= 0 && !isStrainGauge(channelSettings[i].type)) continue;
+            try
+            {
+                startTare(i);
+            } catch (const std::runtime_error &e)
+            {
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: channel %d: %s\n",
+                          driverName, functionName, i+1, e.what());
+                setStringParam(tareStatusMessage[i], std::string("Cannot tare: ") + e.what());
+                setParamAlarmSeverity(tareStatusMessage[i], epicsSevMajor);
+                status = asynError;
+            }
+        }
+        callParamCallbacks();
+        return status;
+    }
+    if (param == recordChannels || param == recordFileSize || param == tareSamples)
+    {
+        // Used when the next recording starts
+        return asynPortDriver::writeInt32(pasynUser, value);
+    }
+    if (param == timestampSource)
+    {
+        // The distributed clock can only be used if the slave has its entries
+        if (value != TimestampSource::Cycle && value != TimestampSource::DistributedClock)
+        {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: %d is not a timestamp source\n",
+                      driverName, functionName, value);
+            return asynError;
+        }
+        if (value == TimestampSource::DistributedClock && !distributedClockFound)
+        {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: slave has no distributed clock entries\n",
+                      driverName, functionName);
+            return asynError;
+        }
+        setIntegerParam(timestampSource, value);
+        callParamCallbacks();
+        return asynSuccess;
+    }
+
+    // Alarm severities take effect from the next sample block
+    int alarmChannel = findChannel(alarmHiHiSeverity, param);
+    if (alarmChannel < 0) alarmChannel = findChannel(alarmHighSeverity, param);
+    if (alarmChannel < 0) alarmChannel = findChannel(alarmLowSeverity, param);
+    if (alarmChannel < 0) alarmChannel = findChannel(alarmLoLoSeverity, param);
+    if (alarmChannel < 0) alarmChannel = findChannel(alarmRateSeverity, param);
+    if (alarmChannel >= 0)
+    {
+        if (value < epicsSevNone || value > epicsSevInvalid)
+        {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: %d is not an alarm severity\n",
+                      driverName, functionName, value);
+            return asynError;
+        }
+        asynStatus status = asynPortDriver::writeInt32(pasynUser, value);
+        updateAlarmLimits(alarmChannel);
+        return status;
+    }
+
+    // Find which filter or spectrum setting changed
+    bool isSpectrumSetting = false;
+    int channel = findChannel(filterMode, param);
+    if (channel < 0) channel = findChannel(cicDecimation, param);
+    if (channel < 0) channel = findChannel(cicOrder, param);
+    if (channel < 0) channel = findChannel(firDecimation, param);
+    if (channel < 0)
+    {
+        isSpectrumSetting = true;
+        channel = findChannel(spectrumSize, param);
+        if (channel < 0) channel = findChannel(spectrumAverages, param);
+    }
+    if (channel < 0)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: parameter %d is read only\n",
+                  driverName, functionName, param);
+        return asynError;
+    }
+
+    // Keep the old value in case the new settings are invalid
+    int oldValue;
+    getIntegerParam(param, &oldValue);
+
+    asynStatus status = asynPortDriver::writeInt32(pasynUser, value);
+    try
+    {
+        if (isSpectrumSetting) rebuildSpectrum(channel);
+        else rebuildPipeline(channel);
+    } catch (const std::runtime_error &e)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: channel %d: %s\n",
+                  driverName, functionName, channel+1, e.what());
+        setIntegerParam(param, oldValue);
+        setStringParam(filterStatusMessage[channel], std::string("Invalid setting: ") + e.what());
+        setParamAlarmSeverity(filterStatusMessage[channel], epicsSevMajor);
+        status = asynError;
+    }
+    callParamCallbacks();
+
+    return status;
+}
+
+
+// AsynPortDriver::writeFloat64 override
+asynStatus ELM3704Acquisition::writeFloat64(asynUser *pasynUser, epicsFloat64 value)
+{
+    // For logging
+    static const char *functionName = "writeFloat64";
+
+    // Updated parameter
+    const int param = pasynUser->reason;
+
+    // The frequency axis depends on the sample rate
+    if (param == sampleRate)
+    {
+        if (value <= 0.0)
+        {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: sample rate %g is not above 0\n",
+                      driverName, functionName, value);
+            return asynError;
+        }
+        asynStatus status = asynPortDriver::writeFloat64(pasynUser, value);
+        for (unsigned int channel=0; channel<4; channel++)
+        {
+            publishFrequencies(channel);
+        }
+        return status;
+    }
+
+    // Alarm limits take effect from the next sample block
+    int channel = findChannel(alarmHiHi, param);
+    if (channel < 0) channel = findChannel(alarmHigh, param);
+    if (channel < 0) channel = findChannel(alarmLow, param);
+    if (channel < 0) channel = findChannel(alarmLoLo, param);
+    if (channel < 0) channel = findChannel(alarmRate, param);
+    if (channel >= 0)
+    {
+        asynStatus status = asynPortDriver::writeFloat64(pasynUser, value);
+        updateAlarmLimits(channel);
+        return status;
+    }
+
+    // The remaining settings are read when they are next used
+    if (param == recordFileTime || param == tareReject || param == statusInterval ||
+        findChannel(bandLow, param) >= 0 || findChannel(bandHigh, param) >= 0)
+    {
+        return asynPortDriver::writeFloat64(pasynUser, value);
+    }
+
+    asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: parameter %d is read only\n",
+              driverName, functionName, param);
+    return asynError;
+}
+
+
+// Return the raw samples of the last cycle
+asynStatus ELM3704Acquisition::readInt32Array(asynUser *pasynUser, epicsInt32 *value, size_t nElements, size_t *nIn)
+{
+    int channel = findChannel(rawSamples, pasynUser->reason);
+    if (channel < 0)
+    {
+        return asynPortDriver::readInt32Array(pasynUser, value, nElements, nIn);
+    }
+
+    const std::vector<epicsInt32> &samples = blocks[channel].samples;
+    size_t n = samples.size() < nElements ? samples.size() : nElements;
+    std::copy(samples.begin(), samples.begin() + n, value);
+    *nIn = n;
+    pasynUser->timestamp = blocks[channel].sampleTime(0);
+    return asynSuccess;
+}
+
+
+// Return the stored FIR coefficients or the last spectrum
+asynStatus ELM3704Acquisition::readFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements, size_t *nIn)
+{
+    const int param = pasynUser->reason;
+    const std::vector<double> *source = NULL;
+    int channel;
+    if ((channel = findChannel(firCoefficients, param)) >= 0) source = &coefficients[channel];
+    else if ((channel = findChannel(spectrumAmplitude, param)) >= 0) source = &spectrumValues[channel];
+    else if ((channel = findChannel(spectrumFrequency, param)) >= 0) source = &spectrumFrequencies[channel];
+    else return asynPortDriver::readFloat64Array(pasynUser, value, nElements, nIn);
+
+    size_t n = source->size() < nElements ? source->size() : nElements;
+    std::copy(source->begin(), source->begin() + n, value);
+    *nIn = n;
+    return asynSuccess;
+}
+
+
+// Set new FIR coefficients for a channel. An empty array restores the default low pass.
+asynStatus ELM3704Acquisition::writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements)
+{
+    // For logging
+    static const char *functionName = "writeFloat64Array";
+
+    int channel = findChannel(firCoefficients, pasynUser->reason);
+    if (channel < 0)
+    {
+        return asynPortDriver::writeFloat64Array(pasynUser, value, nElements);
+    }
+
+    asynStatus status = asynSuccess;
+    std::vector<double> oldCoefficients = coefficients[channel];
+    coefficients[channel].assign(value, value + nElements);
+    try
+    {
+        rebuildPipeline(channel);
+        doCallbacksFloat64Array(value, nElements, firCoefficients[channel], 0);
+    } catch (const std::runtime_error &e)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: channel %d: %s\n",
+                  driverName, functionName, channel+1, e.what());
+        coefficients[channel] = oldCoefficients;
+        status = asynError;
+    }
+    callParamCallbacks();
+
+    return status;
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to call constructor for the ELM3704Acquisition class.
+      * \param[in] portName The name of the asyn port created in this driver.
+      * \param[in] slavePortName The name of the asyn port of the slave module
+      * \param[in] oversampling The number of samples per channel in each PDO
+      * \param[in] logicPortName The name of the ELM3704 driver port (optional)
+      */
+    int ELM3704AcquisitionConfigure(const char *portName, const char *slavePortName, int oversampling, const char *logicPortName)
+    {
+        new ELM3704Acquisition(portName, slavePortName, oversampling, logicPortName);
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg initArg0 = { "portName", iocshArgString };
+    static const iocshArg initArg1 = { "slavePortName", iocshArgString };
+    static const iocshArg initArg2 = { "oversampling", iocshArgInt };
+    static const iocshArg initArg3 = { "logicPortName", iocshArgString };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1, &initArg2, &initArg3 };
+    static const iocshFuncDef initFuncDef = { "ELM3704AcquisitionConfigure", 4, initArgs };
+
+    static void initCallFunc(const iocshArgBuf *args)
+    {
+        ELM3704AcquisitionConfigure(args[0].sval, args[1].sval, args[2].ival, args[3].sval);
+    }
+
+    void ELM3704AcquisitionRegister(void)
+    {
+        iocshRegister(&initFuncDef, initCallFunc);
+    }
+
+    epicsExportRegistrar(ELM3704AcquisitionRegister);
+
+}
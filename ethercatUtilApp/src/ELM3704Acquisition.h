@@ -0,0 +1,228 @@
+/*
+ * ELM3704Acquisition.h
+ *
+ * Class for processing the oversampled PDO data of the ELM3704 channels. Sample
+ * blocks are collected from the slave asyn port each EtherCAT cycle and passed
+ * through a per-channel decimation pipeline and, optionally, recorded to disk.
+ *
+*/
+
+#ifndef ELM3704ACQUISITION_H
+#define ELM3704ACQUISITION_H
+
+#include <memory>
+#include <vector>
+
+#include "asynPortDriver.h"
+#include "PdoPortClient.h"
+#include "DecimationFilter.h"
+#include "SpectrumEngine.h"
+#include "AlarmEvaluator.h"
+#include "SampleBlock.h"
+#include "SampleRecorder.h"
+#include <alarm.h>
+
+
+class ELM3704Acquisition : public asynPortDriver
+{
+
+public:
+    // Constructor
+    ELM3704Acquisition(const char* portName, const char* slavePortName, int oversampling, const char* logicPortName);
+
+    // Overidden methods from asynPortDriver
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+    virtual asynStatus writeFloat64(asynUser *pasynUser, epicsFloat64 value);
+    virtual asynStatus readFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements, size_t *nIn);
+    virtual asynStatus writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements);
+    virtual asynStatus readInt32Array(asynUser *pasynUser, epicsInt32 *value, size_t nElements, size_t *nIn);
+
+protected:
+    // Module asyn parameter indices
+    int oversamplingFactor;
+    int sampleRate;
+    int timestampSource;
+    int recordEnable;
+    int recordChannels;
+    int recordPath;
+    int recordFileSize;
+    int recordFileTime;
+    int recordFile;
+    int recordBlocks;
+    int recordDropped;
+    int recordStatus;
+    int tareAll;
+    int tareSamples;
+    int tareReject;
+    int statusInterval;
+
+    // Channel asyn parameter indices
+    int rawSamples[4];
+    int filterMode[4];
+    int cicDecimation[4];
+    int cicOrder[4];
+    int firDecimation[4];
+    int firCoefficients[4];
+    int filteredValue[4];
+    int filterStatusMessage[4];
+    int spectrumEnabled[4];
+    int spectrumSize[4];
+    int spectrumAverages[4];
+    int spectrumAmplitude[4];
+    int spectrumFrequency[4];
+    int bandLow[4];
+    int bandHigh[4];
+    int bandPower[4];
+    int alarmHiHi[4];
+    int alarmHigh[4];
+    int alarmLow[4];
+    int alarmLoLo[4];
+    int alarmRate[4];
+    int alarmHiHiSeverity[4];
+    int alarmHighSeverity[4];
+    int alarmLowSeverity[4];
+    int alarmLoLoSeverity[4];
+    int alarmRateSeverity[4];
+    int alarmBlocks[4];
+    int tareStart[4];
+    int tareBusy[4];
+    int tareZero[4];
+    int tareStatusMessage[4];
+    int underrange[4];
+    int overrange[4];
+    int channelError[4];
+    int underrangeCycles[4];
+    int overrangeCycles[4];
+    int errorCycles[4];
+    int staleCycles[4];
+
+    // Filter mode enum
+    enum FilterMode {
+        None,
+        CIC,
+        FIR,
+        CICAndFIR,
+    };
+
+    // Timestamp source enum
+    enum TimestampSource {
+        Cycle,
+        DistributedClock,
+    };
+
+    // Bits of the packed PAI status word of a channel
+    enum StatusBit {
+        Underrange = 1 << 0,
+        Overrange = 1 << 1,
+        Error = 1 << 2,
+        TxPdoToggle = 1 << 3,
+    };
+
+private:
+    // Methods for collecting sample blocks from the slave port
+    void connectSampleEntries();
+    void onSample(unsigned int channel, unsigned int index, epicsInt32 value);
+    void onCycleCounter(unsigned int channel, const epicsTimeStamp &timestamp);
+    void onDistributedClock(bool highWord, epicsInt32 value);
+
+    // Methods for the status bits sent with each channel's samples
+    void connectStatusEntries();
+    void onStatusBit(unsigned int channel, epicsUInt32 bit, epicsInt32 value);
+    void decodeStatus(unsigned int channel);
+    void publishStatusCounts(unsigned int channel);
+
+    // Method to follow the measurement type set on the ELM3704 logic port
+    void connectMeasurementTypes();
+    void onMeasurementType(unsigned int channel, epicsInt32 type);
+
+    // Method to follow the settings recorded in the file header
+    void connectChannelSettings();
+    void onChannelSetting(unsigned int channel, int32_t RecorderChannelHeader::*field, epicsInt32 value);
+
+    // Method to process a complete block of samples for a channel
+    void processSampleBlock(unsigned int channel);
+
+    // Method to rebuild a channel's pipeline after a filter setting changes
+    void rebuildPipeline(unsigned int channel);
+
+    // Methods for the spectrum of vibration (IEPE) channels
+    void rebuildSpectrum(unsigned int channel);
+    void publishSpectrum(unsigned int channel);
+    void publishFrequencies(unsigned int channel);
+
+    // Method to pass the alarm limit parameters of a channel to its evaluator
+    void updateAlarmLimits(unsigned int channel);
+
+    // Methods to find the zero point of a channel from its samples
+    void startTare(unsigned int channel);
+    void collectTareSamples(unsigned int channel);
+    void finishTare(unsigned int channel);
+
+    // Methods for recording sample blocks to file
+    void startRecording();
+    void publishRecorderStatus();
+
+    // Find the channel an asyn parameter belongs to
+    int findChannel(const int *params, int param);
+
+    // Oversampling factor of the PDOs (samples per channel per cycle)
+    unsigned int oversampling;
+
+    // Latest samples received for each channel
+    SampleBlock blocks[4];
+
+    // Slave port update time of the last cycle counter callback for each channel
+    epicsTimeStamp cycleTimestamps[4];
+
+    // Latest distributed clock time from the PDO (ns since 2000-01-01)
+    epicsUInt32 distributedClockLow;
+    epicsUInt32 distributedClockHigh;
+    bool distributedClockValid;
+
+    // Whether the slave has the distributed clock entries, so it can be selected
+    bool distributedClockFound;
+
+    // PAI status bits of each channel, the word of the previous cycle, the bits the
+    // slave port provides and the cycles each condition was seen this interval
+    epicsUInt32 statusWord[4];
+    epicsUInt32 previousStatusWord[4];
+    epicsUInt32 statusBitsAvailable[4];
+    unsigned int statusCounts[4][4];
+    epicsTimeStamp statusIntervalStart[4];
+
+    // Filter coefficients written by the user (empty for the default low pass)
+    std::vector<double> coefficients[4];
+
+    // Decimation pipeline and working buffers for each channel
+    DecimationPipeline pipeline[4];
+    std::vector<double> filterInput[4];
+    std::vector<double> filterOutput[4];
+
+    // Spectrum engine, only created while a channel measures IEPE
+    std::unique_ptr<SpectrumEngine> spectrum[4];
+    std::vector<double> spectrumValues[4];
+    std::vector<double> spectrumFrequencies[4];
+
+    // Limit checks on every sample, latched until the filtered value is published
+    AlarmEvaluator alarms[4];
+
+    // Samples collected while taring each channel
+    std::vector<double> tareBuffer[4];
+    size_t tareTarget[4];
+    bool taring[4];
+
+    // Recorder for the full rate data and the channel settings written to its files
+    SampleRecorder recorder;
+    RecorderChannelHeader channelSettings[4];
+    unsigned int recordingChannels;
+    epicsTimeStamp lastRecorderStatus;
+
+    // Client for the PDO entries of the slave port
+    PdoPortClient pdoPortClient;
+
+    // Client for the ELM3704 logic port (optional)
+    std::unique_ptr<PdoPortClient> logicPortClient;
+
+};
+
+#endif /* ELM3704ACQUISITION_H */
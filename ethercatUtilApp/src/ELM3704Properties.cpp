@@ -249,3 +249,25 @@ const char *ELM3704Properties::TCScalerStrings[numTCScalerOptions] = {
 
 // Severities can be done with a single array of all values
 int ELM3704Properties::severities[numSeveritiesOptions] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+
+// Measurement type names, as shown on the TYPE record
+const char *ELM3704Properties::typeStrings[numTypeOptions] = {
+    "None", "Voltage", "Current", "Potentiometer", "Thermocouple", "IEPE", "Strain Gauge FB",
+    "Strain Gauge HB", "Strain Gauge QB 2 wire", "Strain Gauge QB 3 wire", "RTD"
+};
+
+// PDO entries. Sample arrays are named by the oversampling factor of the selected
+// PDO, e.g. PAISamples10Channel1.Samples__ARRAY[9] (oversampling, channel, index).
+const char *ELM3704Properties::sampleEntryFormat = "PAISamples%dChannel%d.Samples__ARRAY[%d]";
+// The input cycle counter increments every cycle so always generates a callback (channel)
+const char *ELM3704Properties::cycleCounterEntryFormat = "PAIStatusChannel%d.InputCycleCounter";
+// Distributed clock time of the samples (ns since 2000-01-01) split into 32 bit words
+const char *ELM3704Properties::timestampLowEntry = "PAITimestamp.TimestampLow";
+const char *ELM3704Properties::timestampHighEntry = "PAITimestamp.TimestampHigh";
+// Status bits of each channel's samples, updated every cycle (channel)
+const char *ELM3704Properties::underrangeEntryFormat = "PAIStatusChannel%d.Underrange";
+const char *ELM3704Properties::overrangeEntryFormat = "PAIStatusChannel%d.Overrange";
+const char *ELM3704Properties::errorEntryFormat = "PAIStatusChannel%d.Error";
+// Toggles when the channel delivers new data, a cycle without a toggle repeats old samples
+const char *ELM3704Properties::txPdoToggleEntryFormat = "PAIStatusChannel%d.TxPDOToggle";
@@ -97,6 +97,20 @@ public:
     static const int numSeveritiesOptions = 16;
     static int severities[numSeveritiesOptions];
 
+    // Measurement type names (indexed by ELM3704::Type)
+    static const int numTypeOptions = 11;
+    static const char *typeStrings[numTypeOptions];
+
+    // PDO entry names on the slave port (printf style formats)
+    static const char *sampleEntryFormat;
+    static const char *cycleCounterEntryFormat;
+    static const char *timestampLowEntry;
+    static const char *timestampHighEntry;
+    static const char *underrangeEntryFormat;
+    static const char *overrangeEntryFormat;
+    static const char *errorEntryFormat;
+    static const char *txPdoToggleEntryFormat;
+
 private:
     // Constructor is private as we just have static members
     ELM3704Properties();
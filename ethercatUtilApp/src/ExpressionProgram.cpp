@@ -0,0 +1,311 @@
+#include "ExpressionProgram.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <cmath>
+#include <stdexcept>
+
+
+// Compile the expression, checking it leaves exactly one value on the stack
+ExpressionProgram::ExpressionProgram(const std::string &expression, const std::vector<std::string> &inputNames) :
+    expression(expression),
+    inputNames(inputNames),
+    position(0),
+    depth(0),
+    maxDepth(0)
+{
+    parseSum();
+    skipSpace();
+    if (position < expression.size())
+    {
+        fail("unexpected '" + expression.substr(position, 1) + "'");
+    }
+    stack.resize(maxDepth);
+}
+
+
+// Run the instructions. The stack was sized when compiling so it cannot overflow.
+double ExpressionProgram::evaluate(const double *inputs)
+{
+    double *top = stack.data() - 1;
+    for (const Instruction &instruction : program)
+    {
+        switch (instruction.op)
+        {
+            case opConstant: *++top = instruction.constant; break;
+            case opInput: *++top = inputs[instruction.input]; break;
+            case opAdd: top--; *top += top[1]; break;
+            case opSubtract: top--; *top -= top[1]; break;
+            case opMultiply: top--; *top *= top[1]; break;
+            case opDivide: top--; *top /= top[1]; break;
+            case opPower: top--; *top = pow(*top, top[1]); break;
+            case opMin: top--; *top = fmin(*top, top[1]); break;
+            case opMax: top--; *top = fmax(*top, top[1]); break;
+            case opNegate: *top = -*top; break;
+            case opAbs: *top = fabs(*top); break;
+            case opSqrt: *top = sqrt(*top); break;
+            case opExp: *top = exp(*top); break;
+            case opLn: *top = log(*top); break;
+            case opLog10: *top = log10(*top); break;
+            case opSin: *top = sin(*top); break;
+            case opCos: *top = cos(*top); break;
+            case opTan: *top = tan(*top); break;
+        }
+    }
+    return *top;
+}
+
+
+// sum := product (('+' | '-') product)*
+void ExpressionProgram::parseSum()
+{
+    parseProduct();
+    while (true)
+    {
+        if (accept('+'))
+        {
+            parseProduct();
+            emit(opAdd);
+        }
+        else if (accept('-'))
+        {
+            parseProduct();
+            emit(opSubtract);
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+
+// product := unary (('*' | '/') unary)*
+void ExpressionProgram::parseProduct()
+{
+    parseUnary();
+    while (true)
+    {
+        if (accept('*'))
+        {
+            parseUnary();
+            emit(opMultiply);
+        }
+        else if (accept('/'))
+        {
+            parseUnary();
+            emit(opDivide);
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+
+// unary := '-' unary | '+' unary | power
+void ExpressionProgram::parseUnary()
+{
+    if (accept('-'))
+    {
+        parseUnary();
+        emit(opNegate);
+    }
+    else if (accept('+'))
+    {
+        parseUnary();
+    }
+    else
+    {
+        parsePower();
+    }
+}
+
+
+// power := primary ('^' unary)?, so -a^2 is -(a^2) and a^-1 is allowed
+void ExpressionProgram::parsePower()
+{
+    parsePrimary();
+    if (accept('^'))
+    {
+        parseUnary();
+        emit(opPower);
+    }
+}
+
+
+// primary := number | input | function '(' arguments ')' | '(' sum ')'
+void ExpressionProgram::parsePrimary()
+{
+    skipSpace();
+    if (position >= expression.size())
+    {
+        fail("unexpected end of expression");
+    }
+
+    if (accept('('))
+    {
+        parseSum();
+        expect(')');
+        return;
+    }
+
+    const char *start = expression.c_str() + position;
+    if (isdigit((unsigned char) *start) || *start == '.')
+    {
+        char *end;
+        double value = strtod(start, &end);
+        position += end - start;
+        emit(opConstant, value);
+        return;
+    }
+
+    if (isalpha((unsigned char) *start) || *start == '_')
+    {
+        size_t begin = position;
+        while (position < expression.size() && (isalnum((unsigned char) expression[position]) || expression[position] == '_'))
+        {
+            position++;
+        }
+        std::string name = expression.substr(begin, position - begin);
+
+        // Inputs take precedence over constants and functions of the same name
+        for (size_t i=0; i<inputNames.size(); i++)
+        {
+            if (inputNames[i] == name)
+            {
+                emit(opInput, 0.0, i);
+                return;
+            }
+        }
+        if (name == "pi")
+        {
+            emit(opConstant, M_PI);
+            return;
+        }
+        skipSpace();
+        if (position < expression.size() && expression[position] == '(')
+        {
+            parseFunction(name);
+            return;
+        }
+        position = begin;
+        fail("unknown input '" + name + "'");
+    }
+
+    fail("unexpected '" + expression.substr(position, 1) + "'");
+}
+
+
+// Functions of one or two arguments
+void ExpressionProgram::parseFunction(const std::string &name)
+{
+    static const struct
+    {
+        const char *name;
+        OpCode op;
+        int arguments;
+    } functions[] = {
+        { "abs", opAbs, 1 },
+        { "sqrt", opSqrt, 1 },
+        { "exp", opExp, 1 },
+        { "ln", opLn, 1 },
+        { "log10", opLog10, 1 },
+        { "sin", opSin, 1 },
+        { "cos", opCos, 1 },
+        { "tan", opTan, 1 },
+        { "min", opMin, 2 },
+        { "max", opMax, 2 },
+    };
+
+    for (unsigned int i=0; i<sizeof(functions)/sizeof(functions[0]); i++)
+    {
+        if (name == functions[i].name)
+        {
+            expect('(');
+            parseSum();
+            for (int argument=1; argument<functions[i].arguments; argument++)
+            {
+                expect(',');
+                parseSum();
+            }
+            expect(')');
+            emit(functions[i].op);
+            return;
+        }
+    }
+    fail("unknown function '" + name + "'");
+}
+
+
+// Move past white space
+void ExpressionProgram::skipSpace()
+{
+    while (position < expression.size() && isspace((unsigned char) expression[position]))
+    {
+        position++;
+    }
+}
+
+
+// Consume the next character if it is c
+bool ExpressionProgram::accept(char c)
+{
+    skipSpace();
+    if (position < expression.size() && expression[position] == c)
+    {
+        position++;
+        return true;
+    }
+    return false;
+}
+
+
+// Consume c or fail
+void ExpressionProgram::expect(char c)
+{
+    if (!accept(c))
+    {
+        fail(std::string("expected '") + c + "'");
+    }
+}
+
+
+// Throw an error with the position in the expression
+void ExpressionProgram::fail(const std::string &message)
+{
+    throw std::runtime_error(message + " at column " + std::to_string(position + 1) + " of \"" + expression + "\"");
+}
+
+
+// Add an instruction. Values push one entry, binary operators pop one.
+void ExpressionProgram::emit(OpCode op, double constant, size_t input)
+{
+    Instruction instruction;
+    instruction.op = op;
+    instruction.constant = constant;
+    instruction.input = input;
+    program.push_back(instruction);
+
+    switch (op)
+    {
+        case opConstant:
+        case opInput:
+            depth++;
+            break;
+        case opAdd:
+        case opSubtract:
+        case opMultiply:
+        case opDivide:
+        case opPower:
+        case opMin:
+        case opMax:
+            depth--;
+            break;
+        default:
+            break;
+    }
+    maxDepth = depth > maxDepth ? depth : maxDepth;
+}
@@ -0,0 +1,85 @@
+/*
+ * ExpressionProgram.h
+ *
+ * Class for evaluating an arithmetic expression of named inputs, e.g.
+ * "(a - b) / (a + b)". The expression is parsed once into a flat list of stack
+ * instructions, so evaluating it each cycle is a single loop without parsing,
+ * allocation or recursion.
+ *
+ * Operators: + - * / ^ (power) and unary minus, with the usual precedence.
+ * Functions: abs, sqrt, exp, ln, log10, sin, cos, tan, min(x, y), max(x, y).
+ * Constants: decimal numbers and pi.
+ *
+*/
+
+#ifndef EXPRESSIONPROGRAM_H
+#define EXPRESSIONPROGRAM_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+
+class ExpressionProgram
+{
+
+public:
+    // Compile an expression of the named inputs. Throws std::runtime_error with
+    // the position of the first error.
+    ExpressionProgram(const std::string &expression, const std::vector<std::string> &inputNames);
+
+    // Evaluate with the input values in the order of the names given to the constructor
+    double evaluate(const double *inputs);
+
+    const std::string &getExpression() const { return expression; }
+
+    // Number of instructions, for diagnostics
+    size_t size() const { return program.size(); }
+
+private:
+    // Instructions, operating on the top of the stack
+    enum OpCode
+    {
+        opConstant, opInput,
+        opAdd, opSubtract, opMultiply, opDivide, opPower, opNegate,
+        opAbs, opSqrt, opExp, opLn, opLog10, opSin, opCos, opTan,
+        opMin, opMax,
+    };
+
+    struct Instruction
+    {
+        OpCode op;
+        double constant;
+        size_t input;
+    };
+
+    // Recursive descent parser, emitting instructions in evaluation order
+    void parseSum();
+    void parseProduct();
+    void parseUnary();
+    void parsePower();
+    void parsePrimary();
+    void parseFunction(const std::string &name);
+
+    // Tokeniser helpers
+    void skipSpace();
+    bool accept(char c);
+    void expect(char c);
+    void fail(const std::string &message);
+
+    // Add an instruction, tracking the stack depth it needs
+    void emit(OpCode op, double constant = 0.0, size_t input = 0);
+
+    // Attributes
+    std::string expression;
+    std::vector<std::string> inputNames;
+    size_t position;
+    size_t depth;
+    size_t maxDepth;
+    std::vector<Instruction> program;
+    std::vector<double> stack;
+
+};
+
+#endif /* EXPRESSIONPROGRAM_H */
@@ -0,0 +1,80 @@
+#include "MockSdoTransport.h"
+
+#include <stdexcept>
+
+
+// Constructor
+MockSdoTransport::MockSdoTransport()
+{
+}
+
+
+// Status of the requests for a parameter
+asynStatus MockSdoTransport::statusOf(const std::string &paramName) const
+{
+    std::map<std::string, asynStatus>::const_iterator it = failures.find(paramName);
+    return it == failures.end() ? asynSuccess : it->second;
+}
+
+
+// Store the value, unless the parameter is set to fail
+asynStatus MockSdoTransport::writeRead(const std::string &paramName, const epicsInt32 &value, double)
+{
+    Request request = { paramName, true, value };
+    requests.push_back(request);
+    asynStatus status = statusOf(paramName);
+    if (status == asynTimeout)
+    {
+        throw std::runtime_error(
+            "ERROR: timeout setting " + paramName + " from " + std::to_string(get(paramName)) + " to " + std::to_string(value)
+        );
+    }
+    if (status == asynSuccess)
+    {
+        values[paramName] = value;
+    }
+    return status;
+}
+
+
+// Read the stored value, unless the parameter is set to fail
+asynStatus MockSdoTransport::read(const std::string &paramName, epicsInt32 &value)
+{
+    asynStatus status = statusOf(paramName);
+    if (status == asynSuccess)
+    {
+        value = get(paramName);
+    }
+    Request request = { paramName, false, value };
+    requests.push_back(request);
+    return status;
+}
+
+
+// Set a value as the module has it
+void MockSdoTransport::set(const std::string &paramName, epicsInt32 value)
+{
+    values[paramName] = value;
+}
+
+
+// Value as the module has it, zero if never written
+epicsInt32 MockSdoTransport::get(const std::string &paramName) const
+{
+    std::map<std::string, epicsInt32>::const_iterator it = values.find(paramName);
+    return it == values.end() ? 0 : it->second;
+}
+
+
+// Make requests for a parameter fail, or succeed again
+void MockSdoTransport::failWith(const std::string &paramName, asynStatus status)
+{
+    if (status == asynSuccess)
+    {
+        failures.erase(paramName);
+    }
+    else
+    {
+        failures[paramName] = status;
+    }
+}
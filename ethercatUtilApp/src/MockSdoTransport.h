@@ -0,0 +1,63 @@
+/*
+ * MockSdoTransport.h
+ *
+ * SDO transport on a table of values, for exercising and timing the ELM3704
+ * driver logic in a plain binary. Writes take effect at once, nothing sleeps
+ * and no threads are started. Every request is kept so tests can check what
+ * the driver sent, and requests for a parameter can be made to fail.
+ *
+*/
+
+#ifndef MOCKSDOTRANSPORT_H
+#define MOCKSDOTRANSPORT_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "SdoTransport.h"
+
+
+class MockSdoTransport : public SdoTransport
+{
+
+public:
+    // A request as the driver made it
+    struct Request
+    {
+        std::string paramName;
+        bool write;
+        epicsInt32 value;
+    };
+
+    // Constructor, every parameter reads as zero until written or set
+    MockSdoTransport();
+
+    // Methods from SdoTransport
+    virtual asynStatus writeRead(const std::string &paramName, const epicsInt32 &value, double timeout=3.0);
+    virtual asynStatus read(const std::string &paramName, epicsInt32 &value);
+
+    // Set or get a value as the module has it
+    void set(const std::string &paramName, epicsInt32 value);
+    epicsInt32 get(const std::string &paramName) const;
+
+    // Make requests for a parameter fail with a status, or succeed again with
+    // asynSuccess. A write failing with asynTimeout throws as a readback timeout does.
+    void failWith(const std::string &paramName, asynStatus status);
+
+    // Requests made so far, and forgetting them
+    const std::vector<Request> &getRequests() const { return requests; }
+    void clearRequests() { requests.clear(); }
+
+private:
+    // Status of the requests for a parameter
+    asynStatus statusOf(const std::string &paramName) const;
+
+    // Attributes
+    std::map<std::string, epicsInt32> values;
+    std::map<std::string, asynStatus> failures;
+    std::vector<Request> requests;
+
+};
+
+#endif /* MOCKSDOTRANSPORT_H */
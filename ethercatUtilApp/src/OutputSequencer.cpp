@@ -0,0 +1,406 @@
+#include "OutputSequencer.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// For logging
+static const char *driverName = "OutputSequencer";
+
+// A module's outputs are packed into one 32 bit word
+static const int maxChannels = 32;
+
+
+// Constructor
+OutputSequencer::OutputSequencer(const char* portName, const char* slavePortName, const char* entryFormat, int channels,
+                                 const char* cyclePortName, const char* cycleEntry, double period, int maxSteps) : asynPortDriver(
+    portName,  /* asyn port name for this driver*/
+    1, /* maxAddr */
+    asynInt32Mask | asynFloat64Mask | asynInt32ArrayMask | asynFloat64ArrayMask | asynOctetMask | asynDrvUserMask, /* Interface mask */
+    asynInt32Mask | asynFloat64Mask | asynInt32ArrayMask | asynFloat64ArrayMask | asynOctetMask,  /* Interrupt mask */
+    0, /* asynFlags.  This driver does not block and it is not multi-device, so flag is 0 */
+    1, /* Autoconnect */
+    0, /* Default priority */
+    0), /* Default stack size*/
+    allBits(0),
+    maxSteps(maxSteps > 0 ? maxSteps : 64),
+    durationCycles(0),
+    ownedBits(0),
+    repeatLimit(0),
+    isRunning(false),
+    abortRequested(false),
+    pdoPortClient(slavePortName), /* Create PdoPortClient instance */
+    ticker(cyclePortName, cycleEntry, period)
+{
+    if (channels < 1 || channels > maxChannels)
+    {
+        printf("%s: %s: number of channels must be 1-%d\n", driverName, portName, maxChannels);
+        channels = channels < 1 ? 1 : maxChannels;
+    }
+
+    entries = PdoPortClient::bitEntries(entryFormat, channels);
+    allBits = entries.allBits;
+
+    /* Asyn parameter creation */
+    createParam("MODE", asynParamInt32, &mode);
+    createParam("STEP_TIMES", asynParamFloat64Array, &stepTimes);
+    createParam("STEP_OUTPUTS", asynParamInt32Array, &stepOutputs);
+    createParam("DURATION", asynParamFloat64, &duration);
+    createParam("PULSE_OUTPUTS", asynParamInt32, &pulseOutputs);
+    createParam("PULSE_WIDTH", asynParamFloat64, &pulseWidth);
+    createParam("PULSE_PERIOD", asynParamFloat64, &pulsePeriod);
+    createParam("REPEATS", asynParamInt32, &repeats);
+    createParam("CYCLE_PERIOD", asynParamFloat64, &cyclePeriod);
+    createParam("START", asynParamInt32, &startCommand);
+    createParam("ABORT", asynParamInt32, &abortCommand);
+    createParam("RUNNING", asynParamInt32, &running);
+    createParam("REPEAT", asynParamInt32, &currentRepeat);
+    createParam("STEP", asynParamInt32, &currentStep);
+    createParam("LATE_CYCLES", asynParamInt32, &lateCycles);
+    createParam("WRITE_ERRORS", asynParamInt32, &writeErrors);
+    createParam("STATUS", asynParamOctet, &statusMessage);
+
+    setIntegerParam(mode, modeTable);
+    setDoubleParam(duration, 0.0);
+    setIntegerParam(pulseOutputs, 0);
+    setDoubleParam(pulseWidth, 0.0);
+    setDoubleParam(pulsePeriod, 0.0);
+    setIntegerParam(repeats, 1);
+    setDoubleParam(cyclePeriod, ticker.getPeriod());
+    setIntegerParam(startCommand, 0);
+    setIntegerParam(abortCommand, 0);
+    setIntegerParam(running, 0);
+    setIntegerParam(currentRepeat, 0);
+    setIntegerParam(currentStep, 0);
+    setIntegerParam(lateCycles, 0);
+    setIntegerParam(writeErrors, 0);
+    setStringParam(statusMessage, "Idle");
+    callParamCallbacks();
+
+    sequenceThread = std::thread(&OutputSequencer::sequenceLoop, this);
+}
+
+
+// Round a time to whole cycles of the ticker
+long OutputSequencer::toCycles(double seconds)
+{
+    return std::lround(seconds / ticker.getPeriod());
+}
+
+
+// Build the steps from the table of times and output words
+void OutputSequencer::compileTable()
+{
+    size_t nSteps = std::min(times.size(), words.size());
+    if (nSteps == 0)
+    {
+        throw std::runtime_error("the step table is empty");
+    }
+
+    steps.clear();
+    ownedBits = 0;
+    for (size_t i=0; i<nSteps; i++)
+    {
+        if (times[i] < 0.0 || (i > 0 && times[i] < times[i-1]))
+        {
+            throw std::runtime_error("step times must be increasing from 0");
+        }
+        Step step = { toCycles(times[i]), words[i] & allBits };
+        steps.push_back(step);
+        ownedBits |= step.word;
+    }
+    if (ownedBits == 0)
+    {
+        throw std::runtime_error("no step sets an output");
+    }
+
+    // The sequence lasts at least until one cycle after its last step
+    double seconds;
+    getDoubleParam(duration, &seconds);
+    durationCycles = std::max(toCycles(seconds), steps.back().cycle + 1);
+}
+
+
+// Build the two steps of a pulse
+void OutputSequencer::compilePulse()
+{
+    int mask;
+    double width, pulseSeconds;
+    getIntegerParam(pulseOutputs, &mask);
+    getDoubleParam(pulseWidth, &width);
+    getDoubleParam(pulsePeriod, &pulseSeconds);
+
+    ownedBits = (epicsUInt32) mask & allBits;
+    if (ownedBits == 0)
+    {
+        throw std::runtime_error("no pulse outputs selected");
+    }
+
+    // A pulse is at least one cycle high and one cycle low
+    long widthCycles = std::max(toCycles(width), 1L);
+    Step high = { 0, ownedBits };
+    Step low = { widthCycles, 0 };
+    steps.assign(1, high);
+    steps.push_back(low);
+    durationCycles = std::max(toCycles(pulseSeconds), widthCycles + 1);
+}
+
+
+// Compile the configuration and wake the sequence thread
+asynStatus OutputSequencer::startSequence()
+{
+    // For logging
+    static const char *functionName = "startSequence";
+
+    if (isRunning)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: %s: sequence already running\n",
+                  driverName, functionName, portName);
+        return asynError;
+    }
+
+    int sequenceMode;
+    getIntegerParam(mode, &sequenceMode);
+    getIntegerParam(repeats, &repeatLimit);
+    try
+    {
+        if (sequenceMode == modePulse) compilePulse();
+        else compileTable();
+    } catch (const std::runtime_error &e)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: %s: %s\n",
+                  driverName, functionName, portName, e.what());
+        setStringParam(statusMessage, e.what());
+        callParamCallbacks();
+        return asynError;
+    }
+
+    isRunning = true;
+    abortRequested = false;
+    setIntegerParam(running, 1);
+    setIntegerParam(currentRepeat, 0);
+    setIntegerParam(currentStep, 0);
+    setStringParam(statusMessage, "Running");
+    callParamCallbacks();
+    startEvent.signal();
+    return asynSuccess;
+}
+
+
+// Wait for each start and play the sequence
+void OutputSequencer::sequenceLoop()
+{
+    while (true)
+    {
+        startEvent.wait();
+        runSequence();
+    }
+}
+
+
+/* Play the compiled sequence, one tick per cycle. A wake after missed cycles plays
+ * all of them and writes the outputs of the last. The owned outputs are all written
+ * on the first tick and then only when a step changes them. They are switched off
+ * when the last repeat ends or the sequence is aborted.
+*/
+void OutputSequencer::runSequence()
+{
+    long cycle = 0;
+    size_t stepIndex = 0;
+    int repeat = 0;
+    epicsUInt32 target = 0;
+    epicsUInt32 written = 0;
+    bool first = true;
+    bool finished = false;
+
+    // Start on a cycle signalled from now on, not one which was missed while idle
+    ticker.clear();
+    while (!finished)
+    {
+        epicsTimeStamp timestamp;
+        long cycles = ticker.waitForCycles(timestamp);
+
+        lock();
+        setIntegerParam(lateCycles, ticker.getLateCycles());
+
+        if (abortRequested)
+        {
+            target = 0;
+            finished = true;
+            setStringParam(statusMessage, "Aborted");
+        }
+        for (long i=0; i<cycles && !finished; i++)
+        {
+            if (cycle == durationCycles)
+            {
+                repeat++;
+                cycle = 0;
+                stepIndex = 0;
+                if (repeatLimit > 0 && repeat >= repeatLimit)
+                {
+                    target = 0;
+                    finished = true;
+                    setStringParam(statusMessage, "Done");
+                }
+            }
+            if (!finished)
+            {
+                while (stepIndex < steps.size() && steps[stepIndex].cycle <= cycle)
+                {
+                    target = steps[stepIndex++].word;
+                }
+                cycle++;
+            }
+        }
+
+        epicsUInt32 changed = first ? ownedBits : (target ^ written) & ownedBits;
+        first = false;
+        written = target;
+        setTimeStamp(&timestamp);
+        setIntegerParam(currentRepeat, repeat);
+        setIntegerParam(currentStep, stepIndex);
+        unlock();
+
+        writeOutputs(target, changed);
+
+        if (finished)
+        {
+            lock();
+            isRunning = false;
+            setIntegerParam(running, 0);
+            callParamCallbacks();
+            unlock();
+        }
+    }
+}
+
+
+// Write the changed outputs without our lock and count those which failed
+void OutputSequencer::writeOutputs(epicsUInt32 word, epicsUInt32 changed)
+{
+    int errors = 0;
+    for (epicsUInt32 failed = changed & ~pdoPortClient.writeBits(entries, word, changed); failed; failed &= failed - 1)
+    {
+        errors++;
+    }
+
+    lock();
+    if (errors)
+    {
+        int count;
+        getIntegerParam(writeErrors, &count);
+        setIntegerParam(writeErrors, count + errors);
+    }
+    callParamCallbacks();
+    unlock();
+}
+
+
+// Start and abort act on the sequence, other parameters are stored for the next start
+asynStatus OutputSequencer::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    int function = pasynUser->reason;
+
+    if (function == startCommand)
+    {
+        return value ? startSequence() : asynSuccess;
+    }
+    else if (function == abortCommand)
+    {
+        if (value && isRunning)
+        {
+            abortRequested = true;
+        }
+        return asynSuccess;
+    }
+    else if (function == running || function == currentRepeat || function == currentStep ||
+             function == lateCycles || function == writeErrors)
+    {
+        return asynError;
+    }
+    return asynPortDriver::writeInt32(pasynUser, value);
+}
+
+
+// Store the output word of each step
+asynStatus OutputSequencer::writeInt32Array(asynUser *pasynUser, epicsInt32 *value, size_t nElements)
+{
+    if (pasynUser->reason != stepOutputs)
+    {
+        return asynPortDriver::writeInt32Array(pasynUser, value, nElements);
+    }
+
+    nElements = std::min(nElements, maxSteps);
+    words.assign(value, value + nElements);
+    doCallbacksInt32Array(value, nElements, stepOutputs, 0);
+    return asynSuccess;
+}
+
+
+// Store the time of each step, in seconds from the start of the sequence
+asynStatus OutputSequencer::writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements)
+{
+    if (pasynUser->reason != stepTimes)
+    {
+        return asynPortDriver::writeFloat64Array(pasynUser, value, nElements);
+    }
+
+    nElements = std::min(nElements, maxSteps);
+    times.assign(value, value + nElements);
+    doCallbacksFloat64Array(value, nElements, stepTimes, 0);
+    return asynSuccess;
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to call constructor for the OutputSequencer class.
+      * \param[in] portName The name of the asyn port created in this driver.
+      * \param[in] slavePortName The name of the asyn port of the slave module
+      * \param[in] entryFormat The PDO entry of each output, with %d for the channel number, or one entry holding them all
+      * \param[in] channels The number of outputs
+      * \param[in] cyclePortName The asyn port with an entry changing every cycle (optional)
+      * \param[in] cycleEntry The entry changing every cycle (optional)
+      * \param[in] period The cycle period in seconds, used to convert step times to cycles
+      * \param[in] maxSteps The maximum number of steps in the table
+      */
+    int OutputSequencerConfigure(const char *portName, const char *slavePortName, const char *entryFormat, int channels,
+                                 const char *cyclePortName, const char *cycleEntry, double period, int maxSteps)
+    {
+        new OutputSequencer(portName, slavePortName, entryFormat, channels, cyclePortName, cycleEntry, period, maxSteps);
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg initArg0 = { "portName", iocshArgString };
+    static const iocshArg initArg1 = { "slavePortName", iocshArgString };
+    static const iocshArg initArg2 = { "entryFormat", iocshArgString };
+    static const iocshArg initArg3 = { "channels", iocshArgInt };
+    static const iocshArg initArg4 = { "cyclePortName", iocshArgString };
+    static const iocshArg initArg5 = { "cycleEntry", iocshArgString };
+    static const iocshArg initArg6 = { "period", iocshArgDouble };
+    static const iocshArg initArg7 = { "maxSteps", iocshArgInt };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1, &initArg2, &initArg3, &initArg4, &initArg5, &initArg6, &initArg7 };
+    static const iocshFuncDef initFuncDef = { "OutputSequencerConfigure", 8, initArgs };
+
+    static void initCallFunc(const iocshArgBuf *args)
+    {
+        OutputSequencerConfigure(args[0].sval, args[1].sval, args[2].sval, args[3].ival, args[4].sval, args[5].sval, args[6].dval, args[7].ival);
+    }
+
+    void OutputSequencerRegister(void)
+    {
+        iocshRegister(&initFuncDef, initCallFunc);
+    }
+
+    epicsExportRegistrar(OutputSequencerRegister);
+
+}
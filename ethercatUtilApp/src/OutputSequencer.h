@@ -0,0 +1,109 @@
+/*
+ * OutputSequencer.h
+ *
+ * Class for generating timed pulses and sequences on the outputs of a digital
+ * output module. A table of (time, output word) steps, or a pulse of a given
+ * width and period, is converted to cycle counts when started and played back
+ * one step per EtherCAT cycle, so edges land on cycle boundaries.
+ *
+*/
+
+#ifndef OUTPUTSEQUENCER_H
+#define OUTPUTSEQUENCER_H
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <epicsEvent.h>
+
+#include "asynPortDriver.h"
+#include "PdoPortClient.h"
+#include "CycleTicker.h"
+
+
+class OutputSequencer : public asynPortDriver
+{
+
+public:
+    // Constructor
+    OutputSequencer(const char* portName, const char* slavePortName, const char* entryFormat, int channels,
+                    const char* cyclePortName, const char* cycleEntry, double period, int maxSteps);
+
+    // Overidden methods from asynPortDriver
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+    virtual asynStatus writeInt32Array(asynUser *pasynUser, epicsInt32 *value, size_t nElements);
+    virtual asynStatus writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements);
+
+    // Modes of the sequencer
+    enum Mode { modeTable, modePulse };
+
+protected:
+    // Asyn parameter indices for the configuration
+    int mode;
+    int stepTimes;
+    int stepOutputs;
+    int duration;
+    int pulseOutputs;
+    int pulseWidth;
+    int pulsePeriod;
+    int repeats;
+    int cyclePeriod;
+
+    // Asyn parameter indices for control and status
+    int startCommand;
+    int abortCommand;
+    int running;
+    int currentRepeat;
+    int currentStep;
+    int lateCycles;
+    int writeErrors;
+    int statusMessage;
+
+private:
+    // A step of the compiled sequence
+    struct Step
+    {
+        long cycle;
+        epicsUInt32 word;
+    };
+
+    // Convert the configuration into steps and start the sequence thread
+    asynStatus startSequence();
+    void compileTable();
+    void compilePulse();
+    long toCycles(double seconds);
+
+    // Thread playing back the sequence
+    void sequenceLoop();
+    void runSequence();
+    void writeOutputs(epicsUInt32 word, epicsUInt32 changed);
+
+    // Attributes
+    PdoPortClient::BitEntries entries;
+    epicsUInt32 allBits;
+    size_t maxSteps;
+
+    // Configured table
+    std::vector<double> times;
+    std::vector<epicsUInt32> words;
+
+    // Compiled sequence, only changed by startSequence while not running
+    std::vector<Step> steps;
+    long durationCycles;
+    epicsUInt32 ownedBits;
+    int repeatLimit;
+    bool isRunning;
+    bool abortRequested;
+
+    // Client for the PDO entries of the slave port
+    PdoPortClient pdoPortClient;
+
+    // Cycle timing and the thread playing the sequence
+    CycleTicker ticker;
+    epicsEvent startEvent;
+    std::thread sequenceThread;
+
+};
+
+#endif /* OUTPUTSEQUENCER_H */
@@ -0,0 +1,209 @@
+#include "PdoPortClient.h"
+
+#include <stdexcept>
+#include <string.h>
+
+#include <epicsStdio.h>
+
+
+// Constructor
+PdoPortClient::PdoPortClient(const char* slavePortName):
+    portName(slavePortName),
+    portClient(slavePortName)
+{
+
+}
+
+
+// Destructor
+PdoPortClient::~PdoPortClient()
+{
+    for (size_t i=0; i<monitors.size(); i++)
+    {
+        delete monitors[i]->client;
+        delete monitors[i];
+    }
+}
+
+
+// Wrapper function to read an entry from the asynPortClient
+asynStatus PdoPortClient::read(const std::string &entryName, epicsInt32 &value)
+{
+    asynStatus status = portClient.read(entryName, &value);
+    if (status)
+    {
+        printf(
+            "%s: could not read PDO entry %s (status %d)\n",
+            portName.c_str(),
+            entryName.c_str(),
+            status
+        );
+    }
+    return status;
+}
+
+
+// Wrapper function to write an entry with the asynPortClient
+asynStatus PdoPortClient::write(const std::string &entryName, const epicsInt32 &value)
+{
+    asynStatus status = portClient.write(entryName, value);
+    if (status)
+    {
+        printf(
+            "%s: failed to write PDO entry %s to value %d (status %d)\n",
+            portName.c_str(),
+            entryName.c_str(),
+            value,
+            status
+        );
+    }
+    return status;
+}
+
+
+// Register an interrupt callback for an entry
+asynStatus PdoPortClient::monitor(const std::string &entryName, MonitorCallback callback)
+{
+    Monitor *pMonitor = new Monitor();
+    pMonitor->entryName = entryName;
+    pMonitor->callback = callback;
+
+    // The client constructor throws if the entry does not exist on the port
+    try
+    {
+        pMonitor->client = new asynInt32Client(portName.c_str(), 0, entryName.c_str());
+    } catch (const std::runtime_error &e)
+    {
+        printf("%s: cannot monitor PDO entry %s: %s\n", portName.c_str(), entryName.c_str(), e.what());
+        delete pMonitor;
+        return asynError;
+    }
+
+    asynStatus status = pMonitor->client->registerInterruptUser(interruptCallback, pMonitor);
+    if (status)
+    {
+        printf(
+            "%s: failed to register callback for PDO entry %s (status %d)\n",
+            portName.c_str(),
+            entryName.c_str(),
+            status
+        );
+        delete pMonitor->client;
+        delete pMonitor;
+        return status;
+    }
+
+    monitors.push_back(pMonitor);
+    return asynSuccess;
+}
+
+
+// Name the entries of the bits of a word
+PdoPortClient::BitEntries PdoPortClient::bitEntries(const char *entryFormat, int channels)
+{
+    BitEntries entries;
+    entries.allBits = channels < 32 ? (1u << channels) - 1 : 0xFFFFFFFF;
+    if (!strchr(entryFormat, '%'))
+    {
+        entries.word = entryFormat;
+        return entries;
+    }
+
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (int channel=0; channel<channels; channel++)
+    {
+        epicsSnprintf(str, NBUFF, entryFormat, channel+1);
+        entries.bits.push_back(str);
+    }
+    return entries;
+}
+
+
+// Read every bit of a word
+asynStatus PdoPortClient::readBits(const BitEntries &entries, epicsUInt32 &word)
+{
+    epicsInt32 value;
+    if (!entries.word.empty())
+    {
+        asynStatus status = read(entries.word, value);
+        word = value & entries.allBits;
+        return status;
+    }
+
+    word = 0;
+    for (unsigned int bit=0; bit<entries.bits.size(); bit++)
+    {
+        asynStatus status = read(entries.bits[bit], value);
+        if (status)
+        {
+            return status;
+        }
+        if (value) word |= 1u << bit;
+    }
+    return asynSuccess;
+}
+
+
+/* Write the bits of a word selected by the mask. A word entry is read to keep its
+ * other bits, then written once. Bit entries are written back to back.
+*/
+epicsUInt32 PdoPortClient::writeBits(const BitEntries &entries, epicsUInt32 word, epicsUInt32 mask)
+{
+    mask &= entries.allBits;
+    if (!entries.word.empty())
+    {
+        epicsInt32 value;
+        if (!mask || read(entries.word, value) != asynSuccess)
+        {
+            return 0;
+        }
+        value = (value & ~mask) | (word & mask);
+        return write(entries.word, value) == asynSuccess ? mask : 0;
+    }
+
+    epicsUInt32 written = 0;
+    for (unsigned int bit=0; bit<entries.bits.size(); bit++)
+    {
+        if ((mask & (1u << bit)) && write(entries.bits[bit], (word >> bit) & 1) == asynSuccess)
+        {
+            written |= 1u << bit;
+        }
+    }
+    return written;
+}
+
+
+// Register a callback for updates of the bits of a word
+asynStatus PdoPortClient::monitorBits(const BitEntries &entries, BitsCallback callback)
+{
+    if (!entries.word.empty())
+    {
+        epicsUInt32 allBits = entries.allBits;
+        return monitor(
+            entries.word,
+            [callback, allBits](epicsInt32 value, const epicsTimeStamp &timestamp) { callback(value & allBits, allBits, timestamp); }
+        );
+    }
+
+    for (unsigned int bit=0; bit<entries.bits.size(); bit++)
+    {
+        asynStatus status = monitor(
+            entries.bits[bit],
+            [callback, bit](epicsInt32 value, const epicsTimeStamp &timestamp) { callback(value ? 1u << bit : 0, 1u << bit, timestamp); }
+        );
+        if (status)
+        {
+            return status;
+        }
+    }
+    return asynSuccess;
+}
+
+
+// Forward the new value and the timestamp of the slave port update
+void PdoPortClient::interruptCallback(void *userPvt, asynUser *pasynUser, epicsInt32 data)
+{
+    Monitor *pMonitor = static_cast<Monitor *>(userPvt);
+    pMonitor->callback(data, pasynUser->timestamp);
+}
@@ -0,0 +1,83 @@
+/*
+ * PdoPortClient.h
+ *
+ * Class which connects to the asyn port of an EtherCAT slave module to read,
+ * write and monitor its PDO entries.
+ *
+*/
+
+#ifndef PDOPORTCLIENT_H
+#define PDOPORTCLIENT_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <asynPortClient.h>
+#include <epicsTime.h>
+
+
+class PdoPortClient
+{
+
+public:
+    // Called from the slave port callback thread whenever a monitored entry updates
+    typedef std::function<void(epicsInt32 value, const epicsTimeStamp &timestamp)> MonitorCallback;
+
+    // Called as MonitorCallback with the bits of a word which updated
+    typedef std::function<void(epicsUInt32 word, epicsUInt32 mask, const epicsTimeStamp &timestamp)> BitsCallback;
+
+    // The outputs of a module packed into a word, with one entry per bit or one entry holding the word
+    struct BitEntries
+    {
+        std::vector<std::string> bits;
+        std::string word;
+        epicsUInt32 allBits;
+    };
+
+    // Entries from a format with %d for the channel number, or of the whole word without one
+    static BitEntries bitEntries(const char *entryFormat, int channels);
+
+    // Constructor
+    PdoPortClient(const char* slavePortName);
+    ~PdoPortClient();
+
+    /* Methods for reading and writing entry values. The slave port calls back its
+     * monitors with its own lock held during a write, so a driver writes without
+     * holding any lock its monitor callbacks take.
+    */
+    asynStatus read(const std::string &entryName, epicsInt32 &value);
+    asynStatus write(const std::string &entryName, const epicsInt32 &value);
+
+    // Register a callback for updates of an entry
+    asynStatus monitor(const std::string &entryName, MonitorCallback callback);
+
+    /* Methods for the bits of a word. Writes of a word entry are one write, keeping
+     * the bits outside the mask, and return the bits written.
+    */
+    asynStatus readBits(const BitEntries &entries, epicsUInt32 &word);
+    epicsUInt32 writeBits(const BitEntries &entries, epicsUInt32 word, epicsUInt32 mask);
+    asynStatus monitorBits(const BitEntries &entries, BitsCallback callback);
+
+    const std::string &getPortName() const { return portName; }
+
+private:
+    // Monitored entry
+    struct Monitor
+    {
+        std::string entryName;
+        MonitorCallback callback;
+        asynInt32Client *client;
+    };
+
+    // Attributes
+    std::string portName;
+    asynPortClient portClient;
+    std::vector<Monitor *> monitors;
+
+    // Interrupt callback registered with asyn
+    static void interruptCallback(void *userPvt, asynUser *pasynUser, epicsInt32 data);
+
+};
+
+#endif /* PDOPORTCLIENT_H */
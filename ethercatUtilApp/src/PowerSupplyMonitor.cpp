@@ -0,0 +1,320 @@
+#include "PowerSupplyMonitor.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+#include <alarm.h>
+
+#include <stdexcept>
+#include <string>
+
+// For logging
+static const char *driverName = "PowerSupplyMonitor";
+
+
+// Constructor
+PowerSupplyMonitor::PowerSupplyMonitor(const char* portName, int maxTerminals) : asynPortDriver(
+    portName,  /* asyn port name for this driver*/
+    maxTerminals > 0 ? maxTerminals : 1, /* maxAddr */
+    asynInt32Mask | asynFloat64Mask | asynOctetMask | asynDrvUserMask, /* Interface mask */
+    asynInt32Mask | asynFloat64Mask | asynOctetMask,  /* Interrupt mask */
+    ASYN_MULTIDEVICE, /* asynFlags.  This driver does not block and has one address per terminal */
+    1, /* Autoconnect */
+    0, /* Default priority */
+    0), /* Default stack size*/
+    terminals(maxTerminals > 0 ? maxTerminals : 1)
+{
+    /* Asyn parameter creation */
+    createParam("POWER_OK", asynParamInt32, &powerOk);
+    createParam("OVERLOAD", asynParamInt32, &overload);
+    createParam("SUMMARY", asynParamInt32, &summary);
+    createParam("DROPOUTS", asynParamInt32, &dropouts);
+    createParam("OVERLOADS", asynParamInt32, &overloads);
+    createParam("LAST_DROPOUT", asynParamFloat64, &lastDropout);
+    createParam("FAULT_TIME", asynParamOctet, &faultTime);
+    createParam("RESET", asynParamInt32, &reset);
+    for (unsigned int addr=0; addr<terminals.size(); addr++)
+    {
+        terminals[addr].powerOk = false;
+        terminals[addr].overload = false;
+        terminals[addr].latched = false;
+        terminals[addr].dropoutSeen = false;
+        terminals[addr].started = false;
+        terminals[addr].powerOkUpdated = false;
+        terminals[addr].overloadUpdated = false;
+        setIntegerParam(addr, powerOk, 0);
+        setIntegerParam(addr, overload, 0);
+        setIntegerParam(addr, summary, 0);
+        setIntegerParam(addr, dropouts, 0);
+        setIntegerParam(addr, overloads, 0);
+        setDoubleParam(addr, lastDropout, 0.0);
+        setStringParam(addr, faultTime, "");
+        callParamCallbacks(addr);
+    }
+}
+
+
+/* Follow the changes of a terminal, then read its current state. Entries which
+ * update before the read is published keep the value of the update.
+*/
+void PowerSupplyMonitor::addTerminal(int addr, const char* slavePortName, const char* powerOkEntry, const char* overloadEntry)
+{
+    if (addr < 0 || addr >= (int) terminals.size())
+    {
+        throw std::runtime_error("address " + std::to_string(addr) + " out of range");
+    }
+    Terminal &terminal = terminals[addr];
+    if (terminal.client)
+    {
+        throw std::runtime_error("address " + std::to_string(addr) + " already in use");
+    }
+    terminal.client.reset(new PdoPortClient(slavePortName));
+    terminal.client->monitor(
+        powerOkEntry,
+        [this, addr](epicsInt32 value, const epicsTimeStamp &timestamp) { onPowerOk(addr, value, timestamp); }
+    );
+    terminal.client->monitor(
+        overloadEntry,
+        [this, addr](epicsInt32 value, const epicsTimeStamp &timestamp) { onOverload(addr, value, timestamp); }
+    );
+
+    epicsInt32 powerOkValue = 0, overloadValue = 0;
+    if (terminal.client->read(powerOkEntry, powerOkValue) != asynSuccess ||
+        terminal.client->read(overloadEntry, overloadValue) != asynSuccess)
+    {
+        // Leave the address free for another attempt
+        terminal.client.reset();
+        lock();
+        terminal.powerOkUpdated = terminal.overloadUpdated = false;
+        unlock();
+        throw std::runtime_error(std::string("cannot read ") + powerOkEntry + " and " + overloadEntry);
+    }
+
+    /* A terminal which starts without power is not a transient, so nothing is
+     * latched, and the dropout has no known start to publish the length of.
+    */
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    lock();
+    if (!terminal.powerOkUpdated) terminal.powerOk = powerOkValue != 0;
+    if (!terminal.overloadUpdated) terminal.overload = overloadValue != 0;
+    terminal.started = true;
+    publish(addr, now);
+    unlock();
+}
+
+
+/* The power going away starts a dropout and latches a fault. When it returns the
+ * length of the dropout is published, in ms, from the cycle times of the two edges.
+*/
+void PowerSupplyMonitor::onPowerOk(int addr, epicsInt32 value, const epicsTimeStamp &timestamp)
+{
+    lock();
+    Terminal &terminal = terminals[addr];
+    bool ok = value != 0;
+    if (!terminal.started)
+    {
+        terminal.powerOk = ok;
+        terminal.powerOkUpdated = true;
+    }
+    else if (ok != terminal.powerOk)
+    {
+        terminal.powerOk = ok;
+        if (!ok)
+        {
+            int count;
+            getIntegerParam(addr, dropouts, &count);
+            setIntegerParam(addr, dropouts, count + 1);
+            terminal.dropoutStart = timestamp;
+            terminal.dropoutSeen = true;
+            latchFault(addr, timestamp);
+        }
+        else if (terminal.dropoutSeen)
+        {
+            setDoubleParam(addr, lastDropout, epicsTimeDiffInSeconds(&timestamp, &terminal.dropoutStart) * 1000.0);
+        }
+        publish(addr, timestamp);
+    }
+    unlock();
+}
+
+
+// An overload latches a fault when it starts
+void PowerSupplyMonitor::onOverload(int addr, epicsInt32 value, const epicsTimeStamp &timestamp)
+{
+    lock();
+    Terminal &terminal = terminals[addr];
+    bool overloaded = value != 0;
+    if (!terminal.started)
+    {
+        terminal.overload = overloaded;
+        terminal.overloadUpdated = true;
+    }
+    else if (overloaded != terminal.overload)
+    {
+        terminal.overload = overloaded;
+        if (overloaded)
+        {
+            int count;
+            getIntegerParam(addr, overloads, &count);
+            setIntegerParam(addr, overloads, count + 1);
+            latchFault(addr, timestamp);
+        }
+        publish(addr, timestamp);
+    }
+    unlock();
+}
+
+
+// Latch a fault, keeping the time of the first one since the last reset
+void PowerSupplyMonitor::latchFault(int addr, const epicsTimeStamp &timestamp)
+{
+    Terminal &terminal = terminals[addr];
+    if (terminal.latched)
+    {
+        return;
+    }
+    terminal.latched = true;
+
+    char text[40];
+    epicsTimeToStrftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S.%03f", &timestamp);
+    setStringParam(addr, faultTime, text);
+}
+
+
+/* Publish the state and summary of a terminal with the time of the edge. The
+ * summary is MAJOR while a fault is present and MINOR while one is latched.
+*/
+void PowerSupplyMonitor::publish(int addr, const epicsTimeStamp &timestamp)
+{
+    Terminal &terminal = terminals[addr];
+    epicsInt32 word = (terminal.powerOk ? PowerOk : 0) | (terminal.overload ? Overload : 0) | (terminal.latched ? FaultLatched : 0);
+
+    setIntegerParam(addr, powerOk, terminal.powerOk);
+    setParamAlarmStatus(addr, powerOk, terminal.powerOk ? epicsAlarmNone : epicsAlarmState);
+    setParamAlarmSeverity(addr, powerOk, terminal.powerOk ? epicsSevNone : epicsSevMajor);
+    setIntegerParam(addr, overload, terminal.overload);
+    setParamAlarmStatus(addr, overload, terminal.overload ? epicsAlarmState : epicsAlarmNone);
+    setParamAlarmSeverity(addr, overload, terminal.overload ? epicsSevMajor : epicsSevNone);
+
+    epicsAlarmSeverity severity = epicsSevNone;
+    if (!terminal.powerOk || terminal.overload) severity = epicsSevMajor;
+    else if (terminal.latched) severity = epicsSevMinor;
+    setIntegerParam(addr, summary, word);
+    setParamAlarmStatus(addr, summary, severity == epicsSevNone ? epicsAlarmNone : epicsAlarmState);
+    setParamAlarmSeverity(addr, summary, severity);
+
+    setTimeStamp(&timestamp);
+    callParamCallbacks(addr);
+}
+
+
+// Clear the latched fault and the counts of a terminal
+asynStatus PowerSupplyMonitor::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    int addr;
+    getAddress(pasynUser, &addr);
+    if (pasynUser->reason != reset)
+    {
+        return asynPortDriver::writeInt32(pasynUser, value);
+    }
+    if (!value)
+    {
+        return asynSuccess;
+    }
+
+    Terminal &terminal = terminals[addr];
+    terminal.latched = false;
+    setIntegerParam(addr, dropouts, 0);
+    setIntegerParam(addr, overloads, 0);
+    setDoubleParam(addr, lastDropout, 0.0);
+    setStringParam(addr, faultTime, "");
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    publish(addr, now);
+    return asynSuccess;
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to call constructor for the PowerSupplyMonitor class.
+      * \param[in] portName The name of the asyn port created in this driver.
+      * \param[in] maxTerminals The number of terminals (asyn addresses)
+      */
+    int PowerSupplyMonitorConfigure(const char *portName, int maxTerminals)
+    {
+        new PowerSupplyMonitor(portName, maxTerminals);
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to add a terminal to a PowerSupplyMonitor port.
+      * \param[in] portName The name of the PowerSupplyMonitor port
+      * \param[in] addr The asyn address for the terminal's records
+      * \param[in] slavePortName The name of the asyn port of the slave module
+      * \param[in] powerOkEntry The PDO entry of the power OK bit
+      * \param[in] overloadEntry The PDO entry of the overload bit
+      */
+    int PowerSupplyMonitorAddTerminal(const char *portName, int addr, const char *slavePortName,
+                                      const char *powerOkEntry, const char *overloadEntry)
+    {
+        if (!portName || !slavePortName || !powerOkEntry || !overloadEntry)
+        {
+            printf("Usage: PowerSupplyMonitorAddTerminal portName addr slavePortName powerOkEntry overloadEntry\n");
+            return(asynError);
+        }
+        PowerSupplyMonitor *monitor = (PowerSupplyMonitor *) findAsynPortDriver(portName);
+        if (!monitor)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        try
+        {
+            monitor->addTerminal(addr, slavePortName, powerOkEntry, overloadEntry);
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: %s: cannot add %s: %s\n", driverName, portName, slavePortName, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg initArg0 = { "portName", iocshArgString };
+    static const iocshArg initArg1 = { "maxTerminals", iocshArgInt };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1 };
+    static const iocshFuncDef initFuncDef = { "PowerSupplyMonitorConfigure", 2, initArgs };
+
+    static void initCallFunc(const iocshArgBuf *args)
+    {
+        PowerSupplyMonitorConfigure(args[0].sval, args[1].ival);
+    }
+
+    static const iocshArg addArg0 = { "portName", iocshArgString };
+    static const iocshArg addArg1 = { "addr", iocshArgInt };
+    static const iocshArg addArg2 = { "slavePortName", iocshArgString };
+    static const iocshArg addArg3 = { "powerOkEntry", iocshArgString };
+    static const iocshArg addArg4 = { "overloadEntry", iocshArgString };
+    static const iocshArg * const addArgs[] = { &addArg0, &addArg1, &addArg2, &addArg3, &addArg4 };
+    static const iocshFuncDef addFuncDef = { "PowerSupplyMonitorAddTerminal", 5, addArgs };
+
+    static void addCallFunc(const iocshArgBuf *args)
+    {
+        PowerSupplyMonitorAddTerminal(args[0].sval, args[1].ival, args[2].sval, args[3].sval, args[4].sval);
+    }
+
+    void PowerSupplyMonitorRegister(void)
+    {
+        iocshRegister(&initFuncDef, initCallFunc);
+        iocshRegister(&addFuncDef, addCallFunc);
+    }
+
+    epicsExportRegistrar(PowerSupplyMonitorRegister);
+
+}
@@ -0,0 +1,87 @@
+/*
+ * PowerSupplyMonitor.h
+ *
+ * Class for following the POWER_OK and OVERLOAD bits of power supply terminals
+ * on every EtherCAT cycle. The slave port calls back each change of the bits, so
+ * a dropout of a single cycle is seen even though the records are only scanned
+ * at a slow rate. Faults are counted and latched with their time until reset,
+ * and a summary word per terminal is called back on every event.
+ *
+*/
+
+#ifndef POWERSUPPLYMONITOR_H
+#define POWERSUPPLYMONITOR_H
+
+#include <memory>
+#include <vector>
+
+#include <epicsTime.h>
+
+#include "asynPortDriver.h"
+#include "PdoPortClient.h"
+
+
+class PowerSupplyMonitor : public asynPortDriver
+{
+
+public:
+    // Constructor
+    PowerSupplyMonitor(const char* portName, int maxTerminals);
+
+    // Follow the status bits of a terminal at an address of this port
+    void addTerminal(int addr, const char* slavePortName, const char* powerOkEntry, const char* overloadEntry);
+
+    // Overidden methods from asynPortDriver
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+
+    // Bits of the summary word
+    enum SummaryBit {
+        PowerOk = 1 << 0,
+        Overload = 1 << 1,
+        FaultLatched = 1 << 2,
+    };
+
+protected:
+    // Asyn parameter indices (one list per terminal)
+    int powerOk;
+    int overload;
+    int summary;
+    int dropouts;
+    int overloads;
+    int lastDropout;
+    int faultTime;
+    int reset;
+
+private:
+    // Status of one terminal
+    struct Terminal
+    {
+        std::unique_ptr<PdoPortClient> client;
+        bool powerOk;
+        bool overload;
+        bool latched;
+        epicsTimeStamp dropoutStart;
+        // Whether dropoutStart holds the start of a dropout we saw
+        bool dropoutSeen;
+        // Until the terminal is read, updates only keep the latest values
+        bool started;
+        bool powerOkUpdated;
+        bool overloadUpdated;
+    };
+
+    // Apply a change of a status bit
+    void onPowerOk(int addr, epicsInt32 value, const epicsTimeStamp &timestamp);
+    void onOverload(int addr, epicsInt32 value, const epicsTimeStamp &timestamp);
+
+    // Latch a fault with the time it happened
+    void latchFault(int addr, const epicsTimeStamp &timestamp);
+
+    // Set the state parameters and call back the terminal's records
+    void publish(int addr, const epicsTimeStamp &timestamp);
+
+    // Attributes
+    std::vector<Terminal> terminals;
+
+};
+
+#endif /* POWERSUPPLYMONITOR_H */
@@ -0,0 +1,339 @@
+#include "RackAggregator.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+#include <alarm.h>
+
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+// For logging
+static const char *driverName = "RackAggregator";
+
+// How often to check whether the database is running
+static const std::chrono::milliseconds startupCheckPeriod(100);
+
+// Shortest update period
+static const double minUpdatePeriod = 0.01;
+
+
+// Constructor
+RackAggregator::RackAggregator(const char* portName, int maxChannels, int maxModules, double period) : asynPortDriver(
+    portName,  /* asyn port name for this driver*/
+    1, /* maxAddr */
+    asynInt32Mask | asynFloat64Mask | asynInt8ArrayMask | asynInt32ArrayMask | asynFloat64ArrayMask | asynDrvUserMask, /* Interface mask */
+    asynInt32Mask | asynFloat64Mask | asynInt8ArrayMask | asynInt32ArrayMask | asynFloat64ArrayMask,  /* Interrupt mask */
+    0, /* asynFlags.  This driver does not block and it is not multi-device, so flag is 0 */
+    1, /* Autoconnect */
+    0, /* Default priority */
+    0), /* Default stack size*/
+    maxChannels(maxChannels > 0 ? maxChannels : 0),
+    maxModules(maxModules > 0 ? maxModules : 0),
+    started(false)
+{
+    /* Asyn parameter creation */
+    createParam("VALUES", asynParamFloat64Array, &values);
+    createParam("SEVERITIES", asynParamInt32Array, &severities);
+    createParam("MODULE_STATES", asynParamInt32Array, &moduleStates);
+    createParam("CHANNEL_NAMES", asynParamInt8Array, &channelNames);
+    createParam("MODULE_NAMES", asynParamInt8Array, &moduleNames);
+    createParam("NUM_CHANNELS", asynParamInt32, &numChannels);
+    createParam("NUM_MODULES", asynParamInt32, &numModules);
+    createParam("MISSING", asynParamInt32, &missing);
+    createParam("UPDATE_PERIOD", asynParamFloat64, &updatePeriod);
+    createParam("UPDATES", asynParamInt32, &updates);
+    createParam("UPDATE_TIME", asynParamFloat64, &updateTime);
+
+    setIntegerParam(numChannels, 0);
+    setIntegerParam(numModules, 0);
+    setIntegerParam(missing, 0);
+    setDoubleParam(updatePeriod, period > minUpdatePeriod ? period : minUpdatePeriod);
+    setIntegerParam(updates, 0);
+    setDoubleParam(updateTime, 0.0);
+    callParamCallbacks();
+
+    aggregatorThread = std::thread(&RackAggregator::aggregatorLoop, this);
+}
+
+
+// Add the records of a module. Records are looked up when the database starts.
+void RackAggregator::addModule(const char* prefix, int channels, const char* channelSuffix)
+{
+    lock();
+    std::string error;
+    if (started)
+    {
+        error = "modules must be added before iocInit";
+    }
+    else if (moduleSources.size() >= maxModules)
+    {
+        error = "more than " + std::to_string(maxModules) + " modules";
+    }
+    else if (channels < 0 || channelSources.size() + channels > maxChannels)
+    {
+        error = "more than " + std::to_string(maxChannels) + " channels";
+    }
+    if (!error.empty())
+    {
+        unlock();
+        throw std::runtime_error(error);
+    }
+
+    Source source;
+    source.found = false;
+    source.name = std::string(prefix) + ":STATE";
+    moduleSources.push_back(source);
+    for (int channel=1; channel<=channels; channel++)
+    {
+        source.name = std::string(prefix) + ":CH" + std::to_string(channel) + ":" + channelSuffix;
+        channelSources.push_back(source);
+    }
+
+    setIntegerParam(numChannels, channelSources.size());
+    setIntegerParam(numModules, moduleSources.size());
+    callParamCallbacks();
+    unlock();
+}
+
+
+// Look up each record and list the names, one per line, in the order of the arrays
+void RackAggregator::resolveSources(std::vector<Source> &sources, std::string &names)
+{
+    // For logging
+    static const char *functionName = "resolveSources";
+
+    for (unsigned int i=0; i<sources.size(); i++)
+    {
+        sources[i].found = dbNameToAddr(sources[i].name.c_str(), &sources[i].addr) == 0;
+        if (!sources[i].found)
+        {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: %s: cannot find record %s\n",
+                      driverName, functionName, portName, sources[i].name.c_str());
+        }
+        names += sources[i].name + "\n";
+    }
+}
+
+
+/* Read each record with its alarm severity. Records which were not found read as
+ * NaN with INVALID severity so the arrays keep their layout.
+*/
+void RackAggregator::gather()
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (unsigned int i=0; i<channelSources.size(); i++)
+    {
+        struct
+        {
+            DBRstatus
+            epicsFloat64 value;
+        } buffer;
+        long options = DBR_STATUS;
+        long nRequest = 1;
+        Source &source = channelSources[i];
+        if (source.found && dbGetField(&source.addr, DBR_DOUBLE, &buffer, &options, &nRequest, NULL) == 0)
+        {
+            valueArray[i] = buffer.value;
+            severityArray[i] = buffer.severity;
+        }
+        else
+        {
+            valueArray[i] = NAN;
+            severityArray[i] = epicsSevInvalid;
+        }
+    }
+
+    for (unsigned int i=0; i<moduleSources.size(); i++)
+    {
+        epicsInt32 state;
+        long options = 0;
+        long nRequest = 1;
+        Source &source = moduleSources[i];
+        if (source.found && dbGetField(&source.addr, DBR_LONG, &state, &options, &nRequest, NULL) == 0)
+        {
+            stateArray[i] = state;
+        }
+        else
+        {
+            stateArray[i] = -1;
+        }
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+
+    lock();
+    setTimeStamp(&now);
+    doCallbacksFloat64Array(valueArray.data(), valueArray.size(), values, 0);
+    doCallbacksInt32Array(severityArray.data(), severityArray.size(), severities, 0);
+    doCallbacksInt32Array(stateArray.data(), stateArray.size(), moduleStates, 0);
+    int count;
+    getIntegerParam(updates, &count);
+    setIntegerParam(updates, count + 1);
+    setDoubleParam(updateTime, elapsed.count());
+    callParamCallbacks();
+    unlock();
+}
+
+
+// Wait for the database to start, find the records and gather at the update period
+void RackAggregator::aggregatorLoop()
+{
+    while (!interruptAccept)
+    {
+        std::this_thread::sleep_for(startupCheckPeriod);
+    }
+
+    // No modules can be added from here on
+    lock();
+    started = true;
+    unlock();
+
+    std::string channelList, moduleList;
+    resolveSources(channelSources, channelList);
+    resolveSources(moduleSources, moduleList);
+    valueArray.resize(channelSources.size());
+    severityArray.resize(channelSources.size());
+    stateArray.resize(moduleSources.size());
+
+    int notFound = 0;
+    for (unsigned int i=0; i<channelSources.size(); i++) notFound += !channelSources[i].found;
+    for (unsigned int i=0; i<moduleSources.size(); i++) notFound += !moduleSources[i].found;
+
+    // The names are published once, clients read them from the records
+    lock();
+    std::vector<epicsInt8> text(channelList.begin(), channelList.end());
+    text.push_back(0);
+    doCallbacksInt8Array(text.data(), text.size(), channelNames, 0);
+    text.assign(moduleList.begin(), moduleList.end());
+    text.push_back(0);
+    doCallbacksInt8Array(text.data(), text.size(), moduleNames, 0);
+    setIntegerParam(missing, notFound);
+    callParamCallbacks();
+    unlock();
+
+    auto nextUpdate = std::chrono::steady_clock::now();
+    while (true)
+    {
+        gather();
+
+        lock();
+        double period;
+        getDoubleParam(updatePeriod, &period);
+        unlock();
+
+        // Keep to the update rate, skipping updates if gathering overran
+        nextUpdate += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(period));
+        auto now = std::chrono::steady_clock::now();
+        if (nextUpdate < now)
+        {
+            nextUpdate = now;
+        }
+        std::this_thread::sleep_until(nextUpdate);
+    }
+}
+
+
+// AsynPortDriver::writeFloat64 override
+asynStatus RackAggregator::writeFloat64(asynUser *pasynUser, epicsFloat64 newValue)
+{
+    // For logging
+    static const char *functionName = "writeFloat64";
+
+    if (pasynUser->reason == updatePeriod && newValue < minUpdatePeriod)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: %g: update period must be at least %g s\n",
+                  driverName, functionName, newValue, minUpdatePeriod);
+        return asynError;
+    }
+    return asynPortDriver::writeFloat64(pasynUser, newValue);
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to call constructor for the RackAggregator class.
+      * \param[in] portName The name of the asyn port created in this driver.
+      * \param[in] maxChannels The maximum number of channels over all modules
+      * \param[in] maxModules The maximum number of modules
+      * \param[in] period The update period in seconds
+      */
+    int RackAggregatorConfigure(const char *portName, int maxChannels, int maxModules, double period)
+    {
+        new RackAggregator(portName, maxChannels, maxModules, period);
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to add a module's records to a RackAggregator port.
+      * \param[in] portName The name of the RackAggregator port
+      * \param[in] prefix The PV prefix of the module, P:R
+      * \param[in] channels The number of channels
+      * \param[in] channelSuffix The record of each channel after CH<n>:, e.g. VAL
+      */
+    int RackAggregatorAddModule(const char *portName, const char *prefix, int channels, const char *channelSuffix)
+    {
+        if (!portName || !prefix)
+        {
+            printf("Usage: RackAggregatorAddModule portName prefix channels [channelSuffix]\n");
+            return(asynError);
+        }
+        RackAggregator *aggregator = (RackAggregator *) findAsynPortDriver(portName);
+        if (!aggregator)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        try
+        {
+            aggregator->addModule(prefix, channels, channelSuffix ? channelSuffix : "VAL");
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: %s: cannot add %s: %s\n", driverName, portName, prefix, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg initArg0 = { "portName", iocshArgString };
+    static const iocshArg initArg1 = { "maxChannels", iocshArgInt };
+    static const iocshArg initArg2 = { "maxModules", iocshArgInt };
+    static const iocshArg initArg3 = { "period", iocshArgDouble };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1, &initArg2, &initArg3 };
+    static const iocshFuncDef initFuncDef = { "RackAggregatorConfigure", 4, initArgs };
+
+    static void initCallFunc(const iocshArgBuf *args)
+    {
+        RackAggregatorConfigure(args[0].sval, args[1].ival, args[2].ival, args[3].dval);
+    }
+
+    static const iocshArg addArg0 = { "portName", iocshArgString };
+    static const iocshArg addArg1 = { "prefix", iocshArgString };
+    static const iocshArg addArg2 = { "channels", iocshArgInt };
+    static const iocshArg addArg3 = { "channelSuffix", iocshArgString };
+    static const iocshArg * const addArgs[] = { &addArg0, &addArg1, &addArg2, &addArg3 };
+    static const iocshFuncDef addFuncDef = { "RackAggregatorAddModule", 4, addArgs };
+
+    static void addCallFunc(const iocshArgBuf *args)
+    {
+        RackAggregatorAddModule(args[0].sval, args[1].sval, args[2].ival, args[3].sval);
+    }
+
+    void RackAggregatorRegister(void)
+    {
+        iocshRegister(&initFuncDef, initCallFunc);
+        iocshRegister(&addFuncDef, addCallFunc);
+    }
+
+    epicsExportRegistrar(RackAggregatorRegister);
+
+}
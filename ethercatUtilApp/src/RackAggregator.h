@@ -0,0 +1,84 @@
+/*
+ * RackAggregator.h
+ *
+ * Class for collecting the channel values, alarm severities and module states
+ * of a set of modules into a few array parameters. The records are read through
+ * the database at a fixed rate, so an overview screen only needs a handful of
+ * channel access connections instead of one per channel.
+ *
+*/
+
+#ifndef RACKAGGREGATOR_H
+#define RACKAGGREGATOR_H
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dbAccess.h>
+
+#include "asynPortDriver.h"
+
+
+class RackAggregator : public asynPortDriver
+{
+
+public:
+    // Constructor
+    RackAggregator(const char* portName, int maxChannels, int maxModules, double period);
+
+    // Add the records of a module, named prefix:STATE and prefix:CH<n>:<suffix>
+    void addModule(const char* prefix, int channels, const char* channelSuffix);
+
+    // Overidden methods from asynPortDriver
+    virtual asynStatus writeFloat64(asynUser *pasynUser, epicsFloat64 value);
+
+protected:
+    // Asyn parameter indices
+    int values;
+    int severities;
+    int moduleStates;
+    int channelNames;
+    int moduleNames;
+    int numChannels;
+    int numModules;
+    int missing;
+    int updatePeriod;
+    int updates;
+    int updateTime;
+
+private:
+    // A record read by the aggregator
+    struct Source
+    {
+        std::string name;
+        DBADDR addr;
+        bool found;
+    };
+
+    // Find the records once the database is running
+    void resolveSources(std::vector<Source> &sources, std::string &names);
+
+    // Read the records into the arrays and publish them
+    void gather();
+
+    // Thread gathering at the update period
+    void aggregatorLoop();
+
+    // Attributes
+    size_t maxChannels;
+    size_t maxModules;
+    bool started;
+    std::vector<Source> channelSources;
+    std::vector<Source> moduleSources;
+
+    // Arrays published to clients, only used by the aggregator thread
+    std::vector<epicsFloat64> valueArray;
+    std::vector<epicsInt32> severityArray;
+    std::vector<epicsInt32> stateArray;
+
+    std::thread aggregatorThread;
+
+};
+
+#endif /* RACKAGGREGATOR_H */
@@ -0,0 +1,52 @@
+/*
+ * SampleBlock.h
+ *
+ * Struct for one EtherCAT cycle of oversampled data from a single channel,
+ * together with the time it was acquired.
+ *
+*/
+
+#ifndef SAMPLEBLOCK_H
+#define SAMPLEBLOCK_H
+
+#include <vector>
+
+#include <epicsTime.h>
+#include <epicsTypes.h>
+
+
+struct SampleBlock
+{
+    // Samples in acquisition order
+    std::vector<epicsInt32> samples;
+
+    // Time of the last (newest) sample in the block
+    epicsTimeStamp timestamp;
+
+    // Time between samples in seconds
+    double samplePeriod;
+
+    // Interpolated time of a sample in the block
+    epicsTimeStamp sampleTime(size_t index) const
+    {
+        epicsTimeStamp time = timestamp;
+        if (index + 1 < samples.size())
+        {
+            epicsTimeAddSeconds(&time, -samplePeriod * (samples.size() - 1 - index));
+        }
+        return time;
+    }
+
+    // Convert an EtherCAT distributed clock time (ns since 2000-01-01) to an EPICS time
+    static epicsTimeStamp fromDistributedClock(epicsUInt64 nanoseconds)
+    {
+        // Seconds between the EPICS epoch (1990-01-01) and the EtherCAT epoch
+        static const epicsUInt32 ethercatEpochOffset = 315532800u;
+        epicsTimeStamp time;
+        time.secPastEpoch = (epicsUInt32) (nanoseconds / 1000000000ull) + ethercatEpochOffset;
+        time.nsec = (epicsUInt32) (nanoseconds % 1000000000ull);
+        return time;
+    }
+};
+
+#endif /* SAMPLEBLOCK_H */
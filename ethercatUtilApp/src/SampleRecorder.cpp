@@ -0,0 +1,359 @@
+#include "SampleRecorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Smallest file which is worth rolling over to
+static const size_t minFileBytes = 1024 * 1024;
+
+// How often the writer thread asks the kernel to write dirty pages back
+static const std::chrono::milliseconds flushPeriod(1000);
+
+// How long the writer thread sleeps when the queue is empty
+static const std::chrono::milliseconds idlePeriod(2);
+
+
+// Constructor
+SampleRecorder::SampleRecorder(const std::string &portName, unsigned int maxSamplesPerBlock, size_t queueLength) :
+    portName(portName),
+    maxSamplesPerBlock(maxSamplesPerBlock),
+    queue(queueLength > 1 ? queueLength : 2),
+    head(0),
+    tail(0),
+    sampleRate(0.0),
+    maxFileBytes(0),
+    maxFileSeconds(0.0),
+    recording(false),
+    fileIndex(0),
+    fd(-1),
+    mapping(NULL),
+    mappedSize(0),
+    writeOffset(0),
+    flushedOffset(0),
+    blocksWritten(0),
+    blocksDropped(0),
+    bytesWritten(0)
+{
+    // Allocate and touch everything up front so pushing a block never allocates or page faults
+    for (size_t i=0; i<queue.size(); i++)
+    {
+        queue[i].samples.assign(maxSamplesPerBlock, 0);
+        queue[i].samples.clear();
+    }
+}
+
+
+// Destructor
+SampleRecorder::~SampleRecorder()
+{
+    stop();
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+}
+
+
+// Start recording, the first file is created when the first block arrives
+void SampleRecorder::start(const std::string &directory, const std::vector<RecorderChannelHeader> &channels,
+                           double sampleRate, size_t maxFileBytes, double maxFileSeconds)
+{
+    if (isRecording())
+    {
+        throw std::runtime_error("already recording");
+    }
+    if (channels.empty())
+    {
+        throw std::runtime_error("no channels selected");
+    }
+    if (maxFileBytes < minFileBytes)
+    {
+        throw std::runtime_error("maximum file size must be at least " + std::to_string(minFileBytes) + " bytes");
+    }
+    if (maxFileSeconds <= 0.0)
+    {
+        throw std::runtime_error("maximum file time must be positive");
+    }
+    if (access(directory.c_str(), W_OK) != 0)
+    {
+        throw std::runtime_error(directory + ": " + strerror(errno));
+    }
+
+    // Wait for the previous recording to finish writing its queue
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+
+    this->directory = directory;
+    this->channels = channels;
+    this->sampleRate = sampleRate;
+    this->maxFileBytes = maxFileBytes;
+    this->maxFileSeconds = maxFileSeconds;
+    blocksWritten = 0;
+    blocksDropped = 0;
+    bytesWritten = 0;
+    {
+        std::lock_guard<std::mutex> guard(statusMutex);
+        lastError.clear();
+    }
+
+    recording.store(true, std::memory_order_release);
+    writer = std::thread(&SampleRecorder::writerThread, this);
+}
+
+
+// Stop accepting blocks, the writer thread closes the file once the queue is empty
+void SampleRecorder::stop()
+{
+    recording.store(false, std::memory_order_release);
+}
+
+
+// Copy a block into the next free slot of the queue
+bool SampleRecorder::push(unsigned int channel, const SampleBlock &block)
+{
+    if (!isRecording())
+    {
+        return false;
+    }
+
+    size_t slot = tail.load(std::memory_order_relaxed);
+    size_t next = (slot + 1 == queue.size()) ? 0 : slot + 1;
+    if (next == head.load(std::memory_order_acquire))
+    {
+        blocksDropped++;
+        return false;
+    }
+
+    size_t n = std::min(block.samples.size(), (size_t) maxSamplesPerBlock);
+    QueuedBlock &queued = queue[slot];
+    queued.header.magic = recorderBlockMagic;
+    queued.header.channel = channel + 1;
+    queued.header.numSamples = n;
+    queued.header.seconds = block.timestamp.secPastEpoch;
+    queued.header.nanoseconds = block.timestamp.nsec;
+    queued.header.samplePeriod = block.samplePeriod;
+    queued.samples.assign(block.samples.begin(), block.samples.begin() + n);
+
+    tail.store(next, std::memory_order_release);
+    return true;
+}
+
+
+// Name of the current file
+std::string SampleRecorder::getCurrentFile()
+{
+    std::lock_guard<std::mutex> guard(statusMutex);
+    return currentFile;
+}
+
+
+// Last error from the writer thread
+std::string SampleRecorder::getLastError()
+{
+    std::lock_guard<std::mutex> guard(statusMutex);
+    return lastError;
+}
+
+
+/* Write queued blocks until recording stops and the queue is empty. A write error
+ * stops the recording; blocks still in the queue are then counted as dropped.
+*/
+void SampleRecorder::writerThread()
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point lastFlush = Clock::now();
+    bool failed = false;
+
+    while (true)
+    {
+        // Check before draining so blocks pushed before stop() are still written
+        bool stillRecording = isRecording();
+
+        size_t index = head.load(std::memory_order_relaxed);
+        bool idle = (index == tail.load(std::memory_order_acquire));
+        while (index != tail.load(std::memory_order_acquire))
+        {
+            if (failed)
+            {
+                blocksDropped++;
+            }
+            else
+            {
+                try
+                {
+                    writeBlock(queue[index]);
+                } catch (const std::runtime_error &e)
+                {
+                    printf("SampleRecorder: %s: %s\n", portName.c_str(), e.what());
+                    {
+                        std::lock_guard<std::mutex> guard(statusMutex);
+                        lastError = e.what();
+                    }
+                    failed = true;
+                    blocksDropped++;
+                    stop();
+                }
+            }
+            index = (index + 1 == queue.size()) ? 0 : index + 1;
+            head.store(index, std::memory_order_release);
+        }
+
+        if (!stillRecording)
+        {
+            break;
+        }
+        if (Clock::now() - lastFlush >= flushPeriod)
+        {
+            flushFile();
+            lastFlush = Clock::now();
+        }
+        if (idle)
+        {
+            std::this_thread::sleep_for(idlePeriod);
+        }
+    }
+
+    closeFile();
+}
+
+
+// Append a block to the current file, starting a new file when needed
+void SampleRecorder::writeBlock(const QueuedBlock &block)
+{
+    const size_t sampleBytes = block.header.numSamples * sizeof(epicsInt32);
+    const size_t blockBytes = sizeof(RecorderBlockHeader) + sampleBytes;
+
+    epicsTimeStamp blockTime;
+    blockTime.secPastEpoch = block.header.seconds;
+    blockTime.nsec = block.header.nanoseconds;
+
+    if (fd < 0)
+    {
+        openFile(blockTime);
+    }
+    else if (writeOffset + blockBytes > mappedSize ||
+             epicsTimeDiffInSeconds(&blockTime, &fileStartTime) >= maxFileSeconds)
+    {
+        closeFile();
+        openFile(blockTime);
+    }
+
+    /* The magic number is written last, after a release fence, so a reader of a
+     * live file which sees it with an acquire fence also sees the rest of the block.
+    */
+    char *destination = mapping + writeOffset;
+    const size_t magicBytes = sizeof(block.header.magic);
+    memcpy(destination + sizeof(RecorderBlockHeader), block.samples.data(), sampleBytes);
+    memcpy(destination + magicBytes, (const char *) &block.header + magicBytes, sizeof(RecorderBlockHeader) - magicBytes);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(destination, &block.header.magic, magicBytes);
+    writeOffset += blockBytes;
+
+    blocksWritten++;
+    bytesWritten += blockBytes;
+}
+
+
+/* Create and map a new file. The full size is allocated on disk up front, so a
+ * full disk is reported here rather than as a SIGBUS when writing to the mapping.
+*/
+void SampleRecorder::openFile(const epicsTimeStamp &startTime)
+{
+    // Port names often contain colons
+    std::string safeName = portName;
+    std::replace(safeName.begin(), safeName.end(), ':', '_');
+
+    char timeString[40];
+    epicsTimeToStrftime(timeString, sizeof(timeString), "%Y%m%d-%H%M%S", &startTime);
+    char indexString[16];
+    snprintf(indexString, sizeof(indexString), "%04u", fileIndex++);
+    std::string name = directory + "/" + safeName + "-" + timeString + "-" + indexString + ".ecatrec";
+
+    fd = open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error(name + ": " + strerror(errno));
+    }
+    int error = posix_fallocate(fd, 0, maxFileBytes);
+    if (error == 0)
+    {
+        void *address = mmap(NULL, maxFileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) error = errno;
+        else mapping = (char *) address;
+    }
+    if (error != 0)
+    {
+        close(fd);
+        unlink(name.c_str());
+        fd = -1;
+        throw std::runtime_error(name + ": " + strerror(error));
+    }
+    mappedSize = maxFileBytes;
+    fileStartTime = startTime;
+
+    // Self-describing header
+    RecorderFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, recorderFileMagic, sizeof(header.magic));
+    header.version = recorderFileVersion;
+    header.headerSize = sizeof(RecorderFileHeader) + channels.size() * sizeof(RecorderChannelHeader);
+    header.numChannels = channels.size();
+    header.oversampling = maxSamplesPerBlock;
+    header.sampleRate = sampleRate;
+    header.startSeconds = startTime.secPastEpoch;
+    header.startNanoseconds = startTime.nsec;
+    strncpy(header.portName, portName.c_str(), sizeof(header.portName) - 1);
+
+    memcpy(mapping, &header, sizeof(header));
+    memcpy(mapping + sizeof(header), channels.data(), channels.size() * sizeof(RecorderChannelHeader));
+    writeOffset = header.headerSize;
+    flushedOffset = 0;
+
+    std::lock_guard<std::mutex> guard(statusMutex);
+    currentFile = name;
+}
+
+
+// Ask the kernel to start writing the pages filled since the last flush
+void SampleRecorder::flushFile()
+{
+    if (fd < 0 || writeOffset == flushedOffset)
+    {
+        return;
+    }
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t start = flushedOffset - (flushedOffset % pageSize);
+    msync(mapping + start, writeOffset - start, MS_ASYNC);
+    flushedOffset = writeOffset;
+}
+
+
+// Write everything out and trim the file to the data actually written
+void SampleRecorder::closeFile()
+{
+    if (fd < 0)
+    {
+        return;
+    }
+    msync(mapping, writeOffset, MS_SYNC);
+    munmap(mapping, mappedSize);
+    if (ftruncate(fd, writeOffset) != 0)
+    {
+        printf("SampleRecorder: %s: cannot truncate %s: %s\n", portName.c_str(), currentFile.c_str(), strerror(errno));
+    }
+    close(fd);
+    fd = -1;
+    mapping = NULL;
+    mappedSize = 0;
+}
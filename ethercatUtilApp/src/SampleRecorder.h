@@ -0,0 +1,121 @@
+/*
+ * SampleRecorder.h
+ *
+ * Class for streaming sample blocks to memory-mapped binary files (see
+ * SampleRecorderFormat.h). Blocks are passed to a background writer thread
+ * through a lock-free queue so recording never blocks acquisition.
+ *
+*/
+
+#ifndef SAMPLERECORDER_H
+#define SAMPLERECORDER_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stddef.h>
+
+#include "SampleBlock.h"
+#include "SampleRecorderFormat.h"
+
+
+class SampleRecorder
+{
+public:
+    // Constructor
+    SampleRecorder(const std::string &portName, unsigned int maxSamplesPerBlock, size_t queueLength = 8192);
+
+    // Destructor, stops recording and waits for the queue to be written
+    ~SampleRecorder();
+
+    /* Start a new file in a directory. The channel headers describe the channels
+     * which will be pushed. A new file is started when the current one reaches
+     * maxFileBytes or contains more than maxFileSeconds of data.
+     * Throws std::runtime_error if already recording or the file cannot be created.
+    */
+    void start(const std::string &directory, const std::vector<RecorderChannelHeader> &channels,
+               double sampleRate, size_t maxFileBytes, double maxFileSeconds);
+
+    // Stop recording. Queued blocks are still written, but nothing new is accepted.
+    void stop();
+
+    // Whether blocks are being accepted (false after stop() or a write error)
+    bool isRecording() const { return recording.load(std::memory_order_acquire); }
+
+    /* Queue a block for writing. This never blocks or allocates; if the writer has
+     * fallen behind and the queue is full the block is dropped and false returned.
+     * Only one thread may push at a time.
+    */
+    bool push(unsigned int channel, const SampleBlock &block);
+
+    // Statistics since the last start()
+    unsigned long long getBlocksWritten() const { return blocksWritten.load(); }
+    unsigned long long getBlocksDropped() const { return blocksDropped.load(); }
+    unsigned long long getBytesWritten() const { return bytesWritten.load(); }
+
+    // Name of the file being written (or the last one written)
+    std::string getCurrentFile();
+
+    // Reason recording stopped on its own (empty if none)
+    std::string getLastError();
+
+private:
+    // A block waiting in the queue
+    struct QueuedBlock
+    {
+        RecorderBlockHeader header;
+        std::vector<epicsInt32> samples;
+    };
+
+    // Background thread draining the queue into the current file
+    void writerThread();
+
+    // File handling, only called from the writer thread
+    void openFile(const epicsTimeStamp &startTime);
+    void closeFile();
+    void flushFile();
+    void writeBlock(const QueuedBlock &block);
+
+    // Attributes
+    std::string portName;
+    unsigned int maxSamplesPerBlock;
+
+    // Single producer, single consumer ring of preallocated blocks
+    std::vector<QueuedBlock> queue;
+    std::atomic<size_t> head;  // Next block to write (consumer)
+    std::atomic<size_t> tail;  // Next free slot (producer)
+
+    // Settings of the current recording
+    std::string directory;
+    std::vector<RecorderChannelHeader> channels;
+    double sampleRate;
+    size_t maxFileBytes;
+    double maxFileSeconds;
+
+    // Writer thread state
+    std::thread writer;
+    std::atomic<bool> recording;
+    unsigned int fileIndex;
+
+    // Current file
+    int fd;
+    char *mapping;
+    size_t mappedSize;
+    size_t writeOffset;
+    size_t flushedOffset;
+    epicsTimeStamp fileStartTime;
+
+    // Statistics
+    std::atomic<unsigned long long> blocksWritten;
+    std::atomic<unsigned long long> blocksDropped;
+    std::atomic<unsigned long long> bytesWritten;
+
+    // Protects the strings read by other threads
+    std::mutex statusMutex;
+    std::string currentFile;
+    std::string lastError;
+};
+
+#endif /* SAMPLERECORDER_H */
@@ -0,0 +1,72 @@
+/*
+ * SampleRecorderFormat.h
+ *
+ * Layout of the binary files written by SampleRecorder. A file starts with a
+ * RecorderFileHeader followed by one RecorderChannelHeader per recorded channel.
+ * The rest of the file is a sequence of blocks, each a RecorderBlockHeader
+ * followed by numSamples 32 bit samples. A block with a zero magic number marks
+ * the end of the data (files are preallocated and zero filled).
+ *
+ * All values are little endian.
+ *
+*/
+
+#ifndef SAMPLERECORDERFORMAT_H
+#define SAMPLERECORDERFORMAT_H
+
+#include <stdint.h>
+
+
+// File magic number and format version
+static const char recorderFileMagic[8] = { 'E', 'C', 'A', 'T', 'R', 'E', 'C', '\0' };
+static const uint32_t recorderFileVersion = 1;
+static const uint32_t recorderBlockMagic = 0x4b4c4231;  // "1BLK"
+
+
+// Start of the file
+struct RecorderFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;        // Including the channel headers
+    uint32_t numChannels;
+    uint32_t oversampling;
+    double sampleRate;          // Samples per second per channel
+    uint32_t startSeconds;      // EPICS epoch (1990-01-01)
+    uint32_t startNanoseconds;
+    char portName[40];
+};
+
+
+// Configuration of a recorded channel when the file was started
+struct RecorderChannelHeader
+{
+    uint32_t channel;           // 1-4
+    int32_t type;               // ELM3704::Type
+    int32_t subtype;            // Interface value
+    int32_t sensorSupply;
+    int32_t rtdElement;
+    int32_t tcElement;
+    int32_t scaler;
+    uint32_t reserved;
+    char typeName[32];
+};
+
+
+// Start of each block of samples
+struct RecorderBlockHeader
+{
+    uint32_t magic;
+    uint16_t channel;           // 1-4
+    uint16_t numSamples;
+    uint32_t seconds;           // Time of the newest sample, EPICS epoch
+    uint32_t nanoseconds;
+    double samplePeriod;        // Seconds between samples
+};
+
+
+static_assert(sizeof(RecorderFileHeader) == 80, "unexpected padding in RecorderFileHeader");
+static_assert(sizeof(RecorderChannelHeader) == 64, "unexpected padding in RecorderChannelHeader");
+static_assert(sizeof(RecorderBlockHeader) == 24, "unexpected padding in RecorderBlockHeader");
+
+#endif /* SAMPLERECORDERFORMAT_H */
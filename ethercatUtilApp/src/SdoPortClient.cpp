@@ -1,10 +1,12 @@
 #include "SdoPortClient.h"
+#include "SdoTraceRecorder.h"
 
 
 // Constructor
-SdoPortClient::SdoPortClient(const char* sdoPortName): 
+SdoPortClient::SdoPortClient(const char* sdoPortName, Clock &clock): 
     portName(sdoPortName),
-    portClient(sdoPortName)
+    portClient(sdoPortName),
+    clock(clock)
 {
     report();
 }
@@ -13,8 +15,15 @@ SdoPortClient::SdoPortClient(const char* sdoPortName):
 // Write to the port and wait until the readback matches (or time out)
 asynStatus SdoPortClient::writeRead(const std::string &paramName, const epicsInt32 &value, double timeout)
 {
+    // Keep the readbacks for the trace, if one is being recorded
+    bool tracing = SdoTraceRecorder::instance().isRecording();
+    SdoTraceRequest trace(portName, paramName, true, value, clock.now());
+
     // Write to the value parameter
     asynStatus status = portClient.write(paramName, value);
+    double writeTime = clock.now();
+    trace.status = status;
+    trace.duration = writeTime - trace.time;
     if (status)
     {
         printf(
@@ -24,26 +33,35 @@ asynStatus SdoPortClient::writeRead(const std::string &paramName, const epicsInt
             value,
             status
         );
+        trace.result = sdoTraceWriteFailed;
     }
     else
     {
         // Poll the readback until it matches or we time out
-        epicsInt32 readbackValue;
+        epicsInt32 readbackValue = 0;
         double parameterSetTime = 0.0;
         static const double parameterPollInterval = 0.1;
-        asynStatus readStatus = read(paramName, readbackValue);
+        asynStatus readStatus = readParameter(paramName, readbackValue);
+        if (tracing) trace.addReadback(clock.now() - writeTime, readbackValue, readStatus);
         if (readStatus == asynSuccess)
         {
             // Readback value doesn't match, wait and see if it updates
             while (readbackValue != value)
             {
-                epicsThreadSleep(parameterPollInterval);
-                readStatus = read(paramName, readbackValue);
-                parameterSetTime += parameterPollInterval;
+                clock.sleep(parameterPollInterval);
+                readStatus = readParameter(paramName, readbackValue);
+                parameterSetTime = clock.now() - writeTime;
+                if (tracing) trace.addReadback(parameterSetTime, readbackValue, readStatus);
 
                 // Check if we exceed a timeout limit
                 if (parameterSetTime > timeout)
                 {
+                    if (tracing)
+                    {
+                        trace.result = sdoTraceTimeout;
+                        SdoTraceRecorder::instance().record(trace);
+                    }
+
                     // Throw an exception which should be caught by writeInt32
                     throw std::runtime_error(
                         "ERROR: timeout setting " +
@@ -68,14 +86,35 @@ asynStatus SdoPortClient::writeRead(const std::string &paramName, const epicsInt
                 parameterSetTime
             );
         }
+        trace.result = readStatus ? sdoTraceReadError : sdoTraceMatched;
     }
 
+    if (tracing)
+    {
+        SdoTraceRecorder::instance().record(trace);
+    }
     return status;
 }
 
 
-// Wrapper function to read from asynPortClient
+// Read a parameter, recording it if a trace is running
 asynStatus SdoPortClient::read(const std::string &paramName, epicsInt32 &value)
+{
+    if (!SdoTraceRecorder::instance().isRecording())
+    {
+        return readParameter(paramName, value);
+    }
+    SdoTraceRequest trace(portName, paramName, false, 0, clock.now());
+    trace.status = readParameter(paramName, value);
+    trace.value = value;
+    trace.duration = clock.now() - trace.time;
+    SdoTraceRecorder::instance().record(trace);
+    return trace.status;
+}
+
+
+// Wrapper function to read from asynPortClient
+asynStatus SdoPortClient::readParameter(const std::string &paramName, epicsInt32 &value)
 {
     asynStatus status = portClient.read(paramName, &value);
     if (status)
@@ -4,6 +4,7 @@
  * Benjamin Bradnick
  *
  * Class which uses an asynPortClient to connect to an EtherCAT SDO port.
+ * Requests are recorded to the SDO trace while SdoTraceRecorder is recording.
  *
 */
 
@@ -13,24 +14,29 @@
 
 #include <asynPortClient.h>
 
+#include "SdoTransport.h"
+#include "Clock.h"
 
-class SdoPortClient
+
+class SdoPortClient : public SdoTransport
 {
 
 public:
-    // Constructor
-    SdoPortClient(const char* sdoPortName);
+    // Constructor, timing writes with a clock
+    SdoPortClient(const char* sdoPortName, Clock &clock = Clock::get());
 
     // Methods for writing and reading parameter values
-    asynStatus writeRead(const std::string &paramName, const epicsInt32 &value, double timeout=3.0);
-    asynStatus read(const std::string &paramName, epicsInt32 &value);
+    virtual asynStatus writeRead(const std::string &paramName, const epicsInt32 &value, double timeout=3.0);
+    virtual asynStatus read(const std::string &paramName, epicsInt32 &value);
 
 private:
     // Attributes
     std::string portName;
     asynPortClient portClient;
+    Clock &clock;
 
     // Methods
+    asynStatus readParameter(const std::string &paramName, epicsInt32 &value);
     void report();
 
 };
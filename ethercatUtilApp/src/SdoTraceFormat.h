@@ -0,0 +1,107 @@
+/*
+ * SdoTraceFormat.h
+ *
+ * Layout of the binary traces of SDO requests written by SdoTraceRecorder. A
+ * file starts with an SdoTraceFileHeader followed by a sequence of records,
+ * each starting with an SdoTraceRecordHeader giving its type and size, so
+ * readers can skip records they do not know.
+ *
+ * Port and parameter names are written once in a name record which gives them
+ * an id, then each request refers to its id. A write is followed by the
+ * readbacks SdoPortClient polled after it, keeping only those which changed.
+ *
+ * All values are little endian.
+ *
+*/
+
+#ifndef SDOTRACEFORMAT_H
+#define SDOTRACEFORMAT_H
+
+#include <stdint.h>
+
+
+// File magic number and format version
+static const char sdoTraceFileMagic[8] = { 'E', 'C', 'A', 'T', 'S', 'D', 'O', '\0' };
+static const uint32_t sdoTraceFileVersion = 1;
+
+
+// Types of record
+enum SdoTraceRecordType
+{
+    sdoTraceName = 1,
+    sdoTraceWrite = 2,
+    sdoTraceRead = 3
+};
+
+
+// How a write ended
+enum SdoTraceResult
+{
+    sdoTraceMatched = 0,        // The readback reached the written value
+    sdoTraceTimeout = 1,        // The readback did not change in time
+    sdoTraceReadError = 2,      // Polling the readback failed
+    sdoTraceWriteFailed = 3     // The write itself failed
+};
+
+
+// Start of the file
+struct SdoTraceFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t startSeconds;      // EPICS epoch (1990-01-01)
+    uint32_t startNanoseconds;
+};
+
+
+// Start of every record
+struct SdoTraceRecordHeader
+{
+    uint8_t type;               // SdoTraceRecordType
+    uint8_t reserved;
+    uint16_t size;              // Of the whole record, including this header
+};
+
+
+// Gives an id to a port and parameter, followed by the characters of both names
+struct SdoTraceNameRecord
+{
+    SdoTraceRecordHeader header;
+    uint16_t id;
+    uint8_t portLength;
+    uint8_t paramLength;
+};
+
+
+// A write or read, a write followed by numReadbacks SdoTraceReadback
+struct SdoTraceRequestRecord
+{
+    SdoTraceRecordHeader header;
+    uint16_t id;
+    uint16_t numReadbacks;
+    double time;                // Seconds from the start of the trace
+    int32_t value;              // Written or read value
+    int32_t status;             // asynStatus of the write or read
+    float duration;             // Seconds the write or read took
+    uint8_t result;             // SdoTraceResult of a write
+    uint8_t reserved[3];
+};
+
+
+// A readback polled after a write
+struct SdoTraceReadback
+{
+    float time;                 // Seconds from the end of the write
+    int32_t value;
+    int32_t status;             // asynStatus of the read
+};
+
+
+static_assert(sizeof(SdoTraceFileHeader) == 24, "unexpected padding in SdoTraceFileHeader");
+static_assert(sizeof(SdoTraceRecordHeader) == 4, "unexpected padding in SdoTraceRecordHeader");
+static_assert(sizeof(SdoTraceNameRecord) == 8, "unexpected padding in SdoTraceNameRecord");
+static_assert(sizeof(SdoTraceRequestRecord) == 32, "unexpected padding in SdoTraceRequestRecord");
+static_assert(sizeof(SdoTraceReadback) == 12, "unexpected padding in SdoTraceReadback");
+
+#endif /* SDOTRACEFORMAT_H */
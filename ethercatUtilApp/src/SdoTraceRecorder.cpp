@@ -0,0 +1,354 @@
+#include "SdoTraceRecorder.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+#include <epicsTime.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+// For logging
+static const char *driverName = "SdoTraceRecorder";
+
+// Most readbacks which fit in a record
+static const size_t maxReadbacks = (UINT16_MAX - sizeof(SdoTraceRequestRecord)) / sizeof(SdoTraceReadback);
+
+
+// Constructor
+SdoTraceRequest::SdoTraceRequest(const std::string &portName, const std::string &paramName,
+                                 bool write, epicsInt32 value, double time) :
+    portName(portName),
+    paramName(paramName),
+    write(write),
+    time(time),
+    value(value),
+    status(asynSuccess),
+    duration(0.0),
+    result(sdoTraceMatched)
+{
+}
+
+
+// Add a polled readback, if it differs from the previous one
+void SdoTraceRequest::addReadback(double time, epicsInt32 value, asynStatus status)
+{
+    if (!readbacks.empty() && readbacks.back().value == value && readbacks.back().status == status)
+    {
+        return;
+    }
+    SdoTraceReadback readback;
+    readback.time = (float) time;
+    readback.value = value;
+    readback.status = status;
+    readbacks.push_back(readback);
+}
+
+
+// Constructor
+SdoTraceRecorder::SdoTraceRecorder() :
+    recording(false),
+    file(NULL),
+    startTime(0.0),
+    requests(0)
+{
+}
+
+
+// The recorder shared by all clients
+SdoTraceRecorder &SdoTraceRecorder::instance()
+{
+    static SdoTraceRecorder recorder;
+    return recorder;
+}
+
+
+// Start recording to a new file
+void SdoTraceRecorder::start(const std::string &name)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if (file)
+    {
+        throw std::runtime_error("already recording to " + fileName);
+    }
+    FILE *newFile = fopen(name.c_str(), "wb");
+    if (!newFile)
+    {
+        throw std::runtime_error(name + ": " + strerror(errno));
+    }
+
+    SdoTraceFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, sdoTraceFileMagic, sizeof(header.magic));
+    header.version = sdoTraceFileVersion;
+    header.headerSize = sizeof(header);
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    header.startSeconds = now.secPastEpoch;
+    header.startNanoseconds = now.nsec;
+    if (fwrite(&header, sizeof(header), 1, newFile) != 1)
+    {
+        int error = errno;
+        fclose(newFile);
+        throw std::runtime_error(name + ": " + strerror(error));
+    }
+
+    file = newFile;
+    fileName = name;
+    startTime = Clock::get().now();
+    requests = 0;
+    ids.clear();
+    recording = true;
+}
+
+
+// Stop recording and close the file
+void SdoTraceRecorder::stop()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    recording = false;
+    if (file)
+    {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+
+// Id of a port and parameter, writing a name record for a new one
+bool SdoTraceRecorder::nameId(const std::string &portName, const std::string &paramName, uint16_t &id)
+{
+    std::string key = portName + '\0' + paramName;
+    std::map<std::string, uint16_t>::iterator it = ids.find(key);
+    if (it != ids.end())
+    {
+        id = it->second;
+        return true;
+    }
+    if (ids.size() > UINT16_MAX)
+    {
+        return false;
+    }
+
+    id = (uint16_t) ids.size();
+    ids[key] = id;
+    SdoTraceNameRecord record;
+    record.header.type = sdoTraceName;
+    record.header.reserved = 0;
+    record.id = id;
+    record.portLength = (uint8_t) std::min<size_t>(portName.size(), UINT8_MAX);
+    record.paramLength = (uint8_t) std::min<size_t>(paramName.size(), UINT8_MAX);
+    record.header.size = sizeof(record) + record.portLength + record.paramLength;
+    fwrite(&record, sizeof(record), 1, file);
+    fwrite(portName.data(), 1, record.portLength, file);
+    fwrite(paramName.data(), 1, record.paramLength, file);
+    return true;
+}
+
+
+/* Append a request. A write with more readbacks than fit in a record keeps the
+ * first of them and the last, which is the one it ended with. Recording stops
+ * once the ids of the ports and parameters run out.
+*/
+void SdoTraceRecorder::record(const SdoTraceRequest &request)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if (!file)
+    {
+        return;
+    }
+
+    uint16_t id;
+    if (!nameId(request.portName, request.paramName, id))
+    {
+        printf("%s: stopped recording to %s: more than %d parameters\n",
+               driverName, fileName.c_str(), UINT16_MAX + 1);
+        recording = false;
+        fclose(file);
+        file = NULL;
+        return;
+    }
+
+    size_t numReadbacks = request.write ? std::min(request.readbacks.size(), maxReadbacks) : 0;
+    SdoTraceRequestRecord record;
+    memset(&record, 0, sizeof(record));
+    record.header.type = request.write ? sdoTraceWrite : sdoTraceRead;
+    record.header.size = sizeof(record) + numReadbacks * sizeof(SdoTraceReadback);
+    record.id = id;
+    record.numReadbacks = numReadbacks;
+    record.time = request.time - startTime;
+    record.value = request.value;
+    record.status = request.status;
+    record.duration = (float) request.duration;
+    record.result = request.result;
+    fwrite(&record, sizeof(record), 1, file);
+    if (numReadbacks)
+    {
+        fwrite(&request.readbacks[0], sizeof(SdoTraceReadback), numReadbacks - 1, file);
+        fwrite(&request.readbacks.back(), sizeof(SdoTraceReadback), 1, file);
+    }
+
+    // Keep the trace whole if the IOC stops without closing it
+    fflush(file);
+    requests++;
+}
+
+
+// Print the file and number of requests recorded
+void SdoTraceRecorder::report(FILE *fp)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if (file)
+    {
+        fprintf(fp, "%s: recording to %s, %lu requests, %d parameters\n",
+                driverName, fileName.c_str(), requests, (int) ids.size());
+    }
+    else
+    {
+        fprintf(fp, "%s: not recording\n", driverName);
+    }
+}
+
+
+// Read all requests of a trace
+std::vector<SdoTraceRequest> SdoTraceRecorder::load(const std::string &name)
+{
+    FILE *traceFile = fopen(name.c_str(), "rb");
+    if (!traceFile)
+    {
+        throw std::runtime_error(name + ": " + strerror(errno));
+    }
+    std::unique_ptr<FILE, int (*)(FILE *)> closer(traceFile, fclose);
+
+    SdoTraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, traceFile) != 1 ||
+        memcmp(header.magic, sdoTraceFileMagic, sizeof(header.magic)) != 0)
+    {
+        throw std::runtime_error(name + ": not an SDO trace");
+    }
+    if (header.version != sdoTraceFileVersion)
+    {
+        throw std::runtime_error(name + ": unsupported version " + std::to_string(header.version));
+    }
+    fseek(traceFile, header.headerSize, SEEK_SET);
+
+    std::map<uint16_t, std::pair<std::string, std::string> > names;
+    std::vector<SdoTraceRequest> requests;
+    std::vector<char> buffer;
+    SdoTraceRecordHeader recordHeader;
+    while (fread(&recordHeader, sizeof(recordHeader), 1, traceFile) == 1)
+    {
+        if (recordHeader.size < sizeof(recordHeader))
+        {
+            throw std::runtime_error(name + ": corrupt record");
+        }
+        buffer.resize(recordHeader.size);
+        memcpy(&buffer[0], &recordHeader, sizeof(recordHeader));
+        size_t rest = recordHeader.size - sizeof(recordHeader);
+        if (rest && fread(&buffer[sizeof(recordHeader)], rest, 1, traceFile) != 1)
+        {
+            // The last record was cut short
+            break;
+        }
+
+        if (recordHeader.type == sdoTraceName && recordHeader.size >= sizeof(SdoTraceNameRecord))
+        {
+            SdoTraceNameRecord record;
+            memcpy(&record, &buffer[0], sizeof(record));
+            if (sizeof(record) + record.portLength + record.paramLength > recordHeader.size)
+            {
+                throw std::runtime_error(name + ": corrupt name record");
+            }
+            const char *text = &buffer[sizeof(record)];
+            names[record.id] = std::make_pair(std::string(text, record.portLength),
+                                              std::string(text + record.portLength, record.paramLength));
+        }
+        else if ((recordHeader.type == sdoTraceWrite || recordHeader.type == sdoTraceRead) &&
+                 recordHeader.size >= sizeof(SdoTraceRequestRecord))
+        {
+            SdoTraceRequestRecord record;
+            memcpy(&record, &buffer[0], sizeof(record));
+            if (sizeof(record) + record.numReadbacks * sizeof(SdoTraceReadback) > recordHeader.size ||
+                names.find(record.id) == names.end())
+            {
+                throw std::runtime_error(name + ": corrupt request record");
+            }
+            SdoTraceRequest request(names[record.id].first, names[record.id].second,
+                                    recordHeader.type == sdoTraceWrite, record.value, record.time);
+            request.status = (asynStatus) record.status;
+            request.duration = record.duration;
+            request.result = (SdoTraceResult) record.result;
+            request.readbacks.resize(record.numReadbacks);
+            if (record.numReadbacks)
+            {
+                memcpy(&request.readbacks[0], &buffer[sizeof(record)], record.numReadbacks * sizeof(SdoTraceReadback));
+            }
+            requests.push_back(request);
+        }
+    }
+    return requests;
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to start recording the requests of all SdoPortClients.
+      * \param[in] fileName The trace file to create
+      */
+    int SdoTraceStart(const char *fileName)
+    {
+        try
+        {
+            SdoTraceRecorder::instance().start(fileName ? fileName : "");
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: cannot start trace: %s\n", driverName, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to stop recording SDO requests and close the trace.
+      */
+    int SdoTraceStop(void)
+    {
+        SdoTraceRecorder::instance().report(stdout);
+        SdoTraceRecorder::instance().stop();
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg startArg0 = { "fileName", iocshArgString };
+    static const iocshArg * const startArgs[] = { &startArg0 };
+    static const iocshFuncDef startFuncDef = { "SdoTraceStart", 1, startArgs };
+
+    static void startCallFunc(const iocshArgBuf *args)
+    {
+        SdoTraceStart(args[0].sval);
+    }
+
+    static const iocshFuncDef stopFuncDef = { "SdoTraceStop", 0, NULL };
+
+    static void stopCallFunc(const iocshArgBuf *)
+    {
+        SdoTraceStop();
+    }
+
+    void SdoTraceRecorderRegister(void)
+    {
+        iocshRegister(&startFuncDef, startCallFunc);
+        iocshRegister(&stopFuncDef, stopCallFunc);
+    }
+
+    epicsExportRegistrar(SdoTraceRecorderRegister);
+
+}
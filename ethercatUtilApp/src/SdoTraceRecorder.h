@@ -0,0 +1,97 @@
+/*
+ * SdoTraceRecorder.h
+ *
+ * Class recording the requests of every SdoPortClient to a binary trace (see
+ * SdoTraceFormat.h), with their times on the Clock in use, status and the
+ * timeline of the readback after each write. Recording is started and stopped
+ * from iocsh and costs the clients nothing while it is off.
+ *
+ * The simulated SDO port loads traces to replay the recorded latencies and
+ * results, see SimELM3704SdoPortDriver.
+ *
+*/
+
+#ifndef SDOTRACERECORDER_H
+#define SDOTRACERECORDER_H
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <asynDriver.h>
+#include <epicsTypes.h>
+
+#include "SdoTraceFormat.h"
+#include "Clock.h"
+
+
+// A request of SdoPortClient, as recorded
+struct SdoTraceRequest
+{
+    // Constructor
+    SdoTraceRequest(const std::string &portName = "", const std::string &paramName = "",
+                    bool write = false, epicsInt32 value = 0, double time = 0.0);
+
+    // Add a polled readback, if it differs from the previous one
+    void addReadback(double time, epicsInt32 value, asynStatus status);
+
+    std::string portName;
+    std::string paramName;
+    bool write;
+    double time;
+    epicsInt32 value;
+    asynStatus status;
+    double duration;
+    SdoTraceResult result;
+    std::vector<SdoTraceReadback> readbacks;
+};
+
+
+class SdoTraceRecorder
+{
+
+public:
+    // The recorder shared by all clients
+    static SdoTraceRecorder &instance();
+
+    // Start recording to a new file. Throws std::runtime_error if it cannot be created.
+    void start(const std::string &fileName);
+
+    // Stop recording and close the file
+    void stop();
+
+    // Whether requests should be recorded
+    bool isRecording() const { return recording; }
+
+    // Append a request, with its time on the clock in use
+    void record(const SdoTraceRequest &request);
+
+    // Print the file and number of requests recorded
+    void report(FILE *fp);
+
+    // Read all requests of a trace. Throws std::runtime_error if it cannot be read.
+    static std::vector<SdoTraceRequest> load(const std::string &fileName);
+
+private:
+    // Constructor
+    SdoTraceRecorder();
+
+    // Id of a port and parameter, writing a name record for a new one.
+    // Returns false if all ids are taken.
+    bool nameId(const std::string &portName, const std::string &paramName, uint16_t &id);
+
+    // Attributes
+    std::atomic<bool> recording;
+    std::mutex mutex;
+    FILE *file;
+    std::string fileName;
+    double startTime;
+    unsigned long requests;
+    std::map<std::string, uint16_t> ids;
+
+};
+
+#endif /* SDOTRACERECORDER_H */
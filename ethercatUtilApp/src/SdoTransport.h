@@ -0,0 +1,35 @@
+/*
+ * SdoTransport.h
+ *
+ * Interface through which the ELM3704 driver reads and writes the settings of
+ * a module, e.g. CH1:Interface. SdoPortClient implements it on the SDO asyn
+ * port of the slave and MockSdoTransport on a table of values, so the driver
+ * logic can be exercised and timed without an IOC.
+ *
+*/
+
+#ifndef SDOTRANSPORT_H
+#define SDOTRANSPORT_H
+
+#include <string>
+
+#include <asynDriver.h>
+#include <epicsTypes.h>
+
+
+class SdoTransport
+{
+
+public:
+    virtual ~SdoTransport() {}
+
+    // Write a value and wait until the readback matches. Throws std::runtime_error
+    // if the readback does not change within the timeout in seconds.
+    virtual asynStatus writeRead(const std::string &paramName, const epicsInt32 &value, double timeout=3.0) = 0;
+
+    // Read the current value
+    virtual asynStatus read(const std::string &paramName, epicsInt32 &value) = 0;
+
+};
+
+#endif /* SDOTRANSPORT_H */
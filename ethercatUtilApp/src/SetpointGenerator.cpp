@@ -0,0 +1,493 @@
+#include "SetpointGenerator.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include <algorithm>
+#include <cmath>
+
+// For logging
+static const char *driverName = "SetpointGenerator";
+
+// How often the generated values are published while running
+static const double publishPeriod = 0.1;
+
+
+// Constructor
+SetpointGenerator::SetpointGenerator(const char* portName, const char* slavePortName, const char* entryFormat, int channels,
+                                     const char* cyclePortName, const char* cycleEntry, double period,
+                                     int rawLow, int rawHigh, double low, double high, int maxPoints) : asynPortDriver(
+    portName,  /* asyn port name for this driver*/
+    1, /* maxAddr */
+    asynInt32Mask | asynFloat64Mask | asynFloat64ArrayMask | asynDrvUserMask, /* Interface mask */
+    asynInt32Mask | asynFloat64Mask | asynFloat64ArrayMask,  /* Interrupt mask */
+    0, /* asynFlags.  This driver does not block and it is not multi-device, so flag is 0 */
+    1, /* Autoconnect */
+    0, /* Default priority */
+    0), /* Default stack size*/
+    mode(channels > 0 ? channels : 0),
+    setpoint(mode.size()),
+    rate(mode.size()),
+    amplitude(mode.size()),
+    offset(mode.size()),
+    frequency(mode.size()),
+    table(mode.size()),
+    tableStep(mode.size()),
+    tableLoop(mode.size()),
+    startCommand(mode.size()),
+    stopCommand(mode.size()),
+    active(mode.size()),
+    generated(mode.size()),
+    channels(mode.size()),
+    rawLow(rawLow),
+    rawHigh(rawHigh),
+    low(low),
+    high(high),
+    maxPoints(maxPoints > 0 ? maxPoints : 1024),
+    rawOutputs(mode.size()),
+    changedOutputs(mode.size()),
+    pdoPortClient(slavePortName), /* Create PdoPortClient instance */
+    ticker(cyclePortName, cycleEntry, period)
+{
+    if (rawLow == rawHigh || low == high)
+    {
+        printf("%s: %s: invalid scaling, using raw counts\n", driverName, portName);
+        this->rawLow = this->low = -32768;
+        this->rawHigh = this->high = 32767;
+    }
+
+    /* Asyn parameter creation */
+    createParam("CYCLE_PERIOD", asynParamFloat64, &cyclePeriod);
+    createParam("LATE_CYCLES", asynParamInt32, &lateCycles);
+    createParam("WRITE_ERRORS", asynParamInt32, &writeErrors);
+    setDoubleParam(cyclePeriod, ticker.getPeriod());
+    setIntegerParam(lateCycles, 0);
+    setIntegerParam(writeErrors, 0);
+
+    // For each channel
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (unsigned int channel=0; channel<this->channels.size(); channel++)
+    {
+        Channel &state = this->channels[channel];
+        epicsSnprintf(str, NBUFF, entryFormat, channel+1);
+        state.entry = str;
+        state.running = false;
+        state.cycle = 0;
+
+        // Start from the output as it is
+        epicsInt32 raw = 0;
+        pdoPortClient.read(state.entry, raw);
+        state.lastRaw = raw;
+        state.value = fromRaw(raw);
+
+        // Waveform settings
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_MODE", channel+1);
+        createParam(str, asynParamInt32, &mode[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_SETPOINT", channel+1);
+        createParam(str, asynParamFloat64, &setpoint[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_RATE", channel+1);
+        createParam(str, asynParamFloat64, &rate[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_AMPLITUDE", channel+1);
+        createParam(str, asynParamFloat64, &amplitude[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_OFFSET", channel+1);
+        createParam(str, asynParamFloat64, &offset[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_FREQUENCY", channel+1);
+        createParam(str, asynParamFloat64, &frequency[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_TABLE", channel+1);
+        createParam(str, asynParamFloat64Array, &table[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_TABLE_STEP", channel+1);
+        createParam(str, asynParamFloat64, &tableStep[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_TABLE_LOOP", channel+1);
+        createParam(str, asynParamInt32, &tableLoop[channel]);
+
+        // Control and status
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_START", channel+1);
+        createParam(str, asynParamInt32, &startCommand[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_STOP", channel+1);
+        createParam(str, asynParamInt32, &stopCommand[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_ACTIVE", channel+1);
+        createParam(str, asynParamInt32, &active[channel]);
+        epicsSnprintf(str, NBUFF, "CH%d:GEN_VALUE", channel+1);
+        createParam(str, asynParamFloat64, &generated[channel]);
+
+        setIntegerParam(mode[channel], modeRamp);
+        setDoubleParam(setpoint[channel], state.value);
+        setDoubleParam(rate[channel], 0.0);
+        setDoubleParam(amplitude[channel], 0.0);
+        setDoubleParam(offset[channel], 0.0);
+        setDoubleParam(frequency[channel], 1.0);
+        setDoubleParam(tableStep[channel], ticker.getPeriod());
+        setIntegerParam(tableLoop[channel], 0);
+        setIntegerParam(startCommand[channel], 0);
+        setIntegerParam(stopCommand[channel], 0);
+        setIntegerParam(active[channel], 0);
+        setDoubleParam(generated[channel], state.value);
+
+        // Follow writes made directly to the slave port while the channel is stopped
+        pdoPortClient.monitor(
+            state.entry,
+            [this, channel](epicsInt32 raw, const epicsTimeStamp &) {
+                lock();
+                if (!this->channels[channel].running)
+                {
+                    this->channels[channel].lastRaw = raw;
+                    this->channels[channel].value = fromRaw(raw);
+                }
+                unlock();
+            }
+        );
+    }
+    callParamCallbacks();
+
+    generatorThread = std::thread(&SetpointGenerator::generatorLoop, this);
+}
+
+
+// Scale an engineering value to raw counts, limited to the output range
+epicsInt32 SetpointGenerator::toRaw(double value)
+{
+    double raw = rawLow + (value - low) * (rawHigh - rawLow) / (high - low);
+    raw = std::min(std::max(raw, (double) std::min(rawLow, rawHigh)), (double) std::max(rawLow, rawHigh));
+    return (epicsInt32) std::lround(raw);
+}
+
+
+// Scale raw counts to an engineering value
+double SetpointGenerator::fromRaw(epicsInt32 raw)
+{
+    return low + (raw - rawLow) * (high - low) / (rawHigh - rawLow);
+}
+
+
+// Find the channel an asyn parameter belongs to (or -1)
+int SetpointGenerator::findChannel(const std::vector<int> &params, int param)
+{
+    for (unsigned int channel=0; channel<params.size(); channel++)
+    {
+        if (params[channel] == param) return channel;
+    }
+    return -1;
+}
+
+
+// Start generating from the channel's current output
+asynStatus SetpointGenerator::startChannel(unsigned int channel)
+{
+    // For logging
+    static const char *functionName = "startChannel";
+
+    int channelMode;
+    getIntegerParam(mode[channel], &channelMode);
+    if (channelMode == modeTable && channels[channel].points.empty())
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "%s::%s: %s: channel %d: the table is empty\n",
+                  driverName, functionName, portName, channel+1);
+        return asynError;
+    }
+
+    // A ramp which is already running carries on to the new setpoint
+    if (!channels[channel].running || channelMode != modeRamp)
+    {
+        channels[channel].cycle = 0;
+    }
+    channels[channel].running = true;
+    setIntegerParam(active[channel], 1);
+    callParamCallbacks();
+    return asynSuccess;
+}
+
+
+// Stop generating, leaving the output at its last value
+void SetpointGenerator::stopChannel(unsigned int channel)
+{
+    channels[channel].running = false;
+    setIntegerParam(active[channel], 0);
+    setDoubleParam(generated[channel], channels[channel].value);
+}
+
+
+/* Value of the waveform for the channel's cycle after the given number, skipping
+ * those which were missed. Ramps and tables played once set done when they reach
+ * their last value.
+*/
+double SetpointGenerator::waveformValue(unsigned int channel, long cycles, bool &done)
+{
+    Channel &state = channels[channel];
+    state.cycle += cycles - 1;
+    double t = state.cycle++ * ticker.getPeriod();
+
+    int channelMode;
+    getIntegerParam(mode[channel], &channelMode);
+    double amp, centre, freq;
+    getDoubleParam(amplitude[channel], &amp);
+    getDoubleParam(offset[channel], &centre);
+    getDoubleParam(frequency[channel], &freq);
+
+    switch (channelMode)
+    {
+        case modeSine:
+            return centre + amp * std::sin(2.0 * M_PI * freq * t);
+
+        case modeSquare:
+            if (freq <= 0.0 || std::fmod(t * freq, 1.0) < 0.5) return centre + amp;
+            return centre - amp;
+
+        case modeTable:
+        {
+            double step;
+            int loop;
+            getDoubleParam(tableStep[channel], &step);
+            getIntegerParam(tableLoop[channel], &loop);
+            size_t n = state.points.size();
+            double position = t / (step > 0.0 ? step : ticker.getPeriod());
+
+            // Looping tables interpolate from the last point back to the first
+            if (loop) position = std::fmod(position, (double) n);
+            else if (position >= n - 1)
+            {
+                done = true;
+                return state.points.back();
+            }
+            size_t i = (size_t) position;
+            double fraction = position - i;
+            return state.points[i] + fraction * (state.points[(i + 1) % n] - state.points[i]);
+        }
+
+        default:
+        {
+            double target;
+            getDoubleParam(setpoint[channel], &target);
+            done = true;
+            return target;
+        }
+    }
+}
+
+
+/* Work out each running channel's setpoint for this cycle under our lock, then
+ * write the ones whose raw value changed without it. The slew covers every cycle
+ * since the last one.
+*/
+void SetpointGenerator::generate(const epicsTimeStamp &timestamp, long cycles, bool publish)
+{
+    std::vector<epicsInt32> &raws = rawOutputs;
+    std::vector<char> &changed = changedOutputs;
+    bool stopped = false;
+
+    lock();
+    setIntegerParam(lateCycles, ticker.getLateCycles());
+    for (unsigned int channel=0; channel<channels.size(); channel++)
+    {
+        Channel &state = channels[channel];
+        changed[channel] = false;
+        if (!state.running) continue;
+
+        bool done = false;
+        double target = waveformValue(channel, cycles, done);
+
+        // Slew towards the waveform, a rate of 0 is unlimited
+        double slew;
+        getDoubleParam(rate[channel], &slew);
+        double maxStep = slew * ticker.getPeriod() * cycles;
+        double value = target;
+        if (slew > 0.0 && std::fabs(target - state.value) > maxStep)
+        {
+            value = state.value + (target > state.value ? maxStep : -maxStep);
+            done = false;
+        }
+        state.value = std::min(std::max(value, std::min(low, high)), std::max(low, high));
+
+        raws[channel] = toRaw(state.value);
+        changed[channel] = raws[channel] != state.lastRaw;
+        state.lastRaw = raws[channel];
+
+        if (done)
+        {
+            stopChannel(channel);
+            stopped = true;
+        }
+        else if (publish)
+        {
+            setDoubleParam(generated[channel], state.value);
+        }
+    }
+    unlock();
+
+    int errors = 0;
+    for (unsigned int channel=0; channel<channels.size(); channel++)
+    {
+        if (changed[channel] && pdoPortClient.write(channels[channel].entry, raws[channel]) != asynSuccess)
+        {
+            errors++;
+        }
+    }
+
+    if (publish || stopped || errors)
+    {
+        lock();
+        if (errors)
+        {
+            int count;
+            getIntegerParam(writeErrors, &count);
+            setIntegerParam(writeErrors, count + errors);
+        }
+        setTimeStamp(&timestamp);
+        callParamCallbacks();
+        unlock();
+    }
+}
+
+
+// Generate the setpoints once per cycle
+void SetpointGenerator::generatorLoop()
+{
+    long publishCycles = std::max(std::lround(publishPeriod / ticker.getPeriod()), 1L);
+    long cycle = 0;
+    epicsTimeStamp timestamp;
+    while (true)
+    {
+        long cycles = ticker.waitForCycles(timestamp);
+        bool publish = (cycle + cycles) / publishCycles != cycle / publishCycles;
+        cycle += cycles;
+        generate(timestamp, cycles, publish);
+    }
+}
+
+
+// Start and stop channels, the other settings are stored
+asynStatus SetpointGenerator::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    int function = pasynUser->reason;
+
+    int channel = findChannel(startCommand, function);
+    if (channel >= 0)
+    {
+        return value ? startChannel(channel) : asynSuccess;
+    }
+
+    channel = findChannel(stopCommand, function);
+    if (channel >= 0)
+    {
+        if (value)
+        {
+            stopChannel(channel);
+            callParamCallbacks();
+        }
+        return asynSuccess;
+    }
+
+    if (findChannel(active, function) >= 0)
+    {
+        return asynError;
+    }
+    return asynPortDriver::writeInt32(pasynUser, value);
+}
+
+
+// A new setpoint starts the ramp in ramp mode
+asynStatus SetpointGenerator::writeFloat64(asynUser *pasynUser, epicsFloat64 value)
+{
+    int function = pasynUser->reason;
+
+    if (findChannel(generated, function) >= 0)
+    {
+        return asynError;
+    }
+
+    asynStatus status = asynPortDriver::writeFloat64(pasynUser, value);
+    int channel = findChannel(setpoint, function);
+    if (status == asynSuccess && channel >= 0)
+    {
+        int channelMode;
+        getIntegerParam(mode[channel], &channelMode);
+        if (channelMode == modeRamp)
+        {
+            status = startChannel(channel);
+        }
+    }
+    return status;
+}
+
+
+// Store a channel's table, it is used from the next start
+asynStatus SetpointGenerator::writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements)
+{
+    int channel = findChannel(table, pasynUser->reason);
+    if (channel < 0)
+    {
+        return asynPortDriver::writeFloat64Array(pasynUser, value, nElements);
+    }
+    if (channels[channel].running)
+    {
+        return asynError;
+    }
+
+    nElements = std::min(nElements, maxPoints);
+    channels[channel].points.assign(value, value + nElements);
+    doCallbacksFloat64Array(value, nElements, table[channel], 0);
+    return asynSuccess;
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to call constructor for the SetpointGenerator class.
+      * \param[in] portName The name of the asyn port created in this driver.
+      * \param[in] slavePortName The name of the asyn port of the slave module
+      * \param[in] entryFormat The PDO entry of each output, with %d for the channel number
+      * \param[in] channels The number of outputs
+      * \param[in] cyclePortName The asyn port with an entry changing every cycle (optional)
+      * \param[in] cycleEntry The entry changing every cycle (optional)
+      * \param[in] period The cycle period in seconds
+      * \param[in] rawLow The raw output value at the low end of the range
+      * \param[in] rawHigh The raw output value at the high end of the range
+      * \param[in] low The engineering value at the low end of the range
+      * \param[in] high The engineering value at the high end of the range
+      * \param[in] maxPoints The maximum number of points in a table
+      */
+    int SetpointGeneratorConfigure(const char *portName, const char *slavePortName, const char *entryFormat, int channels,
+                                   const char *cyclePortName, const char *cycleEntry, double period,
+                                   int rawLow, int rawHigh, double low, double high, int maxPoints)
+    {
+        new SetpointGenerator(portName, slavePortName, entryFormat, channels, cyclePortName, cycleEntry, period,
+                              rawLow, rawHigh, low, high, maxPoints);
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg initArg0 = { "portName", iocshArgString };
+    static const iocshArg initArg1 = { "slavePortName", iocshArgString };
+    static const iocshArg initArg2 = { "entryFormat", iocshArgString };
+    static const iocshArg initArg3 = { "channels", iocshArgInt };
+    static const iocshArg initArg4 = { "cyclePortName", iocshArgString };
+    static const iocshArg initArg5 = { "cycleEntry", iocshArgString };
+    static const iocshArg initArg6 = { "period", iocshArgDouble };
+    static const iocshArg initArg7 = { "rawLow", iocshArgInt };
+    static const iocshArg initArg8 = { "rawHigh", iocshArgInt };
+    static const iocshArg initArg9 = { "low", iocshArgDouble };
+    static const iocshArg initArg10 = { "high", iocshArgDouble };
+    static const iocshArg initArg11 = { "maxPoints", iocshArgInt };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1, &initArg2, &initArg3, &initArg4, &initArg5,
+                                                 &initArg6, &initArg7, &initArg8, &initArg9, &initArg10, &initArg11 };
+    static const iocshFuncDef initFuncDef = { "SetpointGeneratorConfigure", 12, initArgs };
+
+    static void initCallFunc(const iocshArgBuf *args)
+    {
+        SetpointGeneratorConfigure(args[0].sval, args[1].sval, args[2].sval, args[3].ival, args[4].sval, args[5].sval,
+                                   args[6].dval, args[7].ival, args[8].ival, args[9].dval, args[10].dval, args[11].ival);
+    }
+
+    void SetpointGeneratorRegister(void)
+    {
+        iocshRegister(&initFuncDef, initCallFunc);
+    }
+
+    epicsExportRegistrar(SetpointGeneratorRegister);
+
+}
@@ -0,0 +1,112 @@
+/*
+ * SetpointGenerator.h
+ *
+ * Class for generating the setpoints of an analog output module in the driver.
+ * Each channel can ramp to a setpoint, play a sine or square wave, or play a
+ * table of values, with an optional slew rate limit. A new setpoint is written
+ * to the slave port every EtherCAT cycle while a channel is running.
+ *
+*/
+
+#ifndef SETPOINTGENERATOR_H
+#define SETPOINTGENERATOR_H
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asynPortDriver.h"
+#include "PdoPortClient.h"
+#include "CycleTicker.h"
+
+
+class SetpointGenerator : public asynPortDriver
+{
+
+public:
+    // Constructor
+    SetpointGenerator(const char* portName, const char* slavePortName, const char* entryFormat, int channels,
+                      const char* cyclePortName, const char* cycleEntry, double period,
+                      int rawLow, int rawHigh, double low, double high, int maxPoints);
+
+    // Overidden methods from asynPortDriver
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+    virtual asynStatus writeFloat64(asynUser *pasynUser, epicsFloat64 value);
+    virtual asynStatus writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements);
+
+    // Generator modes
+    enum Mode { modeRamp, modeSine, modeSquare, modeTable };
+
+protected:
+    // Module asyn parameter indices
+    int cyclePeriod;
+    int lateCycles;
+    int writeErrors;
+
+    // Channel asyn parameter indices
+    std::vector<int> mode;
+    std::vector<int> setpoint;
+    std::vector<int> rate;
+    std::vector<int> amplitude;
+    std::vector<int> offset;
+    std::vector<int> frequency;
+    std::vector<int> table;
+    std::vector<int> tableStep;
+    std::vector<int> tableLoop;
+    std::vector<int> startCommand;
+    std::vector<int> stopCommand;
+    std::vector<int> active;
+    std::vector<int> generated;
+
+private:
+    // Per-channel state
+    struct Channel
+    {
+        std::string entry;
+        bool running;
+        long cycle;
+        double value;
+        epicsInt32 lastRaw;
+        std::vector<double> points;
+    };
+
+    // Start and stop a channel
+    asynStatus startChannel(unsigned int channel);
+    void stopChannel(unsigned int channel);
+
+    // Value of a running channel after a number of cycles, before the rate limit. Sets done at the end.
+    double waveformValue(unsigned int channel, long cycles, bool &done);
+
+    // Conversion between engineering units and raw counts
+    epicsInt32 toRaw(double value);
+    double fromRaw(epicsInt32 raw);
+
+    // Find the channel an asyn parameter belongs to (or -1)
+    int findChannel(const std::vector<int> &params, int param);
+
+    // Thread writing the setpoints each cycle
+    void generatorLoop();
+    void generate(const epicsTimeStamp &timestamp, long cycles, bool publish);
+
+    // Attributes
+    std::vector<Channel> channels;
+    int rawLow;
+    int rawHigh;
+    double low;
+    double high;
+    size_t maxPoints;
+
+    // Outputs to write this cycle, only used by the generator thread
+    std::vector<epicsInt32> rawOutputs;
+    std::vector<char> changedOutputs;
+
+    // Client for the PDO entries of the slave port
+    PdoPortClient pdoPortClient;
+
+    // Cycle timing and the generator thread
+    CycleTicker ticker;
+    std::thread generatorThread;
+
+};
+
+#endif /* SETPOINTGENERATOR_H */
@@ -0,0 +1,162 @@
+#include "SimELM3704Device.h"
+#include "ELM3704Properties.h"
+
+#include <stdexcept>
+#include <string>
+
+
+// Whether a table of option values contains a value
+static bool contains(const int *values, int numValues, epicsInt32 value)
+{
+    for (int i=0; i<numValues; i++)
+    {
+        if (values[i] == value)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Names of the settings for error messages
+static const char *settingNames[SimELM3704Device::numSettings] = {
+    "Interface", "SensorSupply", "RTDElement", "TCElement", "Scaler"
+};
+
+
+// Constructor
+SimELM3704Device::SimELM3704Device()
+{
+    for (unsigned int channel=0; channel<numChannels; channel++)
+    {
+        for (int setting=0; setting<numSettings; setting++)
+        {
+            settings[channel][setting] = 0;
+        }
+    }
+}
+
+
+/* Check the value against the current interface, or for the interface itself
+ * that it is a known one. Changing to another kind of measurement resets the
+ * sub-settings which depend on it, and a scaler the new kind does not offer.
+*/
+void SimELM3704Device::write(unsigned int channel, Setting setting, epicsInt32 value)
+{
+    if (channel >= numChannels || setting < Interface || setting >= numSettings)
+    {
+        throw std::runtime_error("no such setting");
+    }
+    epicsInt32 *channelSettings = settings[channel];
+
+    if (setting == Interface)
+    {
+        Family family = familyOf(value);
+        bool familyChanged = family != familyOf(channelSettings[Interface]);
+        channelSettings[Interface] = value;
+        if (familyChanged)
+        {
+            channelSettings[SensorSupply] = defaultValue(family, SensorSupply);
+            channelSettings[RTDElement] = defaultValue(family, RTDElement);
+            channelSettings[TCElement] = defaultValue(family, TCElement);
+        }
+        if (!isValid(family, Scaler, channelSettings[Scaler]))
+        {
+            channelSettings[Scaler] = defaultValue(family, Scaler);
+        }
+        return;
+    }
+
+    if (!isValid(familyOf(channelSettings[Interface]), setting, value))
+    {
+        throw std::runtime_error(
+            std::string(settingNames[setting]) + " " + std::to_string(value) +
+            " out of range for interface " + std::to_string(channelSettings[Interface])
+        );
+    }
+    channelSettings[setting] = value;
+}
+
+
+// Current value of a setting
+epicsInt32 SimELM3704Device::get(unsigned int channel, Setting setting) const
+{
+    return settings[channel][setting];
+}
+
+
+// Kind of measurement of an interface value
+SimELM3704Device::Family SimELM3704Device::familyOf(epicsInt32 interface)
+{
+    typedef ELM3704Properties P;
+    if (interface == 0) return Off;
+    if (contains(P::voltageValues, P::numVoltageOptions, interface)) return Voltage;
+    if (contains(P::currentValues, P::numCurrentOptions, interface)) return Current;
+    if (contains(P::potValues, P::numPotOptions, interface)) return Potentiometer;
+    if (contains(P::TCValues, P::numTCOptions, interface)) return Thermocouple;
+    if (contains(P::IEPEValues, P::numIEPEOptions, interface)) return IEPE;
+    if (contains(P::StrainGaugeFBValues, P::numStrainGaugeFBOptions, interface) ||
+        contains(P::StrainGaugeHBValues, P::numStrainGaugeHBOptions, interface) ||
+        contains(P::StrainGaugeQB2WValues, P::numStrainGaugeQB2WOptions, interface) ||
+        contains(P::StrainGaugeQB3WValues, P::numStrainGaugeQB3WOptions, interface)) return StrainGauge;
+    if (contains(P::RTDValues, P::numRTDOptions, interface)) return RTD;
+    throw std::runtime_error("Interface " + std::to_string(interface) + " out of range");
+}
+
+
+/* Sub-settings a kind of measurement does not use only accept 0. The TC element
+ * is accepted for all thermocouple interfaces, as the driver sets it before
+ * changing from 80mV to a CJC interface.
+*/
+bool SimELM3704Device::isValid(Family family, Setting setting, epicsInt32 value)
+{
+    typedef ELM3704Properties P;
+    switch (setting)
+    {
+        case SensorSupply:
+            if (family == StrainGauge) return contains(P::SGSensorSupplyValues, P::numSGSensorSupplyOptions, value);
+            if (family == IEPE) return contains(P::IEPESensorSupplyValues, P::numIEPESensorSupplyOptions, value);
+            return value == 0;
+        case RTDElement:
+            if (family == RTD)
+            {
+                return contains(P::RTDElementFirstPageValues, P::numRTDElementFirstPageOptions, value) ||
+                       contains(P::RTDElementSecondPageValues, P::numRTDElementSecondPageOptions, value) ||
+                       contains(P::RTDElementThirdPageValues, P::numRTDElementThirdPageOptions, value);
+            }
+            return value == 0;
+        case TCElement:
+            if (family == Thermocouple)
+            {
+                return value == 0 ||
+                       contains(P::TCElementFirstPageValues, P::numTCElementFirstPageOptions, value) ||
+                       contains(P::TCElementSecondPageValues, P::numTCElementSecondPageOptions, value);
+            }
+            return value == 0;
+        case Scaler:
+            if (family == Thermocouple) return contains(P::TCScalerValues, P::numTCScalerOptions, value);
+            return contains(P::DefaultScalerValues, P::numDefaultScalerOptions, value);
+        default:
+            return false;
+    }
+}
+
+
+// Value a sub-setting takes after changing to a kind of measurement
+epicsInt32 SimELM3704Device::defaultValue(Family family, Setting setting)
+{
+    typedef ELM3704Properties P;
+    switch (setting)
+    {
+        case SensorSupply:
+            // Strain gauges and IEPE sensors start with the supply under local control
+            return family == StrainGauge || family == IEPE ? P::IEPESensorSupplyValues[0] : 0;
+        case RTDElement:
+            return family == RTD ? P::RTDElementFirstPageValues[1] : 0;
+        case TCElement:
+            return family == Thermocouple ? P::TCElementFirstPageValues[0] : 0;
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * SimELM3704Device.h
+ *
+ * Class modelling the channel settings of an ELM3704 as the simulated SDO port
+ * sees them. Like the real module it rejects values which are not valid for the
+ * channel's interface, and when the interface changes to a different kind of
+ * measurement it resets the sensor supply, RTD element and TC element and
+ * restricts the scaler. The valid values come from ELM3704Properties.
+ *
+*/
+
+#ifndef SIMELM3704DEVICE_H
+#define SIMELM3704DEVICE_H
+
+#include <epicsTypes.h>
+
+
+class SimELM3704Device
+{
+
+public:
+    // Settings of each channel, in the order of the simulated parameters
+    enum Setting
+    {
+        Interface,
+        SensorSupply,
+        RTDElement,
+        TCElement,
+        Scaler,
+        numSettings
+    };
+
+    // Constructor, all channels off
+    SimELM3704Device();
+
+    // Write a setting, applying any side effects to the other settings of the channel.
+    // Throws std::runtime_error for a value the channel does not accept.
+    void write(unsigned int channel, Setting setting, epicsInt32 value);
+
+    // Current value of a setting
+    epicsInt32 get(unsigned int channel, Setting setting) const;
+
+private:
+    // Kinds of measurement, which decide the valid sub-settings
+    enum Family
+    {
+        Off,
+        Voltage,
+        Current,
+        Potentiometer,
+        Thermocouple,
+        IEPE,
+        StrainGauge,
+        RTD
+    };
+
+    // Kind of measurement of an interface value, throwing if there is none
+    static Family familyOf(epicsInt32 interface);
+
+    // Whether a sub-setting value is valid for a kind of measurement
+    static bool isValid(Family family, Setting setting, epicsInt32 value);
+
+    // Value a sub-setting takes after changing to a kind of measurement
+    static epicsInt32 defaultValue(Family family, Setting setting);
+
+    // Attributes
+    static const unsigned int numChannels = 4;
+    epicsInt32 settings[numChannels][numSettings];
+
+};
+
+#endif /* SIMELM3704DEVICE_H */
@@ -0,0 +1,115 @@
+#include "SimFault.h"
+
+#include <stdio.h>
+
+#include <stdexcept>
+
+
+// Names of the kinds of fault, in the order of SimFault::Kind
+static const char *faultNames[] = { "drop", "stuck", "error", "readerror", "disconnect", "clamp" };
+
+
+// Constructor
+SimFault::SimFault(Kind kind, double probability, int every, int count, double argument) :
+    kind(kind),
+    probability(probability),
+    every(every),
+    count(count),
+    argument(argument),
+    requests(0),
+    injected(0)
+{
+}
+
+
+// Create a fault from its name, checking it can trigger
+SimFault SimFault::fromName(const std::string &name, double probability, int every, int count, double argument)
+{
+    for (unsigned int kind=0; kind<sizeof(faultNames)/sizeof(faultNames[0]); kind++)
+    {
+        if (name != faultNames[kind])
+        {
+            continue;
+        }
+        if (every <= 0 && (probability <= 0.0 || probability > 1.0))
+        {
+            throw std::runtime_error("fault needs a schedule (every > 0) or a probability in (0, 1]");
+        }
+        if (count < 0 || argument < 0.0)
+        {
+            throw std::runtime_error("fault count and argument must not be negative");
+        }
+        if (kind == Disconnect && argument <= 0.0)
+        {
+            throw std::runtime_error("disconnect needs a duration above 0");
+        }
+        return SimFault((Kind) kind, probability, every, count, argument);
+    }
+    throw std::runtime_error("unknown fault " + name + " (drop, stuck, error, readerror, disconnect or clamp)");
+}
+
+
+/* A schedule hits every Nth request, otherwise the probability is drawn for each
+ * request. A fault with a count stops once it has been injected that many times.
+*/
+bool SimFault::trigger(std::mt19937 &generator)
+{
+    requests++;
+    if (count > 0 && injected >= count)
+    {
+        return false;
+    }
+    bool hit;
+    if (every > 0)
+    {
+        hit = requests % every == 0;
+    }
+    else
+    {
+        hit = std::uniform_real_distribution<double>(0.0, 1.0)(generator) < probability;
+    }
+    if (hit)
+    {
+        injected++;
+    }
+    return hit;
+}
+
+
+// Whether the fault applies to reads rather than writes
+bool SimFault::appliesToReads() const
+{
+    return kind == ReadError;
+}
+
+
+SimFault::Kind SimFault::getKind() const
+{
+    return kind;
+}
+
+
+double SimFault::getArgument() const
+{
+    return argument;
+}
+
+
+// Description for reports
+std::string SimFault::describe() const
+{
+    char trigger[40];
+    if (every > 0)
+    {
+        snprintf(trigger, sizeof(trigger), "every %d", every);
+    }
+    else
+    {
+        snprintf(trigger, sizeof(trigger), "probability %g", probability);
+    }
+    char text[120];
+    snprintf(text, sizeof(text), "%s %g, %s %s, injected %d%s",
+             faultNames[kind], argument, trigger, appliesToReads() ? "reads" : "writes",
+             injected, count > 0 && injected >= count ? " (done)" : "");
+    return text;
+}
@@ -0,0 +1,65 @@
+/*
+ * SimFault.h
+ *
+ * Class describing a fault the simulated SDO port injects into requests, and
+ * when: at random with a probability, or on a schedule of every Nth request.
+ * Either way a fault can be limited to a number of injections.
+ *
+*/
+
+#ifndef SIMFAULT_H
+#define SIMFAULT_H
+
+#include <random>
+#include <string>
+
+
+class SimFault
+{
+
+public:
+    // Kinds of fault, with the meaning of their argument
+    enum Kind
+    {
+        DropWrite,      // the write succeeds but is lost
+        StuckReadback,  // the readback ignores writes for argument seconds (0 until cleared)
+        WriteError,     // the write fails with asynError
+        ReadError,      // a read fails with asynError
+        Disconnect,     // the port disconnects for argument seconds
+        Clamp,          // the value argument is stored instead of the one written
+    };
+
+    // Constructor
+    SimFault(Kind kind, double probability, int every, int count, double argument);
+
+    // Create a fault from its name (drop, stuck, error, readerror, disconnect or clamp).
+    // Throws std::runtime_error for an unknown name or a fault which can never trigger.
+    static SimFault fromName(const std::string &name, double probability, int every, int count, double argument);
+
+    // Count a request and decide whether the fault hits it
+    bool trigger(std::mt19937 &generator);
+
+    // Whether the fault applies to reads rather than writes
+    bool appliesToReads() const;
+
+    Kind getKind() const;
+    double getArgument() const;
+
+    // Description for reports, e.g. "drop, every 10th write, injected 3"
+    std::string describe() const;
+
+private:
+    // Attributes
+    Kind kind;
+    double probability;
+    int every;
+    int count;
+    double argument;
+
+    // Requests seen and faults injected
+    int requests;
+    int injected;
+
+};
+
+#endif /* SIMFAULT_H */
@@ -0,0 +1,103 @@
+#include "SimLatencyModel.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <stdexcept>
+
+
+// Constructor
+SimLatencyModel::SimLatencyModel(Kind kind, double a, double b) :
+    kind(kind),
+    a(a),
+    b(b)
+{
+}
+
+
+// Create a model from its name, checking the parameters make sense for it
+SimLatencyModel SimLatencyModel::fromName(const std::string &name, double a, double b)
+{
+    if (name == "zero" || name == "none")
+    {
+        return SimLatencyModel(Zero);
+    }
+    if (a < 0.0 || b < 0.0)
+    {
+        throw std::runtime_error("latency parameters must not be negative");
+    }
+    if (name == "fixed")
+    {
+        return SimLatencyModel(Fixed, a);
+    }
+    if (name == "uniform")
+    {
+        if (b < a)
+        {
+            throw std::runtime_error("uniform latency needs a <= b");
+        }
+        return SimLatencyModel(Uniform, a, b);
+    }
+    if (name == "normal")
+    {
+        if (b <= 0.0)
+        {
+            throw std::runtime_error("normal latency needs a standard deviation above 0");
+        }
+        return SimLatencyModel(Normal, a, b);
+    }
+    if (name == "longtail")
+    {
+        if (a <= 0.0 || b <= 0.0)
+        {
+            throw std::runtime_error("long-tailed latency needs a median and shape above 0");
+        }
+        return SimLatencyModel(LongTail, a, b);
+    }
+    throw std::runtime_error("unknown latency model " + name + " (zero, fixed, uniform, normal or longtail)");
+}
+
+
+// Draw a delay in seconds
+double SimLatencyModel::sample(std::mt19937 &generator) const
+{
+    switch (kind)
+    {
+        case Fixed:
+            return a;
+        case Uniform:
+            return std::uniform_real_distribution<double>(a, b)(generator);
+        case Normal:
+            return fmax(std::normal_distribution<double>(a, b)(generator), 0.0);
+        case LongTail:
+            return std::lognormal_distribution<double>(log(a), b)(generator);
+        default:
+            return 0.0;
+    }
+}
+
+
+// Description for reports
+std::string SimLatencyModel::describe() const
+{
+    char text[80];
+    switch (kind)
+    {
+        case Fixed:
+            snprintf(text, sizeof(text), "fixed %g s", a);
+            break;
+        case Uniform:
+            snprintf(text, sizeof(text), "uniform %g-%g s", a, b);
+            break;
+        case Normal:
+            snprintf(text, sizeof(text), "normal %g s, sigma %g s", a, b);
+            break;
+        case LongTail:
+            snprintf(text, sizeof(text), "long tail, median %g s, shape %g", a, b);
+            break;
+        default:
+            snprintf(text, sizeof(text), "zero");
+            break;
+    }
+    return text;
+}
@@ -0,0 +1,53 @@
+/*
+ * SimLatencyModel.h
+ *
+ * Class for drawing simulated delays, e.g. how long an SDO write takes or how
+ * long until its readback changes. A model is zero, fixed, uniform, normal or
+ * long-tailed (log-normal, so most delays are near the median but a few are
+ * many times longer).
+ *
+*/
+
+#ifndef SIMLATENCYMODEL_H
+#define SIMLATENCYMODEL_H
+
+#include <random>
+#include <string>
+
+
+class SimLatencyModel
+{
+
+public:
+    // Kinds of model, with the meaning of their two parameters in seconds
+    enum Kind
+    {
+        Zero,       // no delay
+        Fixed,      // a
+        Uniform,    // between a and b
+        Normal,     // mean a, standard deviation b, never negative
+        LongTail,   // log-normal with median a and shape b
+    };
+
+    // Constructor
+    SimLatencyModel(Kind kind = Zero, double a = 0.0, double b = 0.0);
+
+    // Create a model from its name (zero, fixed, uniform, normal or longtail).
+    // Throws std::runtime_error for an unknown name or invalid parameters.
+    static SimLatencyModel fromName(const std::string &name, double a, double b);
+
+    // Draw a delay in seconds
+    double sample(std::mt19937 &generator) const;
+
+    // Description for reports, e.g. "uniform 0.1-0.5 s"
+    std::string describe() const;
+
+private:
+    // Attributes
+    Kind kind;
+    double a;
+    double b;
+
+};
+
+#endif /* SIMLATENCYMODEL_H */
@@ -0,0 +1,94 @@
+#include "SimMailbox.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+
+// Mailboxes by name, created from iocsh before the IOC starts
+static std::map<std::string, std::unique_ptr<SimMailbox> > mailboxes;
+
+
+// Constructor
+SimMailbox::SimMailbox(const std::string &name, double serviceTime) :
+    name(name),
+    serviceTime(serviceTime > 0.0 ? serviceTime : 0.0),
+    clock(Clock::get()),
+    busy(false),
+    transfers(0),
+    maxQueued(0),
+    totalWait(0.0),
+    maxWait(0.0)
+{
+}
+
+
+// Create a mailbox which can be found by name
+SimMailbox *SimMailbox::create(const std::string &name, double serviceTime)
+{
+    std::unique_ptr<SimMailbox> &mailbox = mailboxes[name];
+    if (mailbox)
+    {
+        throw std::runtime_error("mailbox " + name + " already exists");
+    }
+    mailbox.reset(new SimMailbox(name, serviceTime));
+    return mailbox.get();
+}
+
+
+// The mailbox of a name, or NULL
+SimMailbox *SimMailbox::find(const std::string &name)
+{
+    std::map<std::string, std::unique_ptr<SimMailbox> >::iterator it = mailboxes.find(name);
+    return it == mailboxes.end() ? NULL : it->second.get();
+}
+
+
+/* Queue behind the transfers holding or waiting for the mailbox, then hold it
+ * for the service time and hand it to the next in the queue.
+*/
+double SimMailbox::transfer()
+{
+    double start = clock.now();
+    std::unique_lock<std::mutex> guard(mutex);
+    maxQueued = std::max(maxQueued, (unsigned long) (busy ? 1 : 0) + queued.size() + 1);
+    if (busy)
+    {
+        epicsEvent served;
+        queued.push_back(&served);
+        guard.unlock();
+        clock.wait(served, -1.0);
+        guard.lock();
+    }
+    busy = true;
+    double wait = clock.now() - start;
+    guard.unlock();
+
+    clock.sleep(serviceTime);
+
+    guard.lock();
+    transfers++;
+    totalWait += wait;
+    maxWait = wait > maxWait ? wait : maxWait;
+    if (queued.empty())
+    {
+        busy = false;
+    }
+    else
+    {
+        clock.signal(*queued.front());
+        queued.pop_front();
+    }
+    return wait;
+}
+
+
+// Print the transfer counts and queueing times
+void SimMailbox::report(FILE *fp) const
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    fprintf(fp, "  Mailbox %s: service time %g s, %lu transfers, %lu queued now, at most %lu, wait mean %g s, max %g s\n",
+            name.c_str(), serviceTime, transfers, (unsigned long) (busy ? 1 : 0) + queued.size(), maxQueued,
+            transfers ? totalWait / transfers : 0.0, maxWait);
+}
@@ -0,0 +1,68 @@
+/*
+ * SimMailbox.h
+ *
+ * Class simulating the mailbox path of an EtherCAT master, shared by all of the
+ * simulated slaves on it. SDO transfers are served one at a time in the order
+ * they arrive, each taking the service time, so slaves configured together
+ * queue behind each other as they do on a real master.
+ *
+*/
+
+#ifndef SIMMAILBOX_H
+#define SIMMAILBOX_H
+
+#include <deque>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+
+#include <epicsEvent.h>
+
+#include "Clock.h"
+
+
+class SimMailbox
+{
+
+public:
+    // Constructor, with the time each transfer takes in seconds
+    SimMailbox(const std::string &name, double serviceTime);
+
+    // Create a mailbox which can be found by name. Throws std::runtime_error if
+    // the name is taken.
+    static SimMailbox *create(const std::string &name, double serviceTime);
+
+    // The mailbox of a name, or NULL
+    static SimMailbox *find(const std::string &name);
+
+    // Wait for the turn of this transfer and hold the mailbox for the service time.
+    // Returns the time spent queueing in seconds.
+    double transfer();
+
+    // Print the transfer counts and queueing times
+    void report(FILE *fp) const;
+
+    const std::string &getName() const { return name; }
+
+private:
+    // Attributes
+    std::string name;
+    double serviceTime;
+    Clock &clock;
+
+    // Whether a transfer holds the mailbox, and the events of those queued behind
+    // it in order. The mailbox is handed on through the clock, so a virtual one
+    // counts the queued transfers as blocked.
+    mutable std::mutex mutex;
+    bool busy;
+    std::deque<epicsEvent *> queued;
+
+    // Statistics
+    unsigned long transfers;
+    unsigned long maxQueued;
+    double totalWait;
+    double maxWait;
+
+};
+
+#endif /* SIMMAILBOX_H */
@@ -0,0 +1,126 @@
+#include "SimSignal.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+
+// Names of the shapes, in the order of SimSignal::Shape
+static const char *shapeNames[] = { "constant", "sine", "noise", "step", "ramp", "file" };
+
+
+// Constructor
+SimSignal::SimSignal(Shape shape, double amplitude, double offset, double frequency, double noise) :
+    shape(shape),
+    amplitude(amplitude),
+    offset(offset),
+    frequency(frequency),
+    noise(noise)
+{
+}
+
+
+// Create a signal from the name of its shape
+SimSignal SimSignal::fromName(const std::string &name, double amplitude, double offset, double frequency, double noise)
+{
+    for (unsigned int shape=Constant; shape<File; shape++)
+    {
+        if (name == shapeNames[shape])
+        {
+            if (frequency < 0.0 || noise < 0.0)
+            {
+                throw std::runtime_error("frequency and noise must not be negative");
+            }
+            return SimSignal((Shape) shape, amplitude, offset, frequency, noise);
+        }
+    }
+    throw std::runtime_error("unknown signal " + name + " (constant, sine, noise, step or ramp)");
+}
+
+
+// Read the values of a file signal
+SimSignal SimSignal::fromFile(const std::string &fileName, double noise)
+{
+    std::ifstream file(fileName.c_str());
+    if (!file)
+    {
+        throw std::runtime_error("cannot open " + fileName);
+    }
+    SimSignal signal(File, 0.0, 0.0, 0.0, noise);
+    signal.fileName = fileName;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream words(line.substr(0, line.find('#')));
+        double point;
+        while (words >> point)
+        {
+            signal.points.push_back(point);
+        }
+        if (!words.eof())
+        {
+            throw std::runtime_error("not a number in " + fileName + ": " + line);
+        }
+    }
+    if (signal.points.empty())
+    {
+        throw std::runtime_error("no values in " + fileName);
+    }
+    return signal;
+}
+
+
+/* The waveform is computed from the sample number rather than the time it is
+ * generated, so it has no jitter and repeats exactly from run to run.
+*/
+double SimSignal::value(unsigned long long sample, double samplePeriod, std::mt19937 &generator) const
+{
+    double phase = fmod(sample * samplePeriod * frequency, 1.0);
+    double result;
+    switch (shape)
+    {
+        case Sine:
+            result = offset + amplitude * sin(2.0 * M_PI * phase);
+            break;
+        case Noise:
+            result = offset + std::normal_distribution<double>(0.0, amplitude)(generator);
+            break;
+        case Step:
+            result = offset + (phase < 0.5 ? amplitude : -amplitude);
+            break;
+        case Ramp:
+            result = offset + amplitude * (2.0 * phase - 1.0);
+            break;
+        case File:
+            result = points[sample % points.size()];
+            break;
+        default:
+            result = offset;
+            break;
+    }
+    if (noise > 0.0)
+    {
+        result += std::normal_distribution<double>(0.0, noise)(generator);
+    }
+    return result;
+}
+
+
+// Description for reports
+std::string SimSignal::describe() const
+{
+    char text[200];
+    if (shape == File)
+    {
+        snprintf(text, sizeof(text), "file %s (%d values), noise %g", fileName.c_str(), (int) points.size(), noise);
+    }
+    else
+    {
+        snprintf(text, sizeof(text), "%s %g Hz, amplitude %g, offset %g, noise %g",
+                 shapeNames[shape], frequency, amplitude, offset, noise);
+    }
+    return text;
+}
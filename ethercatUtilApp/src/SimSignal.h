@@ -0,0 +1,63 @@
+/*
+ * SimSignal.h
+ *
+ * Class generating the raw samples of a simulated analog input channel: a
+ * constant, sine, noise, step (square wave) or ramp (sawtooth), or a list of
+ * values read from a file and played in a loop. Gaussian noise can be added to
+ * any of them.
+ *
+*/
+
+#ifndef SIMSIGNAL_H
+#define SIMSIGNAL_H
+
+#include <random>
+#include <string>
+#include <vector>
+
+
+class SimSignal
+{
+
+public:
+    // Shapes of signal
+    enum Shape
+    {
+        Constant,   // offset
+        Sine,       // offset + amplitude * sin
+        Noise,      // offset + gaussian noise with sigma amplitude
+        Step,       // offset +/- amplitude, changing every half period
+        Ramp,       // offset - amplitude to offset + amplitude every period
+        File,       // values from a file, one per sample
+    };
+
+    // Constructor, amplitude and offset in raw counts and frequency in Hz
+    SimSignal(Shape shape = Constant, double amplitude = 0.0, double offset = 0.0, double frequency = 0.0, double noise = 0.0);
+
+    // Create a signal from the name of its shape (constant, sine, noise, step or ramp).
+    // Throws std::runtime_error for an unknown name.
+    static SimSignal fromName(const std::string &name, double amplitude, double offset, double frequency, double noise);
+
+    // Create a signal playing the values in a file, separated by white space
+    // with # comments. Throws std::runtime_error if there are none.
+    static SimSignal fromFile(const std::string &fileName, double noise);
+
+    // Value of a sample, numbered from 0, with the time between samples in seconds
+    double value(unsigned long long sample, double samplePeriod, std::mt19937 &generator) const;
+
+    // Description for reports, e.g. "sine 1000 Hz amplitude 1e+06"
+    std::string describe() const;
+
+private:
+    // Attributes
+    Shape shape;
+    double amplitude;
+    double offset;
+    double frequency;
+    double noise;
+    std::string fileName;
+    std::vector<double> points;
+
+};
+
+#endif /* SIMSIGNAL_H */
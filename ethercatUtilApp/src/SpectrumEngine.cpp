@@ -0,0 +1,234 @@
+#include "SpectrumEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+
+// Check for a power of two
+static bool isPowerOfTwo(size_t n)
+{
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+
+/* FFTPlan */
+
+// Constructor
+FFTPlan::FFTPlan(size_t size) :
+    n(size),
+    twiddles(size / 2),
+    bitReverse(size)
+{
+    if (!isPowerOfTwo(size))
+    {
+        throw std::runtime_error("FFT size " + std::to_string(size) + " is not a power of two");
+    }
+
+    // Twiddle factors exp(-2 pi i k / n)
+    for (size_t k=0; k<n/2; k++)
+    {
+        double angle = -2.0 * M_PI * k / n;
+        twiddles[k] = std::complex<double>(std::cos(angle), std::sin(angle));
+    }
+
+    // Bit reversed index of each element
+    unsigned int bits = 0;
+    while (((size_t) 1 << bits) < n) bits++;
+    for (size_t i=0; i<n; i++)
+    {
+        size_t reversed = 0;
+        for (unsigned int b=0; b<bits; b++)
+        {
+            if (i & ((size_t) 1 << b)) reversed |= (size_t) 1 << (bits - 1 - b);
+        }
+        bitReverse[i] = reversed;
+    }
+}
+
+
+// Iterative radix-2 decimation in time transform
+void FFTPlan::forward(std::complex<double> *data) const
+{
+    for (size_t i=0; i<n; i++)
+    {
+        if (i < bitReverse[i]) std::swap(data[i], data[bitReverse[i]]);
+    }
+
+    for (size_t length=2; length<=n; length<<=1)
+    {
+        size_t half = length / 2;
+        size_t step = n / length;
+        for (size_t start=0; start<n; start+=length)
+        {
+            for (size_t j=0; j<half; j++)
+            {
+                std::complex<double> t = twiddles[j * step] * data[start + j + half];
+                data[start + j + half] = data[start + j] - t;
+                data[start + j] += t;
+            }
+        }
+    }
+}
+
+
+// Plans are shared between all channels using the same size
+std::shared_ptr<const FFTPlan> FFTPlan::get(size_t size)
+{
+    static std::mutex cacheMutex;
+    static std::map<size_t, std::shared_ptr<const FFTPlan> > cache;
+
+    std::lock_guard<std::mutex> guard(cacheMutex);
+    std::shared_ptr<const FFTPlan> &plan = cache[size];
+    if (!plan)
+    {
+        plan = std::make_shared<const FFTPlan>(size);
+    }
+    return plan;
+}
+
+
+/* SpectrumEngine */
+
+// Constructor
+SpectrumEngine::SpectrumEngine(size_t frameSize, unsigned int averages) :
+    frameSize(frameSize),
+    averages(averages > 0 ? averages : 1),
+    window(frameSize),
+    windowSum(0.0),
+    windowSquareSum(0.0),
+    frame(frameSize, 0.0),
+    frameFill(0),
+    buffer(frameSize / 2),
+    powerSum(frameSize / 2 + 1, 0.0),
+    framesAveraged(0),
+    power(frameSize / 2 + 1, 0.0),
+    amplitude(frameSize / 2 + 1, 0.0)
+{
+    if (frameSize < 4 || !isPowerOfTwo(frameSize))
+    {
+        throw std::runtime_error("spectrum size " + std::to_string(frameSize) + " is not a power of two >= 4");
+    }
+
+    // A real transform of size N is done as a complex transform of size N/2
+    plan = FFTPlan::get(frameSize / 2);
+    splitTwiddles.resize(frameSize / 2 + 1);
+    for (size_t k=0; k<=frameSize/2; k++)
+    {
+        double angle = -2.0 * M_PI * k / frameSize;
+        splitTwiddles[k] = std::complex<double>(std::cos(angle), std::sin(angle));
+    }
+
+    // Periodic Hann window
+    for (size_t i=0; i<frameSize; i++)
+    {
+        window[i] = 0.5 - 0.5 * std::cos(2.0 * M_PI * i / frameSize);
+        windowSum += window[i];
+        windowSquareSum += window[i] * window[i];
+    }
+}
+
+
+// Append samples, transforming every time half a frame of new data is available
+bool SpectrumEngine::addSamples(const double *samples, size_t n)
+{
+    bool ready = false;
+    size_t used = 0;
+    while (used < n)
+    {
+        size_t count = std::min(n - used, frameSize - frameFill);
+        std::copy(samples + used, samples + used + count, frame.begin() + frameFill);
+        frameFill += count;
+        used += count;
+
+        if (frameFill == frameSize)
+        {
+            processFrame();
+            if (++framesAveraged == averages)
+            {
+                // Publish the average and start a new one
+                for (size_t k=0; k<power.size(); k++)
+                {
+                    power[k] = powerSum[k] / averages;
+                    amplitude[k] = std::sqrt(power[k]) * 2.0 / windowSum;
+                }
+                amplitude[0] /= 2.0;
+                amplitude[frameSize / 2] /= 2.0;
+                std::fill(powerSum.begin(), powerSum.end(), 0.0);
+                framesAveraged = 0;
+                ready = true;
+            }
+
+            // Keep the second half for 50% overlap with the next frame
+            std::copy(frame.begin() + frameSize / 2, frame.end(), frame.begin());
+            frameFill = frameSize / 2;
+        }
+    }
+    return ready;
+}
+
+
+// Windowed real FFT of the current frame, accumulating |X_k|^2
+void SpectrumEngine::processFrame()
+{
+    const size_t half = frameSize / 2;
+
+    // Pack even samples into the real part and odd samples into the imaginary part
+    for (size_t i=0; i<half; i++)
+    {
+        buffer[i] = std::complex<double>(frame[2*i] * window[2*i], frame[2*i + 1] * window[2*i + 1]);
+    }
+    plan->forward(buffer.data());
+
+    // Separate the transforms of the even and odd samples and combine them
+    for (size_t k=0; k<=half; k++)
+    {
+        std::complex<double> zk = buffer[k % half];
+        std::complex<double> zmk = std::conj(buffer[(half - k) % half]);
+        std::complex<double> even = 0.5 * (zk + zmk);
+        std::complex<double> odd = std::complex<double>(0.0, -0.5) * (zk - zmk);
+        powerSum[k] += std::norm(even + splitTwiddles[k] * odd);
+    }
+}
+
+
+// Sum the power of the bins inside the band, corrected for the window
+double SpectrumEngine::bandPower(double lowHz, double highHz, double sampleRate) const
+{
+    if (sampleRate <= 0.0) return 0.0;
+    const double binWidth = sampleRate / frameSize;
+    double sum = 0.0;
+    for (size_t k=0; k<power.size(); k++)
+    {
+        double frequency = k * binWidth;
+        if (frequency < lowHz || frequency > highHz) continue;
+        // DC and Nyquist bins are not mirrored in the negative frequencies
+        double factor = (k == 0 || k == frameSize / 2) ? 1.0 : 2.0;
+        sum += factor * power[k];
+    }
+    return sum / (frameSize * windowSquareSum);
+}
+
+
+// Centre frequency of each bin
+std::vector<double> SpectrumEngine::binFrequencies(double sampleRate) const
+{
+    std::vector<double> frequencies(frameSize / 2 + 1);
+    for (size_t k=0; k<frequencies.size(); k++)
+    {
+        frequencies[k] = k * sampleRate / frameSize;
+    }
+    return frequencies;
+}
+
+
+// Start again with an empty frame
+void SpectrumEngine::reset()
+{
+    frameFill = 0;
+    framesAveraged = 0;
+    std::fill(powerSum.begin(), powerSum.end(), 0.0);
+}
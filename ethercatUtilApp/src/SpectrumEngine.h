@@ -0,0 +1,96 @@
+/*
+ * SpectrumEngine.h
+ *
+ * Classes for computing averaged amplitude spectra of a continuous stream of
+ * samples (e.g. vibration measurements from IEPE sensors).
+ *
+*/
+
+#ifndef SPECTRUMENGINE_H
+#define SPECTRUMENGINE_H
+
+#include <complex>
+#include <memory>
+#include <vector>
+#include <stddef.h>
+
+
+// Precomputed tables for a radix-2 complex FFT of a fixed size
+class FFTPlan
+{
+public:
+    // Constructor (size must be a power of two)
+    FFTPlan(size_t size);
+
+    // In-place forward transform of size() complex values
+    void forward(std::complex<double> *data) const;
+
+    size_t size() const { return n; }
+
+    // Shared plan for a size, created on first use
+    static std::shared_ptr<const FFTPlan> get(size_t size);
+
+private:
+    size_t n;
+    std::vector<std::complex<double> > twiddles;
+    std::vector<size_t> bitReverse;
+};
+
+
+// Windowed, averaged spectrum of a real valued stream
+class SpectrumEngine
+{
+public:
+    // Constructor (frameSize must be a power of two, at least 4)
+    SpectrumEngine(size_t frameSize, unsigned int averages);
+
+    // Add samples to the stream. Returns true when a new averaged spectrum is ready.
+    bool addSamples(const double *samples, size_t n);
+
+    // Single-sided peak amplitude per bin (frameSize/2 + 1 values) of the last average
+    const std::vector<double> &amplitudeSpectrum() const { return amplitude; }
+
+    // Mean square of the signal between two frequencies of the last average
+    double bandPower(double lowHz, double highHz, double sampleRate) const;
+
+    // Frequency of each bin for a given sample rate
+    std::vector<double> binFrequencies(double sampleRate) const;
+
+    // Discard partial frames and averages
+    void reset();
+
+    size_t getFrameSize() const { return frameSize; }
+    unsigned int getAverages() const { return averages; }
+
+private:
+    // Transform the current frame and add it to the running average
+    void processFrame();
+
+    // Attributes
+    size_t frameSize;
+    unsigned int averages;
+
+    // Half size complex plan plus the twiddles to split it into a real transform
+    std::shared_ptr<const FFTPlan> plan;
+    std::vector<std::complex<double> > splitTwiddles;
+
+    // Hann window and its normalisation factors
+    std::vector<double> window;
+    double windowSum;
+    double windowSquareSum;
+
+    // Frames overlap by 50%, so the newest frameSize samples are kept
+    std::vector<double> frame;
+    size_t frameFill;
+
+    // Working buffer and averaged power per bin
+    std::vector<std::complex<double> > buffer;
+    std::vector<double> powerSum;
+    unsigned int framesAveraged;
+
+    // Last completed average
+    std::vector<double> power;
+    std::vector<double> amplitude;
+};
+
+#endif /* SPECTRUMENGINE_H */
@@ -0,0 +1,87 @@
+/* decimationFilterBench.cpp
+ *
+ * Measures the throughput of the decimation filters in samples per second on
+ * a single core for typical ELM3704 oversampling and decimation ratios.
+ *
+ * Usage: decimationFilterBench [seconds per case]
+*/
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "DecimationFilter.h"
+
+
+// Feed cycles of blockSize samples through the pipeline for the given time
+static double samplesPerSecond(DecimationPipeline &pipeline, unsigned int blockSize, double seconds)
+{
+    // Noisy sine wave at typical ADC amplitude
+    std::vector<double> input(blockSize * 64);
+    for (size_t i=0; i<input.size(); i++)
+    {
+        input[i] = std::round(1e6 * std::sin(i * 0.01) + (rand() % 1000));
+    }
+    std::vector<double> output;
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0.0;
+    unsigned long long samples = 0;
+    size_t offset = 0;
+    while (elapsed < seconds)
+    {
+        // Check the clock every 1024 blocks
+        for (unsigned int block=0; block<1024; block++)
+        {
+            pipeline.process(&input[offset], blockSize, output);
+            offset = (offset + blockSize) % input.size();
+        }
+        samples += 1024ULL * blockSize;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return samples / elapsed;
+}
+
+
+int main(int argc, char *argv[])
+{
+    double seconds = (argc > 1) ? atof(argv[1]) : 1.0;
+
+    static const unsigned int blockSizes[] = { 1, 10, 100 };
+    static const unsigned int ratios[] = { 10, 100, 1000 };
+
+    printf("%-12s %-10s %-10s %-8s %15s\n", "filter", "block", "ratio", "taps", "samples/s");
+    for (unsigned int b=0; b<sizeof(blockSizes)/sizeof(blockSizes[0]); b++)
+    {
+        for (unsigned int r=0; r<sizeof(ratios)/sizeof(ratios[0]); r++)
+        {
+            unsigned int blockSize = blockSizes[b];
+            unsigned int ratio = ratios[r];
+
+            // CIC on its own
+            DecimationPipeline cic;
+            cic.addStage(new CICDecimator(ratio, CICDecimator::maxOrder(ratio) < 4 ? CICDecimator::maxOrder(ratio) : 4));
+            printf("%-12s %-10u %-10u %-8s %15.4g\n", "CIC", blockSize, ratio, "-",
+                   samplesPerSecond(cic, blockSize, seconds));
+
+            // FIR on its own with the default low pass
+            std::vector<double> taps = FIRDecimator::designLowPass(ratio);
+            DecimationPipeline fir;
+            fir.addStage(new FIRDecimator(ratio, taps));
+            printf("%-12s %-10u %-10u %-8zu %15.4g\n", "FIR", blockSize, ratio, taps.size(),
+                   samplesPerSecond(fir, blockSize, seconds));
+
+            // CIC doing most of the decimation followed by a short compensating FIR
+            std::vector<double> shortTaps = FIRDecimator::designLowPass(2);
+            DecimationPipeline cicFir;
+            cicFir.addStage(new CICDecimator(ratio / 2, 3));
+            cicFir.addStage(new FIRDecimator(2, shortTaps));
+            printf("%-12s %-10u %-10u %-8zu %15.4g\n", "CIC+FIR", blockSize, ratio, shortTaps.size(),
+                   samplesPerSecond(cicFir, blockSize, seconds));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,237 @@
+/* elm3704LogicBench.cpp
+ *
+ * Measures the cost of the ELM3704 driver logic alone: dispatching a parameter
+ * write, generating the options of the other records and the SDO requests it
+ * makes. The driver talks to a MockSdoTransport, so no asyn port, SDO thread
+ * or readback polling is involved, and it runs on a virtual clock so its
+ * startup wait takes no time. Writes are made straight to writeInt32 under the
+ * driver lock, as asyn does for the records.
+ *
+ *   types     change each channel through every measurement type
+ *   subtypes  sweep the subtypes of the voltage, current, TC, IEPE, strain
+ *             gauge and RTD types on each channel
+ *   options   change the sensor supply, element and scaler of each channel
+ *
+ * Each workload prints one line of JSON with the mean, p50 and p99 time of an
+ * operation and the SDO requests it made. The driver's own messages are
+ * discarded unless -v is given.
+ *
+ * Usage: elm3704LogicBench [-r repeats] [-v]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <asynDriver.h>
+
+#include "ELM3704.h"
+#include "ELM3704Properties.h"
+#include "MockSdoTransport.h"
+#include "Clock.h"
+
+
+// Subtypes of the types swept by the subtypes workload
+struct SubtypeTable
+{
+    ELM3704::Type type;
+    const int *values;
+    int numValues;
+};
+
+static const SubtypeTable subtypeTables[] = {
+    { ELM3704::Voltage, ELM3704Properties::voltageValues, ELM3704Properties::numVoltageOptions },
+    { ELM3704::Current, ELM3704Properties::currentValues, ELM3704Properties::numCurrentOptions },
+    { ELM3704::Thermocouple, ELM3704Properties::TCValues, ELM3704Properties::numTCOptions },
+    { ELM3704::IEPiezoElectric, ELM3704Properties::IEPEValues, ELM3704Properties::numIEPEOptions },
+    { ELM3704::StrainGaugeFullBridge, ELM3704Properties::StrainGaugeFBValues, ELM3704Properties::numStrainGaugeFBOptions },
+    { ELM3704::RTD, ELM3704Properties::RTDValues, ELM3704Properties::numRTDOptions },
+};
+
+
+// Driver on a mock transport, with writes timed
+class Bench
+{
+
+public:
+    Bench() :
+        transport(new MockSdoTransport()),
+        driver(new ELM3704("BENCH:LOGIC", transport, false)),
+        pasynUser(pasynManager->createAsynUser(NULL, NULL))
+    {
+    }
+
+    // Write a parameter of a channel (1-4) as asyn would
+    asynStatus write(unsigned int channel, const char *param, epicsInt32 value)
+    {
+        std::string name = "CH" + std::to_string(channel) + ":" + param;
+        int index;
+        if (driver->findParam(name.c_str(), &index) != asynSuccess)
+        {
+            return asynError;
+        }
+        pasynUser->reason = index;
+        driver->lock();
+        asynStatus status = driver->writeInt32(pasynUser, value);
+        driver->unlock();
+        return status;
+    }
+
+    // Time a write, counting its SDO requests
+    void time(unsigned int channel, const char *param, epicsInt32 value)
+    {
+        transport->clearRequests();
+        std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+        if (write(channel, param, value) != asynSuccess)
+        {
+            failures++;
+        }
+        times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count());
+        requests += transport->getRequests().size();
+    }
+
+    // Print the results of a workload as a line of JSON and start the next
+    void print(FILE *fp, const char *workload)
+    {
+        std::sort(times.begin(), times.end());
+        double total = 0.0;
+        for (size_t i=0; i<times.size(); i++)
+        {
+            total += times[i];
+        }
+        size_t count = times.size();
+        fprintf(fp, "{\"workload\": \"%s\", \"operations\": %d, \"failures\": %d, \"sdo_requests_per_op\": %.2f, "
+                "\"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}\n",
+                workload, (int) count, failures, count ? (double) requests / count : 0.0,
+                count ? total / count * 1e6 : 0.0, percentile(0.50) * 1e6, percentile(0.99) * 1e6,
+                count ? times.back() * 1e6 : 0.0);
+        fflush(fp);
+        times.clear();
+        failures = 0;
+        requests = 0;
+    }
+
+private:
+    // Nearest rank percentile of the sorted times
+    double percentile(double fraction) const
+    {
+        if (times.empty())
+        {
+            return 0.0;
+        }
+        size_t rank = (size_t) (fraction * times.size() + 0.999999);
+        return times[std::min(std::max(rank, (size_t) 1), times.size()) - 1];
+    }
+
+    // The transport belongs to the driver, which lives until exit
+    MockSdoTransport *transport;
+    ELM3704 *driver;
+    asynUser *pasynUser;
+    std::vector<double> times;
+    int failures = 0;
+    unsigned long requests = 0;
+
+};
+
+
+// Change each channel through every measurement type, ending with none
+static void typeChanges(Bench &bench, unsigned int repeats)
+{
+    for (unsigned int repeat=0; repeat<repeats; repeat++)
+    {
+        for (unsigned int channel=1; channel<=4; channel++)
+        {
+            for (int type=ELM3704::Voltage; type<=ELM3704::RTD; type++)
+            {
+                bench.time(channel, "TYPE", type);
+            }
+            bench.time(channel, "TYPE", ELM3704::None);
+        }
+    }
+}
+
+
+// Sweep the subtypes of each type on each channel
+static void subtypeChanges(Bench &bench, unsigned int repeats)
+{
+    for (unsigned int repeat=0; repeat<repeats; repeat++)
+    {
+        for (unsigned int channel=1; channel<=4; channel++)
+        {
+            for (size_t t=0; t<sizeof(subtypeTables)/sizeof(subtypeTables[0]); t++)
+            {
+                bench.write(channel, "TYPE", subtypeTables[t].type);
+                for (int s=0; s<subtypeTables[t].numValues; s++)
+                {
+                    bench.time(channel, "SUBTYPE", subtypeTables[t].values[s]);
+                }
+            }
+        }
+    }
+}
+
+
+// Change the secondary settings of each channel
+static void optionChanges(Bench &bench, unsigned int repeats)
+{
+    for (unsigned int repeat=0; repeat<repeats; repeat++)
+    {
+        for (unsigned int channel=1; channel<=4; channel++)
+        {
+            bench.write(channel, "TYPE", ELM3704::StrainGaugeFullBridge);
+            bench.time(channel, "SENSOR_SUPPLY", 5);
+            bench.time(channel, "SCALER", 3);
+            bench.write(channel, "TYPE", ELM3704::RTD);
+            bench.time(channel, "RTD_ELEMENT_PAGE", 2);
+            bench.time(channel, "RTD_ELEMENT", 16);
+            bench.write(channel, "TYPE", ELM3704::Thermocouple);
+            bench.time(channel, "TC_ELEMENT_PAGE", 1);
+            bench.time(channel, "TC_ELEMENT", 3);
+            bench.time(channel, "SCALER", 3);
+        }
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    unsigned int repeats = 100;
+    bool verbose = false;
+    int option;
+    while ((option = getopt(argc, argv, "r:v")) != -1)
+    {
+        switch (option)
+        {
+            case 'r': repeats = atoi(optarg); break;
+            case 'v': verbose = true; break;
+            default:
+                fprintf(stderr, "Usage: %s [-r repeats] [-v]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    // Results go to the original stdout, the driver's messages to /dev/null
+    FILE *results = fdopen(dup(fileno(stdout)), "w");
+    if (!verbose && !freopen("/dev/null", "w", stdout))
+    {
+        perror("/dev/null");
+        return 1;
+    }
+
+    // Auto-advancing so the driver's wait for the SDO port to settle is free
+    Clock::set(new VirtualClock(true));
+    Bench bench;
+
+    typeChanges(bench, repeats);
+    bench.print(results, "types");
+    subtypeChanges(bench, repeats);
+    bench.print(results, "subtypes");
+    optionChanges(bench, repeats);
+    bench.print(results, "options");
+    return 0;
+}
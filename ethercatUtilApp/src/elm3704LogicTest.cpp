@@ -0,0 +1,173 @@
+/* elm3704LogicTest.cpp
+ *
+ * Drives an ELM3704 driver on a MockSdoTransport through its asyn port and
+ * checks the SDO requests each write makes, the options it gives the subtype,
+ * sensor supply and scaler records, and how it reports a failed request. The
+ * driver runs on an auto-advancing virtual clock so its startup wait takes no
+ * time.
+*/
+
+#include <string>
+#include <vector>
+
+#include <asynDriver.h>
+#include <asynEnum.h>
+#include <asynPortClient.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "Clock.h"
+#include "ELM3704.h"
+#include "ELM3704Properties.h"
+#include "MockSdoTransport.h"
+
+static const char *portName = "LOGICTEST";
+
+
+// Options last given to an enum record
+struct Options
+{
+    std::vector<std::string> strings;
+    std::vector<int> values;
+};
+
+
+static void optionsCallback(void *userPvt, asynUser *, char *strings[], int values[], int *, size_t nElements)
+{
+    Options *options = (Options *) userPvt;
+    options->strings.assign(strings, strings + nElements);
+    options->values.assign(values, values + nElements);
+}
+
+
+// Keep the options the driver gives a parameter's record
+static void watchOptions(ELM3704 *driver, const char *paramName, Options *options)
+{
+    asynUser *pasynUser = pasynManager->createAsynUser(NULL, NULL);
+    pasynManager->connectDevice(pasynUser, portName, 0);
+    driver->findParam(paramName, &pasynUser->reason);
+    asynInterface *pasynInterface = pasynManager->findInterface(pasynUser, asynEnumType, 1);
+    asynEnum *pasynEnum = (asynEnum *) pasynInterface->pinterface;
+    void *interruptPvt;
+    pasynEnum->registerInterruptUser(pasynInterface->drvPvt, pasynUser, optionsCallback, options, &interruptPvt);
+}
+
+
+// Check the options against a table of strings and values
+static void checkOptions(const char *name, const Options &options, const char **strings, const int *values, int count)
+{
+    bool same = (int) options.strings.size() == count;
+    for (int i=0; same && i<count; i++)
+    {
+        same = options.strings[i] == strings[i] && options.values[i] == values[i];
+    }
+    testOk(same, "%s: %d options as expected", name, count);
+}
+
+
+/* Check the requests since the last check against the expected ones. The values
+ * of reads are those the driver was given, so only those of writes are compared.
+*/
+static void checkRequests(const char *name, MockSdoTransport *transport,
+                          const std::vector<MockSdoTransport::Request> &expected)
+{
+    const std::vector<MockSdoTransport::Request> &requests = transport->getRequests();
+    bool same = requests.size() == expected.size();
+    for (size_t i=0; same && i<requests.size(); i++)
+    {
+        same = requests[i].paramName == expected[i].paramName && requests[i].write == expected[i].write &&
+               (!requests[i].write || requests[i].value == expected[i].value);
+    }
+    testOk(same, "%s: %d SDO requests as expected", name, (int) expected.size());
+    if (!same)
+    {
+        for (size_t i=0; i<requests.size(); i++)
+        {
+            testDiag("%s %s %d", requests[i].write ? "write" : "read", requests[i].paramName.c_str(), requests[i].value);
+        }
+    }
+    transport->clearRequests();
+}
+
+
+// Requests to set the interface of channel 1, and read back its sub-settings
+static std::vector<MockSdoTransport::Request> interfaceRequests(epicsInt32 value)
+{
+    std::vector<MockSdoTransport::Request> requests = {
+        { "CH1:Interface", true, value },
+        { "CH1:SensorSupply", false, 0 },
+        { "CH1:RTDElement", false, 0 },
+        { "CH1:TCElement", false, 0 },
+        { "CH1:Scaler", false, 0 },
+    };
+    return requests;
+}
+
+
+// Status message of channel 1
+static std::string channelStatus()
+{
+    char status[128] = "";
+    size_t nRead = 0;
+    int eomReason;
+    asynOctetClient(portName, 0, "CH1:STATUS").read(status, sizeof(status) - 1, &nRead, &eomReason);
+    status[nRead] = '\0';
+    return status;
+}
+
+
+MAIN(elm3704LogicTest)
+{
+    testPlan(14);
+
+    Clock::set(new VirtualClock(true));
+    MockSdoTransport *transport = new MockSdoTransport();
+    ELM3704 *driver = new ELM3704(portName, transport, false);
+    transport->clearRequests();
+
+    Options subtypes, sensorSupplies, scalers;
+    watchOptions(driver, "CH1:SUBTYPE", &subtypes);
+    watchOptions(driver, "CH1:SENSOR_SUPPLY", &sensorSupplies);
+    watchOptions(driver, "CH1:SCALER", &scalers);
+    asynInt32Client type(portName, 0, "CH1:TYPE");
+    asynInt32Client subtype(portName, 0, "CH1:SUBTYPE");
+
+    // A type sets the first of its subtypes and offers the rest
+    testOk1(type.write(ELM3704::Voltage) == asynSuccess);
+    checkRequests("voltage", transport, interfaceRequests(ELM3704Properties::voltageValues[0]));
+    checkOptions("voltage subtypes", subtypes, ELM3704Properties::voltageStrings,
+                 ELM3704Properties::voltageValues, ELM3704Properties::numVoltageOptions);
+    static const char *naStrings[] = { "N/A" };
+    static const int naValues[] = { 0 };
+    checkOptions("voltage sensor supply", sensorSupplies, naStrings, naValues, 1);
+
+    // A subtype only changes the interface, and the sub-settings are read back
+    transport->set("CH1:Scaler", 3);
+    testOk1(subtype.write(ELM3704Properties::voltageValues[1]) == asynSuccess);
+    checkRequests("voltage subtype", transport, interfaceRequests(ELM3704Properties::voltageValues[1]));
+    epicsInt32 scaler = 0;
+    asynInt32Client(portName, 0, "CH1:SCALER").read(&scaler);
+    testOk(transport->get("CH1:Interface") == ELM3704Properties::voltageValues[1] && scaler == 3,
+           "voltage subtype: interface set and scaler read back as %d", scaler);
+
+    // Thermocouples have scaler options of their own
+    testOk1(type.write(ELM3704::Thermocouple) == asynSuccess);
+    checkOptions("thermocouple subtypes", subtypes, ELM3704Properties::TCStrings,
+                 ELM3704Properties::TCValues, ELM3704Properties::numTCOptions);
+    checkOptions("thermocouple scalers", scalers, ELM3704Properties::TCScalerStrings,
+                 ELM3704Properties::TCScalerValues, ELM3704Properties::numTCScalerOptions);
+    transport->clearRequests();
+
+    // A write which times out fails the record and leaves the module as it was
+    epicsInt32 interface = transport->get("CH1:Interface");
+    transport->failWith("CH1:Interface", asynTimeout);
+    testOk1(type.write(ELM3704::Current) == asynError);
+    std::vector<MockSdoTransport::Request> expected = { { "CH1:Interface", true, ELM3704Properties::currentValues[0] } };
+    checkRequests("timeout", transport, expected);
+    testOk(transport->get("CH1:Interface") == interface, "timeout: interface unchanged");
+    std::string status = channelStatus();
+    testOk(status == "Failed to set parameter: Interface", "timeout: status %s", status.c_str());
+
+    // The driver lives until exit
+    return testDone();
+}
@@ -0,0 +1,201 @@
+/* iocStartupBench.cpp
+ *
+ * Measures how long an IOC with many ELM3704 modules takes to start. For each
+ * module count a st.cmd is generated which creates a simulated SDO and PDO
+ * port and an ELM3704 driver for every module and loads its channel records,
+ * then an IOC is booted from it in a child process.
+ *
+ * Each count prints one line of JSON: the time taken by the st.cmd and
+ * iocInit, the time until every driver had initialised its
+ * parameters, and the mean and maximum of each phase of a driver's startup
+ * (construction, waiting for the SDO port, reading the settings and the
+ * parameter callbacks), see ELM3704StartupReport. The IOC's own messages are
+ * discarded unless -v is given.
+ *
+ * Reading the settings of every channel dominates startup, so the simulated
+ * SDO reads take 2 ms by default (-r), as on a real rack. Writes take no time
+ * unless -w is given. The PDO ports only back the channel records, so they
+ * cycle once a second to leave the host to the startup being timed.
+ *
+ * Run it from the top of the module, or give the directory with -t, so the
+ * st.cmd can load dbd/iocStartupBench.dbd and the templates in db.
+ *
+ * Usage: iocStartupBench [-t top] [-r read latency] [-w write latency] [-s] [-v] [modules ...]
+*/
+
+#include <chrono>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <iocsh.h>
+#include <epicsStdio.h>
+
+#include "Clock.h"
+#include "ELM3704.h"
+#include "ELM3704Properties.h"
+
+
+// Seconds to wait for the drivers to initialise after iocInit
+static const double initialiseTimeout = 600.0;
+
+// Cycle period of the simulated PDO ports
+static const double pdoCyclePeriod = 1.0;
+
+
+// Write the st.cmd line setting a latency of all parameters of a simulated SDO port.
+// Latencies are "<model> [a [b]]" as for SimELM3704SdoPortDriverSetLatency.
+static void writeSetLatency(FILE *fp, int module, const char *stage, const std::string &latency)
+{
+    std::string model = latency.substr(0, latency.find(' '));
+    std::string parameters = latency.size() > model.size() ? latency.substr(model.size()) : "";
+    double a = 0.0, b = 0.0;
+    sscanf(parameters.c_str(), "%lf %lf", &a, &b);
+    fprintf(fp, "SimELM3704SdoPortDriverSetLatency(\"BENCH%d_SDO\", \"*\", \"%s\", \"%s\", %g, %g)\n",
+            module, stage, model.c_str(), a, b);
+}
+
+
+// Write a st.cmd creating numModules simulated modules with their drivers and records
+static void writeStartupScript(const std::string &fileName, const std::string &top, int numModules,
+                               const std::string &readLatency, const std::string &writeLatency)
+{
+    FILE *fp = fopen(fileName.c_str(), "w");
+    if (!fp)
+    {
+        throw std::runtime_error("cannot create " + fileName);
+    }
+    fprintf(fp, "dbLoadDatabase(\"%s/dbd/iocStartupBench.dbd\")\n", top.c_str());
+    fprintf(fp, "iocStartupBench_registerRecordDeviceDriver(pdbbase)\n");
+    fprintf(fp, "epicsEnvSet(\"EPICS_DB_INCLUDE_PATH\", \"%s/db\")\n", top.c_str());
+
+    for (int module=1; module<=numModules; module++)
+    {
+        fprintf(fp, "SimELM3704SdoPortDriverConfigure(\"BENCH%d_SDO\", \"\")\n", module);
+        writeSetLatency(fp, module, "read", readLatency);
+        writeSetLatency(fp, module, "write", writeLatency);
+        fprintf(fp, "SimELM3704PdoPortDriverConfigure(\"BENCH%d\", 1, %g)\n", module, pdoCyclePeriod);
+        fprintf(fp, "ELM3704DriverConfigure(\"BENCH%d:LOGIC\", \"BENCH%d_SDO\")\n", module, module);
+        for (int channel=1; channel<=4; channel++)
+        {
+            char entry[64];
+            epicsSnprintf(entry, sizeof(entry), ELM3704Properties::sampleEntryFormat, 1, channel, 0);
+            fprintf(fp, "dbLoadRecords(\"ethercat_gui_ELM3704_channel.template\", "
+                    "\"P=BENCH,R=M%d,CHANNEL=%d,PORT=BENCH%d,LOGICPORT=BENCH%d:LOGIC,ENTRY=%s,SCAN=1 second\")\n",
+                    module, channel, module, module, entry);
+        }
+    }
+    fclose(fp);
+}
+
+
+/* Boot an IOC from the script and print its startup times to the results. On
+ * a virtual clock the shell holds the clock until every driver has been created,
+ * so they all start at the same time, but not through iocInit, whose records
+ * can wait for a driver blocked on the clock.
+*/
+static void bootIoc(const std::string &fileName, FILE *results, bool virtualTime, bool verbose)
+{
+    if (!verbose && !freopen("/dev/null", "w", stdout))
+    {
+        perror("/dev/null");
+        _exit(1);
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (virtualTime)
+    {
+        iocshCmd("VirtualClockEnable(1)");
+    }
+    Clock::get().attach();
+    iocsh(fileName.c_str());
+    Clock::get().detach();
+    iocshCmd("iocInit");
+    double bootSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bool initialised = ELM3704::waitForStartup(initialiseTimeout);
+    double readySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(results, "{\"st_cmd_s\": %.6f, \"ready_s\": %.6f, \"complete\": %s, \"startup\": ",
+            bootSeconds, readySeconds, initialised ? "true" : "false");
+    ELM3704::reportStartup(results);
+    fprintf(results, "}\n");
+    fflush(results);
+
+    // Don't wait for the IOC's threads to stop
+    _exit(initialised ? 0 : 1);
+}
+
+
+int main(int argc, char *argv[])
+{
+    std::string top = ".";
+    std::string readLatency = "fixed 0.002";
+    std::string writeLatency = "zero";
+    bool virtualTime = false;
+    bool verbose = false;
+    int option;
+    while ((option = getopt(argc, argv, "t:r:w:sv")) != -1)
+    {
+        switch (option)
+        {
+            case 't': top = optarg; break;
+            case 'r': readLatency = optarg; break;
+            case 'w': writeLatency = optarg; break;
+            case 's': virtualTime = true; break;
+            case 'v': verbose = true; break;
+            default:
+                fprintf(stderr, "Usage: %s [-t top] [-r read latency] [-w write latency] [-s] [-v] [modules ...]\n", argv[0]);
+                return 2;
+        }
+    }
+    std::vector<int> counts;
+    for (int i=optind; i<argc; i++)
+    {
+        counts.push_back(atoi(argv[i]));
+    }
+    if (counts.empty())
+    {
+        counts = { 10, 100, 500 };
+    }
+
+    // Each IOC boots in a child process, which has the asyn ports to itself
+    int status = 0;
+    for (size_t i=0; i<counts.size(); i++)
+    {
+        std::string fileName = "/tmp/iocStartupBench-" + std::to_string(counts[i]) + ".cmd";
+        try
+        {
+            writeStartupScript(fileName, top, counts[i], readLatency, writeLatency);
+        } catch (const std::runtime_error &e)
+        {
+            fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+
+        printf("{\"modules\": %d, \"clock\": \"%s\", \"read_latency\": \"%s\", \"write_latency\": \"%s\", \"result\": ",
+               counts[i], virtualTime ? "virtual" : "system", readLatency.c_str(), writeLatency.c_str());
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0)
+        {
+            FILE *results = fdopen(dup(fileno(stdout)), "w");
+            bootIoc(fileName, results, virtualTime, verbose);
+        }
+        int childStatus = 0;
+        if (child < 0 || waitpid(child, &childStatus, 0) < 0 || !WIFEXITED(childStatus))
+        {
+            printf("null}\n");
+            fprintf(stderr, "IOC with %d modules did not exit\n", counts[i]);
+            status = 1;
+            continue;
+        }
+        printf("}\n");
+        status |= WEXITSTATUS(childStatus);
+        remove(fileName.c_str());
+    }
+    return status;
+}
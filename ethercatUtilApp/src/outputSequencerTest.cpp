@@ -0,0 +1,261 @@
+/* outputSequencerTest.cpp
+ *
+ * Plays sequences and pulses with an OutputSequencer timed by the cycle counter
+ * of a simulated ELM3704 PDO port, and checks the output edges it writes. The
+ * outputs go to a recording port, which notes the simulator cycle of every
+ * write, so edge times, pulse widths and repeats are checked in cycles. It also
+ * checks that an abort leaves the outputs off.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asynPortDriver.h>
+#include <asynPortClient.h>
+#include <epicsStdio.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "ELM3704Properties.h"
+#include "OutputSequencer.h"
+#include "PdoPortClient.h"
+#include "simELM3704PdoPortDriver.h"
+
+// Long enough that a busy test host does not miss a cycle
+static const double cyclePeriod = 0.02;
+
+static const int numOutputs = 4;
+
+
+// Output entries noting the simulator cycle of every write
+class OutputRecorder : public asynPortDriver
+{
+
+public:
+    // A write to an output
+    struct Edge
+    {
+        long cycle;
+        int output;
+        epicsInt32 value;
+    };
+
+    OutputRecorder(const char *portName, const char *cyclePortName, const char *cycleEntry) : asynPortDriver(
+        portName,
+        1,
+        asynInt32Mask | asynDrvUserMask,
+        asynInt32Mask,
+        0,
+        1,
+        0,
+        0),
+        cycles(0),
+        cycleClient(cyclePortName)
+    {
+        char str[16];
+        for (int i=0; i<numOutputs; i++)
+        {
+            epicsSnprintf(str, sizeof(str), "OUT%d", i+1);
+            createParam(str, asynParamInt32, &outputs[i]);
+            setIntegerParam(outputs[i], 0);
+        }
+        cycleClient.monitor(cycleEntry, [this](epicsInt32, const epicsTimeStamp &) { cycles++; });
+    }
+
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value)
+    {
+        for (int i=0; i<numOutputs; i++)
+        {
+            if (pasynUser->reason == outputs[i])
+            {
+                std::lock_guard<std::mutex> guard(edgesMutex);
+                Edge edge = { cycles, i, value };
+                edges.push_back(edge);
+            }
+        }
+        return asynPortDriver::writeInt32(pasynUser, value);
+    }
+
+    // Writes since the last call, with cycles counted from the first of them
+    std::vector<Edge> takeEdges()
+    {
+        std::lock_guard<std::mutex> guard(edgesMutex);
+        std::vector<Edge> taken;
+        taken.swap(edges);
+        for (size_t i=1; i<taken.size(); i++)
+        {
+            taken[i].cycle -= taken[0].cycle;
+        }
+        if (!taken.empty())
+        {
+            taken[0].cycle = 0;
+        }
+        return taken;
+    }
+
+    // Current value of an output
+    epicsInt32 output(int i)
+    {
+        int value;
+        lock();
+        getIntegerParam(outputs[i], &value);
+        unlock();
+        return value;
+    }
+
+private:
+    int outputs[numOutputs];
+    std::atomic<long> cycles;
+    std::mutex edgesMutex;
+    std::vector<Edge> edges;
+    PdoPortClient cycleClient;
+
+};
+
+
+// Wait until the sequencer is no longer running, false on timeout
+static bool waitUntilIdle(const char *portName, double timeout)
+{
+    asynInt32Client running(portName, 0, "RUNNING");
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+    while (std::chrono::steady_clock::now() < end)
+    {
+        epicsInt32 value = 1;
+        if (running.read(&value) == asynSuccess && value == 0)
+        {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+
+// Check the writes against the expected (cycle, output, value) edges
+static void checkEdges(const char *name, const std::vector<OutputRecorder::Edge> &edges,
+                       const std::vector<OutputRecorder::Edge> &expected)
+{
+    bool same = edges.size() == expected.size();
+    for (size_t i=0; same && i<edges.size(); i++)
+    {
+        same = edges[i].cycle == expected[i].cycle && edges[i].output == expected[i].output &&
+               edges[i].value == expected[i].value;
+    }
+    testOk(same, "%s: %d edges as expected", name, (int) expected.size());
+    if (!same)
+    {
+        for (size_t i=0; i<edges.size(); i++)
+        {
+            testDiag("cycle %ld output %d value %d", edges[i].cycle, edges[i].output + 1, edges[i].value);
+        }
+    }
+}
+
+
+// Edges of a table of three steps, repeated twice
+static void testTable(OutputRecorder &recorder)
+{
+    epicsFloat64 times[] = { 0.0, 5 * cyclePeriod, 12 * cyclePeriod };
+    epicsInt32 words[] = { 0x1, 0x3, 0x0 };
+    asynInt32Client("SEQTEST", 0, "MODE").write(OutputSequencer::modeTable);
+    asynFloat64ArrayClient("SEQTEST", 0, "STEP_TIMES").write(times, 3);
+    asynInt32ArrayClient("SEQTEST", 0, "STEP_OUTPUTS").write(words, 3);
+    asynFloat64Client("SEQTEST", 0, "DURATION").write(20 * cyclePeriod);
+    asynInt32Client("SEQTEST", 0, "REPEATS").write(2);
+
+    testOk1(asynInt32Client("SEQTEST", 0, "START").write(1) == asynSuccess);
+    testOk(waitUntilIdle("SEQTEST", 5.0), "table: sequence finished");
+
+    // All owned outputs are written at the start, then only those a step changes
+    std::vector<OutputRecorder::Edge> expected = {
+        { 0, 0, 1 }, { 0, 1, 0 }, { 5, 1, 1 }, { 12, 0, 0 }, { 12, 1, 0 },
+        { 20, 0, 1 }, { 25, 1, 1 }, { 32, 0, 0 }, { 32, 1, 0 },
+    };
+    checkEdges("table", recorder.takeEdges(), expected);
+
+    epicsInt32 repeat = 0;
+    asynInt32Client("SEQTEST", 0, "REPEAT").read(&repeat);
+    testOk(repeat == 2, "table: played %d times", repeat);
+}
+
+
+// Width and count of a pulse repeated three times
+static void testPulse(OutputRecorder &recorder)
+{
+    asynInt32Client("SEQTEST", 0, "MODE").write(OutputSequencer::modePulse);
+    asynInt32Client("SEQTEST", 0, "PULSE_OUTPUTS").write(0x4);
+    asynFloat64Client("SEQTEST", 0, "PULSE_WIDTH").write(3 * cyclePeriod);
+    asynFloat64Client("SEQTEST", 0, "PULSE_PERIOD").write(10 * cyclePeriod);
+    asynInt32Client("SEQTEST", 0, "REPEATS").write(3);
+
+    testOk1(asynInt32Client("SEQTEST", 0, "START").write(1) == asynSuccess);
+    testOk(waitUntilIdle("SEQTEST", 5.0), "pulse: sequence finished");
+
+    std::vector<OutputRecorder::Edge> edges = recorder.takeEdges();
+    std::vector<OutputRecorder::Edge> expected = {
+        { 0, 2, 1 }, { 3, 2, 0 }, { 10, 2, 1 }, { 13, 2, 0 }, { 20, 2, 1 }, { 23, 2, 0 },
+    };
+    checkEdges("pulse", edges, expected);
+
+    int pulses = 0;
+    bool widthsOk = true;
+    for (size_t i=0; i+1<edges.size(); i+=2)
+    {
+        pulses++;
+        widthsOk = widthsOk && edges[i].value == 1 && edges[i+1].value == 0 && edges[i+1].cycle - edges[i].cycle == 3;
+    }
+    testOk(pulses == 3, "pulse: %d pulses", pulses);
+    testOk(widthsOk, "pulse: every pulse 3 cycles wide");
+}
+
+
+// An endless pulse train stopped by an abort
+static void testAbortSequence(OutputRecorder &recorder)
+{
+    asynInt32Client("SEQTEST", 0, "MODE").write(OutputSequencer::modePulse);
+    asynInt32Client("SEQTEST", 0, "PULSE_OUTPUTS").write(0x3);
+    asynFloat64Client("SEQTEST", 0, "PULSE_WIDTH").write(100 * cyclePeriod);
+    asynFloat64Client("SEQTEST", 0, "PULSE_PERIOD").write(200 * cyclePeriod);
+    asynInt32Client("SEQTEST", 0, "REPEATS").write(0);
+
+    testOk1(asynInt32Client("SEQTEST", 0, "START").write(1) == asynSuccess);
+    std::this_thread::sleep_for(std::chrono::duration<double>(10 * cyclePeriod));
+    testOk(recorder.output(0) == 1 && recorder.output(1) == 1, "abort: pulse high before the abort");
+
+    asynInt32Client("SEQTEST", 0, "ABORT").write(1);
+    testOk(waitUntilIdle("SEQTEST", 5.0), "abort: sequence stopped");
+    testOk(recorder.output(0) == 0 && recorder.output(1) == 0, "abort: owned outputs off");
+    testOk(recorder.output(2) == 0 && recorder.output(3) == 0, "abort: other outputs untouched");
+
+    char status[64] = "";
+    size_t nRead = 0;
+    int eomReason;
+    asynOctetClient("SEQTEST", 0, "STATUS").read(status, sizeof(status) - 1, &nRead, &eomReason);
+    status[nRead] = '\0';
+    testOk(std::string(status) == "Aborted", "abort: status %s", status);
+    recorder.takeEdges();
+}
+
+
+MAIN(outputSequencerTest)
+{
+    testPlan(15);
+
+    char cycleEntry[64];
+    epicsSnprintf(cycleEntry, sizeof(cycleEntry), ELM3704Properties::cycleCounterEntryFormat, 1);
+    new SimELM3704PdoPortDriver("SEQTEST_PDO", 1, cyclePeriod);
+    OutputRecorder *recorder = new OutputRecorder("SEQTEST_OUT", "SEQTEST_PDO", cycleEntry);
+    new OutputSequencer("SEQTEST", "SEQTEST_OUT", "OUT%d", numOutputs, "SEQTEST_PDO", cycleEntry, cyclePeriod, 16);
+
+    testTable(*recorder);
+    testPulse(*recorder);
+    testAbortSequence(*recorder);
+
+    // The driver threads run until exit
+    return testDone();
+}
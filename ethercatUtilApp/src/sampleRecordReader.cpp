@@ -0,0 +1,156 @@
+/* sampleRecordReader.cpp
+ *
+ * Prints the header and a summary of a file written by SampleRecorder, or dumps
+ * its samples as CSV (channel, time in seconds since 1970, raw value).
+ *
+ * Usage: sampleRecordReader [-c] file.ecatrec
+*/
+
+#include <atomic>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SampleRecorderFormat.h"
+
+// Seconds between the POSIX epoch and the EPICS epoch (1990-01-01)
+static const double epicsEpochOffset = 631152000.0;
+
+
+// Per-channel totals for the summary
+struct ChannelSummary
+{
+    unsigned long long blocks;
+    unsigned long long samples;
+    double firstTime;
+    double lastTime;
+};
+
+
+static void printHeader(const RecorderFileHeader *header, const RecorderChannelHeader *channels)
+{
+    printf("Port:          %.*s\n", (int) sizeof(header->portName), header->portName);
+    printf("Version:       %u\n", header->version);
+    printf("Start:         %.9f\n", header->startSeconds + epicsEpochOffset + header->startNanoseconds * 1e-9);
+    printf("Oversampling:  %u\n", header->oversampling);
+    printf("Sample rate:   %g Hz\n", header->sampleRate);
+    printf("Channels:      %u\n", header->numChannels);
+    for (unsigned int i=0; i<header->numChannels; i++)
+    {
+        const RecorderChannelHeader &channel = channels[i];
+        printf("  CH%u: %-24.*s subtype %d, supply %d, RTD element %d, TC element %d, scaler %d\n",
+               channel.channel, (int) sizeof(channel.typeName), channel.typeName, channel.subtype,
+               channel.sensorSupply, channel.rtdElement, channel.tcElement, channel.scaler);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    bool csv = (argc == 3 && strcmp(argv[1], "-c") == 0);
+    if (argc != 2 && !csv)
+    {
+        fprintf(stderr, "Usage: %s [-c] file.ecatrec\n", argv[0]);
+        return 2;
+    }
+    const char *fileName = argv[argc - 1];
+
+    int fd = open(fileName, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        perror(fileName);
+        return 1;
+    }
+    size_t size = info.st_size;
+    if (size < sizeof(RecorderFileHeader))
+    {
+        fprintf(stderr, "%s: too short for a recorder file\n", fileName);
+        return 1;
+    }
+    void *address = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED)
+    {
+        perror(fileName);
+        return 1;
+    }
+    const char *data = (const char *) address;
+
+    const RecorderFileHeader *header = (const RecorderFileHeader *) data;
+    if (memcmp(header->magic, recorderFileMagic, sizeof(header->magic)) != 0 ||
+        header->version != recorderFileVersion || header->headerSize > size)
+    {
+        fprintf(stderr, "%s: not a version %u recorder file\n", fileName, recorderFileVersion);
+        return 1;
+    }
+    uint64_t channelBytes = (uint64_t) header->numChannels * sizeof(RecorderChannelHeader);
+    if (header->headerSize != sizeof(RecorderFileHeader) + channelBytes)
+    {
+        fprintf(stderr, "%s: header size %u does not hold %u channels\n", fileName, header->headerSize, header->numChannels);
+        return 1;
+    }
+    const RecorderChannelHeader *channels = (const RecorderChannelHeader *) (data + sizeof(RecorderFileHeader));
+
+    if (csv) printf("channel,time,value\n");
+    else printHeader(header, channels);
+
+    // Blocks follow until the end of the file or the zero filled unused space
+    std::map<unsigned int, ChannelSummary> summaries;
+    size_t offset = header->headerSize;
+    while (offset + sizeof(RecorderBlockHeader) <= size)
+    {
+        // The rest of a block is only read once its magic number is seen, see SampleRecorder::writeBlock
+        uint32_t magic;
+        memcpy(&magic, data + offset, sizeof(magic));
+        if (magic != recorderBlockMagic)
+        {
+            break;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        RecorderBlockHeader block;
+        memcpy(&block, data + offset, sizeof(block));
+        size_t blockBytes = sizeof(block) + block.numSamples * sizeof(int32_t);
+        if (offset + blockBytes > size)
+        {
+            break;
+        }
+        const int32_t *samples = (const int32_t *) (data + offset + sizeof(block));
+        double lastTime = block.seconds + epicsEpochOffset + block.nanoseconds * 1e-9;
+        double firstTime = lastTime - block.samplePeriod * (block.numSamples - 1);
+
+        if (csv)
+        {
+            for (unsigned int i=0; i<block.numSamples; i++)
+            {
+                printf("%u,%.9f,%d\n", block.channel, firstTime + i * block.samplePeriod, samples[i]);
+            }
+        }
+
+        ChannelSummary &summary = summaries[block.channel];
+        if (summary.blocks == 0) summary.firstTime = firstTime;
+        summary.blocks++;
+        summary.samples += block.numSamples;
+        summary.lastTime = lastTime;
+        offset += blockBytes;
+    }
+
+    if (!csv)
+    {
+        printf("Data:          %zu bytes\n", offset - header->headerSize);
+        for (std::map<unsigned int, ChannelSummary>::const_iterator it=summaries.begin(); it!=summaries.end(); ++it)
+        {
+            printf("  CH%u: %llu blocks, %llu samples, %.6f s\n", it->first, it->second.blocks,
+                   it->second.samples, it->second.lastTime - it->second.firstTime);
+        }
+    }
+
+    munmap(address, size);
+    close(fd);
+    return 0;
+}
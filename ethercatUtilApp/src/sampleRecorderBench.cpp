@@ -0,0 +1,141 @@
+/* sampleRecorderBench.cpp
+ *
+ * Measures the sustained throughput of SampleRecorder and the time taken by
+ * push(), which is what the acquisition thread pays for recording. Blocks for
+ * four channels are pushed as fast as possible; a block which does not fit in
+ * the queue is counted as dropped.
+ *
+ * Usage: sampleRecorderBench [directory] [seconds per case]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+#include "SampleRecorder.h"
+
+
+// Push blocks of oversampling samples for four channels for the given time
+static void runCase(const char *directory, unsigned int oversampling, double seconds)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<RecorderChannelHeader> channels(4);
+    for (unsigned int channel=0; channel<4; channel++)
+    {
+        memset(&channels[channel], 0, sizeof(RecorderChannelHeader));
+        channels[channel].channel = channel + 1;
+        strncpy(channels[channel].typeName, "Voltage", sizeof(channels[channel].typeName) - 1);
+    }
+
+    SampleBlock block;
+    block.samples.resize(oversampling);
+    for (unsigned int i=0; i<oversampling; i++)
+    {
+        block.samples[i] = (epicsInt32) std::round(1e6 * std::sin(i * 0.01));
+    }
+    block.samplePeriod = 1.0 / (1000.0 * oversampling);
+    block.timestamp.secPastEpoch = 0;
+    block.timestamp.nsec = 0;
+
+    std::vector<double> pushTimes;
+    pushTimes.reserve(1 << 20);
+    unsigned long long pushed = 0, written, dropped, bytes;
+    double total;
+    {
+        SampleRecorder recorder("BENCH", oversampling);
+        recorder.start(directory, channels, 1000.0 * oversampling, 256 * 1024 * 1024, 3600.0);
+
+        Clock::time_point start = Clock::now();
+        double elapsed = 0.0;
+        while (elapsed < seconds)
+        {
+            // Check the clock every 1024 cycles
+            for (unsigned int cycle=0; cycle<1024; cycle++)
+            {
+                // Advance the block time by one 1ms cycle
+                block.timestamp.nsec += 1000000;
+                if (block.timestamp.nsec >= 1000000000)
+                {
+                    block.timestamp.nsec = 0;
+                    block.timestamp.secPastEpoch++;
+                }
+                for (unsigned int channel=0; channel<4; channel++)
+                {
+                    Clock::time_point before = Clock::now();
+                    recorder.push(channel, block);
+                    if (pushTimes.size() < pushTimes.capacity())
+                    {
+                        pushTimes.push_back(std::chrono::duration<double>(Clock::now() - before).count());
+                    }
+                }
+                pushed += 4;
+            }
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        // Wait for the queue to be written
+        recorder.stop();
+        while (recorder.getBlocksWritten() + recorder.getBlocksDropped() < pushed)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        total = std::chrono::duration<double>(Clock::now() - start).count();
+        written = recorder.getBlocksWritten();
+        dropped = recorder.getBlocksDropped();
+        bytes = recorder.getBytesWritten();
+    }
+
+    std::sort(pushTimes.begin(), pushTimes.end());
+    double p99 = pushTimes[pushTimes.size() * 99 / 100];
+    double maximum = pushTimes.back();
+
+    printf("%-8u %15.4g %12.4g %10llu %12.3g %12.3g\n", oversampling,
+           written * oversampling / total, bytes / total / 1e6, dropped, p99 * 1e6, maximum * 1e6);
+
+    // The files are large, don't leave them behind
+    DIR *dir = opendir(directory);
+    if (dir)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            if (strncmp(entry->d_name, "BENCH-", 6) == 0)
+            {
+                remove((std::string(directory) + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *directory = (argc > 1) ? argv[1] : "/tmp";
+    double seconds = (argc > 2) ? atof(argv[2]) : 1.0;
+
+    static const unsigned int oversamplings[] = { 1, 10, 100 };
+
+    printf("%-8s %15s %12s %10s %12s %12s\n", "samples", "samples/s", "MB/s", "dropped", "push p99 us", "push max us");
+    for (unsigned int i=0; i<sizeof(oversamplings)/sizeof(oversamplings[0]); i++)
+    {
+        try
+        {
+            runCase(directory, oversamplings[i], seconds);
+        } catch (const std::runtime_error &e)
+        {
+            fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+    }
+    return 0;
+}
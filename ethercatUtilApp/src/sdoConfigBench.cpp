@@ -0,0 +1,429 @@
+/* sdoConfigBench.cpp
+ *
+ * Measures the configuration path of the ELM3704 driver. A number of drivers
+ * are created on simulated SDO ports and scripted workloads write to their
+ * parameters through asyn, as the records do:
+ *
+ *   types     change each channel through every measurement type
+ *   subtypes  sweep the subtypes of the voltage, current, TC, IEPE, strain
+ *             gauge and RTD types on each channel
+ *   restore   restore a saved configuration of all four channels of a module,
+ *             one operation per module
+ *   burst     one operator thread per module making random subtype and scaler
+ *             changes, all at once
+ *
+ * Each workload prints one line of JSON with its throughput and the p50, p95
+ * and p99 latency of its operations, so results can be compared between
+ * releases. The drivers' own messages are discarded unless -v is given.
+ *
+ * By default the simulated ports answer at once, so only the driver and
+ * SdoPortClient are measured. Latencies (e.g. -w "fixed 0.01") and a shared
+ * mailbox give a realistic rack; with -s they are timed on a virtual clock,
+ * so simulated seconds take no real time and latencies are in simulated time.
+ * The clock moves on only when every driver and burst thread is blocked on it,
+ * so the results do not depend on how busy the host is.
+ *
+ * Usage: sdoConfigBench [-n modules] [-r repeats] [-w write latency]
+ *                       [-b readback latency] [-m mailbox service time] [-s] [-v]
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <asynPortClient.h>
+#include <epicsStdio.h>
+
+#include "ELM3704.h"
+#include "ELM3704Properties.h"
+#include "SimMailbox.h"
+#include "simELM3704SdoPortDriver.h"
+#include "Clock.h"
+
+
+// Subtypes of the types swept by the subtypes workload
+struct SubtypeTable
+{
+    ELM3704::Type type;
+    const int *values;
+    int numValues;
+};
+
+static const SubtypeTable subtypeTables[] = {
+    { ELM3704::Voltage, ELM3704Properties::voltageValues, ELM3704Properties::numVoltageOptions },
+    { ELM3704::Current, ELM3704Properties::currentValues, ELM3704Properties::numCurrentOptions },
+    { ELM3704::Thermocouple, ELM3704Properties::TCValues, ELM3704Properties::numTCOptions },
+    { ELM3704::IEPiezoElectric, ELM3704Properties::IEPEValues, ELM3704Properties::numIEPEOptions },
+    { ELM3704::StrainGaugeFullBridge, ELM3704Properties::StrainGaugeFBValues, ELM3704Properties::numStrainGaugeFBOptions },
+    { ELM3704::RTD, ELM3704Properties::RTDValues, ELM3704Properties::numRTDOptions },
+};
+
+
+// A saved channel configuration, written in the order autosave restores it (0 to skip)
+struct ChannelConfiguration
+{
+    int type;
+    int subtype;
+    int sensorSupply;
+    int RTDElementPage;
+    int RTDElement;
+    int TCElementPage;
+    int TCElement;
+    int scaler;
+};
+
+static const ChannelConfiguration savedConfigurations[4] = {
+    { ELM3704::Thermocouple, 86, 0, 0, 0, 1, 3, 3 },
+    { ELM3704::RTD, 800, 0, 2, 16, 0, 0, 0 },
+    { ELM3704::StrainGaugeFullBridge, 261, 5, 0, 0, 0, 0, 3 },
+    { ELM3704::Voltage, 5, 0, 0, 0, 0, 0, 0 },
+};
+
+
+// A simulated module with its driver parameters
+class Module
+{
+
+public:
+    Module(const std::string &portName) : portName(portName) {}
+
+    // Write a parameter of a channel (1-4) through asyn
+    bool write(unsigned int channel, const char *param, epicsInt32 value)
+    {
+        std::string name = "CH" + std::to_string(channel) + ":" + param;
+        std::unique_ptr<asynInt32Client> &client = clients[name];
+        if (!client)
+        {
+            client.reset(new asynInt32Client(portName.c_str(), 0, name.c_str()));
+        }
+        return client->write(value) == asynSuccess;
+    }
+
+    // Wait for the driver to read the settings of the simulated module
+    bool waitInitialised(double timeout)
+    {
+        asynOctetClient status(portName.c_str(), 0, "CH4:STATUS");
+        char buffer[64];
+        size_t nRead = 0;
+        int eomReason;
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+        while (std::chrono::steady_clock::now() < end)
+        {
+            if (status.read(buffer, sizeof(buffer), &nRead, &eomReason) == asynSuccess && nRead > 0)
+            {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+
+    const std::string portName;
+
+private:
+    std::map<std::string, std::unique_ptr<asynInt32Client> > clients;
+
+};
+
+
+// Latencies and failures of the operations of a workload
+class Results
+{
+
+public:
+    Results(const char *workload, Clock &clock) :
+        workload(workload), clock(clock), failures(0), start(std::chrono::steady_clock::now()) {}
+
+    // Time an operation, counting it as failed if it returns false
+    template <typename Operation> void time(Operation operation)
+    {
+        double before = clock.now();
+        bool ok = operation();
+        double latency = clock.now() - before;
+        std::lock_guard<std::mutex> guard(mutex);
+        latencies.push_back(latency);
+        if (!ok) failures++;
+    }
+
+    // Print the results as a line of JSON
+    void print(FILE *fp, const std::string &settings)
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::sort(latencies.begin(), latencies.end());
+        fprintf(fp, "{\"workload\": \"%s\", %s, \"operations\": %d, \"failures\": %d, \"seconds\": %.6f, "
+                "\"ops_per_second\": %.3f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}\n",
+                workload, settings.c_str(), (int) latencies.size(), failures, seconds,
+                seconds > 0.0 ? latencies.size() / seconds : 0.0,
+                percentile(0.50) * 1e3, percentile(0.95) * 1e3, percentile(0.99) * 1e3,
+                latencies.empty() ? 0.0 : latencies.back() * 1e3);
+        fflush(fp);
+    }
+
+private:
+    // Nearest rank percentile of the sorted latencies
+    double percentile(double fraction) const
+    {
+        if (latencies.empty())
+        {
+            return 0.0;
+        }
+        size_t rank = (size_t) (fraction * latencies.size() + 0.999999);
+        return latencies[std::min(std::max(rank, (size_t) 1), latencies.size()) - 1];
+    }
+
+    const char *workload;
+    Clock &clock;
+    std::mutex mutex;
+    std::vector<double> latencies;
+    int failures;
+    std::chrono::steady_clock::time_point start;
+
+};
+
+
+// Change each channel through every measurement type, ending with none
+static void typeChanges(std::vector<std::unique_ptr<Module> > &modules, unsigned int repeats, Results &results)
+{
+    for (unsigned int repeat=0; repeat<repeats; repeat++)
+    {
+        for (size_t m=0; m<modules.size(); m++)
+        {
+            for (unsigned int channel=1; channel<=4; channel++)
+            {
+                for (int type=1; type<=ELM3704Properties::numTypeOptions; type++)
+                {
+                    int value = type % ELM3704Properties::numTypeOptions;
+                    results.time([&]() { return modules[m]->write(channel, "TYPE", value); });
+                }
+            }
+        }
+    }
+}
+
+
+// Sweep the subtypes of each type, only the subtype writes are timed
+static void subtypeSweeps(std::vector<std::unique_ptr<Module> > &modules, unsigned int repeats, Results &results)
+{
+    for (unsigned int repeat=0; repeat<repeats; repeat++)
+    {
+        for (size_t m=0; m<modules.size(); m++)
+        {
+            for (unsigned int channel=1; channel<=4; channel++)
+            {
+                for (size_t t=0; t<sizeof(subtypeTables)/sizeof(subtypeTables[0]); t++)
+                {
+                    const SubtypeTable &table = subtypeTables[t];
+                    modules[m]->write(channel, "TYPE", table.type);
+                    for (int i=0; i<table.numValues; i++)
+                    {
+                        results.time([&]() { return modules[m]->write(channel, "SUBTYPE", table.values[i]); });
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+// Restore a configuration of all channels, rotated each repeat so every restore changes them
+static void fullRestores(std::vector<std::unique_ptr<Module> > &modules, unsigned int repeats, Results &results)
+{
+    for (unsigned int repeat=0; repeat<repeats; repeat++)
+    {
+        for (size_t m=0; m<modules.size(); m++)
+        {
+            results.time([&]() {
+                bool ok = true;
+                for (unsigned int channel=1; channel<=4; channel++)
+                {
+                    const ChannelConfiguration &saved = savedConfigurations[(channel + repeat) % 4];
+                    ok &= modules[m]->write(channel, "TYPE", saved.type);
+                    ok &= modules[m]->write(channel, "SUBTYPE", saved.subtype);
+                    if (saved.sensorSupply) ok &= modules[m]->write(channel, "SENSOR_SUPPLY", saved.sensorSupply);
+                    if (saved.RTDElementPage) ok &= modules[m]->write(channel, "RTD_ELEMENT_PAGE", saved.RTDElementPage);
+                    if (saved.RTDElement) ok &= modules[m]->write(channel, "RTD_ELEMENT", saved.RTDElement);
+                    if (saved.TCElementPage) ok &= modules[m]->write(channel, "TC_ELEMENT_PAGE", saved.TCElementPage);
+                    if (saved.TCElement) ok &= modules[m]->write(channel, "TC_ELEMENT", saved.TCElement);
+                    ok &= modules[m]->write(channel, "SCALER", saved.scaler);
+                }
+                return ok;
+            });
+        }
+    }
+}
+
+
+// Operators on every module at once changing voltage ranges and scalers
+static void operatorBursts(std::vector<std::unique_ptr<Module> > &modules, unsigned int repeats, Results &results)
+{
+    static const unsigned int changesPerRepeat = 20;
+    for (size_t m=0; m<modules.size(); m++)
+    {
+        for (unsigned int channel=1; channel<=4; channel++)
+        {
+            modules[m]->write(channel, "TYPE", ELM3704::Voltage);
+        }
+    }
+
+    // Hold the clock until every operator is attached to it
+    std::vector<std::thread> operators;
+    std::atomic<size_t> attached(0);
+    Clock::get().attach();
+    for (size_t m=0; m<modules.size(); m++)
+    {
+        operators.push_back(std::thread([&modules, &results, &attached, m, repeats]() {
+            ClockAttachment attachment(Clock::get());
+            attached++;
+            std::mt19937 generator(m + 1);
+            for (unsigned int change=0; change<repeats * changesPerRepeat; change++)
+            {
+                unsigned int channel = 1 + generator() % 4;
+                if (generator() % 4)
+                {
+                    int value = ELM3704Properties::voltageValues[generator() % ELM3704Properties::numVoltageOptions];
+                    results.time([&]() { return modules[m]->write(channel, "SUBTYPE", value); });
+                }
+                else
+                {
+                    int value = ELM3704Properties::DefaultScalerValues[generator() % ELM3704Properties::numDefaultScalerOptions];
+                    results.time([&]() { return modules[m]->write(channel, "SCALER", value); });
+                }
+            }
+        }));
+    }
+    while (attached < operators.size())
+    {
+        std::this_thread::yield();
+    }
+    Clock::get().detach();
+    for (size_t i=0; i<operators.size(); i++)
+    {
+        operators[i].join();
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    int numModules = 4;
+    unsigned int repeats = 3;
+    std::string writeLatency = "zero";
+    std::string readbackLatency = "zero";
+    double serviceTime = 0.0;
+    bool virtualTime = false;
+    bool verbose = false;
+    int option;
+    while ((option = getopt(argc, argv, "n:r:w:b:m:sv")) != -1)
+    {
+        switch (option)
+        {
+            case 'n': numModules = atoi(optarg); break;
+            case 'r': repeats = atoi(optarg); break;
+            case 'w': writeLatency = optarg; break;
+            case 'b': readbackLatency = optarg; break;
+            case 'm': serviceTime = atof(optarg); break;
+            case 's': virtualTime = true; break;
+            case 'v': verbose = true; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n modules] [-r repeats] [-w write latency] [-b readback latency] "
+                        "[-m mailbox service time] [-s] [-v]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    // Results go to stdout, everything the drivers print to /dev/null
+    FILE *results = fdopen(dup(fileno(stdout)), "w");
+    if (!verbose && !freopen("/dev/null", "w", stdout))
+    {
+        perror("/dev/null");
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Module> > modules;
+    std::ostringstream settings;
+    try
+    {
+        // Latencies are "<model> [a [b]]" as for SimELM3704SdoPortDriverSetLatency
+        SimLatencyModel models[2];
+        const std::string *descriptions[2] = { &writeLatency, &readbackLatency };
+        for (int i=0; i<2; i++)
+        {
+            std::istringstream words(*descriptions[i]);
+            std::string model;
+            double a = 0.0, b = 0.0;
+            words >> model >> a >> b;
+            models[i] = SimLatencyModel::fromName(model, a, b);
+        }
+
+        if (virtualTime)
+        {
+            Clock::set(new VirtualClock(true));
+        }
+        SimMailbox *mailbox = serviceTime > 0.0 ? SimMailbox::create("BENCH", serviceTime) : NULL;
+
+        // Hold the clock until every driver has started initialising
+        {
+            ClockAttachment creating(Clock::get());
+            static const int NBUFF = 255;
+            char portName[NBUFF], sdoPortName[NBUFF];
+            for (int m=1; m<=numModules; m++)
+            {
+                epicsSnprintf(portName, NBUFF, "BENCH%d", m);
+                epicsSnprintf(sdoPortName, NBUFF, "BENCH%d_SDO", m);
+                SimELM3704SdoPortDriver *sdoPort = new SimELM3704SdoPortDriver(sdoPortName, mailbox);
+                sdoPort->setLatency("*", "write", models[0]);
+                sdoPort->setLatency("*", "readback", models[1]);
+                new ELM3704(portName, sdoPortName);
+                modules.push_back(std::unique_ptr<Module>(new Module(portName)));
+            }
+        }
+        for (size_t m=0; m<modules.size(); m++)
+        {
+            if (!modules[m]->waitInitialised(60.0))
+            {
+                throw std::runtime_error(modules[m]->portName + " did not initialise");
+            }
+        }
+
+        settings << "\"modules\": " << numModules << ", \"repeats\": " << repeats
+                 << ", \"clock\": \"" << (virtualTime ? "virtual" : "system") << "\""
+                 << ", \"write_latency\": \"" << models[0].describe() << "\""
+                 << ", \"readback_latency\": \"" << models[1].describe() << "\""
+                 << ", \"mailbox_service_s\": " << serviceTime;
+    } catch (const std::runtime_error &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    typedef void (*Workload)(std::vector<std::unique_ptr<Module> > &, unsigned int, Results &);
+    static const struct { const char *name; Workload run; } workloads[] = {
+        { "types", typeChanges },
+        { "subtypes", subtypeSweeps },
+        { "restore", fullRestores },
+        { "burst", operatorBursts },
+    };
+    for (size_t w=0; w<sizeof(workloads)/sizeof(workloads[0]); w++)
+    {
+        Results workloadResults(workloads[w].name, Clock::get());
+        workloads[w].run(modules, repeats, workloadResults);
+        workloadResults.print(results, settings.str());
+    }
+
+    fclose(results);
+    return 0;
+}
@@ -0,0 +1,193 @@
+/* sdoTraceReader.cpp
+ *
+ * Prints a summary of a trace written by SdoTraceRecorder for each port and
+ * parameter, or dumps its requests as CSV (time in seconds from the start of
+ * the trace, port, parameter, write or read, value, status, duration, result,
+ * readback lag and number of readback changes).
+ *
+ * Usage: sdoTraceReader [-c] file.sdotrace
+*/
+
+#include <map>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SdoTraceFormat.h"
+
+// Seconds between the POSIX epoch and the EPICS epoch (1990-01-01)
+static const double epicsEpochOffset = 631152000.0;
+
+static const char *resultNames[] = { "matched", "timeout", "readerror", "writefailed" };
+
+
+// Per-parameter totals for the summary
+struct ParamSummary
+{
+    unsigned long writes;
+    unsigned long reads;
+    unsigned long failures[4];
+    double totalWriteTime;
+    double maxWriteTime;
+    unsigned long lags;
+    double totalLag;
+    double maxLag;
+};
+
+
+// Seconds from the end of a write to the readback showing its value, or negative if it never did
+static double readbackLag(const SdoTraceRequestRecord &record, const SdoTraceReadback *readbacks)
+{
+    for (unsigned int i=0; i<record.numReadbacks; i++)
+    {
+        SdoTraceReadback readback;
+        memcpy(&readback, &readbacks[i], sizeof(readback));
+        if (readback.status == 0 && readback.value == record.value)
+        {
+            return readback.time;
+        }
+    }
+    return -1.0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    bool csv = (argc == 3 && strcmp(argv[1], "-c") == 0);
+    if (argc != 2 && !csv)
+    {
+        fprintf(stderr, "Usage: %s [-c] file.sdotrace\n", argv[0]);
+        return 2;
+    }
+    const char *fileName = argv[argc - 1];
+
+    int fd = open(fileName, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        perror(fileName);
+        return 1;
+    }
+    size_t size = info.st_size;
+    if (size < sizeof(SdoTraceFileHeader))
+    {
+        fprintf(stderr, "%s: too short for an SDO trace\n", fileName);
+        return 1;
+    }
+    void *address = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED)
+    {
+        perror(fileName);
+        return 1;
+    }
+    const char *data = (const char *) address;
+
+    SdoTraceFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, sdoTraceFileMagic, sizeof(header.magic)) != 0 ||
+        header.version != sdoTraceFileVersion || header.headerSize > size)
+    {
+        fprintf(stderr, "%s: not a version %u SDO trace\n", fileName, sdoTraceFileVersion);
+        return 1;
+    }
+
+    if (csv)
+    {
+        printf("time,port,parameter,type,value,status,duration,result,lag,readbacks\n");
+    }
+    else
+    {
+        printf("Version:       %u\n", header.version);
+        printf("Start:         %.9f\n", header.startSeconds + epicsEpochOffset + header.startNanoseconds * 1e-9);
+    }
+
+    // Records follow until the end of the file, the last may be cut short
+    std::map<uint16_t, std::string> names;
+    std::map<std::string, ParamSummary> summaries;
+    double lastTime = 0.0;
+    size_t offset = header.headerSize;
+    while (offset + sizeof(SdoTraceRecordHeader) <= size)
+    {
+        SdoTraceRecordHeader recordHeader;
+        memcpy(&recordHeader, data + offset, sizeof(recordHeader));
+        if (recordHeader.size < sizeof(recordHeader) || offset + recordHeader.size > size)
+        {
+            break;
+        }
+        const char *recordData = data + offset;
+        offset += recordHeader.size;
+
+        if (recordHeader.type == sdoTraceName && recordHeader.size >= sizeof(SdoTraceNameRecord))
+        {
+            SdoTraceNameRecord record;
+            memcpy(&record, recordData, sizeof(record));
+            const char *text = recordData + sizeof(record);
+            names[record.id] = std::string(text, record.portLength) + "," + std::string(text + record.portLength, record.paramLength);
+        }
+        else if ((recordHeader.type == sdoTraceWrite || recordHeader.type == sdoTraceRead) &&
+                 recordHeader.size >= sizeof(SdoTraceRequestRecord))
+        {
+            SdoTraceRequestRecord record;
+            memcpy(&record, recordData, sizeof(record));
+            if (sizeof(record) + record.numReadbacks * sizeof(SdoTraceReadback) > recordHeader.size)
+            {
+                break;
+            }
+            const SdoTraceReadback *readbacks = (const SdoTraceReadback *) (recordData + sizeof(record));
+            bool write = recordHeader.type == sdoTraceWrite;
+            double lag = write ? readbackLag(record, readbacks) : -1.0;
+            const std::string &name = names[record.id];
+            lastTime = record.time;
+
+            if (csv)
+            {
+                printf("%.6f,%s,%s,%d,%d,%.6f,%s,%.6f,%u\n", record.time, name.c_str(), write ? "write" : "read",
+                       record.value, record.status, record.duration,
+                       write && record.result < 4 ? resultNames[record.result] : "", lag, record.numReadbacks);
+            }
+
+            ParamSummary &summary = summaries[name];
+            if (!write)
+            {
+                summary.reads++;
+                continue;
+            }
+            summary.writes++;
+            if (record.result < 4) summary.failures[record.result]++;
+            summary.totalWriteTime += record.duration;
+            summary.maxWriteTime = record.duration > summary.maxWriteTime ? record.duration : summary.maxWriteTime;
+            if (lag >= 0.0)
+            {
+                summary.lags++;
+                summary.totalLag += lag;
+                summary.maxLag = lag > summary.maxLag ? lag : summary.maxLag;
+            }
+        }
+    }
+
+    if (!csv)
+    {
+        printf("Duration:      %.6f s\n", lastTime);
+        printf("Parameters:    %d\n", (int) summaries.size());
+        for (std::map<std::string, ParamSummary>::const_iterator it=summaries.begin(); it!=summaries.end(); ++it)
+        {
+            const ParamSummary &summary = it->second;
+            printf("  %s: %lu writes, %lu reads, write mean %.3f s max %.3f s, readback lag mean %.3f s max %.3f s, "
+                   "%lu timeouts, %lu read errors, %lu write errors\n",
+                   it->first.c_str(), summary.writes, summary.reads,
+                   summary.writes ? summary.totalWriteTime / summary.writes : 0.0, summary.maxWriteTime,
+                   summary.lags ? summary.totalLag / summary.lags : 0.0, summary.maxLag,
+                   summary.failures[sdoTraceTimeout], summary.failures[sdoTraceReadError],
+                   summary.failures[sdoTraceWriteFailed]);
+        }
+    }
+
+    munmap(address, size);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,325 @@
+#include "simELM3704PdoPortDriver.h"
+#include "ELM3704Properties.h"
+
+#include <iocsh.h>
+#include <epicsExport.h>
+#include <epicsTime.h>
+
+#include <chrono>
+#include <stdexcept>
+
+// For logging
+static const char *driverName = "SimELM3704PdoPortDriver";
+
+// Raw value of 100 % of the measuring range (legacy range), beyond it a sample is
+// clipped and flagged as over or under range
+static const double rawFullScale = 8388607.0;
+
+// Seconds between the EPICS epoch (1990-01-01) and the EtherCAT epoch (2000-01-01)
+static const epicsUInt32 ethercatEpochOffset = 315532800u;
+
+
+// Constructor
+SimELM3704PdoPortDriver::SimELM3704PdoPortDriver(const char *portName, int oversampling, double period) : asynPortDriver(
+    portName,
+    1,
+    asynInt32Mask | asynDrvUserMask,
+    asynInt32Mask,
+    0,
+    1,
+    0,
+    0),
+    portName(portName),
+    oversampling(oversampling > 0 ? oversampling : 1),
+    period(period > 0.0 ? period : 0.001),
+    nextSample(0),
+    generator(1)
+{
+    // Create the entries of the slave port
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (unsigned int ch=0; ch<4; ch++)
+    {
+        epicsSnprintf(str, NBUFF, ELM3704Properties::cycleCounterEntryFormat, ch+1);
+        createParam(str, asynParamInt32, &cycleCounter[ch]);
+    }
+    createParam(ELM3704Properties::timestampLowEntry, asynParamInt32, &timestampLow);
+    createParam(ELM3704Properties::timestampHighEntry, asynParamInt32, &timestampHigh);
+    for (unsigned int ch=0; ch<4; ch++)
+    {
+        epicsSnprintf(str, NBUFF, ELM3704Properties::underrangeEntryFormat, ch+1);
+        createParam(str, asynParamInt32, &underrange[ch]);
+        epicsSnprintf(str, NBUFF, ELM3704Properties::overrangeEntryFormat, ch+1);
+        createParam(str, asynParamInt32, &overrange[ch]);
+        epicsSnprintf(str, NBUFF, ELM3704Properties::errorEntryFormat, ch+1);
+        createParam(str, asynParamInt32, &error[ch]);
+        epicsSnprintf(str, NBUFF, ELM3704Properties::txPdoToggleEntryFormat, ch+1);
+        createParam(str, asynParamInt32, &txPdoToggle[ch]);
+    }
+    for (unsigned int ch=0; ch<4; ch++)
+    {
+        samples[ch].resize(this->oversampling);
+        for (unsigned int index=0; index<this->oversampling; index++)
+        {
+            epicsSnprintf(str, NBUFF, ELM3704Properties::sampleEntryFormat, this->oversampling, ch+1, index);
+            createParam(str, asynParamInt32, &samples[ch][index]);
+        }
+    }
+    createParam("SIM:CYCLES", asynParamInt32, &cycles);
+    createParam("SIM:LATE_CYCLES", asynParamInt32, &lateCycles);
+
+    // Initialise values
+    for (unsigned int ch=0; ch<4; ch++)
+    {
+        setIntegerParam(cycleCounter[ch], 0);
+        setIntegerParam(underrange[ch], 0);
+        setIntegerParam(overrange[ch], 0);
+        setIntegerParam(error[ch], 0);
+        setIntegerParam(txPdoToggle[ch], 0);
+        for (unsigned int index=0; index<this->oversampling; index++)
+        {
+            setIntegerParam(samples[ch][index], 0);
+        }
+    }
+    setIntegerParam(timestampLow, 0);
+    setIntegerParam(timestampHigh, 0);
+    setIntegerParam(cycles, 0);
+    setIntegerParam(lateCycles, 0);
+
+    generateThread = std::thread(&SimELM3704PdoPortDriver::generateLoop, this);
+}
+
+
+// Set the signal of a channel
+void SimELM3704PdoPortDriver::setSignal(int channel, const SimSignal &signal)
+{
+    if (channel < 1 || channel > 4)
+    {
+        throw std::runtime_error("channel " + std::to_string(channel) + " out of range (1-4)");
+    }
+    lock();
+    signals[channel-1] = signal;
+    unlock();
+}
+
+
+/* Generate the samples of every channel for one cycle and publish them with the
+ * time of the cycle, flagging samples beyond the measuring range. The toggle bit
+ * changes every cycle, as the data is always new.
+ *
+ * Callbacks are made in the order the values changed. As on the slave, the cycle
+ * counters call back before the time, status and samples of the same cycle,
+ * which ELM3704Acquisition relies on.
+*/
+void SimELM3704PdoPortDriver::publishCycle()
+{
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    epicsUInt64 nanoseconds = (epicsUInt64) (now.secPastEpoch - ethercatEpochOffset) * 1000000000ull + now.nsec;
+    double samplePeriod = period / oversampling;
+
+    lock();
+    int count;
+    getIntegerParam(cycles, &count);
+    count++;
+    setIntegerParam(cycles, count);
+
+    setTimeStamp(&now);
+    for (unsigned int ch=0; ch<4; ch++)
+    {
+        setIntegerParam(cycleCounter[ch], count & 0xFFFF);
+    }
+    setIntegerParam(timestampLow, (epicsInt32) (epicsUInt32) nanoseconds);
+    setIntegerParam(timestampHigh, (epicsInt32) (epicsUInt32) (nanoseconds >> 32));
+    for (unsigned int ch=0; ch<4; ch++)
+    {
+        bool under = false, over = false;
+        for (unsigned int index=0; index<oversampling; index++)
+        {
+            double value = signals[ch].value(nextSample + index, samplePeriod, generator);
+            if (value > rawFullScale)
+            {
+                value = rawFullScale;
+                over = true;
+            }
+            else if (value < -rawFullScale)
+            {
+                value = -rawFullScale;
+                under = true;
+            }
+            setIntegerParam(samples[ch][index], (epicsInt32) value);
+        }
+        setIntegerParam(underrange[ch], under);
+        setIntegerParam(overrange[ch], over);
+        setIntegerParam(txPdoToggle[ch], count & 1);
+    }
+    nextSample += oversampling;
+    callParamCallbacks();
+    unlock();
+}
+
+
+/* Publish a cycle every period. Cycles are scheduled from the start so the rate
+ * does not drift, a cycle more than a period late is counted and the schedule
+ * restarts from it rather than catching up in a burst.
+*/
+void SimELM3704PdoPortDriver::generateLoop()
+{
+    const std::chrono::steady_clock::duration cycle =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(period));
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    while (true)
+    {
+        publishCycle();
+
+        next += cycle;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now > next + cycle)
+        {
+            lock();
+            int count;
+            getIntegerParam(lateCycles, &count);
+            setIntegerParam(lateCycles, count + 1);
+            unlock();
+            next = now;
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+
+// Report the signals as well as the parameters
+void SimELM3704PdoPortDriver::report(FILE *fp, int details)
+{
+    asynPortDriver::report(fp, details);
+    fprintf(fp, "  Oversampling %d, period %g s\n", oversampling, period);
+    for (unsigned int ch=0; ch<4; ch++)
+    {
+        fprintf(fp, "  Channel %d: %s\n", ch+1, signals[ch].describe().c_str());
+    }
+}
+
+
+/* EPICS IOCSH STUFF */
+
+extern "C"
+{
+
+    /** EPICS iocsh callable function to call constructor for the SimELM3704PdoPortDriver class.
+      * \param[in] portName The name of the asyn port created in this driver, as the slave port.
+      * \param[in] oversampling The number of samples per channel in each cycle
+      * \param[in] period The cycle period in seconds (default 0.001)
+      */
+    int SimELM3704PdoPortDriverConfigure(const char *portName, int oversampling, double period)
+    {
+        new SimELM3704PdoPortDriver(portName, oversampling, period);
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to set the signal of a simulated channel.
+      * \param[in] portName The name of the simulated PDO port
+      * \param[in] channel The channel (1-4)
+      * \param[in] shape constant, sine, noise, step or ramp
+      * \param[in] amplitude The amplitude in raw counts (sigma for noise)
+      * \param[in] offset The offset in raw counts
+      * \param[in] frequency The frequency in Hz
+      * \param[in] noise The sigma of gaussian noise added to the signal, in raw counts
+      */
+    int SimELM3704PdoPortDriverSetSignal(const char *portName, int channel, const char *shape,
+                                         double amplitude, double offset, double frequency, double noise)
+    {
+        SimELM3704PdoPortDriver *driver = (SimELM3704PdoPortDriver *) findAsynPortDriver(portName);
+        if (!driver)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        try
+        {
+            driver->setSignal(channel, SimSignal::fromName(shape ? shape : "", amplitude, offset, frequency, noise));
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: %s: cannot set signal: %s\n", driverName, portName, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to play a file of raw values on a simulated channel.
+      * \param[in] portName The name of the simulated PDO port
+      * \param[in] channel The channel (1-4)
+      * \param[in] fileName The file, one value per sample separated by white space
+      * \param[in] noise The sigma of gaussian noise added to the values, in raw counts
+      */
+    int SimELM3704PdoPortDriverLoadSignal(const char *portName, int channel, const char *fileName, double noise)
+    {
+        SimELM3704PdoPortDriver *driver = (SimELM3704PdoPortDriver *) findAsynPortDriver(portName);
+        if (!driver)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        try
+        {
+            driver->setSignal(channel, SimSignal::fromFile(fileName ? fileName : "", noise));
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: %s: cannot load signal: %s\n", driverName, portName, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /* EPICS iocsh shell commands */
+
+    static const iocshArg initArg0 = { "portName", iocshArgString };
+    static const iocshArg initArg1 = { "oversampling", iocshArgInt };
+    static const iocshArg initArg2 = { "period", iocshArgDouble };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1, &initArg2 };
+    static const iocshFuncDef initFuncDef = { "SimELM3704PdoPortDriverConfigure", 3, initArgs };
+
+    static void initCallFunc(const iocshArgBuf *args)
+    {
+        SimELM3704PdoPortDriverConfigure(args[0].sval, args[1].ival, args[2].dval);
+    }
+
+    static const iocshArg signalArg0 = { "portName", iocshArgString };
+    static const iocshArg signalArg1 = { "channel", iocshArgInt };
+    static const iocshArg signalArg2 = { "shape", iocshArgString };
+    static const iocshArg signalArg3 = { "amplitude", iocshArgDouble };
+    static const iocshArg signalArg4 = { "offset", iocshArgDouble };
+    static const iocshArg signalArg5 = { "frequency", iocshArgDouble };
+    static const iocshArg signalArg6 = { "noise", iocshArgDouble };
+    static const iocshArg * const signalArgs[] = { &signalArg0, &signalArg1, &signalArg2, &signalArg3, &signalArg4, &signalArg5, &signalArg6 };
+    static const iocshFuncDef signalFuncDef = { "SimELM3704PdoPortDriverSetSignal", 7, signalArgs };
+
+    static void signalCallFunc(const iocshArgBuf *args)
+    {
+        SimELM3704PdoPortDriverSetSignal(args[0].sval, args[1].ival, args[2].sval, args[3].dval, args[4].dval, args[5].dval, args[6].dval);
+    }
+
+    static const iocshArg loadArg0 = { "portName", iocshArgString };
+    static const iocshArg loadArg1 = { "channel", iocshArgInt };
+    static const iocshArg loadArg2 = { "fileName", iocshArgString };
+    static const iocshArg loadArg3 = { "noise", iocshArgDouble };
+    static const iocshArg * const loadArgs[] = { &loadArg0, &loadArg1, &loadArg2, &loadArg3 };
+    static const iocshFuncDef loadFuncDef = { "SimELM3704PdoPortDriverLoadSignal", 4, loadArgs };
+
+    static void loadCallFunc(const iocshArgBuf *args)
+    {
+        SimELM3704PdoPortDriverLoadSignal(args[0].sval, args[1].ival, args[2].sval, args[3].dval);
+    }
+
+    void SimELM3704PdoPortDriverRegister(void)
+    {
+        iocshRegister(&initFuncDef, initCallFunc);
+        iocshRegister(&signalFuncDef, signalCallFunc);
+        iocshRegister(&loadFuncDef, loadCallFunc);
+    }
+
+    epicsExportRegistrar(SimELM3704PdoPortDriverRegister);
+
+}
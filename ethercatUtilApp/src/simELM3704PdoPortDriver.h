@@ -0,0 +1,75 @@
+/*
+ * simELM3704PdoPortDriver.h
+ *
+ * Test class for simulating the PDO entries of an ELM3704 slave port. Every
+ * cycle it publishes the input cycle counters, distributed clock time, status
+ * bits and oversampled sample arrays under the same entry names as the
+ * EtherCAT slave, so the channel records and ELM3704Acquisition can run
+ * without hardware. Each channel plays a SimSignal.
+ *
+*/
+
+#ifndef SIMELM3704PDOPORTDRIVER_H
+#define SIMELM3704PDOPORTDRIVER_H
+
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asynPortDriver.h>
+
+#include "SimSignal.h"
+
+
+class SimELM3704PdoPortDriver : public asynPortDriver
+{
+
+public:
+    // Constructor
+    SimELM3704PdoPortDriver(const char *portName, int oversampling, double period);
+
+    // Overidden methods from asynPortDriver
+    virtual void report(FILE *fp, int details);
+
+    // Set the signal of a channel (1-4)
+    void setSignal(int channel, const SimSignal &signal);
+
+private:
+    // Generate and publish the entries of one cycle
+    void publishCycle();
+
+    // Thread publishing a cycle every period
+    void generateLoop();
+
+    // Attributes
+    std::string portName;
+    unsigned int oversampling;
+    double period;
+
+    // Entry asyn parameter indices, created in the order the slave updates them
+    int cycleCounter[4];
+    int timestampLow;
+    int timestampHigh;
+    int underrange[4];
+    int overrange[4];
+    int error[4];
+    int txPdoToggle[4];
+    std::vector<int> samples[4];
+
+    // Simulator asyn parameter indices
+    int cycles;
+    int lateCycles;
+
+    // Signal of each channel and the number of the next sample
+    SimSignal signals[4];
+    unsigned long long nextSample;
+
+    // Fixed seed so simulated runs can be repeated
+    std::mt19937 generator;
+
+    std::thread generateThread;
+
+};
+
+#endif /* SIMELM3704PDOPORTDRIVER_H */
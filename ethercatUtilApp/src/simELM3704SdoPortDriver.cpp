@@ -1,94 +1,594 @@
-/*
- * simELM3704SdoPortDriver.h
- *
- * Benjamin Bradnick
- *
- * Test class for simulating the ELM3704 SDO asynPortDriver
- *
-*/
-
-#include <asynPortDriver.h>
+#include "simELM3704SdoPortDriver.h"
 
 #include <iocsh.h>
 #include <epicsExport.h>
 #include <epicsThread.h>
 
+#include <math.h>
 
-class SimELM3704SdoPortDriver : public asynPortDriver
+#include <algorithm>
+#include <stdexcept>
+
+// For logging
+static const char *driverName = "SimELM3704SdoPortDriver";
+
+
+// Constructor
+SimELM3704SdoPortDriver::SimELM3704SdoPortDriver(const char *portName, SimMailbox *mailbox) : asynPortDriver(
+    portName,
+    1,
+    asynInt32Mask | asynDrvUserMask,
+    asynInt32Mask,
+    0,
+    1,
+    0,
+    0),
+    portName(portName),
+    mailbox(mailbox),
+    clock(Clock::get()),
+    generator(1),
+    disconnected(false),
+    reconnectAt(0.0)
 {
+    // Create test parameters for each channel
+    static const int NBUFF = 255;
+    char str[NBUFF];
+    for (unsigned int ch=0; ch<4; ch++)
+    {
+        // Interface
+        epicsSnprintf(str, NBUFF, "CH%d:Interface", ch+1);
+        createParam(str, asynParamInt32, &interface[ch]);
 
-public:
-    // Constructor
-    SimELM3704SdoPortDriver(const char *portName) : asynPortDriver(
-        portName,
-        1,
-        asynInt32Mask | asynDrvUserMask,
-        asynInt32Mask,
-        0,
-        1,
-        0,
-        0),
-        portName(portName)
+        // Sensor supply
+        epicsSnprintf(str, NBUFF, "CH%d:SensorSupply", ch+1);
+        createParam(str, asynParamInt32, &sensorSupply[ch]);
+
+        // RTD element
+        epicsSnprintf(str, NBUFF, "CH%d:RTDElement", ch+1);
+        createParam(str, asynParamInt32, &RTDElement[ch]);
+
+        // TC element
+        epicsSnprintf(str, NBUFF, "CH%d:TCElement", ch+1);
+        createParam(str, asynParamInt32, &TCElement[ch]);
+
+        // Scaler
+        epicsSnprintf(str, NBUFF, "CH%d:Scaler", ch+1);
+        createParam(str, asynParamInt32, &scaler[ch]);
+
+    }
+
+    // Initialise values
+    for (unsigned int ch=0; ch<4; ch++)
     {
-        // Create test parameters for each channel
-        static const int NBUFF = 255;
-        char str[NBUFF];
-        for (unsigned int ch=0; ch<4; ch++)
+        setIntegerParam(interface[ch], 0);
+        setIntegerParam(sensorSupply[ch], 0);
+        setIntegerParam(RTDElement[ch], 0);
+        setIntegerParam(TCElement[ch], 0);
+        setIntegerParam(scaler[ch], 0);
+    }
+
+    // Pretend each write takes some time, with the readback up to date when it returns
+    defaultLatency.write = SimLatencyModel(SimLatencyModel::Fixed, 1.0);
+
+    readbackThread = std::thread(&SimELM3704SdoPortDriver::readbackLoop, this);
+}
+
+
+// Latency models of a parameter, the defaults unless it has its own
+const SimELM3704SdoPortDriver::Latency &SimELM3704SdoPortDriver::latencyOf(int param) const
+{
+    std::map<int, Latency>::const_iterator it = latencies.find(param);
+    return it == latencies.end() ? defaultLatency : it->second;
+}
+
+
+/* Set the latency of one parameter or of all of them. Setting all parameters
+ * also forgets the models of individual parameters.
+*/
+void SimELM3704SdoPortDriver::setLatency(const std::string &paramName, const std::string &stage, const SimLatencyModel &model)
+{
+    bool setWrite = stage == "write" || stage == "both";
+    bool setReadback = stage == "readback" || stage == "both";
+    bool setRead = stage == "read";
+    if (!setWrite && !setReadback && !setRead)
+    {
+        throw std::runtime_error("unknown stage " + stage + " (write, readback, both or read)");
+    }
+
+    lock();
+    Latency *latency = &defaultLatency;
+    if (paramName.empty() || paramName == "*")
+    {
+        latencies.clear();
+    }
+    else
+    {
+        int param;
+        if (findParam(paramName.c_str(), &param) != asynSuccess)
+        {
+            unlock();
+            throw std::runtime_error("unknown parameter " + paramName);
+        }
+        if (latencies.find(param) == latencies.end())
+        {
+            latencies[param] = defaultLatency;
+        }
+        latency = &latencies[param];
+    }
+    if (setWrite) latency->write = model;
+    if (setReadback) latency->readback = model;
+    if (setRead) latency->read = model;
+    unlock();
+}
+
+
+/* Add a fault. Faults are checked in the order they were added and the first
+ * which hits a request decides what happens to it.
+*/
+void SimELM3704SdoPortDriver::addFault(const std::string &paramName, const SimFault &fault)
+{
+    lock();
+    int param = -1;
+    if (!paramName.empty() && paramName != "*" && findParam(paramName.c_str(), &param) != asynSuccess)
+    {
+        unlock();
+        throw std::runtime_error("unknown parameter " + paramName);
+    }
+    faults.push_back(std::make_pair(param, fault));
+    unlock();
+}
+
+
+// Remove all faults, ending any stuck readbacks and disconnect
+void SimELM3704SdoPortDriver::clearFaults()
+{
+    lock();
+    faults.clear();
+    stuckUntil.clear();
+    reconnectAt = clock.now();
+    clock.signal(pendingEvent);
+    unlock();
+}
+
+
+/* Turn the recorded writes of a port into the outcomes to replay. The readback
+ * lag of a write is the time of the first poll which saw the written value, so
+ * it is rounded up to the poll interval of SdoPortClient. A write whose readback
+ * never reached the value is replayed as lost, and one whose polling failed
+ * fails the reads from when it did.
+*/
+size_t SimELM3704SdoPortDriver::loadReplay(const std::vector<SdoTraceRequest> &requests, const std::string &tracePortName)
+{
+    std::map<int, std::deque<ReplayedWrite> > loaded;
+    size_t count = 0;
+    lock();
+    for (size_t i=0; i<requests.size(); i++)
+    {
+        const SdoTraceRequest &request = requests[i];
+        int param;
+        if (!request.write || request.portName != tracePortName ||
+            findParam(request.paramName.c_str(), &param) != asynSuccess)
+        {
+            continue;
+        }
+        ReplayedWrite replayed;
+        replayed.writeDelay = request.duration;
+        replayed.readbackDelay = 0.0;
+        replayed.status = request.status;
+        replayed.lost = request.result == sdoTraceTimeout;
+        replayed.readErrorDelay = -1.0;
+        for (size_t j=0; j<request.readbacks.size(); j++)
+        {
+            if (request.readbacks[j].status == asynSuccess && request.readbacks[j].value == request.value)
+            {
+                replayed.readbackDelay = request.readbacks[j].time;
+                break;
+            }
+        }
+        if (request.result == sdoTraceReadError && !request.readbacks.empty())
+        {
+            replayed.readErrorDelay = request.readbacks.back().time;
+            replayed.readbackDelay = replayed.readErrorDelay;
+        }
+        loaded[param].push_back(replayed);
+        count++;
+    }
+    if (count)
+    {
+        replay.swap(loaded);
+    }
+    unlock();
+    if (!count)
+    {
+        throw std::runtime_error("no writes recorded for port " + tracePortName);
+    }
+    return count;
+}
+
+
+// Count the request towards every matching fault, returning the first which hits it
+SimFault *SimELM3704SdoPortDriver::injectFault(int param, bool read)
+{
+    SimFault *hit = NULL;
+    for (size_t i=0; i<faults.size(); i++)
+    {
+        SimFault &fault = faults[i].second;
+        if ((faults[i].first == -1 || faults[i].first == param) && fault.appliesToReads() == read &&
+            fault.trigger(generator) && !hit)
+        {
+            hit = &fault;
+        }
+    }
+    return hit;
+}
+
+
+// Take the port offline, as if the slave had dropped off the bus
+void SimELM3704SdoPortDriver::startDisconnect(double duration)
+{
+    disconnected = true;
+    reconnectAt = clock.now() + duration;
+    pasynManager->exceptionDisconnect(pasynUserSelf);
+    clock.signal(pendingEvent);
+}
+
+
+// Refuse to connect while a disconnect fault lasts
+asynStatus SimELM3704SdoPortDriver::connect(asynUser *pasynUser)
+{
+    if (disconnected)
+    {
+        epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize, "%s: simulated disconnect", portName.c_str());
+        return asynError;
+    }
+    return asynPortDriver::connect(pasynUser);
+}
+
+
+/* Reads are SDO uploads, so they queue for the shared mailbox as writes do and
+ * take the read latency, without holding the port lock. They fail while
+ * disconnected or when a read fault hits them, and otherwise see every
+ * readback due by the time they finish.
+*/
+asynStatus SimELM3704SdoPortDriver::readInt32(asynUser *pasynUser, epicsInt32 *value)
+{
+    if (disconnected)
+    {
+        return asynDisconnected;
+    }
+
+    // Queue for the shared mailbox, then the module takes the read latency
+    double readDelay = latencyOf(pasynUser->reason).read.sample(generator);
+    if (mailbox || readDelay > 0.0)
+    {
+        unlock();
+        if (mailbox)
+        {
+            mailbox->transfer();
+        }
+        if (readDelay > 0.0)
+        {
+            clock.sleep(readDelay);
+        }
+        lock();
+        if (disconnected)
         {
-            // Interface
-            epicsSnprintf(str, NBUFF, "CH%d:Interface", ch+1);
-            createParam(str, asynParamInt32, &interface[ch]);
+            return asynDisconnected;
+        }
+    }
+    std::map<int, double>::const_iterator failing = readErrorFrom.find(pasynUser->reason);
+    if (injectFault(pasynUser->reason, true) ||
+        (failing != readErrorFrom.end() && failing->second <= clock.now()))
+    {
+        epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize, "%s: simulated read error", portName.c_str());
+        return asynError;
+    }
+    applyDueReadbacks(clock.now());
+    return asynPortDriver::readInt32(pasynUser, value);
+}
 
-            // Sensor supply
-            epicsSnprintf(str, NBUFF, "CH%d:SensorSupply", ch+1);
-            createParam(str, asynParamInt32, &sensorSupply[ch]);
 
-            // RTD element
-            epicsSnprintf(str, NBUFF, "CH%d:RTDElement", ch+1);
-            createParam(str, asynParamInt32, &RTDElement[ch]);
+/* Wait for the shared mailbox and the write latency, without holding the port
+ * lock so reads carry on, then either store the value or queue it until its
+ * readback lag has passed. A later write to the same parameter replaces a value still queued. The device
+ * model can reject the value or change other settings of the channel, which
+ * reach the readback with the same delay.
+ *
+ * A fault can fail the write or disconnect the port before the latency, or once
+ * it has passed lose the value, freeze the readback or store a different value.
+ * A replayed write takes its latencies from the trace and can also fail or be
+ * lost once its latency has passed, as the recorded write did.
+*/
+asynStatus SimELM3704SdoPortDriver::writeInt32(asynUser *pasynUser, epicsInt32 value)
+{
+    const int param = pasynUser->reason;
+    const char *paramName;
+    getParamName(param, &paramName);
 
-            // TC element
-            epicsSnprintf(str, NBUFF, "CH%d:TCElement", ch+1);
-            createParam(str, asynParamInt32, &TCElement[ch]);
+    if (disconnected)
+    {
+        return asynDisconnected;
+    }
+    readErrorFrom.erase(param);
+    SimFault *fault = injectFault(param, false);
+    auto hits = [fault](SimFault::Kind kind) { return fault && fault->getKind() == kind; };
+    if (hits(SimFault::WriteError))
+    {
+        epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize, "%s: simulated write error", portName.c_str());
+        return asynError;
+    }
+    if (hits(SimFault::Disconnect))
+    {
+        asynPrint(pasynUser, ASYN_TRACE_WARNING, "%s: simulated disconnect for %g s writing %s\n",
+                  portName.c_str(), fault->getArgument(), paramName);
+        startDisconnect(fault->getArgument());
+        return asynDisconnected;
+    }
+    if (hits(SimFault::StuckReadback))
+    {
+        stuckUntil[param] = fault->getArgument() > 0.0 ? clock.now() + fault->getArgument() : HUGE_VAL;
+    }
+    if (hits(SimFault::Clamp))
+    {
+        value = (epicsInt32) fault->getArgument();
+    }
+    // The fault list can change while the port is unlocked
+    bool dropped = hits(SimFault::DropWrite);
 
-            // Scaler
-            epicsSnprintf(str, NBUFF, "CH%d:Scaler", ch+1);
-            createParam(str, asynParamInt32, &scaler[ch]);
+    // The next recorded write to the parameter takes the place of the latency models
+    std::map<int, std::deque<ReplayedWrite> >::iterator queue = replay.find(param);
+    bool replaying = queue != replay.end() && !queue->second.empty();
+    ReplayedWrite replayed;
+    double writeDelay, readbackDelay;
+    if (replaying)
+    {
+        replayed = queue->second.front();
+        queue->second.pop_front();
+        writeDelay = replayed.writeDelay;
+        readbackDelay = replayed.readbackDelay;
+    }
+    else
+    {
+        const Latency &latency = latencyOf(param);
+        writeDelay = latency.write.sample(generator);
+        readbackDelay = latency.readback.sample(generator);
+    }
+    asynPrint(pasynUser, ASYN_TRACEIO_DRIVER, "%s: writing value %d to %s (write %.3f s, readback %.3f s)\n",
+              portName.c_str(), value, paramName, writeDelay, readbackDelay);
 
+    // Queue for the shared mailbox, then the module takes the write latency
+    if (mailbox || writeDelay > 0.0)
+    {
+        unlock();
+        if (mailbox)
+        {
+            mailbox->transfer();
         }
+        if (writeDelay > 0.0)
+        {
+            clock.sleep(writeDelay);
+        }
+        lock();
+    }
 
-        // Initialise values
-        for (unsigned int ch=0; ch<4; ch++)
+    if (replaying)
+    {
+        if (replayed.status != asynSuccess)
         {
-            setIntegerParam(interface[ch], 0);
-            setIntegerParam(sensorSupply[ch], 0);
-            setIntegerParam(RTDElement[ch], 0);
-            setIntegerParam(TCElement[ch], 0);
-            setIntegerParam(scaler[ch], 0);
+            epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize,
+                          "%s: replayed write error (status %d)", portName.c_str(), replayed.status);
+            return replayed.status;
         }
+        if (replayed.readErrorDelay >= 0.0)
+        {
+            readErrorFrom[param] = clock.now() + replayed.readErrorDelay;
+        }
+        dropped = dropped || replayed.lost;
     }
 
-    // Overide writeInt32 for basic logging
-    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value)
+    // A lost write or frozen readback still reports success, only the readback shows it
+    std::map<int, double>::iterator stuck = stuckUntil.find(param);
+    if (stuck != stuckUntil.end() && stuck->second <= clock.now())
+    {
+        stuckUntil.erase(stuck);
+        stuck = stuckUntil.end();
+    }
+    if (dropped || stuck != stuckUntil.end())
+    {
+        return asynSuccess;
+    }
+
+    // The device checks the value and can change other settings of the channel
+    unsigned int channel;
+    SimELM3704Device::Setting setting;
+    if (!findSetting(param, channel, setting))
     {
-        printf("%s: writing value %d to param %d\n", portName.c_str(), pasynUser->reason, value);
-        // Pretend to take some time
-        epicsThreadSleep(1.0);
         return asynPortDriver::writeInt32(pasynUser, value);
     }
+    epicsInt32 before[SimELM3704Device::numSettings];
+    for (int other=0; other<SimELM3704Device::numSettings; other++)
+    {
+        before[other] = device.get(channel, (SimELM3704Device::Setting) other);
+    }
+    try
+    {
+        device.write(channel, setting, value);
+    } catch (const std::runtime_error &e)
+    {
+        epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize,
+                      "%s: SDO abort 0x06090030 (value range exceeded): %s", portName.c_str(), e.what());
+        return asynError;
+    }
+    for (int other=0; other<SimELM3704Device::numSettings; other++)
+    {
+        epicsInt32 current = device.get(channel, (SimELM3704Device::Setting) other);
+        if (other == setting || current != before[other])
+        {
+            updateReadback(settingParam(channel, (SimELM3704Device::Setting) other), current, readbackDelay);
+        }
+    }
+    if (readbackDelay <= 0.0)
+    {
+        callParamCallbacks();
+    }
+    else
+    {
+        clock.signal(pendingEvent);
+    }
+    return asynSuccess;
+}
+
+
+// Parameter of a setting of a channel
+int SimELM3704SdoPortDriver::settingParam(unsigned int channel, SimELM3704Device::Setting setting) const
+{
+    switch (setting)
+    {
+        case SimELM3704Device::Interface: return interface[channel];
+        case SimELM3704Device::SensorSupply: return sensorSupply[channel];
+        case SimELM3704Device::RTDElement: return RTDElement[channel];
+        case SimELM3704Device::TCElement: return TCElement[channel];
+        default: return scaler[channel];
+    }
+}
+
+
+// Channel and setting of a parameter
+bool SimELM3704SdoPortDriver::findSetting(int param, unsigned int &channel, SimELM3704Device::Setting &setting) const
+{
+    for (channel=0; channel<4; channel++)
+    {
+        for (int candidate=0; candidate<SimELM3704Device::numSettings; candidate++)
+        {
+            setting = (SimELM3704Device::Setting) candidate;
+            if (settingParam(channel, setting) == param)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+/* Change the readback of a parameter now, or queue the change until the delay
+ * has passed. A change still queued for the parameter is replaced.
+*/
+void SimELM3704SdoPortDriver::updateReadback(int param, epicsInt32 value, double delay)
+{
+    pendingReadbacks.erase(
+        std::remove_if(pendingReadbacks.begin(), pendingReadbacks.end(),
+                       [param](const PendingReadback &pending) { return pending.param == param; }),
+        pendingReadbacks.end()
+    );
+    if (delay <= 0.0)
+    {
+        setIntegerParam(param, value);
+        return;
+    }
+
+    PendingReadback pending;
+    pending.due = clock.now() + delay;
+    pending.param = param;
+    pending.value = value;
+    pendingReadbacks.push_back(pending);
+}
+
+
+// Apply the queued values which are due, returning when the next one is
+double SimELM3704SdoPortDriver::applyDueReadbacks(double now)
+{
+    double next = HUGE_VAL;
+    bool changed = false;
+    for (auto it = pendingReadbacks.begin(); it != pendingReadbacks.end(); )
+    {
+        if (it->due <= now)
+        {
+            setIntegerParam(it->param, it->value);
+            changed = true;
+            it = pendingReadbacks.erase(it);
+        }
+        else
+        {
+            next = std::min(next, it->due);
+            ++it;
+        }
+    }
+    if (changed)
+    {
+        callParamCallbacks();
+    }
+    return next;
+}
 
-private:
-    // Attributes
-    std::string portName;
 
-    // Simulated asynParameter indices for each channel
-    int interface[4];
-    int sensorSupply[4];
-    int RTDElement[4];
-    int TCElement[4];
-    int scaler[4];
+/* Apply queued values once they are due, sleeping until the next one. The
+ * thread is not attached to the clock, as it takes the port lock, which a
+ * request waiting on the clock can hold. Reads apply the due values themselves,
+ * so they do not depend on when this thread runs.
+*/
+void SimELM3704SdoPortDriver::readbackLoop()
+{
+    while (true)
+    {
+        lock();
+        double now = clock.now();
+        double next = applyDueReadbacks(now);
+        if (disconnected)
+        {
+            if (reconnectAt <= now)
+            {
+                disconnected = false;
+                pasynManager->exceptionConnect(pasynUserSelf);
+            }
+            else
+            {
+                next = std::min(next, reconnectAt);
+            }
+        }
+        unlock();
 
-};
+        clock.wait(pendingEvent, next == HUGE_VAL ? -1.0 : next - now);
+    }
+}
+
+
+// Report the latency models and faults as well as the parameters
+void SimELM3704SdoPortDriver::report(FILE *fp, int details)
+{
+    asynPortDriver::report(fp, details);
+    fprintf(fp, "  Write latency: %s\n", defaultLatency.write.describe().c_str());
+    fprintf(fp, "  Readback latency: %s\n", defaultLatency.readback.describe().c_str());
+    fprintf(fp, "  Read latency: %s\n", defaultLatency.read.describe().c_str());
+    for (std::map<int, Latency>::const_iterator it = latencies.begin(); it != latencies.end(); ++it)
+    {
+        const char *paramName;
+        getParamName(it->first, &paramName);
+        fprintf(fp, "  %s: write %s, readback %s\n",
+                paramName, it->second.write.describe().c_str(), it->second.readback.describe().c_str());
+    }
+    fprintf(fp, "  Readbacks pending: %d\n", (int) pendingReadbacks.size());
+    size_t replayed = 0;
+    for (std::map<int, std::deque<ReplayedWrite> >::const_iterator it = replay.begin(); it != replay.end(); ++it)
+    {
+        replayed += it->second.size();
+    }
+    fprintf(fp, "  Recorded writes to replay: %d\n", (int) replayed);
+    for (size_t i=0; i<faults.size(); i++)
+    {
+        const char *paramName = "*";
+        if (faults[i].first != -1)
+        {
+            getParamName(faults[i].first, &paramName);
+        }
+        fprintf(fp, "  Fault on %s: %s\n", paramName, faults[i].second.describe().c_str());
+    }
+    fprintf(fp, "  Stuck readbacks: %d%s\n", (int) stuckUntil.size(), disconnected ? ", disconnected" : "");
+    if (mailbox)
+    {
+        mailbox->report(fp);
+    }
+}
 
 
 /* EPICS IOCSH STUFF */
@@ -98,10 +598,193 @@ extern "C"
 
     /** EPICS iocsh callable function to call constructor for the TestSdoPortDriver class.
       * \param[in] portName The name of the asyn port created in this driver.
+      * \param[in] mailboxName The mailbox shared with other slaves (optional)
+      */
+    int SimELM3704SdoPortDriverConfigure(const char *portName, const char *mailboxName)
+    {
+        SimMailbox *mailbox = NULL;
+        if (mailboxName && mailboxName[0])
+        {
+            mailbox = SimMailbox::find(mailboxName);
+            if (!mailbox)
+            {
+                printf("%s: %s: cannot find mailbox %s\n", driverName, portName, mailboxName);
+                return(asynError);
+            }
+        }
+        new SimELM3704SdoPortDriver(portName, mailbox);
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to create the shared mailbox of a simulated master.
+      * \param[in] mailboxName The name of the mailbox
+      * \param[in] serviceTime The time each SDO transfer holds the mailbox, in seconds
+      */
+    int SimMailboxConfigure(const char *mailboxName, double serviceTime)
+    {
+        try
+        {
+            SimMailbox::create(mailboxName ? mailboxName : "", serviceTime);
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: cannot create mailbox: %s\n", driverName, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to create a simulated master with a number of ELM3704
+      * slaves sharing its mailbox. The slaves have no write latency of their own, so the
+      * mailbox is the only delay until it is set with SimELM3704SdoPortDriverSetLatency.
+      * \param[in] mailboxName The name of the mailbox
+      * \param[in] serviceTime The time each SDO transfer holds the mailbox, in seconds
+      * \param[in] numSlaves The number of slaves
+      * \param[in] portFormat The port name of each slave, numbered from 1, e.g. SIM%d_SDO
+      */
+    int SimELM3704MasterConfigure(const char *mailboxName, double serviceTime, int numSlaves, const char *portFormat)
+    {
+        if (SimMailboxConfigure(mailboxName, serviceTime) != asynSuccess)
+        {
+            return(asynError);
+        }
+        SimMailbox *mailbox = SimMailbox::find(mailboxName);
+        static const int NBUFF = 255;
+        char portName[NBUFF];
+        for (int slave=1; slave<=numSlaves; slave++)
+        {
+            epicsSnprintf(portName, NBUFF, portFormat ? portFormat : "SIM%d_SDO", slave);
+            SimELM3704SdoPortDriver *driver = new SimELM3704SdoPortDriver(portName, mailbox);
+            driver->setLatency("*", "write", SimLatencyModel(SimLatencyModel::Zero));
+        }
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to print the statistics of a simulated mailbox.
+      * \param[in] mailboxName The name of the mailbox
       */
-    int SimELM3704SdoPortDriverConfigure(const char *portName)
+    int SimMailboxReport(const char *mailboxName)
     {
-        new SimELM3704SdoPortDriver(portName);
+        SimMailbox *mailbox = SimMailbox::find(mailboxName ? mailboxName : "");
+        if (!mailbox)
+        {
+            printf("%s: cannot find mailbox %s\n", driverName, mailboxName);
+            return(asynError);
+        }
+        mailbox->report(stdout);
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to set a latency model of the simulated SDO port.
+      * \param[in] portName The name of the simulated SDO port
+      * \param[in] paramName The parameter, e.g. CH1:Interface, or "*" for all of them
+      * \param[in] stage The write, its readback, both or a read
+      * \param[in] model zero, fixed, uniform, normal or longtail
+      * \param[in] a The delay, minimum, mean or median in seconds
+      * \param[in] b The maximum or standard deviation in seconds, or the long tail shape
+      */
+    int SimELM3704SdoPortDriverSetLatency(const char *portName, const char *paramName, const char *stage,
+                                          const char *model, double a, double b)
+    {
+        SimELM3704SdoPortDriver *driver = (SimELM3704SdoPortDriver *) findAsynPortDriver(portName);
+        if (!driver)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        try
+        {
+            driver->setLatency(
+                paramName ? paramName : "",
+                stage ? stage : "both",
+                SimLatencyModel::fromName(model ? model : "zero", a, b)
+            );
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: %s: cannot set latency: %s\n", driverName, portName, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to inject a fault into the simulated SDO port.
+      * \param[in] portName The name of the simulated SDO port
+      * \param[in] paramName The parameter, e.g. CH1:Interface, or "*" for all of them
+      * \param[in] fault drop, stuck, error, readerror, disconnect or clamp
+      * \param[in] probability The chance of each request being hit, used without a schedule
+      * \param[in] every Hit every Nth request instead (0 for none)
+      * \param[in] count The number of times to inject the fault (0 for no limit)
+      * \param[in] argument Seconds for stuck (0 until cleared) and disconnect, the value for clamp
+      */
+    int SimELM3704SdoPortDriverAddFault(const char *portName, const char *paramName, const char *fault,
+                                        double probability, int every, int count, double argument)
+    {
+        SimELM3704SdoPortDriver *driver = (SimELM3704SdoPortDriver *) findAsynPortDriver(portName);
+        if (!driver)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        try
+        {
+            driver->addFault(
+                paramName ? paramName : "",
+                SimFault::fromName(fault ? fault : "", probability, every, count, argument)
+            );
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: %s: cannot add fault: %s\n", driverName, portName, e.what());
+            return(asynError);
+        }
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to remove all faults from the simulated SDO port.
+      * \param[in] portName The name of the simulated SDO port
+      */
+    int SimELM3704SdoPortDriverClearFaults(const char *portName)
+    {
+        SimELM3704SdoPortDriver *driver = (SimELM3704SdoPortDriver *) findAsynPortDriver(portName);
+        if (!driver)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        driver->clearFaults();
+        return(asynSuccess);
+    }
+
+
+    /** EPICS iocsh callable function to replay a trace recorded by SdoTraceStart on the simulated SDO port.
+      * \param[in] portName The name of the simulated SDO port
+      * \param[in] fileName The trace file
+      * \param[in] tracePortName The port whose writes to replay, if not the same as portName
+      */
+    int SimELM3704SdoPortDriverReplay(const char *portName, const char *fileName, const char *tracePortName)
+    {
+        SimELM3704SdoPortDriver *driver = (SimELM3704SdoPortDriver *) findAsynPortDriver(portName);
+        if (!driver)
+        {
+            printf("%s: cannot find port %s\n", driverName, portName);
+            return(asynError);
+        }
+        try
+        {
+            size_t count = driver->loadReplay(
+                SdoTraceRecorder::load(fileName ? fileName : ""),
+                tracePortName && tracePortName[0] ? tracePortName : portName
+            );
+            printf("%s: %s: replaying %d recorded writes\n", driverName, portName, (int) count);
+        } catch (const std::runtime_error &e)
+        {
+            printf("%s: %s: cannot replay trace: %s\n", driverName, portName, e.what());
+            return(asynError);
+        }
         return(asynSuccess);
     }
 
@@ -109,19 +792,107 @@ extern "C"
     /* EPICS iocsh shell commands */
 
     static const iocshArg initArg0 = { "portName", iocshArgString };
-    static const iocshArg * const initArgs[] = { &initArg0 };
-    static const iocshFuncDef initFuncDef = { "SimELM3704SdoPortDriverConfigure", 1, initArgs };
+    static const iocshArg initArg1 = { "mailboxName", iocshArgString };
+    static const iocshArg * const initArgs[] = { &initArg0, &initArg1 };
+    static const iocshFuncDef initFuncDef = { "SimELM3704SdoPortDriverConfigure", 2, initArgs };
 
     static void initCallFunc(const iocshArgBuf *args)
     {
-        SimELM3704SdoPortDriverConfigure(args[0].sval);
+        SimELM3704SdoPortDriverConfigure(args[0].sval, args[1].sval);
+    }
+
+    static const iocshArg mailboxArg0 = { "mailboxName", iocshArgString };
+    static const iocshArg mailboxArg1 = { "serviceTime", iocshArgDouble };
+    static const iocshArg * const mailboxArgs[] = { &mailboxArg0, &mailboxArg1 };
+    static const iocshFuncDef mailboxFuncDef = { "SimMailboxConfigure", 2, mailboxArgs };
+
+    static void mailboxCallFunc(const iocshArgBuf *args)
+    {
+        SimMailboxConfigure(args[0].sval, args[1].dval);
+    }
+
+    static const iocshArg masterArg0 = { "mailboxName", iocshArgString };
+    static const iocshArg masterArg1 = { "serviceTime", iocshArgDouble };
+    static const iocshArg masterArg2 = { "numSlaves", iocshArgInt };
+    static const iocshArg masterArg3 = { "portFormat", iocshArgString };
+    static const iocshArg * const masterArgs[] = { &masterArg0, &masterArg1, &masterArg2, &masterArg3 };
+    static const iocshFuncDef masterFuncDef = { "SimELM3704MasterConfigure", 4, masterArgs };
+
+    static void masterCallFunc(const iocshArgBuf *args)
+    {
+        SimELM3704MasterConfigure(args[0].sval, args[1].dval, args[2].ival, args[3].sval);
+    }
+
+    static const iocshArg mailboxReportArg0 = { "mailboxName", iocshArgString };
+    static const iocshArg * const mailboxReportArgs[] = { &mailboxReportArg0 };
+    static const iocshFuncDef mailboxReportFuncDef = { "SimMailboxReport", 1, mailboxReportArgs };
+
+    static void mailboxReportCallFunc(const iocshArgBuf *args)
+    {
+        SimMailboxReport(args[0].sval);
+    }
+
+    static const iocshArg latencyArg0 = { "portName", iocshArgString };
+    static const iocshArg latencyArg1 = { "paramName", iocshArgString };
+    static const iocshArg latencyArg2 = { "stage", iocshArgString };
+    static const iocshArg latencyArg3 = { "model", iocshArgString };
+    static const iocshArg latencyArg4 = { "a", iocshArgDouble };
+    static const iocshArg latencyArg5 = { "b", iocshArgDouble };
+    static const iocshArg * const latencyArgs[] = { &latencyArg0, &latencyArg1, &latencyArg2, &latencyArg3, &latencyArg4, &latencyArg5 };
+    static const iocshFuncDef latencyFuncDef = { "SimELM3704SdoPortDriverSetLatency", 6, latencyArgs };
+
+    static void latencyCallFunc(const iocshArgBuf *args)
+    {
+        SimELM3704SdoPortDriverSetLatency(args[0].sval, args[1].sval, args[2].sval, args[3].sval, args[4].dval, args[5].dval);
+    }
+
+    static const iocshArg faultArg0 = { "portName", iocshArgString };
+    static const iocshArg faultArg1 = { "paramName", iocshArgString };
+    static const iocshArg faultArg2 = { "fault", iocshArgString };
+    static const iocshArg faultArg3 = { "probability", iocshArgDouble };
+    static const iocshArg faultArg4 = { "every", iocshArgInt };
+    static const iocshArg faultArg5 = { "count", iocshArgInt };
+    static const iocshArg faultArg6 = { "argument", iocshArgDouble };
+    static const iocshArg * const faultArgs[] = { &faultArg0, &faultArg1, &faultArg2, &faultArg3, &faultArg4, &faultArg5, &faultArg6 };
+    static const iocshFuncDef faultFuncDef = { "SimELM3704SdoPortDriverAddFault", 7, faultArgs };
+
+    static void faultCallFunc(const iocshArgBuf *args)
+    {
+        SimELM3704SdoPortDriverAddFault(args[0].sval, args[1].sval, args[2].sval, args[3].dval, args[4].ival, args[5].ival, args[6].dval);
+    }
+
+    static const iocshArg clearArg0 = { "portName", iocshArgString };
+    static const iocshArg * const clearArgs[] = { &clearArg0 };
+    static const iocshFuncDef clearFuncDef = { "SimELM3704SdoPortDriverClearFaults", 1, clearArgs };
+
+    static void clearCallFunc(const iocshArgBuf *args)
+    {
+        SimELM3704SdoPortDriverClearFaults(args[0].sval);
+    }
+
+    static const iocshArg replayArg0 = { "portName", iocshArgString };
+    static const iocshArg replayArg1 = { "fileName", iocshArgString };
+    static const iocshArg replayArg2 = { "tracePortName", iocshArgString };
+    static const iocshArg * const replayArgs[] = { &replayArg0, &replayArg1, &replayArg2 };
+    static const iocshFuncDef replayFuncDef = { "SimELM3704SdoPortDriverReplay", 3, replayArgs };
+
+    static void replayCallFunc(const iocshArgBuf *args)
+    {
+        SimELM3704SdoPortDriverReplay(args[0].sval, args[1].sval, args[2].sval);
     }
 
     void SimELM3704SdoPortDriverRegister(void)
     {
         iocshRegister(&initFuncDef, initCallFunc);
+        iocshRegister(&latencyFuncDef, latencyCallFunc);
+        iocshRegister(&faultFuncDef, faultCallFunc);
+        iocshRegister(&clearFuncDef, clearCallFunc);
+        iocshRegister(&replayFuncDef, replayCallFunc);
+        iocshRegister(&mailboxFuncDef, mailboxCallFunc);
+        iocshRegister(&masterFuncDef, masterCallFunc);
+        iocshRegister(&mailboxReportFuncDef, mailboxReportCallFunc);
     }
 
     epicsExportRegistrar(SimELM3704SdoPortDriverRegister);
 
-}
\ No newline at end of file
+}
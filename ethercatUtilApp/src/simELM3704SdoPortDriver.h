@@ -0,0 +1,173 @@
+/*
+ * simELM3704SdoPortDriver.h
+ *
+ * Benjamin Bradnick
+ *
+ * Test class for simulating the ELM3704 SDO asynPortDriver
+ *
+ * The settings behave as on the module, see SimELM3704Device. Each parameter
+ * has a latency model for how long a write blocks, another for how long after
+ * the write its readback changes, so SdoPortClient sees the old value until
+ * then, and one for how long a read blocks. All can be set from iocsh,
+ * including to zero so that functional tests run without waiting, and are
+ * timed with the Clock in use.
+ *
+ * Slaves can share a SimMailbox, which serialises their reads and writes as the mailbox
+ * of a real master does.
+ *
+ * Faults can be injected into the requests, e.g. lost writes or a disconnect,
+ * to exercise the error paths of SdoPortClient and ELM3704.
+ *
+ * A trace recorded by SdoTraceRecorder on a real rack can be replayed: each
+ * write to a parameter then takes the latency, status and readback lag of the
+ * next write recorded for it, until the recorded writes run out.
+ *
+*/
+
+#ifndef SIMELM3704SDOPORTDRIVER_H
+#define SIMELM3704SDOPORTDRIVER_H
+
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asynPortDriver.h>
+#include <epicsEvent.h>
+
+#include "SimLatencyModel.h"
+#include "SimFault.h"
+#include "SimELM3704Device.h"
+#include "SimMailbox.h"
+#include "SdoTraceRecorder.h"
+#include "Clock.h"
+
+
+class SimELM3704SdoPortDriver : public asynPortDriver
+{
+
+public:
+    // Constructor, with the mailbox of the simulated master or NULL for none
+    SimELM3704SdoPortDriver(const char *portName, SimMailbox *mailbox = NULL);
+
+    // Overidden methods from asynPortDriver
+    virtual asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+    virtual asynStatus readInt32(asynUser *pasynUser, epicsInt32 *value);
+    virtual asynStatus connect(asynUser *pasynUser);
+    virtual void report(FILE *fp, int details);
+
+    // Set the latency of a write ("write"), of its readback ("readback"), both
+    // ("both") or of a read ("read") for one parameter, or for all parameters
+    // with an empty name or "*"
+    void setLatency(const std::string &paramName, const std::string &stage, const SimLatencyModel &model);
+
+    // Inject a fault into requests for one parameter, or all with an empty name or "*"
+    void addFault(const std::string &paramName, const SimFault &fault);
+
+    // Remove all faults, ending any stuck readbacks and disconnect
+    void clearFaults();
+
+    // Replay the writes recorded for a port in a trace, replacing any not replayed yet.
+    // Returns the number of writes loaded.
+    size_t loadReplay(const std::vector<SdoTraceRequest> &requests, const std::string &tracePortName);
+
+private:
+    // Latency models of a parameter
+    struct Latency
+    {
+        SimLatencyModel write;
+        SimLatencyModel readback;
+        SimLatencyModel read;
+    };
+
+    // A written value which has not reached the readback yet
+    struct PendingReadback
+    {
+        double due;
+        int param;
+        epicsInt32 value;
+    };
+
+    // Outcome of a recorded write, replayed in place of the latency models
+    struct ReplayedWrite
+    {
+        double writeDelay;
+        double readbackDelay;
+        asynStatus status;
+        bool lost;                  // The readback never showed the value
+        double readErrorDelay;      // Reads fail from this time after the write, or negative
+    };
+
+    // Latency models of a parameter, the defaults unless it has its own
+    const Latency &latencyOf(int param) const;
+
+    // The first fault which hits a request, or NULL
+    SimFault *injectFault(int param, bool read);
+
+    // Start a disconnect, the readback thread reconnects when it is over
+    void startDisconnect(double duration);
+
+    // Parameter of a setting of a channel, and the reverse
+    int settingParam(unsigned int channel, SimELM3704Device::Setting setting) const;
+    bool findSetting(int param, unsigned int &channel, SimELM3704Device::Setting &setting) const;
+
+    // Change the readback of a parameter now or after a delay
+    void updateReadback(int param, epicsInt32 value, double delay);
+
+    // Apply the queued values which are due, returning when the next one is
+    double applyDueReadbacks(double now);
+
+    // Thread applying written values when their readback lag has passed
+    void readbackLoop();
+
+    // Attributes
+    std::string portName;
+
+    // Simulated asynParameter indices for each channel
+    int interface[4];
+    int sensorSupply[4];
+    int RTDElement[4];
+    int TCElement[4];
+    int scaler[4];
+
+    // Settings of the simulated module
+    SimELM3704Device device;
+
+    // Mailbox shared with the other slaves of the master, or NULL
+    SimMailbox *mailbox;
+
+    // Clock of the latencies and faults
+    Clock &clock;
+
+    // Latency of parameters without their own models
+    Latency defaultLatency;
+    std::map<int, Latency> latencies;
+
+    // Fixed seed so simulated runs can be repeated
+    std::mt19937 generator;
+
+    // Faults with their parameter, -1 for all of them
+    std::vector<std::pair<int, SimFault> > faults;
+
+    // Parameters whose readback ignores writes, until a time or until cleared
+    std::map<int, double> stuckUntil;
+
+    // Recorded writes still to replay for each parameter
+    std::map<int, std::deque<ReplayedWrite> > replay;
+
+    // Parameters whose reads fail since a replayed write, until the next write
+    std::map<int, double> readErrorFrom;
+
+    // Disconnected by a fault, until reconnectAt
+    bool disconnected;
+    double reconnectAt;
+
+    std::vector<PendingReadback> pendingReadbacks;
+    epicsEvent pendingEvent;
+    std::thread readbackThread;
+
+};
+
+#endif /* SIMELM3704SDOPORTDRIVER_H */